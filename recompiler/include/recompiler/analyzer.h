@@ -6,9 +6,11 @@
 #ifndef RECOMPILER_ANALYZER_H
 #define RECOMPILER_ANALYZER_H
 
+#include "containers.h"
 #include "decoder.h"
 #include "rom.h"
 #include <map>
+#include <optional>
 #include <set>
 #include <vector>
 #include <string>
@@ -79,26 +81,29 @@ struct AnalysisResult {
     // ROM reference
     const ROM* rom = nullptr;
     
-    // All decoded instructions
+    // All decoded instructions, in address order
     std::vector<Instruction> instructions;
     
     // Address to instruction index map
-    std::map<uint32_t, size_t> addr_to_index;  // (bank << 16 | addr) -> index
+    AddressIndex addr_to_index;  // (bank << 16 | addr) -> index
     
     // Basic blocks indexed by (bank << 16 | addr)
-    std::map<uint32_t, BasicBlock> blocks;
+    FlatMap<uint32_t, BasicBlock> blocks;
     
     // Functions indexed by (bank << 16 | addr)  
-    std::map<uint32_t, Function> functions;
+    FlatMap<uint32_t, Function> functions;
     
     // Labels needed (jump targets)
-    std::set<uint32_t> label_addresses;  // (bank << 16 | addr)
+    AddressSet label_addresses;  // (bank << 16 | addr)
     
     // Call targets (function entry points)
-    std::set<uint32_t> call_targets;
+    AddressSet call_targets;
     
     // Computed jump targets (JP HL, etc.)
-    std::set<uint32_t> computed_jump_targets;
+    AddressSet computed_jump_targets;
+    
+    // Proven jump tables: JP (HL) site -> every known target
+    std::map<uint32_t, std::set<uint32_t>> jump_tables;  // (bank << 16 | addr)
     
     // Bank switch points
     std::set<uint16_t> bank_switch_addresses;
@@ -147,17 +152,24 @@ struct AnalyzerOptions {
         uint16_t ram_addr;
         uint32_t rom_addr;
         uint16_t size;
+        bool oam_dma = false;           // Standard OAM DMA routine (find_oam_dma_routine)
     };
     std::vector<RamOverlay> ram_overlays;
     
     // Explicit list of entry points to analyze (in addition to standard ones)
     std::vector<uint32_t> entry_points;
+    
+    // Computed jump targets seen at runtime (gbrecomp --profile)
+    std::vector<uint32_t> jump_targets;
 
     bool analyze_all_banks = true;      // Analyze all ROM banks
     bool detect_computed_jumps = true;  // Try to resolve JP HL targets
     bool track_bank_switches = true;    // Track bank switch operations
     bool mark_unreachable = true;       // Mark unreachable code
     
+    // Worker threads for exploration (0 = one per hardware thread)
+    unsigned jobs = 0;
+    
     // Debugging options
     bool trace_log = false;             // Print detailed execution trace
     size_t max_instructions = 0;        // Max instructions to analyze (0 = infinite)
@@ -184,6 +196,46 @@ AnalysisResult analyze(const ROM& rom, const AnalyzerOptions& options = {});
 AnalysisResult analyze_bank(const ROM& rom, uint8_t bank,
                             const AnalyzerOptions& options = {});
 
+/**
+ * @brief Find the standard OAM DMA routine games copy to HRAM
+ * 
+ * Looks for LDH (46),A; LD A,n; DEC A; JR NZ,-3; RET anywhere in the ROM.
+ * The generated dispatcher runs the routine as one runtime call while
+ * HRAM still holds it.
+ * 
+ * @return Overlay mapping the routine to 0xFF80, or nullopt if not found
+ */
+std::optional<AnalyzerOptions::RamOverlay> find_oam_dma_routine(const ROM& rom);
+
+/* ============================================================================
+ * Analysis Cache
+ * ========================================================================== */
+
+/**
+ * @brief Key identifying an analysis: ROM contents plus every option that
+ * affects exploration. Debug options are excluded; they disable the cache.
+ */
+uint64_t analysis_cache_key(const ROM& rom, const AnalyzerOptions& options);
+
+/**
+ * @brief Serialize the exploration results of an analysis
+ * 
+ * Only discovered addresses and targets are stored; instructions, blocks
+ * and functions are rebuilt from the ROM on load.
+ * 
+ * @return true on success
+ */
+bool save_analysis(const AnalysisResult& result, const std::string& path, uint64_t key);
+
+/**
+ * @brief Reload an analysis saved by save_analysis
+ * 
+ * @return The analysis, or nullopt if the file is missing, corrupt, or
+ *         was saved under a different key
+ */
+std::optional<AnalysisResult> load_analysis(const ROM& rom, const AnalyzerOptions& options,
+                                            const std::string& path, uint64_t key);
+
 /* ============================================================================
  * Utility Functions
  * ========================================================================== */
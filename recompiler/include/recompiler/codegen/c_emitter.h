@@ -9,6 +9,7 @@
 #include "emitter.h"
 #include <sstream>
 #include <ostream>
+#include <vector>
 
 namespace gbrecomp {
 namespace codegen {
@@ -175,17 +176,55 @@ private:
  * @brief Generate complete output from IR program
  */
 struct GeneratedOutput {
+    struct File {
+        std::string name;
+        std::string content;
+    };
+    
     std::string header_content;
-    std::string source_content;
+    std::string internal_header_content;    // Prototypes and dispatch lookup
+    std::string source_content;             // Dispatch tables and entry points
     std::string rom_data_content;
     std::string main_content;
     std::string cmake_content;
     
     std::string header_file;
+    std::string internal_header_file;
     std::string source_file;
     std::string rom_data_file;
     std::string main_file;
     std::string cmake_file;
+    
+    // Raw ROM copy for the incbin/embed/external ROM modes (else empty)
+    std::string rom_image_content;
+    std::string rom_image_file;
+    
+    // Recompiled functions, split into independently compiled shards
+    std::vector<File> code_files;
+    
+    // Profiling side-cars (emit_symbol_map, emit_line_directives), else empty
+    std::string symbol_map_content;
+    std::string symbol_map_file;
+    std::string listing_content;
+    std::string listing_file;
+    
+    // Content hashes recorded in the output manifest
+    struct FunctionHash {
+        std::string name;
+        uint64_t ir_hash;
+        uint64_t text_hash;
+    };
+    std::vector<FunctionHash> function_hashes;
+};
+
+/**
+ * @brief What an incremental write_output did
+ */
+struct WriteStats {
+    size_t files_written = 0;
+    size_t files_unchanged = 0;     // Left untouched, mtime preserved
+    size_t files_removed = 0;       // Stale shards from a previous run
+    size_t functions_changed = 0;   // New, or IR/text differs from the manifest
 };
 
 /**
@@ -198,9 +237,16 @@ GeneratedOutput generate_output(const ir::Program& program,
 
 /**
  * @brief Write generated output to files
+ * 
+ * When incremental, files whose content hash matches the manifest from the
+ * previous run are not rewritten, so the generated project only rebuilds
+ * what changed. Files the previous run wrote but this one no longer
+ * produces are removed.
  */
 bool write_output(const GeneratedOutput& output,
-                  const std::string& output_dir);
+                  const std::string& output_dir,
+                  WriteStats* stats = nullptr,
+                  bool incremental = true);
 
 } // namespace codegen
 } // namespace gbrecomp
@@ -10,12 +10,32 @@
 #define RECOMPILER_CODEGEN_EMITTER_H
 
 #include "../ir/ir.h"
+#include "../analyzer.h"
 #include <string>
 #include <ostream>
+#include <vector>
 
 namespace gbrecomp {
 namespace codegen {
 
+/**
+ * @brief Granularity of emitted cycle accounting
+ */
+enum class TimingMode {
+    Instruction,    // Tick after every GB instruction
+    Block,          // One tick per basic block, split at timing-sensitive I/O
+};
+
+/**
+ * @brief How the ROM image reaches the generated program
+ */
+enum class RomEmbed {
+    Array,          // Hex initializer in <prefix>_rom.c (portable, slow to compile)
+    Incbin,         // Assembler .incbin of <prefix>.gb (GCC/Clang)
+    Embed,          // C23 #embed of <prefix>.gb
+    External,       // Nothing linked in; <prefix>.gb is mapped at startup
+};
+
 /**
  * @brief Generator options
  */
@@ -28,13 +48,48 @@ struct GeneratorOptions {
     bool single_function_mode = false;   // All code in one function
     bool use_prefixed_symbols = false;   // Prefix all symbols (for multi-ROM)
     bool embed_rom_data = true;          // Embed ROM data in output
+    RomEmbed rom_embed = RomEmbed::Array;
     bool debug_mode = false;             // Extra debug output
     
     // Cycle counting
     bool emit_cycle_counting = true;
+    TimingMode timing_mode = TimingMode::Instruction;
     
     // Bank handling
     bool generate_bank_dispatch = true;  // Generate runtime bank dispatch
+    
+    // Register allocation
+    bool cache_registers = false;        // Keep CPU registers in C locals
+    
+    // Compile for size: the instruction steps, returns and resolved calls
+    // repeated all over generated code become calls to out-of-line runtime
+    // helpers. Applies to all but profiled hot functions; cold ones are
+    // always compiled for size.
+    bool opt_size = false;
+    
+    // Lane kernels: blocks of register, flag and fixed WRAM0/HRAM operations
+    // are also compiled over a structure-of-arrays register file, so that a
+    // grouped batch (batch.h) runs instances entering them together
+    bool soa_kernels = false;
+    
+    // Superblocks: small functions reached by an unconditional same-bank
+    // jump or fallthrough are emitted inside their predecessor
+    size_t superblock_budget = 256;      // IR instructions a function may take in (0 = off)
+    
+    // Output sharding
+    size_t shard_bytes = 1 << 20;        // Split code files past this size (0 = one file)
+    bool shard_by_bank = false;          // Also split at every ROM bank
+    unsigned jobs = 0;                   // Generator threads (0 = one per hardware thread)
+    
+    // Profiling: a JSON map from generated C lines to bank:address, and
+    // #line directives attributing each instruction's C code to its line in
+    // a disassembly listing
+    bool emit_symbol_map = false;
+    bool emit_line_directives = false;
+    
+    // RAM routines recompiled from their ROM copies; the dispatcher only
+    // enters them while RAM still holds those bytes
+    std::vector<AnalyzerOptions::RamOverlay> ram_overlays;
 };
 
 /**
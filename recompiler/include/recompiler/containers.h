@@ -0,0 +1,345 @@
+/**
+ * @file containers.h
+ * @brief Flat containers for analysis and IR tables
+ *
+ * Code addresses are (bank << 16 | addr) and cluster densely inside 16 KiB
+ * banks, so membership and index lookups use per-bank paged arrays instead
+ * of node-based trees. Keyed tables that are built once and then searched
+ * use a sorted vector. Data that lives as long as the IR program (its
+ * instructions and strings) is bump-allocated from an arena.
+ */
+
+#ifndef RECOMPILER_CONTAINERS_H
+#define RECOMPILER_CONTAINERS_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace gbrecomp {
+
+/* ============================================================================
+ * Address Set
+ * ========================================================================== */
+
+/**
+ * @brief Bitset over (bank << 16 | addr)
+ *
+ * Each bank touched gets a 64 Ki-bit (8 KiB) bitmap on first insert.
+ * Iterates in ascending address order, like the std::set it replaces.
+ */
+class AddressSet {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = uint32_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const uint32_t*;
+        using reference = uint32_t;
+
+        const_iterator() = default;
+
+        uint32_t operator*() const { return pos_; }
+        const_iterator& operator++() { pos_ = set_->next(pos_ + 1); return *this; }
+        const_iterator operator++(int) { const_iterator it = *this; ++*this; return it; }
+        bool operator==(const const_iterator& other) const { return pos_ == other.pos_; }
+        bool operator!=(const const_iterator& other) const { return pos_ != other.pos_; }
+
+    private:
+        friend class AddressSet;
+        const_iterator(const AddressSet* set, uint32_t pos) : set_(set), pos_(pos) {}
+
+        const AddressSet* set_ = nullptr;
+        uint32_t pos_ = END;
+    };
+
+    bool insert(uint32_t addr) {
+        uint32_t bank = addr >> 16;
+        if (bank >= banks_.size()) banks_.resize(bank + 1);
+        std::vector<uint64_t>& bits = banks_[bank];
+        if (bits.empty()) bits.resize(WORDS_PER_BANK);
+        uint64_t& word = bits[(addr & 0xFFFF) >> 6];
+        uint64_t mask = uint64_t{1} << (addr & 63);
+        if (word & mask) return false;
+        word |= mask;
+        size_++;
+        return true;
+    }
+
+    template <typename It>
+    void insert(It first, It last) {
+        for (; first != last; ++first) insert(*first);
+    }
+
+    void insert(const AddressSet& other) {
+        for (uint32_t addr : other) insert(addr);
+    }
+
+    size_t count(uint32_t addr) const {
+        uint32_t bank = addr >> 16;
+        if (bank >= banks_.size() || banks_[bank].empty()) return 0;
+        return (banks_[bank][(addr & 0xFFFF) >> 6] >> (addr & 63)) & 1;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    void clear() { banks_.clear(); size_ = 0; }
+
+    const_iterator begin() const { return const_iterator(this, next(0)); }
+    const_iterator end() const { return const_iterator(this, END); }
+
+private:
+    static constexpr size_t WORDS_PER_BANK = 0x10000 / 64;
+    static constexpr uint32_t END = UINT32_MAX;
+
+    // First member at or after pos, or END
+    uint32_t next(uint32_t pos) const {
+        for (uint32_t bank = pos >> 16; bank < banks_.size(); bank++, pos = bank << 16) {
+            const std::vector<uint64_t>& bits = banks_[bank];
+            if (bits.empty()) continue;
+            size_t word_index = (pos & 0xFFFF) >> 6;
+            uint64_t word = bits[word_index] & (~uint64_t{0} << (pos & 63));
+            for (;;) {
+                if (word) {
+                    return (bank << 16) | static_cast<uint32_t>(word_index << 6) |
+                           static_cast<uint32_t>(std::countr_zero(word));
+                }
+                if (++word_index == WORDS_PER_BANK) break;
+                word = bits[word_index];
+            }
+        }
+        return END;
+    }
+
+    std::vector<std::vector<uint64_t>> banks_;  // Empty until the bank is touched
+    size_t size_ = 0;
+};
+
+/* ============================================================================
+ * Address Index
+ * ========================================================================== */
+
+/**
+ * @brief Dense map from (bank << 16 | addr) to an index
+ *
+ * Values live in 256-entry pages allocated on first write, so a bank only
+ * pays for the address ranges that actually hold code.
+ */
+class AddressIndex {
+public:
+    static constexpr size_t npos = SIZE_MAX;
+
+    void insert(uint32_t addr, size_t index) {
+        uint32_t page = addr >> 8;
+        if (page >= pages_.size()) pages_.resize(page + 1);
+        std::vector<uint32_t>& entries = pages_[page];
+        if (entries.empty()) entries.assign(256, EMPTY);
+        uint32_t& slot = entries[addr & 0xFF];
+        if (slot == EMPTY) size_++;
+        slot = static_cast<uint32_t>(index);
+    }
+
+    // Index stored for addr, or npos
+    size_t find(uint32_t addr) const {
+        uint32_t page = addr >> 8;
+        if (page >= pages_.size() || pages_[page].empty()) return npos;
+        uint32_t slot = pages_[page][addr & 0xFF];
+        return slot == EMPTY ? npos : slot;
+    }
+
+    size_t count(uint32_t addr) const { return find(addr) != npos; }
+    size_t size() const { return size_; }
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    std::vector<std::vector<uint32_t>> pages_;  // Empty until the page is touched
+    size_t size_ = 0;
+};
+
+/* ============================================================================
+ * Flat Map
+ * ========================================================================== */
+
+/**
+ * @brief Sorted-vector map for tables built once and then searched
+ *
+ * Appending keys in ascending order is O(1); out-of-order inserts shift the
+ * tail, so bulk-build out-of-order tables through the vector constructor.
+ */
+template <typename Key, typename Value>
+class FlatMap {
+public:
+    using value_type = std::pair<Key, Value>;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    FlatMap() = default;
+
+    // Takes unsorted entries; on duplicate keys the last one wins
+    explicit FlatMap(std::vector<value_type> entries) : entries_(std::move(entries)) {
+        std::stable_sort(entries_.begin(), entries_.end(),
+                         [](const value_type& a, const value_type& b) { return a.first < b.first; });
+        auto last = entries_.end();
+        auto out = entries_.begin();
+        for (auto it = entries_.begin(); it != last; ++it) {
+            if (out != entries_.begin() && !((out - 1)->first < it->first)) {
+                *(out - 1) = std::move(*it);
+            } else {
+                if (out != it) *out = std::move(*it);
+                ++out;
+            }
+        }
+        entries_.erase(out, last);
+    }
+
+    Value& operator[](const Key& key) {
+        if (entries_.empty() || entries_.back().first < key) {
+            entries_.emplace_back(key, Value{});
+            return entries_.back().second;
+        }
+        auto it = lower_bound(key);
+        if (it == entries_.end() || key < it->first) {
+            it = entries_.emplace(it, key, Value{});
+        }
+        return it->second;
+    }
+
+    iterator find(const Key& key) {
+        auto it = lower_bound(key);
+        return (it != entries_.end() && !(key < it->first)) ? it : entries_.end();
+    }
+
+    const_iterator find(const Key& key) const {
+        auto it = lower_bound(key);
+        return (it != entries_.end() && !(key < it->first)) ? it : entries_.end();
+    }
+
+    size_t count(const Key& key) const { return find(key) != end(); }
+
+    iterator begin() { return entries_.begin(); }
+    iterator end() { return entries_.end(); }
+    const_iterator begin() const { return entries_.begin(); }
+    const_iterator end() const { return entries_.end(); }
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+    void reserve(size_t n) { entries_.reserve(n); }
+    void clear() { entries_.clear(); }
+
+private:
+    iterator lower_bound(const Key& key) {
+        return std::lower_bound(entries_.begin(), entries_.end(), key,
+                                [](const value_type& e, const Key& k) { return e.first < k; });
+    }
+
+    const_iterator lower_bound(const Key& key) const {
+        return std::lower_bound(entries_.begin(), entries_.end(), key,
+                                [](const value_type& e, const Key& k) { return e.first < k; });
+    }
+
+    std::vector<value_type> entries_;
+};
+
+/* ============================================================================
+ * Arena
+ * ========================================================================== */
+
+/**
+ * @brief Bump allocator for data freed all at once with its owner
+ *
+ * Memory comes from 64 KiB chunks and is never returned one object at a
+ * time, so an allocation is a pointer bump with no per-object header.
+ * Chunks never move: what the arena hands out stays put when the arena
+ * itself is moved. Runs no destructors, so only trivial types go in.
+ */
+class Arena {
+public:
+    Arena() = default;
+    Arena(Arena&&) noexcept = default;
+    Arena& operator=(Arena&&) noexcept = default;
+
+    void* allocate(size_t size, size_t align) {
+        size_t offset = (used_ + align - 1) & ~(align - 1);
+        if (chunks_.empty() || offset + size > capacity_) {
+            // Chunks come from new[], aligned for any fundamental type
+            capacity_ = std::max(CHUNK_SIZE, size);
+            chunks_.emplace_back(new std::byte[capacity_]);
+            offset = 0;
+        }
+        used_ = offset + size;
+        return chunks_.back().get() + offset;
+    }
+
+    // Copy of items that lives as long as the arena
+    template <typename T>
+    std::span<T> copy(const std::vector<T>& items) {
+        static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+        if (items.empty()) return {};
+        T* data = static_cast<T*>(allocate(items.size() * sizeof(T), alignof(T)));
+        std::memcpy(static_cast<void*>(data), items.data(), items.size() * sizeof(T));
+        return {data, items.size()};
+    }
+
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<std::byte[]>> chunks_;
+    size_t capacity_ = 0;  // Of the last chunk
+    size_t used_ = 0;      // Of the last chunk
+};
+
+/* ============================================================================
+ * String Pool
+ * ========================================================================== */
+
+/**
+ * @brief Interned strings, named by dense 32-bit ids
+ *
+ * Each distinct string is stored once in the pool's arena. Id 0 is the
+ * empty string, so a zeroed id field means "none".
+ */
+class StringPool {
+public:
+    StringPool() { strings_.emplace_back(); }
+
+    uint32_t intern(std::string_view text) {
+        if (text.empty()) return 0;
+        auto it = ids_.find(text);
+        if (it != ids_.end()) return it->second;
+        char* data = static_cast<char*>(arena_.allocate(text.size(), 1));
+        std::memcpy(data, text.data(), text.size());
+        std::string_view stored(data, text.size());
+        uint32_t id = static_cast<uint32_t>(strings_.size());
+        strings_.push_back(stored);
+        ids_.emplace(stored, id);
+        return id;
+    }
+
+    // Empty for 0 and unknown ids
+    std::string_view view(uint32_t id) const {
+        return id < strings_.size() ? strings_[id] : std::string_view{};
+    }
+
+    size_t size() const { return strings_.size() - 1; }
+
+private:
+    Arena arena_;
+    std::vector<std::string_view> strings_;  // By id, pointing into arena_
+    std::unordered_map<std::string_view, uint32_t> ids_;
+};
+
+} // namespace gbrecomp
+
+#endif // RECOMPILER_CONTAINERS_H
@@ -255,6 +255,9 @@ class ROM;
 
 /**
  * @brief SM83 instruction decoder
+ * 
+ * Looks opcodes up in the compile-time tables of opcodes.h; disassembly
+ * text is only built when disassemble() is called.
  */
 class Decoder {
 public:
@@ -264,11 +267,6 @@ public:
     Instruction decode(uint16_t addr, uint8_t bank) const;
     
 private:
-    void decode_main(Instruction& instr, uint8_t opcode, 
-                     uint16_t addr, uint8_t bank) const;
-    Instruction decode_cb(uint16_t addr, uint8_t bank) const;
-    uint16_t read_u16(uint16_t addr, uint8_t bank) const;
-    
     const ROM& rom_;
 };
 
@@ -0,0 +1,54 @@
+/**
+ * @file hash.h
+ * @brief Stable content hashing for the recompilation caches
+ *
+ * FNV-1a over explicitly fed fields, so hashes do not depend on struct
+ * padding and stay valid across runs and builds of the recompiler.
+ */
+
+#ifndef RECOMPILER_HASH_H
+#define RECOMPILER_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace gbrecomp {
+
+class Hasher {
+public:
+    Hasher& bytes(const void* data, size_t size) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            state_ = (state_ ^ p[i]) * 0x100000001B3ull;
+        }
+        return *this;
+    }
+
+    // Integers are fed little-endian so the hash is host-independent
+    Hasher& u64(uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            uint8_t byte = static_cast<uint8_t>(value >> (i * 8));
+            bytes(&byte, 1);
+        }
+        return *this;
+    }
+
+    Hasher& str(std::string_view s) {
+        u64(s.size());
+        return bytes(s.data(), s.size());
+    }
+
+    uint64_t digest() const { return state_; }
+
+private:
+    uint64_t state_ = 0xCBF29CE484222325ull;
+};
+
+inline uint64_t hash_string(std::string_view s) {
+    return Hasher().bytes(s.data(), s.size()).digest();
+}
+
+} // namespace gbrecomp
+
+#endif // RECOMPILER_HASH_H
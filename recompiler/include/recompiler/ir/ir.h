@@ -9,11 +9,15 @@
 #ifndef RECOMPILER_IR_H
 #define RECOMPILER_IR_H
 
+#include "../containers.h"
 #include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <memory>
+#include <span>
+#include <string_view>
 
 namespace gbrecomp {
 namespace ir {
@@ -101,6 +105,11 @@ enum class Opcode : uint16_t {
     IO_WRITE,           // mem[0xFF00 + offset] = A
     IO_WRITE_C,         // mem[0xFF00 + C] = A
     
+    // === Loop Idioms (whole self-looping blocks, see IRBuilder) ===
+    BLOCK_COPY,         // do { A = mem[src]; mem[dst] = A; step pointers } while (--counter)
+    BLOCK_FILL,         // do { mem[dst] = value; step dst } while (--counter)
+    WAIT_LY,            // do { A = LY; compare with imm8 } while (condition)
+    
     // === Bank Switching (pseudo-ops) ===
     BANK_HINT,          // Hint: bank may have changed
     CROSS_BANK_CALL,    // Call that crosses bank boundary
@@ -164,6 +173,7 @@ struct Operand {
     static Operand offset(int8_t o);
     static Operand condition(uint8_t c);
     static Operand bit_idx(uint8_t b);
+    static Operand bank(uint8_t b);
     static Operand mem_reg16(uint8_t r);
     static Operand mem_imm16(uint16_t addr);
     static Operand io_offset(uint8_t off);
@@ -175,6 +185,13 @@ struct Operand {
  * Flag Effects
  * ========================================================================== */
 
+// Flag bits used by liveness analysis, one per GBContext f_* field
+constexpr uint8_t FLAG_Z = 0x8;
+constexpr uint8_t FLAG_N = 0x4;
+constexpr uint8_t FLAG_H = 0x2;
+constexpr uint8_t FLAG_C = 0x1;
+constexpr uint8_t FLAG_ALL = FLAG_Z | FLAG_N | FLAG_H | FLAG_C;
+
 struct FlagEffects {
     // Which flags are affected
     bool affects_z : 1;
@@ -199,6 +216,9 @@ struct FlagEffects {
     static FlagEffects z1hc();  // Z=computed, N=1, H=computed, C=computed
     static FlagEffects z0hc();  // Z=computed, N=0, H=computed, C=computed
     static FlagEffects only_c(); // Only carry affected
+    
+    // FLAG_* bits of the affected flags
+    uint8_t mask() const;
 };
 
 /* ============================================================================
@@ -222,8 +242,16 @@ struct IRInstruction {
     // Flag effects
     FlagEffects flags = FlagEffects::none();
     
-    // Debug info
-    std::string comment;
+    // Flags that may be read after this instruction before being overwritten;
+    // the emitter may skip computing the others (set by FlagElimination)
+    uint8_t live_flags = FLAG_ALL;
+    
+    // Per-iteration pointer steps of BLOCK_COPY (dst, src) and BLOCK_FILL (dst)
+    int8_t dst_step = 0;
+    int8_t src_step = 0;
+    
+    // Disassembly, interned in Program::strings (0 = none)
+    uint32_t comment = 0;
     
     // Factory methods
     static IRInstruction make_nop(uint8_t bank, uint16_t addr);
@@ -236,7 +264,7 @@ struct IRInstruction {
     static IRInstruction make_call(uint32_t label_id, uint8_t bank, uint16_t addr);
     static IRInstruction make_ret(uint8_t bank, uint16_t addr);
     static IRInstruction make_label(uint32_t label_id);
-    static IRInstruction make_comment(const std::string& text);
+    static IRInstruction make_comment(uint32_t text);
 };
 
 /* ============================================================================
@@ -245,12 +273,12 @@ struct IRInstruction {
 
 struct BasicBlock {
     uint32_t id;
-    std::string label;
-    std::vector<IRInstruction> instructions;
+    std::span<IRInstruction> instructions;  // In Program::arena
     
-    // Control flow
+    // Control flow within the owning function
     std::vector<uint32_t> successors;
     std::vector<uint32_t> predecessors;
+    bool has_external_exit = false;   // May leave the function (return, dispatch, other bank)
     
     // Bank info
     uint8_t bank = 0;
@@ -277,6 +305,11 @@ struct Function {
     bool is_interrupt_handler = false;
     bool is_entry_point = false;
     bool crosses_banks = false;
+    
+    // From a runtime profile (gbrecomp --profile): hot functions are laid
+    // out together and compiled for speed, cold ones are kept apart
+    bool hot = false;
+    bool cold = false;
 };
 
 /* ============================================================================
@@ -286,17 +319,19 @@ struct Function {
 struct Program {
     std::string rom_name;
     
-    // All basic blocks
-    std::map<uint32_t, BasicBlock> blocks;
+    // All basic blocks, indexed by id (ids are handed out in ascending order)
+    FlatMap<uint32_t, BasicBlock> blocks;
     uint32_t next_block_id = 0;
     
-    // Functions
-    std::map<std::string, Function> functions;
+    // Functions, sorted by name
+    FlatMap<std::string, Function> functions;
     
-    // Labels (for cross-referencing)
-    std::map<uint32_t, std::string> labels;         // id -> name
-    std::map<std::string, uint32_t> label_by_name;  // name -> id
-    uint32_t next_label_id = 0;
+    // Backing store of the blocks' instructions. Blocks point into it, so
+    // a program can be moved but not copied.
+    Arena arena;
+    
+    // Label names and comments; ids are resolved to text only at emission
+    StringPool strings;
     
     // ROM info
     uint8_t mbc_type = 0;
@@ -306,12 +341,20 @@ struct Program {
     uint16_t main_entry = 0x100;
     std::vector<uint16_t> interrupt_vectors;
     
+    // Known targets of computed jumps, (bank << 16 | addr) of the JP (HL) site
+    std::map<uint32_t, std::set<uint32_t>> jump_tables;
+    
+    // Registers and flags live before each instruction (lockstep.h
+    // GB_LIVE_* bits), keyed (bank << 16 | addr), where optimization may
+    // have left others stale. Filled by record_live_masks; absent = all live.
+    std::map<uint32_t, uint16_t> live_masks;
+    
     // Create a new block
     uint32_t create_block(uint8_t bank, uint16_t addr);
     
-    // Create/lookup labels
-    uint32_t create_label(const std::string& name);
-    uint32_t get_or_create_label(const std::string& name);
+    // Create/lookup labels (interned, so equal names share an id)
+    uint32_t create_label(std::string_view name);
+    uint32_t get_or_create_label(std::string_view name);
     std::string get_label_name(uint32_t id) const;
     
     // Generate unique label for address
@@ -331,7 +374,12 @@ const char* opcode_name(Opcode op);
 /**
  * @brief Print IR instruction for debugging
  */
-std::string format_instruction(const IRInstruction& instr);
+std::string format_instruction(const Program& program, const IRInstruction& instr);
+
+/**
+ * @brief Stable hash of a function's IR (blocks, instructions, operands)
+ */
+uint64_t hash_function(const Program& program, const Function& func);
 
 /**
  * @brief Print entire program for debugging
@@ -9,6 +9,7 @@
 #include "ir.h"
 #include "../decoder.h"
 #include "../analyzer.h"
+#include <utility>
 #include <vector>
 
 namespace gbrecomp {
@@ -21,6 +22,7 @@ struct BuilderOptions {
     bool emit_source_locations = true;   // Include source address info
     bool emit_comments = true;           // Include disassembly comments
     bool preserve_flags_exactly = true;  // Emit exact flag computations
+    bool recognize_idioms = true;        // Lower copy/fill/LY-wait loops to intrinsics
 };
 
 /**
@@ -38,38 +40,47 @@ public:
      * @return IR program
      */
     Program build(const AnalysisResult& analysis, const std::string& rom_name);
-    
-    /**
-     * @brief Lower a single instruction to IR
-     * 
-     * @param instr Decoded instruction
-     * @param block Block to append to
-     */
-    void lower_instruction(const Instruction& instr, BasicBlock& block);
 
 private:
     BuilderOptions options_;
     
+    // State of the running build(): the program, and the instructions
+    // lowered so far for the current block
+    Program* program_ = nullptr;
+    std::vector<IRInstruction> pending_;
+    
+    // Lower one instruction into pending_; build() copies each finished
+    // block's instructions into the program's arena
+    void lower_instruction(const Instruction& instr);
+    
     // Lowering helpers for instruction categories
-    void lower_load_r_r(const Instruction& instr, BasicBlock& block);
-    void lower_load_r_imm(const Instruction& instr, BasicBlock& block);
-    void lower_load_mem(const Instruction& instr, BasicBlock& block);
-    void lower_store_mem(const Instruction& instr, BasicBlock& block);
-    void lower_alu_r(const Instruction& instr, BasicBlock& block);
-    void lower_alu_imm(const Instruction& instr, BasicBlock& block);
-    void lower_inc_dec(const Instruction& instr, BasicBlock& block);
-    void lower_rotate_shift(const Instruction& instr, BasicBlock& block);
-    void lower_bit_op(const Instruction& instr, BasicBlock& block);
-    void lower_jump(const Instruction& instr, BasicBlock& block, Program& prog);
-    void lower_call(const Instruction& instr, BasicBlock& block, Program& prog);
-    void lower_ret(const Instruction& instr, BasicBlock& block);
-    void lower_misc(const Instruction& instr, BasicBlock& block);
-    void lower_io(const Instruction& instr, BasicBlock& block);
-    void lower_16bit_load(const Instruction& instr, BasicBlock& block);
-    void lower_16bit_alu(const Instruction& instr, BasicBlock& block);
+    void lower_load_r_r(const Instruction& instr);
+    void lower_load_r_imm(const Instruction& instr);
+    void lower_load_mem(const Instruction& instr);
+    void lower_store_mem(const Instruction& instr);
+    void lower_alu_r(const Instruction& instr);
+    void lower_alu_imm(const Instruction& instr);
+    void lower_inc_dec(const Instruction& instr);
+    void lower_rotate_shift(const Instruction& instr);
+    void lower_bit_op(const Instruction& instr);
+    void lower_jump(const Instruction& instr, Program& prog);
+    void lower_call(const Instruction& instr, Program& prog);
+    void lower_ret(const Instruction& instr);
+    void lower_misc(const Instruction& instr);
+    void lower_io(const Instruction& instr);
+    void lower_16bit_load(const Instruction& instr);
+    void lower_16bit_alu(const Instruction& instr);
+    
+    // Replace a self-looping block matching a copy, fill or LY wait loop by
+    // one intrinsic instruction; false if the block is no known idiom
+    bool lower_loop_idiom(const std::vector<const Instruction*>& body, BasicBlock& block);
     
     // Helper to add instruction with source location
-    void emit(BasicBlock& block, IRInstruction instr, const Instruction& src);
+    void emit(IRInstruction instr, const Instruction& src);
+    
+    // Fill successors/predecessors of one function's blocks from the analyzer CFG
+    void link_blocks(Program& program,
+                     const std::vector<std::pair<uint32_t, const gbrecomp::BasicBlock*>>& blocks);
 };
 
 } // namespace ir
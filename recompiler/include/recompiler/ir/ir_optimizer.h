@@ -16,7 +16,7 @@ namespace ir {
  */
 enum class OptLevel {
     O0,  // No optimization
-    O1,  // Basic optimizations (constant propagation, dead code)
+    O1,  // Basic optimizations (constant propagation, dead code, dead flags)
     O2,  // More aggressive (may affect debugging)
 };
 
@@ -36,6 +36,12 @@ public:
  * 
  * Propagates known constant values through registers.
  * Example: LD A, 5; LD B, A  →  LD A, 5; LD B, 5
+ * 
+ * Tracks A-L, SP and values pushed within a block. Register sources and
+ * pointers with known values become immediates and constant addresses,
+ * so LD A,(HL) and LDH A,(C) pick up region-specialized accesses. A
+ * constant write to the ROM bank register tags later direct calls into
+ * 0x4000-0x7FFF with the selected bank (a BANK extra operand).
  */
 class ConstantPropagation : public OptimizationPass {
 public:
@@ -46,7 +52,10 @@ public:
 /**
  * @brief Dead code elimination pass
  * 
- * Removes instructions whose results are never used.
+ * Removes instructions whose results are never used. Register and flag
+ * liveness is solved over each function's CFG (BasicBlock::successors);
+ * side-effect-free instructions whose results are all dead become NOPs
+ * that keep their cycle cost.
  */
 class DeadCodeElimination : public OptimizationPass {
 public:
@@ -68,8 +77,11 @@ public:
 /**
  * @brief Flag computation elimination
  * 
- * Removes flag computations that are immediately overwritten.
- * Must be used carefully - some games may read flags unexpectedly.
+ * Backward flag liveness over each function's blocks. Records in
+ * IRInstruction::live_flags which flags are read before the next writer
+ * so the emitter can skip computing the rest. Every exit that does not
+ * resolve to a block of the same function (calls, returns, dispatch,
+ * cross-bank jumps) keeps all flags live.
  */
 class FlagElimination : public OptimizationPass {
 public:
@@ -77,6 +89,16 @@ public:
     bool run(Program& program) override;
 };
 
+/**
+ * @brief Record which registers and flags are live before each instruction
+ * 
+ * Fills Program::live_masks with the DeadCodeElimination liveness of the
+ * final instruction stream, so lockstep validation can skip values the
+ * O1 passes legitimately left stale. An address in several functions
+ * keeps only what is live in all of them. optimize() runs it after O1.
+ */
+void record_live_masks(Program& program);
+
 /**
  * @brief Run optimization passes at the specified level
  * 
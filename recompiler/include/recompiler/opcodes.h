@@ -0,0 +1,390 @@
+/**
+ * @file opcodes.h
+ * @brief Compile-time SM83 opcode table
+ *
+ * Everything about an opcode that does not depend on its operand bytes -
+ * type, length, timing, register fields, control flow and memory/flag
+ * effects - is derived from the opcode's bit fields once, at compile time.
+ * Decoding an instruction is a table lookup plus reading its operand.
+ */
+
+#ifndef RECOMPILER_OPCODES_H
+#define RECOMPILER_OPCODES_H
+
+#include "decoder.h"
+#include <array>
+#include <cstdint>
+
+namespace gbrecomp {
+
+/**
+ * @brief Operand bytes following the opcode
+ */
+enum class OperandKind : uint8_t {
+    NONE,
+    IMM8,       // imm8
+    IMM16,      // imm16, little-endian
+    OFFSET8,    // signed offset (JR, ADD SP / LD HL,SP+)
+    PADDING,    // byte skipped by STOP
+};
+
+/* Flag bits in OpcodeInfo::flags */
+inline constexpr uint8_t OPCODE_FLAG_Z = 0x80;
+inline constexpr uint8_t OPCODE_FLAG_N = 0x40;
+inline constexpr uint8_t OPCODE_FLAG_H = 0x20;
+inline constexpr uint8_t OPCODE_FLAG_C = 0x10;
+
+/**
+ * @brief Operand-independent description of one opcode
+ */
+struct OpcodeInfo {
+    InstructionType type = InstructionType::UNDEFINED;
+    OperandKind operand = OperandKind::NONE;
+    uint8_t length = 1;
+    uint8_t cycles = 4;
+    uint8_t cycles_branch = 0;      // Cycles when a conditional branch is taken
+    Reg8 reg8_dst = Reg8::B;
+    Reg8 reg8_src = Reg8::B;
+    Reg16 reg16 = Reg16::BC;
+    Condition condition = Condition::NZ;
+    uint8_t bit_index = 0;
+    uint8_t rst_vector = 0;
+    uint8_t flags = 0;              // OPCODE_FLAG_* bits written
+    bool is_jump = false;
+    bool is_call = false;
+    bool is_return = false;
+    bool is_conditional = false;
+    bool is_terminator = false;     // Control never falls through
+    bool reads_memory = false;
+    bool writes_memory = false;
+    bool is_io = false;             // Always accesses 0xFF00-0xFFFF
+};
+
+namespace opcode_detail {
+
+inline constexpr Reg8 REG8[8] = {
+    Reg8::B, Reg8::C, Reg8::D, Reg8::E, Reg8::H, Reg8::L, Reg8::HL_IND, Reg8::A
+};
+inline constexpr Reg16 REG16[4] = { Reg16::BC, Reg16::DE, Reg16::HL, Reg16::SP };
+inline constexpr Reg16 REG16_STACK[4] = { Reg16::BC, Reg16::DE, Reg16::HL, Reg16::AF };
+inline constexpr Condition COND[4] = { Condition::NZ, Condition::Z, Condition::NC, Condition::C };
+
+inline constexpr uint8_t ZNHC = OPCODE_FLAG_Z | OPCODE_FLAG_N | OPCODE_FLAG_H | OPCODE_FLAG_C;
+inline constexpr uint8_t ZNH = OPCODE_FLAG_Z | OPCODE_FLAG_N | OPCODE_FLAG_H;
+inline constexpr uint8_t NHC = OPCODE_FLAG_N | OPCODE_FLAG_H | OPCODE_FLAG_C;
+
+// ALU operations by bits 3-5: register, (HL) and immediate forms
+inline constexpr InstructionType ALU_R[8] = {
+    InstructionType::ADD_A_R, InstructionType::ADC_A_R, InstructionType::SUB_A_R, InstructionType::SBC_A_R,
+    InstructionType::AND_A_R, InstructionType::XOR_A_R, InstructionType::OR_A_R, InstructionType::CP_A_R,
+};
+inline constexpr InstructionType ALU_HL[8] = {
+    InstructionType::ADD_A_HL, InstructionType::ADC_A_HL, InstructionType::SUB_A_HL, InstructionType::SBC_A_HL,
+    InstructionType::AND_A_HL, InstructionType::XOR_A_HL, InstructionType::OR_A_HL, InstructionType::CP_A_HL,
+};
+inline constexpr InstructionType ALU_N[8] = {
+    InstructionType::ADD_A_N, InstructionType::ADC_A_N, InstructionType::SUB_A_N, InstructionType::SBC_A_N,
+    InstructionType::AND_A_N, InstructionType::XOR_A_N, InstructionType::OR_A_N, InstructionType::CP_A_N,
+};
+
+// CB rotates and shifts by bits 3-5: register and (HL) forms
+inline constexpr InstructionType CB_SHIFT_R[8] = {
+    InstructionType::RLC_R, InstructionType::RRC_R, InstructionType::RL_R, InstructionType::RR_R,
+    InstructionType::SLA_R, InstructionType::SRA_R, InstructionType::SWAP_R, InstructionType::SRL_R,
+};
+inline constexpr InstructionType CB_SHIFT_HL[8] = {
+    InstructionType::RLC_HL, InstructionType::RRC_HL, InstructionType::RL_HL, InstructionType::RR_HL,
+    InstructionType::SLA_HL, InstructionType::SRA_HL, InstructionType::SWAP_HL, InstructionType::SRL_HL,
+};
+
+inline constexpr InstructionType ACC_ROTATE[8] = {
+    InstructionType::RLCA, InstructionType::RRCA, InstructionType::RLA, InstructionType::RRA,
+    InstructionType::DAA, InstructionType::CPL, InstructionType::SCF, InstructionType::CCF,
+};
+inline constexpr uint8_t ACC_ROTATE_FLAGS[8] = {
+    ZNHC, ZNHC, ZNHC, ZNHC,
+    OPCODE_FLAG_Z | OPCODE_FLAG_H | OPCODE_FLAG_C, OPCODE_FLAG_N | OPCODE_FLAG_H, NHC, NHC,
+};
+
+constexpr OpcodeInfo make(InstructionType type, uint8_t cycles,
+                          OperandKind operand = OperandKind::NONE) {
+    OpcodeInfo info;
+    info.type = type;
+    info.cycles = cycles;
+    info.operand = operand;
+    info.length = operand == OperandKind::NONE ? 1 : operand == OperandKind::IMM16 ? 3 : 2;
+    return info;
+}
+
+constexpr OpcodeInfo branch(InstructionType type, uint8_t cycles, uint8_t taken,
+                            OperandKind operand, int cond) {
+    OpcodeInfo info = make(type, cycles, operand);
+    if (cond >= 0) {
+        info.condition = COND[cond];
+        info.cycles_branch = taken;
+        info.is_conditional = true;
+    }
+    return info;
+}
+
+constexpr OpcodeInfo make_main(uint8_t op) {
+    const int x = op >> 6, y = (op >> 3) & 7, z = op & 7, p = y >> 1, q = y & 1;
+    OpcodeInfo info;
+
+    if (x == 0) {
+        switch (z) {
+            case 0:
+                if (y == 0) return make(InstructionType::NOP, 4);
+                if (y == 1) {
+                    info = make(InstructionType::LD_NN_SP, 20, OperandKind::IMM16);
+                    info.writes_memory = true;
+                    return info;
+                }
+                if (y == 2) return make(InstructionType::STOP, 4, OperandKind::PADDING);
+                info = y == 3 ? branch(InstructionType::JR_N, 12, 0, OperandKind::OFFSET8, -1)
+                              : branch(InstructionType::JR_CC_N, 8, 12, OperandKind::OFFSET8, y - 4);
+                info.is_jump = true;
+                info.is_terminator = y == 3;
+                return info;
+            case 1:
+                if (q == 0) {
+                    info = make(InstructionType::LD_RR_NN, 12, OperandKind::IMM16);
+                } else {
+                    info = make(InstructionType::ADD_HL_RR, 8);
+                    info.flags = NHC;
+                }
+                info.reg16 = REG16[p];
+                return info;
+            case 2: {
+                constexpr InstructionType stores[4] = {
+                    InstructionType::LD_BC_A, InstructionType::LD_DE_A,
+                    InstructionType::LD_HLI_A, InstructionType::LD_HLD_A,
+                };
+                constexpr InstructionType loads[4] = {
+                    InstructionType::LD_A_BC, InstructionType::LD_A_DE,
+                    InstructionType::LD_A_HLI, InstructionType::LD_A_HLD,
+                };
+                info = make(q == 0 ? stores[p] : loads[p], 8);
+                info.writes_memory = q == 0;
+                info.reads_memory = q == 1;
+                return info;
+            }
+            case 3:
+                info = make(q == 0 ? InstructionType::INC_RR : InstructionType::DEC_RR, 8);
+                info.reg16 = REG16[p];
+                return info;
+            case 4:
+            case 5:
+                if (y == 6) {
+                    info = make(z == 4 ? InstructionType::INC_HL_IND : InstructionType::DEC_HL_IND, 12);
+                    info.reads_memory = info.writes_memory = true;
+                } else {
+                    info = make(z == 4 ? InstructionType::INC_R : InstructionType::DEC_R, 4);
+                    info.reg8_dst = REG8[y];
+                }
+                info.flags = ZNH;
+                return info;
+            case 6:
+                if (y == 6) {
+                    info = make(InstructionType::LD_HL_N, 12, OperandKind::IMM8);
+                    info.writes_memory = true;
+                } else {
+                    info = make(InstructionType::LD_R_N, 8, OperandKind::IMM8);
+                    info.reg8_dst = REG8[y];
+                }
+                return info;
+            default:
+                info = make(ACC_ROTATE[y], 4);
+                info.flags = ACC_ROTATE_FLAGS[y];
+                return info;
+        }
+    }
+
+    if (x == 1) {
+        if (op == 0x76) return make(InstructionType::HALT, 4);
+        if (z == 6) {
+            info = make(InstructionType::LD_R_HL, 8);
+            info.reg8_dst = REG8[y];
+            info.reads_memory = true;
+        } else if (y == 6) {
+            info = make(InstructionType::LD_HL_R, 8);
+            info.reg8_src = REG8[z];
+            info.writes_memory = true;
+        } else {
+            info = make(InstructionType::LD_R_R, 4);
+            info.reg8_dst = REG8[y];
+            info.reg8_src = REG8[z];
+        }
+        return info;
+    }
+
+    if (x == 2) {
+        if (z == 6) {
+            info = make(ALU_HL[y], 8);
+            info.reads_memory = true;
+        } else {
+            info = make(ALU_R[y], 4);
+            info.reg8_src = REG8[z];
+        }
+        info.flags = ZNHC;
+        return info;
+    }
+
+    switch (z) {
+        case 0:
+            if (y < 4) {
+                info = branch(InstructionType::RET_CC, 8, 20, OperandKind::NONE, y);
+                info.is_return = true;
+                info.reads_memory = true;
+                return info;
+            }
+            if (y == 4 || y == 6) {
+                info = make(y == 4 ? InstructionType::LDH_N_A : InstructionType::LDH_A_N, 12, OperandKind::IMM8);
+                info.writes_memory = y == 4;
+                info.reads_memory = y == 6;
+                info.is_io = true;
+                return info;
+            }
+            info = y == 5 ? make(InstructionType::ADD_SP_N, 16, OperandKind::OFFSET8)
+                          : make(InstructionType::LD_HL_SP_N, 12, OperandKind::OFFSET8);
+            info.flags = ZNHC;
+            return info;
+        case 1:
+            if (q == 0) {
+                info = make(InstructionType::POP, 12);
+                info.reg16 = REG16_STACK[p];
+                info.reads_memory = true;
+                if (p == 3) info.flags = ZNHC;
+                return info;
+            }
+            if (p <= 1) {
+                info = make(p == 0 ? InstructionType::RET : InstructionType::RETI, 16);
+                info.is_return = true;
+                info.is_terminator = true;
+                info.reads_memory = true;
+                return info;
+            }
+            if (p == 2) {
+                info = make(InstructionType::JP_HL, 4);
+                info.is_jump = true;
+                info.is_terminator = true;
+                return info;
+            }
+            return make(InstructionType::LD_SP_HL, 8);
+        case 2:
+            if (y < 4) {
+                info = branch(InstructionType::JP_CC_NN, 12, 16, OperandKind::IMM16, y);
+                info.is_jump = true;
+                return info;
+            }
+            if (y == 4 || y == 6) {
+                info = make(y == 4 ? InstructionType::LDH_C_A : InstructionType::LDH_A_C, 8);
+                info.writes_memory = y == 4;
+                info.reads_memory = y == 6;
+                info.is_io = true;
+                return info;
+            }
+            info = make(y == 5 ? InstructionType::LD_NN_A : InstructionType::LD_A_NN, 16, OperandKind::IMM16);
+            info.writes_memory = y == 5;
+            info.reads_memory = y == 7;
+            return info;
+        case 3:
+            if (y == 0) {
+                info = make(InstructionType::JP_NN, 16, OperandKind::IMM16);
+                info.is_jump = true;
+                info.is_terminator = true;
+                return info;
+            }
+            if (y == 1) {
+                // CB prefix; only the length is meaningful here
+                info.length = 2;
+                return info;
+            }
+            if (y == 6) return make(InstructionType::DI, 4);
+            if (y == 7) return make(InstructionType::EI, 4);
+            return info;
+        case 4:
+            if (y >= 4) return info;
+            info = branch(InstructionType::CALL_CC_NN, 12, 24, OperandKind::IMM16, y);
+            info.is_call = true;
+            info.writes_memory = true;
+            return info;
+        case 5:
+            if (q == 0) {
+                info = make(InstructionType::PUSH, 16);
+                info.reg16 = REG16_STACK[p];
+                info.writes_memory = true;
+                return info;
+            }
+            if (p != 0) return info;
+            info = make(InstructionType::CALL_NN, 24, OperandKind::IMM16);
+            info.is_call = true;
+            info.writes_memory = true;
+            return info;
+        case 6:
+            info = make(ALU_N[y], 8, OperandKind::IMM8);
+            info.flags = ZNHC;
+            return info;
+        default:
+            info = make(InstructionType::RST, 16);
+            info.rst_vector = static_cast<uint8_t>(y * 8);
+            info.is_call = true;
+            info.writes_memory = true;
+            return info;
+    }
+}
+
+constexpr OpcodeInfo make_cb(uint8_t op) {
+    const int x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+    const bool hl = z == 6;
+    OpcodeInfo info;
+    info.length = 2;
+    info.reg8_dst = info.reg8_src = REG8[z];
+    info.bit_index = static_cast<uint8_t>(y);
+    info.cycles = hl ? 16 : 8;
+    info.reads_memory = hl;
+    info.writes_memory = hl;
+    switch (x) {
+        case 0:
+            info.type = hl ? CB_SHIFT_HL[y] : CB_SHIFT_R[y];
+            info.flags = ZNHC;
+            break;
+        case 1:
+            info.type = hl ? InstructionType::BIT_N_HL : InstructionType::BIT_N_R;
+            info.cycles = hl ? 12 : 8;
+            info.writes_memory = false;
+            info.flags = ZNH;
+            break;
+        case 2:
+            info.type = hl ? InstructionType::RES_N_HL : InstructionType::RES_N_R;
+            break;
+        default:
+            info.type = hl ? InstructionType::SET_N_HL : InstructionType::SET_N_R;
+            break;
+    }
+    return info;
+}
+
+template <OpcodeInfo (*Make)(uint8_t)>
+constexpr std::array<OpcodeInfo, 256> build() {
+    std::array<OpcodeInfo, 256> table{};
+    for (int op = 0; op < 256; op++) table[op] = Make(static_cast<uint8_t>(op));
+    return table;
+}
+
+} // namespace opcode_detail
+
+/** Unprefixed opcodes; the 0xCB entry only gives the prefixed length */
+inline constexpr std::array<OpcodeInfo, 256> MAIN_OPCODES = opcode_detail::build<opcode_detail::make_main>();
+
+/** CB-prefixed opcodes, indexed by the byte after 0xCB */
+inline constexpr std::array<OpcodeInfo, 256> CB_OPCODES = opcode_detail::build<opcode_detail::make_cb>();
+
+static_assert(MAIN_OPCODES[0xCD].length == 3 && MAIN_OPCODES[0xCD].cycles == 24);
+static_assert(MAIN_OPCODES[0x20].cycles_branch == 12 && MAIN_OPCODES[0x20].condition == Condition::NZ);
+static_assert(MAIN_OPCODES[0xD3].type == InstructionType::UNDEFINED);
+static_assert(CB_OPCODES[0x46].type == InstructionType::BIT_N_HL && CB_OPCODES[0x46].cycles == 12);
+
+} // namespace gbrecomp
+
+#endif // RECOMPILER_OPCODES_H
@@ -0,0 +1,62 @@
+/**
+ * @file profile.h
+ * @brief Runtime profiles for profile-guided recompilation
+ *
+ * A profile is the JSON written by the runtime's hotspot counters
+ * (runtime/include/hotspot.h): per bank:address, how often a recompiled
+ * function was entered, how often and for how many instructions the
+ * interpreter ran there, and how often a computed jump landed there.
+ */
+
+#ifndef RECOMPILER_PROFILE_H
+#define RECOMPILER_PROFILE_H
+
+#include "analyzer.h"
+#include "ir/ir.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace gbrecomp {
+
+struct RuntimeProfile {
+    struct Site {
+        uint8_t bank = 0;
+        uint16_t addr = 0;
+        uint64_t calls = 0;
+        uint64_t fallbacks = 0;
+        uint64_t instructions = 0;
+        uint64_t jumps = 0;
+    };
+    std::vector<Site> sites;
+};
+
+/**
+ * @brief Load a profile written by gb_hotspots_write_profile
+ * @param error Receives the reason on failure
+ */
+std::optional<RuntimeProfile> load_profile(const std::string& path, std::string& error);
+
+/**
+ * @brief Add the interpreted addresses and computed jump targets to the analysis
+ */
+void add_profile_hints(const RuntimeProfile& profile, AnalyzerOptions& options);
+
+struct ProfileStats {
+    size_t hot = 0;
+    size_t cold = 0;
+};
+
+/**
+ * @brief Mark hot and cold functions
+ *
+ * Functions are weighted by entries plus interpreted instructions. The
+ * heaviest ones that together make up hot_share of the total weight are
+ * hot; functions the profiled run never entered are cold.
+ */
+ProfileStats apply_profile(const RuntimeProfile& profile, ir::Program& program, double hot_share = 0.9);
+
+} // namespace gbrecomp
+
+#endif // RECOMPILER_PROFILE_H
@@ -4,8 +4,17 @@
  */
 
 #include "recompiler/analyzer.h"
+#include "recompiler/hash.h"
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <queue>
+#include <thread>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
@@ -33,10 +42,9 @@ static uint16_t get_offset(uint32_t addr) {
  * ========================================================================== */
 
 const Instruction* AnalysisResult::get_instruction(uint8_t bank, uint16_t addr) const {
-    uint32_t full_addr = make_addr(bank, addr);
-    auto it = addr_to_index.find(full_addr);
-    if (it != addr_to_index.end() && it->second < instructions.size()) {
-        return &instructions[it->second];
+    size_t index = addr_to_index.find(make_addr(bank, addr));
+    if (index != AddressIndex::npos && index < instructions.size()) {
+        return &instructions[index];
     }
     return nullptr;
 }
@@ -112,6 +120,20 @@ static bool is_rst28_jump_table(const ROM& rom) {
     return false;
 }
 
+/**
+ * @brief Address of the JP (HL) that ends the RST 28 dispatcher
+ * 
+ * Only meaningful when is_rst28_jump_table() holds.
+ */
+static uint16_t rst28_jump_site(const ROM& rom) {
+    for (uint16_t addr = 0x2A; addr < 0x40; addr++) {
+        if (rom.read_banked(0, addr) == 0xE9) {
+            return addr;
+        }
+    }
+    return 0;
+}
+
 /**
  * @brief Check if RST 28 falls through into RST 30
  * 
@@ -238,287 +260,428 @@ static std::set<uint8_t> detect_bank_values(const ROM& rom) {
 }
 
 /* ============================================================================
- * Analysis Implementation
+ * Parallel Exploration
  * ========================================================================== */
 
-AnalysisResult analyze(const ROM& rom, const AnalyzerOptions& options) {
-    AnalysisResult result;
-    result.rom = &rom;
-    result.entry_point = 0x100;
+namespace {
+
+/**
+ * @brief Canonical work item for an address
+ * 
+ * 0x0000-0x3FFF always lives in bank 0, and switchable addresses reached
+ * from bank 0 default to bank 1. The bank of the canonical address decides
+ * which worklist owns it.
+ */
+uint32_t canonical_address(uint32_t addr) {
+    uint16_t offset = get_offset(addr);
+    if (offset < 0x4000) return make_address(0, offset);
+    if (offset < 0x8000 && get_bank(addr) == 0) return make_address(1, offset);
+    return addr;
+}
+
+/**
+ * @brief Decode the instruction at a canonical address
+ * 
+ * Addresses inside a RAM overlay decode from the overlay's ROM source and
+ * are relocated to the RAM address. Returns false outside ROM and overlays.
+ */
+bool decode_at(const Decoder& decoder, const ROM& rom, const AnalyzerOptions& options,
+               uint32_t addr, Instruction& instr) {
+    uint8_t bank = get_bank(addr);
+    uint16_t offset = get_offset(addr);
     
-    // Add standard GameBoy entry points
-    result.interrupt_vectors = {0x40, 0x48, 0x50, 0x58, 0x60};  // Interrupt vectors
+    // Check if inside any RAM overlay
+    const AnalyzerOptions::RamOverlay* overlay = nullptr;
+    for (const auto& ov : options.ram_overlays) {
+        if (offset >= ov.ram_addr && offset < ov.ram_addr + ov.size) {
+            overlay = &ov;
+            break;
+        }
+    }
     
-    Decoder decoder(rom);
+    // Only analyze ROM space or RAM overlays
+    if (offset >= 0x8000 && !overlay) return false;
     
-    // Detect which banks are used
-    std::set<uint8_t> known_banks = detect_bank_values(rom);
+    // Calculate ROM offset for reading
+    size_t rom_offset;
+    if (overlay) {
+        // Map RAM address to ROM source
+        // Note: overlay->rom_addr is full 32-bit address (bank | addr)
+        uint8_t src_bank = get_bank(overlay->rom_addr);
+        uint16_t src_addr = get_offset(overlay->rom_addr);
+        
+        if (src_addr < 0x4000) {
+            rom_offset = src_addr;
+        } else {
+            rom_offset = static_cast<size_t>(src_bank) * 0x4000 + (src_addr - 0x4000);
+        }
+        // Add offset within the overlay
+        rom_offset += (offset - overlay->ram_addr);
+    } else if (offset < 0x4000) {
+        rom_offset = offset;
+    } else {
+        rom_offset = static_cast<size_t>(bank) * 0x4000 + (offset - 0x4000);
+    }
+    if (rom_offset >= rom.size()) return false;
     
-    // Track addresses to explore: (bank, addr, known_bank_state)
-    // We explore each bank separately for code in 0x4000-0x7FFF
-    std::queue<uint32_t> work_queue;
-    std::set<uint32_t> visited;
+    // Decode instruction
+    if (overlay) {
+        // Decode at the ROM source, then relocate to the RAM address.
+        // Overlays are small and assumed not to cross a bank boundary.
+        uint8_t src_bank = get_bank(overlay->rom_addr);
+        uint16_t src_addr = get_offset(overlay->rom_addr) + (offset - overlay->ram_addr);
+        
+        instr = decoder.decode(src_addr, src_bank);
+        instr.address = offset;
+        instr.bank = 0; // RAM is bank 0
+    } else {
+        instr = decoder.decode(offset, bank);
+    }
+    return true;
+}
+
+/**
+ * @brief Everything discovered while exploring one bank
+ * 
+ * Only the worker currently draining a bank touches its results, so they
+ * need no locking; other banks reach it through the inbox.
+ */
+struct BankState {
+    std::vector<uint32_t> worklist;
+    AddressSet visited;
     
-    // Entry point is always a function (bank 0)
-    result.call_targets.insert(make_address(0, 0x100));
+    std::vector<std::pair<uint32_t, Instruction>> instructions;
+    AddressSet call_targets;
+    AddressSet label_addresses;
+    AddressSet computed_jump_targets;
+    std::map<uint32_t, std::set<uint32_t>> jump_tables;
+    size_t cross_bank_calls = 0;
     
-    // RST vectors are implicit functions (always bank 0)
-    // Skip any RST vector that contains only 0xFF padding (common in many ROMs)
-    // Also skip RST 30 when RST 28 uses it as part of its jump table implementation
-    bool skip_rst30 = rst28_uses_rst30(rom);
-    for (uint16_t vec : {0x00, 0x08, 0x10, 0x18, 0x20, 0x28, 0x30, 0x38}) {
-        if (is_rst_padding(rom, vec)) {
-            continue;  // Skip this RST vector - contains only padding
-        }
-        if (vec == 0x30 && skip_rst30) {
-            continue;  // Skip RST 30 - it's part of RST 28's jump table implementation
-        }
-        result.call_targets.insert(make_address(0, vec));
-        work_queue.push(make_address(0, vec));
+    // Log lines keyed by address, printed in address order after the merge
+    std::map<uint32_t, std::string> errors;     // stdout
+    std::map<uint32_t, std::string> notes;      // stderr
+    
+    // Cross-bank targets posted by other workers
+    std::mutex inbox_mutex;
+    std::vector<uint32_t> inbox;
+    bool scheduled = false;     // Queued or being drained (guarded by inbox_mutex)
+};
+
+/**
+ * @brief Work-stealing explorer over per-bank worklists
+ * 
+ * Each bank is explored by one worker at a time. Targets in the same bank
+ * go straight onto its worklist; targets in other banks are posted to the
+ * owning bank's inbox, which queues that bank on the poster's deque if it
+ * was idle. Idle workers steal banks from the back of other deques.
+ * 
+ * The set of explored addresses is the reachability closure of the seeds,
+ * so the merged result does not depend on scheduling.
+ */
+class Explorer {
+public:
+    Explorer(const ROM& rom, const AnalyzerOptions& options, unsigned threads)
+        : rom_(rom), options_(options), decoder_(rom), threads_(threads) {
+        for (auto& bank : banks_) bank = std::make_unique<BankState>();
+        for (unsigned i = 0; i < threads_; i++) queues_.push_back(std::make_unique<WorkQueue>());
     }
     
-    // Interrupt vectors are functions (bank 0)
-    for (uint16_t vec : result.interrupt_vectors) {
-        result.call_targets.insert(make_address(0, vec));
-        work_queue.push(make_address(0, vec));
+    void seed(uint32_t addr) {
+        addr = canonical_address(addr);
+        post(get_bank(addr) % threads_, addr);
     }
     
-    // Start from entry point
-    work_queue.push(make_address(0, 0x100));
+    void run() {
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < threads_; i++) {
+            workers.emplace_back([this, i] { work(i); });
+        }
+        work(0);
+        for (auto& worker : workers) worker.join();
+    }
     
-    // For MBC games, also analyze code at entry point in each bank
-    // This catches trampoline code that jumps from bank 0 to banked code
-    if (rom.header().mbc_type != MBCType::NONE && options.analyze_all_banks) {
-        std::cerr << "Analyzing all " << known_banks.size() << " banks\n";
-        for (uint8_t bank : known_banks) {
-            if (bank > 0) {
-                // Check for code at common bank entry points
-                // Many games have jump tables or trampolines at 0x4000
-                work_queue.push(make_address(bank, 0x4000));
-                result.call_targets.insert(make_address(bank, 0x4000));
+    void merge(AnalysisResult& result, AddressSet& visited) {
+        std::vector<std::pair<uint32_t, Instruction>> instructions;
+        std::map<uint32_t, std::string> errors, notes;
+        for (auto& bank : banks_) {
+            BankState& state = *bank;
+            for (auto& entry : state.instructions) instructions.push_back(std::move(entry));
+            visited.insert(state.visited);
+            result.call_targets.insert(state.call_targets);
+            result.label_addresses.insert(state.label_addresses);
+            result.computed_jump_targets.insert(state.computed_jump_targets);
+            for (auto& [site, targets] : state.jump_tables) {
+                result.jump_tables[site].insert(targets.begin(), targets.end());
             }
+            result.stats.cross_bank_calls += state.cross_bank_calls;
+            errors.merge(state.errors);
+            notes.merge(state.notes);
+        }
+        
+        std::sort(instructions.begin(), instructions.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        result.instructions.reserve(instructions.size());
+        for (auto& [addr, instr] : instructions) {
+            result.addr_to_index.insert(addr, result.instructions.size());
+            result.instructions.push_back(std::move(instr));
+        }
+        
+        for (const auto& [addr, message] : errors) std::cout << message;
+        for (const auto& [addr, message] : notes) std::cerr << message;
+        if (limit_reached_) {
+            std::cerr << "Reached instruction limit (" << options_.max_instructions << ")\n";
         }
     }
     
-    // Add overlay entry points
-    for (const auto& ov : options.ram_overlays) {
-        uint32_t addr = make_address(0, ov.ram_addr);
-        result.call_targets.insert(addr);
-        work_queue.push(addr);
-    }
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<uint8_t> banks;
+    };
     
-    // Explore all reachable code
-    while (!work_queue.empty()) {
-        uint32_t addr = work_queue.front();
-        work_queue.pop();
-        
-        if (visited.count(addr)) continue;
-        
+    void post(unsigned worker, uint32_t addr) {
         uint8_t bank = get_bank(addr);
-        uint16_t offset = get_offset(addr);
-        
-        // Check if inside any RAM overlay
-        const AnalyzerOptions::RamOverlay* overlay = nullptr;
-        for (const auto& ov : options.ram_overlays) {
-            if (offset >= ov.ram_addr && offset < ov.ram_addr + ov.size) {
-                overlay = &ov;
-                break;
-            }
+        BankState& state = *banks_[bank];
+        bool wake;
+        {
+            std::lock_guard<std::mutex> lock(state.inbox_mutex);
+            state.inbox.push_back(addr);
+            wake = !state.scheduled;
+            state.scheduled = true;
         }
-        
-        // Only analyze ROM space or RAM overlays
-        if (offset >= 0x8000 && !overlay) continue;
-        
-        // Bank mapping rules:
-        // 0x0000-0x3FFF: Always bank 0
-        // 0x4000-0x7FFF: Switchable bank (1-N)
-        if (offset < 0x4000) {
-            bank = 0;  // Force bank 0 for this region
-            addr = make_address(0, offset);
-            if (visited.count(addr)) continue;
-        } else if (offset < 0x8000 && bank == 0) {
-            bank = 1;  // Default to bank 1 for switchable region
-            addr = make_address(1, offset);
-            if (visited.count(addr)) continue;
-        } else if (overlay) {
-            // Keep original bank/addr for overlays
-             if (visited.count(addr)) continue;
+        if (wake) {
+            outstanding_++;
+            WorkQueue& queue = *queues_[worker];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.banks.push_back(bank);
         }
-        
-        // Calculate ROM offset for reading
-        size_t rom_offset;
-        if (overlay) {
-            // Map RAM address to ROM source
-            // Note: overlay->rom_addr is full 32-bit address (bank | addr)
-            // But ROM object access is handled by decoder? 
-            // We need linear offset for bounds check.
-            uint8_t src_bank = get_bank(overlay->rom_addr);
-            uint16_t src_addr = get_offset(overlay->rom_addr);
-            
-            if (src_addr < 0x4000) {
-                rom_offset = src_addr;
+    }
+    
+    bool take(unsigned worker, uint8_t& bank) {
+        for (unsigned i = 0; i < threads_; i++) {
+            WorkQueue& queue = *queues_[(worker + i) % threads_];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.banks.empty()) continue;
+            if (i == 0) {
+                bank = queue.banks.front();
+                queue.banks.pop_front();
             } else {
-                rom_offset = static_cast<size_t>(src_bank) * 0x4000 + (src_addr - 0x4000);
+                bank = queue.banks.back();
+                queue.banks.pop_back();
             }
-            // Add offset within the overlay
-            rom_offset += (offset - overlay->ram_addr);
-        } else if (offset < 0x4000) {
-            rom_offset = offset;
-        } else {
-            rom_offset = static_cast<size_t>(bank) * 0x4000 + (offset - 0x4000);
+            return true;
         }
-        if (rom_offset >= rom.size()) continue;
-        
-        visited.insert(addr);
-        
-        // Decode instruction
-        Instruction instr;
-        if (overlay) {
-            // Decode at the source address (calculating bank/addr from rom_offset is hard if purely linear)
-            // But we can just use the rom source addr + offset
-             // Actually, overlay->rom_addr is 0x00BB_AAAA (Bank, Addr).
-             // If we cross 0x4000/0x8000 boundary this math is wrong for packed uint32.
-             // But overlays are usually small and within one bank.
-             uint8_t src_bank = get_bank(overlay->rom_addr);
-             uint16_t src_addr = get_offset(overlay->rom_addr) + (offset - overlay->ram_addr);
-             
-             instr = decoder.decode(src_addr, src_bank);
-             
-             // Relocate to RAM address
-             instr.address = offset; 
-             instr.bank = 0; // RAM is bank 0
-        } else {
-            instr = decoder.decode(offset, bank);
+        return false;
+    }
+    
+    void work(unsigned worker) {
+        while (!limit_reached_) {
+            uint8_t bank;
+            if (take(worker, bank)) {
+                drain(worker, bank);
+            } else if (outstanding_ == 0) {
+                break;
+            } else {
+                std::this_thread::yield();
+            }
         }
-
-        // Trace logging
-        if (options.trace_log) {
-            std::cout << "[TRACE] " << std::hex << std::setfill('0') << std::setw(2) << (int)bank
-                      << ":" << std::setw(4) << offset << " " << instr.disassemble() << std::dec << "\n";
+    }
+    
+    void drain(unsigned worker, uint8_t bank) {
+        BankState& state = *banks_[bank];
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(state.inbox_mutex);
+                if (state.inbox.empty() || limit_reached_) {
+                    state.scheduled = false;
+                    break;
+                }
+                state.worklist.insert(state.worklist.end(), state.inbox.begin(), state.inbox.end());
+                state.inbox.clear();
+            }
+            while (!state.worklist.empty() && !limit_reached_) {
+                uint32_t addr = state.worklist.back();
+                state.worklist.pop_back();
+                explore(worker, state, addr);
+            }
         }
-
-        // Check for undefined instructions
-        if (instr.type == InstructionType::UNDEFINED) {
-             std::cout << "[ERROR] Undefined instruction at " 
-                       << std::hex << std::setfill('0') << std::setw(2) << (int)bank << ":" << std::setw(4) << offset 
-                       << " Opcode: " << std::setw(2) << (int)instr.opcode << std::dec << "\n";
+        outstanding_--;
+    }
+    
+    void push(unsigned worker, BankState& state, uint32_t addr) {
+        addr = canonical_address(addr);
+        if (banks_[get_bank(addr)].get() == &state) {
+            if (!state.visited.count(addr)) state.worklist.push_back(addr);
+        } else {
+            post(worker, addr);
         }
+    }
+    
+    void explore(unsigned worker, BankState& state, uint32_t addr);
+    
+    const ROM& rom_;
+    const AnalyzerOptions& options_;
+    Decoder decoder_;
+    unsigned threads_;
+    
+    std::array<std::unique_ptr<BankState>, 256> banks_;
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::atomic<size_t> outstanding_{0};    // Banks queued or being drained
+    std::atomic<size_t> instruction_count_{0};
+    std::atomic<bool> limit_reached_{false};
+};
 
-        // Limit check
-        if (options.max_instructions > 0 && result.instructions.size() >= options.max_instructions) {
-            std::cerr << "Reached instruction limit (" << options.max_instructions << ")\n";
-            break;
-        }
-        
-        // Store instruction
-        size_t idx = result.instructions.size();
-        result.instructions.push_back(instr);
-        result.addr_to_index[addr] = idx;
-        
-        // Calculate target bank for jumps/calls
-        auto target_bank = [&](uint16_t target) -> uint8_t {
-            if (target < 0x4000) return 0;  // Bank 0 region
-            // For ROM ONLY (no MBC), switchable region is always bank 1
-            if (rom.header().mbc_type == MBCType::NONE) return 1;
-            return bank;  // Same bank for switchable region (MBC games)
-        };
-        
-        // Track control flow
-        // NOTE: RST instructions have is_call=true but need special handling,
-        // so we check for RST type FIRST before the general is_call check
-        if (instr.type == InstructionType::RST) {
-            // RST with 0xFF padding should not be analyzed - it's not real code
-            if (is_rst_padding(rom, instr.rst_vector)) {
-                // Don't push this RST or fallthrough - target contains only padding
-                continue;
-            }
-            
-            result.call_targets.insert(make_address(0, instr.rst_vector));
-            work_queue.push(make_address(0, instr.rst_vector));
+/**
+ * @brief Decode one canonical address and queue its successors
+ */
+void Explorer::explore(unsigned worker, BankState& state, uint32_t addr) {
+    if (state.visited.count(addr)) return;
+    
+    uint8_t bank = get_bank(addr);
+    uint16_t offset = get_offset(addr);
+    
+    Instruction instr;
+    if (!decode_at(decoder_, rom_, options_, addr, instr)) return;
+    state.visited.insert(addr);
+    
+    // Trace logging (tracing runs single-threaded, so this stays in order)
+    if (options_.trace_log) {
+        std::cout << "[TRACE] " << std::hex << std::setfill('0') << std::setw(2) << (int)bank
+                  << ":" << std::setw(4) << offset << " " << instr.disassemble() << std::dec << "\n";
+    }
+    
+    // Check for undefined instructions
+    if (instr.type == InstructionType::UNDEFINED) {
+        std::ostringstream ss;
+        ss << "[ERROR] Undefined instruction at "
+           << std::hex << std::setfill('0') << std::setw(2) << (int)bank << ":" << std::setw(4) << offset
+           << " Opcode: " << std::setw(2) << (int)instr.opcode << std::dec << "\n";
+        state.errors[addr] = ss.str();
+    }
+    
+    // Limit check
+    if (options_.max_instructions > 0 && instruction_count_++ >= options_.max_instructions) {
+        limit_reached_ = true;
+        return;
+    }
+    
+    // Calculate target bank for jumps/calls
+    auto target_bank = [&](uint16_t target) -> uint8_t {
+        if (target < 0x4000) return 0;  // Bank 0 region
+        // For ROM ONLY (no MBC), switchable region is always bank 1
+        if (rom_.header().mbc_type == MBCType::NONE) return 1;
+        return bank;  // Same bank for switchable region (MBC games)
+    };
+    
+    // Track control flow
+    // NOTE: RST instructions have is_call=true but need special handling,
+    // so we check for RST type FIRST before the general is_call check
+    if (instr.type == InstructionType::RST) {
+        // RST with 0xFF padding should not be analyzed - it's not real code
+        if (!is_rst_padding(rom_, instr.rst_vector)) {
+            state.call_targets.insert(make_address(0, instr.rst_vector));
+            push(worker, state, make_address(0, instr.rst_vector));
             
             // RST 28 jump table pattern: the bytes after RST 28 are table data, NOT code
             // Only push fallthrough if this is NOT a RST 28 jump table
-            bool is_rst28_jt = (instr.rst_vector == 0x28 && is_rst28_jump_table(rom));
+            bool is_rst28_jt = (instr.rst_vector == 0x28 && is_rst28_jump_table(rom_));
             if (is_rst28_jt) {
                 // Extract jump table entries and add them as call targets
-                std::vector<uint16_t> table_targets = extract_rst28_table_entries(rom, offset, bank);
+                std::vector<uint16_t> table_targets = extract_rst28_table_entries(rom_, offset, bank);
+                auto& site_targets = state.jump_tables[make_address(0, rst28_jump_site(rom_))];
                 for (uint16_t target : table_targets) {
                     uint8_t tbank = (target < 0x4000) ? 0 : bank;
-                    result.call_targets.insert(make_address(tbank, target));
-                    work_queue.push(make_address(tbank, target));
+                    state.call_targets.insert(make_address(tbank, target));
+                    state.computed_jump_targets.insert(make_address(tbank, target));
+                    site_targets.insert(make_address(tbank, target));
+                    push(worker, state, make_address(tbank, target));
                     // Mark these as labels too for proper block generation
-                    result.label_addresses.insert(make_address(tbank, target));
+                    state.label_addresses.insert(make_address(tbank, target));
                 }
-                std::cerr << "  RST 28 jump table at 0x" << std::hex << offset << std::dec 
-                          << " with " << table_targets.size() << " entries\n";
+                std::ostringstream ss;
+                ss << "  RST 28 jump table at 0x" << std::hex << offset << std::dec
+                   << " with " << table_targets.size() << " entries\n";
+                state.notes[addr] = ss.str();
                 
                 // DON'T push fallthrough - the bytes after RST 28 are table data
             } else {
                 // Normal RST call - push fallthrough and mark as label
                 uint32_t fall_through = make_address(bank, offset + instr.length);
-                result.label_addresses.insert(fall_through);
-                work_queue.push(fall_through);
+                state.label_addresses.insert(fall_through);
+                push(worker, state, fall_through);
             }
-        } else if (instr.is_call) {
+        }
+    } else if (instr.is_call) {
+        uint16_t target = instr.imm16;
+        uint8_t tbank = target_bank(target);
+        state.call_targets.insert(make_address(tbank, target));
+        push(worker, state, make_address(tbank, target));
+        
+        // Track cross-bank calls
+        if (tbank != bank) {
+            state.cross_bank_calls++;
+        }
+        
+        // Calls fall through - mark as label so a new block starts
+        uint32_t fall_through = make_address(bank, offset + instr.length);
+        state.label_addresses.insert(fall_through);
+        push(worker, state, fall_through);
+    } else if (instr.is_jump) {
+        if (instr.type == InstructionType::JP_NN || instr.type == InstructionType::JP_CC_NN) {
             uint16_t target = instr.imm16;
             uint8_t tbank = target_bank(target);
-            result.call_targets.insert(make_address(tbank, target));
-            work_queue.push(make_address(tbank, target));
-            
-            // Track cross-bank calls
-            if (tbank != bank) {
-                result.stats.cross_bank_calls++;
+            if (target >= 0x4000 && target <= 0x7FFF) {
+                state.call_targets.insert(make_address(tbank, target));
             }
-            
-            // Calls fall through - mark as label so a new block starts
+            state.label_addresses.insert(make_address(tbank, target));
+            push(worker, state, make_address(tbank, target));
+        } else if (instr.type == InstructionType::JR_N || instr.type == InstructionType::JR_CC_N) {
+            uint16_t target = offset + instr.length + instr.offset;
+            state.label_addresses.insert(make_address(bank, target));
+            push(worker, state, make_address(bank, target));
+        }
+        
+        if (instr.is_conditional) {
+            // Conditional jumps fall through - this is also a block start
             uint32_t fall_through = make_address(bank, offset + instr.length);
-            result.label_addresses.insert(fall_through);
-            work_queue.push(fall_through);
-        } else if (instr.is_jump) {
-            if (instr.type == InstructionType::JP_NN || instr.type == InstructionType::JP_CC_NN) {
-                uint16_t target = instr.imm16;
-                uint8_t tbank = target_bank(target);
-                if (target >= 0x4000 && target <= 0x7FFF) {
-                    result.call_targets.insert(make_address(tbank, target));
-                }
-                result.label_addresses.insert(make_address(tbank, target));
-                work_queue.push(make_address(tbank, target));
-            } else if (instr.type == InstructionType::JR_N || instr.type == InstructionType::JR_CC_N) {
-                uint16_t target = offset + instr.length + instr.offset;
-                result.label_addresses.insert(make_address(bank, target));
-                work_queue.push(make_address(bank, target));
-            }
-            
-            if (instr.is_conditional) {
-                // Conditional jumps fall through - this is also a block start
-                uint32_t fall_through = make_address(bank, offset + instr.length);
-                result.label_addresses.insert(fall_through);
-                work_queue.push(fall_through);
-            }
-        } else if (instr.is_return) {
-            // Returns end the block
-            // But conditional returns fall through if condition is false
-            if (instr.is_conditional) {
-                uint32_t fall_through = make_address(bank, offset + instr.length);
-                result.label_addresses.insert(fall_through);
-                work_queue.push(fall_through);
-            }
-        } else {
-            // Continue to next instruction
-            work_queue.push(make_address(bank, offset + instr.length));
+            state.label_addresses.insert(fall_through);
+            push(worker, state, fall_through);
         }
+    } else if (instr.is_return) {
+        // Returns end the block
+        // But conditional returns fall through if condition is false
+        if (instr.is_conditional) {
+            uint32_t fall_through = make_address(bank, offset + instr.length);
+            state.label_addresses.insert(fall_through);
+            push(worker, state, fall_through);
+        }
+    } else {
+        // Continue to next instruction
+        push(worker, state, make_address(bank, offset + instr.length));
     }
     
+    // Store instruction
+    state.instructions.emplace_back(addr, std::move(instr));
+}
+
+} // namespace
+
+/* ============================================================================
+ * Analysis Implementation
+ * ========================================================================== */
+
+/**
+ * @brief Build blocks, functions and stats from explored instructions
+ * 
+ * visited holds the canonical address of every decoded instruction.
+ */
+static void finish_analysis(AnalysisResult& result, const AddressSet& visited) {
     // Build basic blocks from instruction boundaries
-    std::set<uint32_t> block_starts;
+    AddressSet block_starts;
     block_starts.insert(make_address(0, 0x100));  // Entry point
     
-    for (uint32_t target : result.call_targets) {
-        block_starts.insert(target);
-    }
-    for (uint32_t target : result.label_addresses) {
-        block_starts.insert(target);
-    }
+    block_starts.insert(result.call_targets);
+    block_starts.insert(result.label_addresses);
     
     // Create blocks
     for (uint32_t start : block_starts) {
@@ -536,11 +699,11 @@ AnalysisResult analyze(const ROM& rom, const AnalyzerOptions& options) {
         // Find instructions in this block
         uint32_t curr = start;
         while (visited.count(curr)) {
-            auto it = result.addr_to_index.find(curr);
-            if (it == result.addr_to_index.end()) break;
+            size_t index = result.addr_to_index.find(curr);
+            if (index == AddressIndex::npos) break;
             
-            block.instruction_indices.push_back(it->second);
-            const Instruction& instr = result.instructions[it->second];
+            block.instruction_indices.push_back(index);
+            const Instruction& instr = result.instructions[index];
             
             block.end_address = get_offset(curr) + instr.length;
             
@@ -580,7 +743,7 @@ AnalysisResult analyze(const ROM& rom, const AnalyzerOptions& options) {
             }
         }
         
-        result.blocks[start] = block;
+        result.blocks[start] = std::move(block);
     }
     
     // Create functions from call targets
@@ -625,7 +788,7 @@ AnalysisResult analyze(const ROM& rom, const AnalyzerOptions& options) {
             }
         }
         
-        result.functions[target] = func;
+        result.functions[target] = std::move(func);
     }
     
     // Update stats
@@ -633,6 +796,96 @@ AnalysisResult analyze(const ROM& rom, const AnalyzerOptions& options) {
     result.stats.total_blocks = result.blocks.size();
     result.stats.total_functions = result.functions.size();
     
+}
+
+AnalysisResult analyze(const ROM& rom, const AnalyzerOptions& options) {
+    AnalysisResult result;
+    result.rom = &rom;
+    result.entry_point = 0x100;
+    
+    // Add standard GameBoy entry points
+    result.interrupt_vectors = {0x40, 0x48, 0x50, 0x58, 0x60};  // Interrupt vectors
+    
+    // Detect which banks are used
+    std::set<uint8_t> known_banks = detect_bank_values(rom);
+    
+    // Tracing and instruction limits depend on visit order, so keep them serial
+    unsigned threads = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    if (options.trace_log || options.max_instructions > 0) threads = 1;
+    
+    // Addresses to explore, partitioned by bank
+    Explorer explorer(rom, options, threads);
+    AddressSet visited;
+    
+    // Entry point is always a function (bank 0)
+    result.call_targets.insert(make_address(0, 0x100));
+    
+    // RST vectors are implicit functions (always bank 0)
+    // Skip any RST vector that contains only 0xFF padding (common in many ROMs)
+    // Also skip RST 30 when RST 28 uses it as part of its jump table implementation
+    bool skip_rst30 = rst28_uses_rst30(rom);
+    for (uint16_t vec : {0x00, 0x08, 0x10, 0x18, 0x20, 0x28, 0x30, 0x38}) {
+        if (is_rst_padding(rom, vec)) {
+            continue;  // Skip this RST vector - contains only padding
+        }
+        if (vec == 0x30 && skip_rst30) {
+            continue;  // Skip RST 30 - it's part of RST 28's jump table implementation
+        }
+        result.call_targets.insert(make_address(0, vec));
+        explorer.seed(make_address(0, vec));
+    }
+    
+    // Interrupt vectors are functions (bank 0)
+    for (uint16_t vec : result.interrupt_vectors) {
+        result.call_targets.insert(make_address(0, vec));
+        explorer.seed(make_address(0, vec));
+    }
+    
+    // Start from entry point
+    explorer.seed(make_address(0, 0x100));
+    
+    // For MBC games, also analyze code at entry point in each bank
+    // This catches trampoline code that jumps from bank 0 to banked code
+    if (rom.header().mbc_type != MBCType::NONE && options.analyze_all_banks) {
+        std::cerr << "Analyzing all " << known_banks.size() << " banks\n";
+        for (uint8_t bank : known_banks) {
+            if (bank > 0) {
+                // Check for code at common bank entry points
+                // Many games have jump tables or trampolines at 0x4000
+                explorer.seed(make_address(bank, 0x4000));
+                result.call_targets.insert(make_address(bank, 0x4000));
+            }
+        }
+    }
+    
+    // Add overlay entry points
+    for (const auto& ov : options.ram_overlays) {
+        uint32_t addr = make_address(0, ov.ram_addr);
+        result.call_targets.insert(addr);
+        explorer.seed(addr);
+    }
+    
+    // Explicit entry points, e.g. interpreter fallbacks seen at runtime
+    for (uint32_t ep : options.entry_points) {
+        uint32_t addr = canonical_address(ep);
+        if (get_offset(addr) >= 0x8000 || get_bank(addr) >= rom.bank_count()) continue;
+        result.call_targets.insert(addr);
+        explorer.seed(addr);
+    }
+    for (uint32_t target : options.jump_targets) {
+        uint32_t addr = canonical_address(target);
+        if (get_offset(addr) >= 0x8000 || get_bank(addr) >= rom.bank_count()) continue;
+        result.call_targets.insert(addr);
+        result.computed_jump_targets.insert(addr);
+        explorer.seed(addr);
+    }
+    
+    // Explore all reachable code, one worklist per bank
+    explorer.run();
+    explorer.merge(result, visited);
+    
+    finish_analysis(result, visited);
+    
     return result;
 }
 
@@ -642,6 +895,186 @@ AnalysisResult analyze_bank(const ROM& rom, uint8_t bank, const AnalyzerOptions&
     return analyze(rom, options);
 }
 
+std::optional<AnalyzerOptions::RamOverlay> find_oam_dma_routine(const ROM& rom) {
+    // LDH (46),A; LD A,n; DEC A; JR NZ,-3; RET, with any delay n
+    const std::vector<uint8_t>& data = rom.bytes();
+    for (size_t i = 0; i + 8 <= data.size(); i++) {
+        const uint8_t* p = &data[i];
+        if (p[0] != 0xE0 || p[1] != 0x46 || p[2] != 0x3E || p[4] != 0x3D ||
+            p[5] != 0x20 || p[6] != 0xFD || p[7] != 0xC9) continue;
+        uint8_t bank = static_cast<uint8_t>(i / 0x4000);
+        uint16_t offset = static_cast<uint16_t>(i % 0x4000 + (bank > 0 ? 0x4000 : 0));
+        AnalyzerOptions::RamOverlay overlay;
+        overlay.ram_addr = 0xFF80;
+        overlay.rom_addr = AnalysisResult::make_addr(bank, offset);
+        overlay.size = 8;
+        overlay.oam_dma = true;
+        return overlay;
+    }
+    return std::nullopt;
+}
+
+/* ============================================================================
+ * Analysis Cache
+ * ========================================================================== */
+
+// Bump whenever exploration or the cache layout changes
+static constexpr uint32_t ANALYSIS_CACHE_MAGIC = 0x41524247;  // "GBRA"
+static constexpr uint32_t ANALYSIS_CACHE_VERSION = 1;
+
+uint64_t analysis_cache_key(const ROM& rom, const AnalyzerOptions& options) {
+    Hasher h;
+    h.u64(ANALYSIS_CACHE_VERSION);
+    h.bytes(rom.data(), rom.size());
+    h.u64(options.ram_overlays.size());
+    for (const auto& ov : options.ram_overlays) {
+        h.u64(ov.ram_addr).u64(ov.rom_addr).u64(ov.size);
+    }
+    h.u64(options.entry_points.size());
+    for (uint32_t ep : options.entry_points) h.u64(ep);
+    h.u64(options.jump_targets.size());
+    for (uint32_t target : options.jump_targets) h.u64(target);
+    h.u64(options.analyze_all_banks).u64(options.detect_computed_jumps)
+     .u64(options.track_bank_switches).u64(options.mark_unreachable);
+    return h.digest();
+}
+
+static void put_u32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+}
+
+static void put_u64(std::vector<uint8_t>& out, uint64_t value) {
+    put_u32(out, static_cast<uint32_t>(value));
+    put_u32(out, static_cast<uint32_t>(value >> 32));
+}
+
+template <typename Container>
+static void put_addresses(std::vector<uint8_t>& out, const Container& addrs) {
+    put_u32(out, static_cast<uint32_t>(addrs.size()));
+    for (uint32_t addr : addrs) put_u32(out, addr);
+}
+
+/**
+ * @brief Bounds-checked little-endian reader over a cache file
+ */
+class CacheReader {
+public:
+    explicit CacheReader(std::vector<uint8_t> data) : data_(std::move(data)) {}
+
+    bool u32(uint32_t& value) {
+        if (data_.size() - pos_ < 4) return false;
+        value = 0;
+        for (int i = 0; i < 4; i++) value |= static_cast<uint32_t>(data_[pos_++]) << (i * 8);
+        return true;
+    }
+
+    bool u64(uint64_t& value) {
+        uint32_t lo, hi;
+        if (!u32(lo) || !u32(hi)) return false;
+        value = (static_cast<uint64_t>(hi) << 32) | lo;
+        return true;
+    }
+
+    bool addresses(std::vector<uint32_t>& addrs) {
+        uint32_t count;
+        if (!u32(count) || count > (data_.size() - pos_) / 4) return false;
+        addrs.resize(count);
+        for (uint32_t& addr : addrs) u32(addr);
+        return true;
+    }
+
+    bool at_end() const { return pos_ == data_.size(); }
+
+private:
+    std::vector<uint8_t> data_;
+    size_t pos_ = 0;
+};
+
+bool save_analysis(const AnalysisResult& result, const std::string& path, uint64_t key) {
+    std::vector<uint8_t> out;
+    put_u32(out, ANALYSIS_CACHE_MAGIC);
+    put_u32(out, ANALYSIS_CACHE_VERSION);
+    put_u64(out, key);
+    
+    // Instructions are in address order; re-key them by canonical address
+    std::vector<uint32_t> instructions;
+    instructions.reserve(result.instructions.size());
+    for (const Instruction& instr : result.instructions) {
+        instructions.push_back(canonical_address(make_address(instr.bank, instr.address)));
+    }
+    put_addresses(out, instructions);
+    put_addresses(out, result.call_targets);
+    put_addresses(out, result.label_addresses);
+    put_addresses(out, result.computed_jump_targets);
+    
+    put_u32(out, static_cast<uint32_t>(result.jump_tables.size()));
+    for (const auto& [site, targets] : result.jump_tables) {
+        put_u32(out, site);
+        put_addresses(out, targets);
+    }
+    put_u64(out, result.stats.cross_bank_calls);
+    
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+    file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+    return static_cast<bool>(file);
+}
+
+std::optional<AnalysisResult> load_analysis(const ROM& rom, const AnalyzerOptions& options,
+                                            const std::string& path, uint64_t key) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return std::nullopt;
+    CacheReader in(std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {}));
+    
+    uint32_t magic, version;
+    uint64_t stored_key;
+    if (!in.u32(magic) || magic != ANALYSIS_CACHE_MAGIC) return std::nullopt;
+    if (!in.u32(version) || version != ANALYSIS_CACHE_VERSION) return std::nullopt;
+    if (!in.u64(stored_key) || stored_key != key) return std::nullopt;
+    
+    AnalysisResult result;
+    result.rom = &rom;
+    result.entry_point = 0x100;
+    result.interrupt_vectors = {0x40, 0x48, 0x50, 0x58, 0x60};
+    
+    std::vector<uint32_t> instructions, call_targets, labels, computed;
+    if (!in.addresses(instructions) || !in.addresses(call_targets) ||
+        !in.addresses(labels) || !in.addresses(computed)) {
+        return std::nullopt;
+    }
+    result.call_targets.insert(call_targets.begin(), call_targets.end());
+    result.label_addresses.insert(labels.begin(), labels.end());
+    result.computed_jump_targets.insert(computed.begin(), computed.end());
+    
+    uint32_t table_count;
+    if (!in.u32(table_count)) return std::nullopt;
+    for (uint32_t i = 0; i < table_count; i++) {
+        uint32_t site;
+        std::vector<uint32_t> targets;
+        if (!in.u32(site) || !in.addresses(targets)) return std::nullopt;
+        result.jump_tables[site].insert(targets.begin(), targets.end());
+    }
+    uint64_t cross_bank_calls;
+    if (!in.u64(cross_bank_calls) || !in.at_end()) return std::nullopt;
+    result.stats.cross_bank_calls = cross_bank_calls;
+    
+    // Decoding is deterministic, so re-decoding the saved addresses
+    // reproduces the explored instruction stream exactly
+    Decoder decoder(rom);
+    AddressSet visited;
+    result.instructions.reserve(instructions.size());
+    for (uint32_t addr : instructions) {
+        Instruction instr;
+        if (!decode_at(decoder, rom, options, addr, instr)) return std::nullopt;
+        visited.insert(addr);
+        result.addr_to_index.insert(addr, result.instructions.size());
+        result.instructions.push_back(instr);
+    }
+    
+    finish_analysis(result, visited);
+    return result;
+}
+
 /* ============================================================================
  * Utility Functions
  * ========================================================================== */
@@ -706,8 +1139,7 @@ void print_analysis_summary(const AnalysisResult& result) {
 }
 
 bool is_likely_data(const AnalysisResult& result, uint8_t bank, uint16_t address) {
-    uint32_t full_addr = AnalysisResult::make_addr(bank, address);
-    return result.addr_to_index.find(full_addr) == result.addr_to_index.end();
+    return !result.addr_to_index.count(AnalysisResult::make_addr(bank, address));
 }
 
 } // namespace gbrecomp
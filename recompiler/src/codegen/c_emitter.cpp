@@ -4,15 +4,84 @@
  */
 
 #include "recompiler/codegen/c_emitter.h"
+#include "recompiler/hash.h"
+#include "recompiler/decoder.h"
 #include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <fstream>
 #include <filesystem>
 #include <algorithm>
+#include <map>
+#include <set>
+#include <atomic>
+#include <thread>
+#include <cctype>
 
 namespace gbrecomp {
 namespace codegen {
 
+/* ============================================================================
+ * Memory Access Specialization
+ * ========================================================================== */
+
+static std::string hex_literal(uint32_t value, int width) {
+    std::ostringstream ss;
+    ss << "0x" << std::hex << std::setfill('0') << std::setw(width) << value;
+    return ss.str();
+}
+
+/**
+ * @brief Whether 0x0000-0x3FFF always holds ROM bank 0
+ *
+ * MBC1 mode 1 maps bank 0x20, 0x40 or 0x60 there, which only differs from
+ * bank 0 on ROMs over 512 KiB (MBC1 multicarts are 1 MiB).
+ */
+static bool rom0_fixed(const ir::Program& program) {
+    bool mbc1 = program.mbc_type >= 0x01 && program.mbc_type <= 0x03;
+    return !mbc1 || program.rom_bank_count <= 32;
+}
+
+/**
+ * @brief C expression reading a byte from a statically known address
+ *
+ * Fixed regions (ROM0 unless the mapper can remap it, WRAM0 and its echo,
+ * HRAM, IE) become direct array accesses and I/O goes straight to
+ * gb_io_read. OAM goes through gb_oam_read, which is locked out during
+ * OAM DMA. Banked regions keep the inline page-table lookup since their
+ * mapping is only known at runtime.
+ */
+static std::string static_read8_expr(uint16_t addr, bool rom0_is_fixed) {
+    if (addr < 0x4000 && rom0_is_fixed) return "ctx->rom[" + hex_literal(addr, 4) + "]";
+    if (addr >= 0xC000 && addr < 0xD000) return "ctx->wram[" + hex_literal(addr - 0xC000, 4) + "]";
+    if (addr >= 0xE000 && addr < 0xF000) return "ctx->wram[" + hex_literal(addr - 0xE000, 4) + "]";
+    if (addr >= 0xFE00 && addr < 0xFEA0) return "gb_oam_read(ctx, " + hex_literal(addr - 0xFE00, 2) + ")";
+    if (addr >= 0xFF80 && addr < 0xFFFF) return "ctx->hram[" + hex_literal(addr - 0xFF80, 2) + "]";
+    if (addr == 0xFFFF) return "ctx->io[0x80]";
+    if (addr >= 0xFF00) return "gb_io_read(ctx, " + hex_literal(addr & 0xFF, 2) + ")";
+    return "gb_read8_fast(ctx, " + hex_literal(addr, 4) + ")";
+}
+
+/**
+ * @brief C statement writing a byte to a statically known address
+ *
+ * Writes below 0x8000 are MBC register writes and go to the slow path;
+ * I/O and IE writes go to gb_io_write so register side effects still run.
+ * WRAM0 stores use gb_wram_write so save-state snapshots see the page,
+ * and WRAM0 and HRAM stores both drop code cached from the page. OAM
+ * stores use gb_oam_write so the PPU catches up and rebuilds its sprite
+ * line buckets, and so they are dropped during OAM DMA.
+ */
+static std::string static_write8_stmt(uint16_t addr, const std::string& value) {
+    if (addr < 0x8000) return "gb_write8_slow(ctx, " + hex_literal(addr, 4) + ", " + value + ");";
+    if (addr >= 0xC000 && addr < 0xD000) return "gb_wram_write(ctx, " + hex_literal(addr - 0xC000, 4) + ", " + value + ");";
+    if (addr >= 0xE000 && addr < 0xF000) return "gb_wram_write(ctx, " + hex_literal(addr - 0xE000, 4) + ", " + value + ");";
+    if (addr >= 0xFE00 && addr < 0xFEA0) return "gb_oam_write(ctx, " + hex_literal(addr - 0xFE00, 2) + ", " + value + ");";
+    if (addr >= 0xFF80 && addr < 0xFFFF) return "gb_hram_write(ctx, " + hex_literal(addr - 0xFF80, 2) + ", " + value + ");";
+    if (addr >= 0xFF00) return "gb_io_write(ctx, " + hex_literal(addr & 0xFF, 2) + ", " + value + ");";
+    return "gb_write8_fast(ctx, " + hex_literal(addr, 4) + ", " + value + ");";
+}
+
 /* ============================================================================
  * CEmitter Constructor
  * ========================================================================== */
@@ -119,8 +188,7 @@ void CEmitter::emit_mov_reg16_imm16(uint8_t dst, uint16_t imm) {
 
 void CEmitter::emit_load8_addr(uint8_t dst, uint16_t addr) {
     emit_indent();
-    out_ << "ctx->" << reg8_name(dst) << " = gbrt_read8(ctx, 0x" << std::hex 
-         << std::setfill('0') << std::setw(4) << addr << std::dec << ");\n";
+    out_ << "ctx->" << reg8_name(dst) << " = " << static_read8_expr(addr, false) << ";\n";
 }
 
 void CEmitter::emit_load8_reg(uint8_t dst, uint8_t addr_reg) {
@@ -137,8 +205,7 @@ void CEmitter::emit_load16_addr(uint8_t dst, uint16_t addr) {
 
 void CEmitter::emit_store8_addr(uint16_t addr, uint8_t src) {
     emit_indent();
-    out_ << "gbrt_write8(ctx, 0x" << std::hex << std::setfill('0') << std::setw(4) 
-         << addr << std::dec << ", ctx->" << reg8_name(src) << ");\n";
+    out_ << static_write8_stmt(addr, std::string("ctx->") + reg8_name(src)) << "\n";
 }
 
 void CEmitter::emit_store8_reg(uint8_t addr_reg, uint8_t src) {
@@ -484,23 +551,19 @@ void CEmitter::emit_scf() { emit_line("gbrt_scf(ctx);"); }
  * ========================================================================== */
 
 void CEmitter::emit_ldh_a_n(uint8_t offset) {
-    emit_indent();
-    out_ << "ctx->A = gbrt_read8(ctx, 0xFF00 + 0x" << std::hex << std::setfill('0') 
-         << std::setw(2) << (int)offset << std::dec << ");\n";
+    emit_load8_addr(0, 0xFF00 + offset);
 }
 
 void CEmitter::emit_ldh_n_a(uint8_t offset) {
-    emit_indent();
-    out_ << "gbrt_write8(ctx, 0xFF00 + 0x" << std::hex << std::setfill('0') 
-         << std::setw(2) << (int)offset << std::dec << ", ctx->A);\n";
+    emit_store8_addr(0xFF00 + offset, 0);
 }
 
 void CEmitter::emit_ldh_a_c() {
-    emit_line("ctx->A = gbrt_read8(ctx, 0xFF00 + ctx->C);");
+    emit_line("ctx->A = gb_io_read(ctx, ctx->C);");
 }
 
 void CEmitter::emit_ldh_c_a() {
-    emit_line("gbrt_write8(ctx, 0xFF00 + ctx->C, ctx->A);");
+    emit_line("gb_io_write(ctx, ctx->C, ctx->A);");
 }
 
 /* ============================================================================
@@ -562,17 +625,403 @@ static const char* get_reg8_name(int idx) {
     return reg8_names[idx];
 }
 
+// Operand text for an 8-bit ALU source; index 6 reads (HL) through the fast path
+static std::string reg8_operand(int idx) {
+    if (idx == 6) return "gb_read8_fast(ctx, ctx->hl)";
+    return std::string("ctx->") + reg8_names[idx];
+}
+
+/* ============================================================================
+ * Flag-Aware ALU Emission
+ * ========================================================================== */
+
+// Joins statements into one line, braced when they declare temporaries
+static std::string join_stmts(const std::vector<std::string>& stmts, bool braced) {
+    std::string line = braced ? "{ " : "";
+    for (size_t i = 0; i < stmts.size(); i++) {
+        if (i > 0) line += " ";
+        line += stmts[i];
+    }
+    if (braced) line += " }";
+    return line;
+}
+
+/**
+ * @brief 8-bit ALU operation on A that computes only its live flags
+ *
+ * Falls back to the gb_* helper when every flag it writes is still needed,
+ * unless force_inline asks for inline code regardless (register caching,
+ * where a helper call would force a register sync). Flags the liveness pass
+ * proved dead keep their stale values.
+ */
+static std::string alu8_stmt(const ir::IRInstruction& instr, const char* helper,
+                             bool force_inline) {
+    std::string src = instr.src.type == ir::OperandType::IMM8
+                    ? hex_literal(instr.src.value.imm8, 2)
+                    : reg8_operand(instr.src.value.reg8);
+    uint8_t written = instr.flags.mask();
+    uint8_t live = instr.live_flags & written;
+    if (live == written && !force_inline) {
+        return std::string(helper) + "(ctx, " + src + ");";
+    }
+    
+    bool from_mem = instr.src.type == ir::OperandType::REG8 && instr.src.value.reg8 == 6;
+    bool with_carry = instr.opcode == ir::Opcode::ADC8 || instr.opcode == ir::Opcode::SBC8;
+    if (instr.opcode == ir::Opcode::CP8 && live == 0) {
+        return from_mem ? "(void)" + src + ";" : "/* flags unused */";
+    }
+    
+    std::vector<std::string> stmts;
+    std::string v = src;
+    if (from_mem) {
+        stmts.push_back("uint8_t v = " + src + ";");
+        v = "v";
+    }
+    if (with_carry) stmts.push_back("uint8_t cy = ctx->f_c;");
+    std::string cy = with_carry ? " + cy" : "";
+    bool z = live & ir::FLAG_Z, n = live & ir::FLAG_N;
+    bool h = live & ir::FLAG_H, c = live & ir::FLAG_C;
+    
+    switch (instr.opcode) {
+        case ir::Opcode::ADD8:
+        case ir::Opcode::ADC8:
+            if (h) stmts.push_back("ctx->f_h = ((ctx->a & 0x0F) + (" + v + " & 0x0F)" + cy + ") > 0x0F;");
+            if (c) stmts.push_back("ctx->f_c = ctx->a + " + v + cy + " > 0xFF;");
+            stmts.push_back("ctx->a = (uint8_t)(ctx->a + " + v + cy + ");");
+            break;
+        case ir::Opcode::SUB8:
+        case ir::Opcode::SBC8:
+        case ir::Opcode::CP8:
+            if (instr.opcode == ir::Opcode::CP8 && z) stmts.push_back("ctx->f_z = ctx->a == " + v + ";");
+            if (h) stmts.push_back("ctx->f_h = (ctx->a & 0x0F) < (" + v + " & 0x0F)" + cy + ";");
+            if (c) stmts.push_back("ctx->f_c = ctx->a < " + v + cy + ";");
+            if (instr.opcode != ir::Opcode::CP8) {
+                stmts.push_back("ctx->a = (uint8_t)(ctx->a - " + v + (with_carry ? " - cy" : "") + ");");
+            }
+            break;
+        case ir::Opcode::AND8:
+            stmts.push_back("ctx->a &= " + v + ";");
+            break;
+        case ir::Opcode::OR8:
+            stmts.push_back("ctx->a |= " + v + ";");
+            break;
+        case ir::Opcode::XOR8:
+            stmts.push_back("ctx->a ^= " + v + ";");
+            break;
+        default:
+            break;
+    }
+    
+    if (z && instr.opcode != ir::Opcode::CP8) stmts.push_back("ctx->f_z = ctx->a == 0;");
+    if (n) stmts.push_back(instr.flags.n_value ? "ctx->f_n = 1;" : "ctx->f_n = 0;");
+    if (instr.opcode == ir::Opcode::AND8 || instr.opcode == ir::Opcode::OR8 ||
+        instr.opcode == ir::Opcode::XOR8) {
+        if (h) stmts.push_back(instr.flags.h_value ? "ctx->f_h = 1;" : "ctx->f_h = 0;");
+        if (c) stmts.push_back("ctx->f_c = 0;");
+    }
+    return join_stmts(stmts, from_mem || with_carry);
+}
+
+// INC/DEC of a register or (HL) computing only its live flags
+static std::string incdec8_stmt(const ir::IRInstruction& instr, bool force_inline) {
+    bool inc = instr.opcode == ir::Opcode::INC8;
+    bool from_mem = instr.dst.value.reg8 == 6;
+    uint8_t written = instr.flags.mask();
+    uint8_t live = instr.live_flags & written;
+    const char* helper = inc ? "gb_inc8" : "gb_dec8";
+    
+    if (live == written && !force_inline) {
+        if (from_mem) {
+            return std::string("gb_write8_fast(ctx, ctx->hl, ") + helper +
+                   "(ctx, gb_read8_fast(ctx, ctx->hl)));";
+        }
+        std::string reg = std::string("ctx->") + reg8_names[instr.dst.value.reg8];
+        return reg + " = " + helper + "(ctx, " + reg + ");";
+    }
+    
+    std::vector<std::string> stmts;
+    std::string t = from_mem ? "v" : std::string("ctx->") + reg8_names[instr.dst.value.reg8];
+    if (from_mem) stmts.push_back("uint8_t v = gb_read8_fast(ctx, ctx->hl);");
+    if (live & ir::FLAG_H) {
+        stmts.push_back("ctx->f_h = (" + t + (inc ? " & 0x0F) == 0x0F;" : " & 0x0F) == 0;"));
+    }
+    stmts.push_back(t + (inc ? "++;" : "--;"));
+    if (live & ir::FLAG_Z) stmts.push_back("ctx->f_z = " + t + " == 0;");
+    if (live & ir::FLAG_N) stmts.push_back(inc ? "ctx->f_n = 0;" : "ctx->f_n = 1;");
+    if (from_mem) stmts.push_back("gb_write8_fast(ctx, ctx->hl, v);");
+    return join_stmts(stmts, from_mem);
+}
+
+// ADD HL,rr computing only its live flags
+static std::string add16_stmt(const ir::IRInstruction& instr, bool force_inline) {
+    std::string rr = std::string("ctx->") + reg16_names[instr.src.value.reg16];
+    uint8_t written = instr.flags.mask();
+    uint8_t live = instr.live_flags & written;
+    if (live == written && !force_inline) return "gb_add16(ctx, " + rr + ");";
+    
+    std::vector<std::string> stmts;
+    if (live & ir::FLAG_H) {
+        stmts.push_back("ctx->f_h = ((ctx->hl & 0x0FFF) + (" + rr + " & 0x0FFF)) > 0x0FFF;");
+    }
+    if (live & ir::FLAG_C) stmts.push_back("ctx->f_c = ctx->hl + " + rr + " > 0xFFFF;");
+    stmts.push_back("ctx->hl = (uint16_t)(ctx->hl + " + rr + ");");
+    if (live & ir::FLAG_N) stmts.push_back("ctx->f_n = 0;");
+    return join_stmts(stmts, false);
+}
+
+// Push of a return address; open-coded under register caching so that SP
+// stays in the cached register file
+static std::string push_addr_stmt(const GeneratorOptions& options, uint16_t addr) {
+    std::string value = hex_literal(addr, 4);
+    if (options.cache_registers) return "ctx->sp -= 2; gb_write16(ctx, ctx->sp, " + value + ");";
+    return "gb_push16(ctx, " + value + ");";
+}
+
+static std::string ret_stmt(const GeneratorOptions& options) {
+    if (options.cache_registers) return "ctx->pc = gb_read16(ctx, ctx->sp); ctx->sp += 2;";
+    return "gb_ret(ctx);";
+}
+
+// Code compiled for size (opt_size) replaces "ctx->pc = pc; gb_tick(ctx,
+// cycles);" and the ctx->stopped poll after it by one runtime call
+static std::string step_call(uint16_t pc, uint32_t cycles, bool poll) {
+    std::string call = "gb_step_to(ctx, " + hex_literal(pc, 4) + ", " + std::to_string(cycles) + ")";
+    return poll ? "if (" + call + ") return;" : call + ";";
+}
+
+// Instructions that emit their own PC update and cycle tick
+static bool is_control_flow_op(ir::Opcode op) {
+    switch (op) {
+        case ir::Opcode::RET:
+        case ir::Opcode::RETI:
+        case ir::Opcode::RET_CC:
+        case ir::Opcode::JUMP:
+        case ir::Opcode::JUMP_CC:
+        case ir::Opcode::JUMP_REG:
+        case ir::Opcode::JR:
+        case ir::Opcode::JR_CC:
+        case ir::Opcode::CALL:
+        case ir::Opcode::CALL_CC:
+        case ir::Opcode::RST:
+        case ir::Opcode::HALT:
+        case ir::Opcode::STOP:
+        case ir::Opcode::BLOCK_COPY:
+        case ir::Opcode::BLOCK_FILL:
+        case ir::Opcode::WAIT_LY:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// GBLoopReg name of a loop intrinsic pointer or counter operand
+static std::string loop_reg(const ir::Operand& op) {
+    static const char* reg8[] = {"GB_LOOP_B", "GB_LOOP_C", "GB_LOOP_D", "GB_LOOP_E", "GB_LOOP_H", "GB_LOOP_L"};
+    static const char* pairs[] = {"GB_LOOP_BC", "GB_LOOP_DE", "GB_LOOP_HL"};
+    if (op.type == ir::OperandType::REG16) return pairs[op.value.reg16 % 3];
+    return reg8[op.value.reg8 % 6];
+}
+
+// Runtime call replaying a recognized loop; see gbrt_block_copy
+static std::string loop_idiom_call(const ir::IRInstruction& instr, uint32_t cycles) {
+    std::ostringstream call;
+    switch (instr.opcode) {
+        case ir::Opcode::BLOCK_COPY:
+            call << "gbrt_block_copy(ctx, " << loop_reg(instr.dst) << ", " << (int)instr.dst_step
+                 << ", " << loop_reg(instr.src) << ", " << (int)instr.src_step
+                 << ", " << loop_reg(instr.extra) << ", " << cycles << ")";
+            break;
+        case ir::Opcode::BLOCK_FILL:
+            call << "gbrt_block_fill(ctx, " << loop_reg(instr.dst) << ", " << (int)instr.dst_step << ", "
+                 << (instr.src.type == ir::OperandType::IMM8 ? hex_literal(instr.src.value.imm8, 2) : "-1")
+                 << ", " << loop_reg(instr.extra) << ", " << cycles << ")";
+            break;
+        default:
+            call << "gbrt_wait_ly(ctx, " << hex_literal(instr.src.value.imm8, 2) << ", "
+                 << (int)instr.extra.value.condition << ", " << cycles << ")";
+            break;
+    }
+    return call.str();
+}
+
+// Registers whose behaviour depends on the exact cycle of the access:
+// timer (FF04-FF07), IF, LCD/PPU including DMA (FF40-FF4B) and IE.
+static bool is_timing_sensitive_addr(uint16_t addr) {
+    return (addr >= 0xFF04 && addr <= 0xFF07) ||
+           addr == 0xFF0F ||
+           (addr >= 0xFF40 && addr <= 0xFF4B) ||
+           addr == 0xFFFF;
+}
+
+// Whether an instruction must observe an up-to-date cycle counter in
+// block timing mode. Register-indirect accesses are not tracked; they
+// only see the cycles accumulated up to the previous split point.
+static bool is_timing_sensitive(const ir::IRInstruction& instr) {
+    switch (instr.opcode) {
+        case ir::Opcode::LOAD8:
+            if (instr.src.type == ir::OperandType::IMM16)
+                return is_timing_sensitive_addr(instr.src.value.imm16);
+            return instr.src.type == ir::OperandType::REG8;  // (0xFF00 + C)
+        case ir::Opcode::STORE8:
+            if (instr.dst.type == ir::OperandType::IMM16)
+                return is_timing_sensitive_addr(instr.dst.value.imm16);
+            return instr.dst.type == ir::OperandType::REG8;  // (0xFF00 + C)
+        case ir::Opcode::IO_READ:
+            return is_timing_sensitive_addr(0xFF00 | instr.src.value.imm8);
+        case ir::Opcode::IO_WRITE:
+            return is_timing_sensitive_addr(0xFF00 | instr.dst.value.imm8);
+        case ir::Opcode::IO_READ_C:
+        case ir::Opcode::IO_WRITE_C:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Whether an instruction can make an interrupt due: EI, or a write to IE
+// or IF. Execution stops to poll ctx->stopped right after it.
+static bool raises_interrupts(const ir::IRInstruction& instr) {
+    switch (instr.opcode) {
+        case ir::Opcode::EI:
+        case ir::Opcode::IO_WRITE_C:
+            return true;
+        case ir::Opcode::IO_WRITE:
+            return instr.dst.value.imm8 == 0x0F || instr.dst.value.imm8 == 0xFF;
+        case ir::Opcode::STORE8:
+            return instr.dst.type == ir::OperandType::IMM16 &&
+                   (instr.dst.value.imm16 == 0xFF0F || instr.dst.value.imm16 == 0xFFFF);
+        default:
+            return false;
+    }
+}
+
+// Most cycles straight-line code runs between polls of ctx->stopped, which
+// bounds how late a due interrupt or a finished frame is noticed
+static constexpr uint32_t MAX_UNPOLLED_CYCLES = 64;
+
+// Function entered at bank:addr, including the vector-named ones in bank 0
+static const ir::Function* find_function(const ir::Program& program, uint8_t bank, uint16_t addr) {
+    auto it = program.functions.find(program.make_function_name(bank, addr));
+    if (it != program.functions.end()) return &it->second;
+    if (bank == 0 && addr <= 0x0100) {
+        for (const auto& [name, func] : program.functions) {
+            if (func.bank == 0 && func.entry_address == addr) return &func;
+        }
+    }
+    return nullptr;
+}
+
+// Callee of a CALL whose bank is known at compile time and which returns
+// with RET/RETI somewhere in its body; nullptr if it must be dispatched.
+// A BANK extra operand (set by ConstantPropagation after a constant MBC
+// write) names the switchable bank selected at the call site.
+static const ir::Function* find_native_callee(const ir::Program& program,
+                                              const ir::IRInstruction& instr) {
+    uint8_t source_bank = instr.source_bank;
+    uint16_t target = instr.dst.value.imm16;
+    uint8_t bank;
+    if (target < 0x4000) {
+        bank = 0;
+    } else if (target < 0x8000 && instr.extra.type == ir::OperandType::BANK) {
+        bank = instr.extra.value.bank;  // Verified at runtime like any banked callee
+    } else if (target < 0x8000 && source_bank > 0) {
+        bank = source_bank;  // Same switchable bank, verified at runtime
+    } else {
+        return nullptr;
+    }
+    
+    const ir::Function* found = find_function(program, bank, target);
+    if (!found) return nullptr;
+    const ir::Function& callee = *found;
+    
+    for (uint32_t block_id : callee.block_ids) {
+        auto block_it = program.blocks.find(block_id);
+        if (block_it == program.blocks.end()) continue;
+        for (const auto& instr : block_it->second.instructions) {
+            if (instr.opcode == ir::Opcode::RET ||
+                instr.opcode == ir::Opcode::RET_CC ||
+                instr.opcode == ir::Opcode::RETI) {
+                return &callee;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// Direct C call to a resolved callee; execution continues inline only when
+// the callee returned to return_addr, anything else goes back to dispatch
+static void emit_native_call(std::ostream& out, int indent,
+                             const ir::Function& callee, uint16_t return_addr) {
+    auto emit_indent = [&out, indent]() {
+        for (int i = 0; i < indent; i++) out << "    ";
+    };
+    
+    emit_indent(); out << "if (ctx->native_depth >= GB_MAX_NATIVE_DEPTH";
+    if (callee.bank > 0) {
+        out << " || ctx->rom_bank != " << (int)callee.bank;
+    }
+    out << ") return;\n";
+    emit_indent(); out << "ctx->native_depth++;\n";
+    emit_indent(); out << callee.name << "(ctx, 0);\n";
+    emit_indent(); out << "ctx->native_depth--;\n";
+    emit_indent(); out << "if (ctx->pc != 0x" << std::hex << return_addr << std::dec
+                       << " || ctx->stopped || ctx->halted) return;\n";
+}
+
+// The push, tick and native call of a resolved CALL as one runtime call,
+// for code compiled for size
+static std::string native_call_step(const ir::Function& callee, uint16_t return_addr,
+                                    uint16_t target, uint32_t cycles) {
+    return "if (!gb_call_native(ctx, " + hex_literal(return_addr, 4) + ", " + hex_literal(target, 4) +
+           ", " + std::to_string(cycles) + ", " + std::to_string(callee.bank) + ", " + callee.name +
+           ")) return;";
+}
+
 static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& instr, 
                                 const ir::Program& program, int indent, 
                                 const GeneratorOptions& options,
                                 uint16_t next_pc_val,
                                 uint32_t group_cycles,
                                 bool is_last_in_group,
-                                const std::string& current_func_name = "") {
+                                const std::set<std::string>& local_functions = {},
+                                uint32_t carry_cycles = 0,
+                                bool poll_stopped = true) {
     auto emit_indent = [&out, indent]() {
         for (int i = 0; i < indent; i++) out << "    ";
     };
     
+    // PC and tick of a taken branch, inside its if
+    auto emit_taken_step = [&](uint16_t target, uint32_t cycles) {
+        if (options.opt_size && options.emit_cycle_counting) {
+            emit_indent(); out << "    " << step_call(target, cycles, true) << "\n";
+            return;
+        }
+        emit_indent(); out << "    ctx->pc = 0x" << std::hex << target << std::dec << ";\n";
+        if (options.emit_cycle_counting) {
+            emit_indent(); out << "    gb_tick(ctx, " << cycles << ");\n";
+            emit_indent(); out << "    if (ctx->stopped) return;\n";
+        }
+    };
+    
+    // PC of the next instruction and this one's tick, nested extra levels
+    auto emit_next_step = [&](int extra, bool poll) {
+        std::string pad(extra * 4, ' ');
+        bool tick = options.emit_cycle_counting && group_cycles > 0;
+        if (options.opt_size && tick && next_pc_val != 0) {
+            emit_indent(); out << pad << step_call(next_pc_val, group_cycles, poll) << "\n";
+            return;
+        }
+        if (next_pc_val != 0) {
+            emit_indent(); out << pad << "ctx->pc = 0x" << std::hex << next_pc_val << std::dec << ";\n";
+        }
+        if (tick) {
+            emit_indent(); out << pad << "gb_tick(ctx, " << group_cycles << ");\n";
+            if (poll) {
+                emit_indent(); out << pad << "if (ctx->stopped) return;\n";
+            }
+        }
+    };
+    
     // Emit source location comment if enabled
     if (options.emit_address_comments && instr.source_address != 0) {
         emit_indent();
@@ -584,9 +1033,10 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
     }
     
     // Comment (usually disassembly)
-    if (!instr.comment.empty() && options.emit_comments) {
+    std::string_view comment = program.strings.view(instr.comment);
+    if (!comment.empty() && options.emit_comments) {
         emit_indent();
-        out << "/* " << instr.comment << " */\n";
+        out << "/* " << comment << " */\n";
         return;  // Comment-only instruction
     }
     
@@ -619,141 +1069,74 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
             if (!dst_name) dst_name = "a";
             
             if (instr.src.type == ir::OperandType::IMM16) {
-                out << "ctx->" << dst_name << " = gb_read8(ctx, 0x" << std::hex << std::setfill('0') 
-                    << std::setw(4) << instr.src.value.imm16 << std::dec << ");\n";
+                out << "ctx->" << dst_name << " = " << static_read8_expr(instr.src.value.imm16, rom0_fixed(program)) << ";\n";
             } else if (instr.src.type == ir::OperandType::REG16) {
-                out << "ctx->" << dst_name << " = gb_read8(ctx, ctx->" 
+                out << "ctx->" << dst_name << " = gb_read8_fast(ctx, ctx->" 
                     << reg16_names[instr.src.value.reg16] << ");\n";
             } else if (instr.src.type == ir::OperandType::REG8) {
                 // LDH A,(C) - 0xFF00 + C
-                out << "ctx->" << dst_name << " = gb_read8(ctx, 0xFF00 + ctx->c);\n";
+                out << "ctx->" << dst_name << " = gb_io_read(ctx, ctx->c);\n";
             } else {
-                out << "ctx->a = gb_read8(ctx, ctx->hl);\n";
+                out << "ctx->a = gb_read8_fast(ctx, ctx->hl);\n";
             }
             break;
         }
             
-        case ir::Opcode::STORE8:
+        case ir::Opcode::STORE8: {
+            std::string value;
+            const char* src_name = get_reg8_name(instr.src.value.reg8);
+            if (instr.src.type == ir::OperandType::IMM8) {
+                value = hex_literal(instr.src.value.imm8, 2);
+            } else if (src_name) {
+                value = std::string("ctx->") + src_name;
+            } else {
+                value = "ctx->a";
+            }
+            
             if (instr.dst.type == ir::OperandType::IMM16) {
-                const char* src_name = get_reg8_name(instr.src.value.reg8);
-                if (src_name) {
-                    out << "gb_write8(ctx, 0x" << std::hex << std::setfill('0') 
-                        << std::setw(4) << instr.dst.value.imm16 << std::dec 
-                        << ", ctx->" << src_name << ");\n";
-                } else if (instr.src.type == ir::OperandType::IMM8) {
-                    out << "gb_write8(ctx, 0x" << std::hex << std::setfill('0') 
-                        << std::setw(4) << instr.dst.value.imm16 << std::dec 
-                        << ", 0x" << std::setw(2) << (int)instr.src.value.imm8 << ");\n";
-                } else {
-                    out << "gb_write8(ctx, 0x" << std::hex << std::setfill('0') 
-                        << std::setw(4) << instr.dst.value.imm16 << std::dec 
-                        << ", ctx->a);\n";
-                }
+                out << static_write8_stmt(instr.dst.value.imm16, value) << "\n";
             } else if (instr.dst.type == ir::OperandType::REG16) {
-                const char* src_name = get_reg8_name(instr.src.value.reg8);
-                if (src_name) {
-                    out << "gb_write8(ctx, ctx->" << reg16_names[instr.dst.value.reg16] 
-                        << ", ctx->" << src_name << ");\n";
-                } else if (instr.src.type == ir::OperandType::IMM8) {
-                    out << "gb_write8(ctx, ctx->" << reg16_names[instr.dst.value.reg16] 
-                        << ", 0x" << std::hex << std::setw(2) << (int)instr.src.value.imm8 << std::dec << ");\n";
-                } else {
-                    out << "gb_write8(ctx, ctx->" << reg16_names[instr.dst.value.reg16] 
-                        << ", ctx->a);\n";
-                }
+                out << "gb_write8_fast(ctx, ctx->" << reg16_names[instr.dst.value.reg16] 
+                    << ", " << value << ");\n";
             }
             break;
+        }
             
         case ir::Opcode::ADD8:
-            if (instr.src.type == ir::OperandType::IMM8) {
-                out << "gb_add8(ctx, 0x" << std::hex << std::setfill('0') 
-                    << std::setw(2) << (int)instr.src.value.imm8 << std::dec << ");\n";
-            } else {
-                out << "gb_add8(ctx, ctx->" << reg8_names[instr.src.value.reg8] << ");\n";
-            }
+            out << alu8_stmt(instr, "gb_add8", options.cache_registers) << "\n";
             break;
             
         case ir::Opcode::ADC8:
-            if (instr.src.type == ir::OperandType::IMM8) {
-                out << "gb_adc8(ctx, 0x" << std::hex << std::setfill('0') 
-                    << std::setw(2) << (int)instr.src.value.imm8 << std::dec << ");\n";
-            } else {
-                out << "gb_adc8(ctx, ctx->" << reg8_names[instr.src.value.reg8] << ");\n";
-            }
+            out << alu8_stmt(instr, "gb_adc8", options.cache_registers) << "\n";
             break;
             
         case ir::Opcode::SUB8:
-            if (instr.src.type == ir::OperandType::IMM8) {
-                out << "gb_sub8(ctx, 0x" << std::hex << std::setfill('0') 
-                    << std::setw(2) << (int)instr.src.value.imm8 << std::dec << ");\n";
-            } else {
-                out << "gb_sub8(ctx, ctx->" << reg8_names[instr.src.value.reg8] << ");\n";
-            }
+            out << alu8_stmt(instr, "gb_sub8", options.cache_registers) << "\n";
             break;
             
         case ir::Opcode::SBC8:
-            if (instr.src.type == ir::OperandType::IMM8) {
-                out << "gb_sbc8(ctx, 0x" << std::hex << std::setfill('0') 
-                    << std::setw(2) << (int)instr.src.value.imm8 << std::dec << ");\n";
-            } else {
-                out << "gb_sbc8(ctx, ctx->" << reg8_names[instr.src.value.reg8] << ");\n";
-            }
+            out << alu8_stmt(instr, "gb_sbc8", options.cache_registers) << "\n";
             break;
             
         case ir::Opcode::AND8:
-            if (instr.src.type == ir::OperandType::IMM8) {
-                out << "gb_and8(ctx, 0x" << std::hex << std::setfill('0') 
-                    << std::setw(2) << (int)instr.src.value.imm8 << std::dec << ");\n";
-            } else {
-                out << "gb_and8(ctx, ctx->" << reg8_names[instr.src.value.reg8] << ");\n";
-            }
+            out << alu8_stmt(instr, "gb_and8", options.cache_registers) << "\n";
             break;
             
         case ir::Opcode::OR8:
-            if (instr.src.type == ir::OperandType::IMM8) {
-                out << "gb_or8(ctx, 0x" << std::hex << std::setfill('0') 
-                    << std::setw(2) << (int)instr.src.value.imm8 << std::dec << ");\n";
-            } else {
-                out << "gb_or8(ctx, ctx->" << reg8_names[instr.src.value.reg8] << ");\n";
-            }
+            out << alu8_stmt(instr, "gb_or8", options.cache_registers) << "\n";
             break;
             
         case ir::Opcode::XOR8:
-            if (instr.src.type == ir::OperandType::IMM8) {
-                out << "gb_xor8(ctx, 0x" << std::hex << std::setfill('0') 
-                    << std::setw(2) << (int)instr.src.value.imm8 << std::dec << ");\n";
-            } else {
-                out << "gb_xor8(ctx, ctx->" << reg8_names[instr.src.value.reg8] << ");\n";
-            }
+            out << alu8_stmt(instr, "gb_xor8", options.cache_registers) << "\n";
             break;
             
         case ir::Opcode::CP8:
-            if (instr.src.type == ir::OperandType::IMM8) {
-                out << "gb_cp8(ctx, 0x" << std::hex << std::setfill('0') 
-                    << std::setw(2) << (int)instr.src.value.imm8 << std::dec << ");\n";
-            } else {
-                out << "gb_cp8(ctx, ctx->" << reg8_names[instr.src.value.reg8] << ");\n";
-            }
+            out << alu8_stmt(instr, "gb_cp8", options.cache_registers) << "\n";
             break;
             
         case ir::Opcode::INC8:
-            if (instr.dst.value.reg8 == 6) {
-                // INC (HL) - read-modify-write memory at address HL
-                out << "gb_write8(ctx, ctx->hl, gb_inc8(ctx, gb_read8(ctx, ctx->hl)));\n";
-            } else {
-                out << "ctx->" << reg8_names[instr.dst.value.reg8] 
-                    << " = gb_inc8(ctx, ctx->" << reg8_names[instr.dst.value.reg8] << ");\n";
-            }
-            break;
-            
         case ir::Opcode::DEC8:
-            if (instr.dst.value.reg8 == 6) {
-                // DEC (HL) - read-modify-write memory at address HL
-                out << "gb_write8(ctx, ctx->hl, gb_dec8(ctx, gb_read8(ctx, ctx->hl)));\n";
-            } else {
-                out << "ctx->" << reg8_names[instr.dst.value.reg8] 
-                    << " = gb_dec8(ctx, ctx->" << reg8_names[instr.dst.value.reg8] << ");\n";
-            }
+            out << incdec8_stmt(instr, options.cache_registers) << "\n";
             break;
             
         case ir::Opcode::INC16:
@@ -765,7 +1148,7 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
             break;
             
         case ir::Opcode::ADD16:
-            out << "gb_add16(ctx, ctx->" << reg16_names[instr.src.value.reg16] << ");\n";
+            out << add16_stmt(instr, options.cache_registers) << "\n";
             break;
             
         case ir::Opcode::ADD_SP_IMM8:
@@ -773,7 +1156,16 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
                 break;
                 
             case ir::Opcode::PUSH16:
-                if (instr.dst.value.reg16 == 4) { // AF
+                if (options.cache_registers) {
+                    // Open-coded so SP and F stay in the cached register file
+                    std::string value = std::string("ctx->") + reg16_names[instr.dst.value.reg16];
+                    if (instr.dst.value.reg16 == 4) {
+                        out << "ctx->f = (ctx->f_z ? 0x80 : 0) | (ctx->f_n ? 0x40 : 0) | "
+                               "(ctx->f_h ? 0x20 : 0) | (ctx->f_c ? 0x10 : 0); ";
+                        value = "ctx->af & 0xFFF0";
+                    }
+                    out << "ctx->sp -= 2; gb_write16(ctx, ctx->sp, " << value << ");\n";
+                } else if (instr.dst.value.reg16 == 4) { // AF
                     out << "gb_pack_flags(ctx); gb_push16(ctx, ctx->af & 0xFFF0);\n";
                 } else {
                     out << "gb_push16(ctx, ctx->" << reg16_names[instr.dst.value.reg16] << ");\n";
@@ -781,7 +1173,16 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
                 break;
                 
             case ir::Opcode::POP16:
-                if (instr.dst.value.reg16 == 4) { // AF
+                if (options.cache_registers) {
+                    bool af = instr.dst.value.reg16 == 4;
+                    out << "ctx->" << reg16_names[instr.dst.value.reg16] << " = gb_read16(ctx, ctx->sp)"
+                        << (af ? " & 0xFFF0" : "") << "; ctx->sp += 2;";
+                    if (af) {
+                        out << " ctx->f_z = (ctx->f & 0x80) != 0; ctx->f_n = (ctx->f & 0x40) != 0;"
+                               " ctx->f_h = (ctx->f & 0x20) != 0; ctx->f_c = (ctx->f & 0x10) != 0;";
+                    }
+                    out << "\n";
+                } else if (instr.dst.value.reg16 == 4) { // AF
                     out << "ctx->af = gb_pop16(ctx) & 0xFFF0; gb_unpack_flags(ctx);\n";
                 } else {
                     out << "ctx->" << reg16_names[instr.dst.value.reg16] << " = gb_pop16(ctx);\n";
@@ -814,8 +1215,8 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
                 }
                 
                 if (is_cross_bank) {
-                    if (options.emit_cycle_counting && instr.cycles > 0) {
-                        out << "gb_tick(ctx, " << (int)instr.cycles << ");\n";
+                    if (options.emit_cycle_counting && instr.cycles + carry_cycles > 0) {
+                        out << "gb_tick(ctx, " << (int)(instr.cycles + carry_cycles) << ");\n";
                         emit_indent();
                     }
                     out << "gb_dispatch(ctx, 0x" << std::hex << std::setfill('0') 
@@ -827,10 +1228,12 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
                     std::string func_name = func_name_ss.str();
                     
                     if (program.functions.find(func_name) != program.functions.end()) {
-                        // Check if target is the CURRENT function - if so, use goto to avoid recursion
-                        if (func_name == current_func_name) {
+                        // Target emitted in this body (itself or a superblock tail) - goto it
+                        if (local_functions.count(func_name)) {
                             // Cycle tick before goto
-                            if (options.emit_cycle_counting && group_cycles > 0) {
+                            if (options.opt_size && options.emit_cycle_counting && group_cycles > 0) {
+                                out << step_call(target, group_cycles, true) << "\n";
+                            } else if (options.emit_cycle_counting && group_cycles > 0) {
                                 out << "ctx->pc = 0x" << std::hex << target << std::dec << ";\n";
                                 emit_indent();
                                 out << "gb_tick(ctx, " << (int)group_cycles << ");\n";
@@ -844,7 +1247,9 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
                                 << std::setw(4) << target << std::dec << ";\n";
                         } else {
                             // Target is a different function entry - call it and return
-                            if (options.emit_cycle_counting && group_cycles > 0) {
+                            if (options.opt_size && options.emit_cycle_counting && group_cycles > 0) {
+                                out << step_call(target, group_cycles, true) << "\n";
+                            } else if (options.emit_cycle_counting && group_cycles > 0) {
                                 out << "ctx->pc = 0x" << std::hex << target << std::dec << ";\n";
                                 emit_indent();
                                 out << "gb_tick(ctx, " << (int)group_cycles << ");\n";
@@ -858,7 +1263,9 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
                         }
                     } else {
                         // Target is a label within a function - emit cycles before goto
-                        if (options.emit_cycle_counting && group_cycles > 0) {
+                        if (options.opt_size && options.emit_cycle_counting && group_cycles > 0) {
+                            out << step_call(target, group_cycles, true) << "\n";
+                        } else if (options.emit_cycle_counting && group_cycles > 0) {
                             out << "ctx->pc = 0x" << std::hex << target << std::dec << ";\n";
                             emit_indent();
                             out << "gb_tick(ctx, " << (int)group_cycles << ");\n";
@@ -880,6 +1287,35 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
                     out << "gb_tick(ctx, " << (int)group_cycles << ");\n";
                     emit_indent(); out << "if (ctx->stopped) return;\n";
                 }
+                
+                // Proven jump table: switch over the known targets first
+                auto table_it = program.jump_tables.find(
+                    (static_cast<uint32_t>(instr.source_bank) << 16) | instr.source_address);
+                if (table_it != program.jump_tables.end()) {
+                    std::map<uint16_t, std::vector<const ir::Function*>> by_addr;
+                    for (uint32_t full : table_it->second) {
+                        if (const ir::Function* f = find_function(program, full >> 16, full & 0xFFFF)) {
+                            by_addr[full & 0xFFFF].push_back(f);
+                        }
+                    }
+                    emit_indent(); out << "switch (ctx->pc) {\n";
+                    for (const auto& [addr, funcs] : by_addr) {
+                        emit_indent(); out << "    case 0x" << std::hex << std::setfill('0') 
+                                           << std::setw(4) << addr << std::dec << ":\n";
+                        for (const ir::Function* f : funcs) {
+                            emit_indent(); out << "        ";
+                            if (addr >= 0x4000) {
+                                out << "if (ctx->rom_bank == " << (int)f->bank << ") ";
+                            }
+                            out << "{ dispatch_native(ctx, " << f->name << ", 0); return; }\n";
+                        }
+                        emit_indent(); out << "        break;\n";
+                    }
+                    emit_indent(); out << "    default: break;\n";
+                    emit_indent(); out << "}\n";
+                }
+                emit_indent();
+                out << "dispatch_jump(ctx);\n";
                 emit_indent();
                 out << "return;\n";
             } else {
@@ -890,6 +1326,8 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
                     emit_indent(); out << "if (ctx->stopped) return;\n";
                 }
                 emit_indent();
+                out << "dispatch_jump(ctx);\n";
+                emit_indent();
                 out << "return;\n";
             }
             break;
@@ -917,11 +1355,7 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
             
             if (is_cross_bank) {
                 out << "if (" << expr << ") {\n";
-                emit_indent(); out << "    ctx->pc = 0x" << std::hex << target << std::dec << ";\n";
-                if (options.emit_cycle_counting) {
-                    emit_indent(); out << "    gb_tick(ctx, " << (int)instr.cycles_branch_taken << ");\n";
-                    emit_indent(); out << "    if (ctx->stopped) return;\n";
-                }
+                emit_taken_step(target, instr.cycles_branch_taken + carry_cycles);
                 emit_indent(); out << "return;\n";
                 emit_indent(); out << "} /* " << cond << " */\n";
             } else {
@@ -935,48 +1369,30 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
                 std::string func_name = func_name_ss.str();
                 
                 if (program.functions.find(func_name) != program.functions.end()) {
-                    // Check if target is the CURRENT function - if so, use goto to avoid recursion
-                    if (func_name == current_func_name) {
+                    // Target emitted in this body (itself or a superblock tail) - goto it
+                    if (local_functions.count(func_name)) {
                         out << "if (" << expr << ") {\n";
-                        emit_indent(); out << "    ctx->pc = 0x" << std::hex << target << std::dec << ";\n";
-                        if (options.emit_cycle_counting) {
-                            emit_indent(); out << "    gb_tick(ctx, " << (int)instr.cycles_branch_taken << ");\n";
-                            emit_indent(); out << "    if (ctx->stopped) return;\n";
-                        }
+                        emit_taken_step(target, instr.cycles_branch_taken + carry_cycles);
                         emit_indent(); out << "    goto loc_" << std::hex << std::setfill('0') 
                             << std::setw(4) << target << std::dec << ";\n";
                         emit_indent(); out << "} /* " << cond << " */\n";
                     } else {
                         // Target is a different function entry - call it and return on condition
                         out << "if (" << expr << ") {\n";
-                        emit_indent(); out << "    ctx->pc = 0x" << std::hex << target << std::dec << ";\n";
-                        if (options.emit_cycle_counting) {
-                            emit_indent(); out << "    gb_tick(ctx, " << (int)instr.cycles_branch_taken << ");\n";
-                            emit_indent(); out << "    if (ctx->stopped) return;\n";
-                        }
+                        emit_taken_step(target, instr.cycles_branch_taken + carry_cycles);
                         emit_indent(); out << "    return;\n";
                         emit_indent(); out << "} /* " << cond << " */\n";
                     }
                 } else {
                     out << "if (" << expr << ") {\n";
-                    emit_indent(); out << "    ctx->pc = 0x" << std::hex << target << std::dec << ";\n";
-                    if (options.emit_cycle_counting) {
-                        emit_indent(); out << "    gb_tick(ctx, " << (int)instr.cycles_branch_taken << ");\n";
-                        emit_indent(); out << "    if (ctx->stopped) return;\n";
-                    }
+                    emit_taken_step(target, instr.cycles_branch_taken + carry_cycles);
                     emit_indent(); out << "    goto loc_" << std::hex << std::setfill('0') 
                         << std::setw(4) << target << std::dec << ";\n";
                     emit_indent(); out << "} /* " << cond << " */\n";
                 }
             }
             // Branch NOT taken: update PC to next and tick with base cycles
-            if (next_pc_val != 0) {
-                emit_indent(); out << "ctx->pc = 0x" << std::hex << next_pc_val << std::dec << ";\n";
-            }
-            if (options.emit_cycle_counting && group_cycles > 0) {
-                emit_indent(); out << "gb_tick(ctx, " << (int)group_cycles << ");\n";
-                emit_indent(); out << "if (ctx->stopped) return;\n";
-            }
+            emit_next_step(0, true);
             break;
         }
             
@@ -984,16 +1400,27 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
             uint16_t target = instr.dst.value.imm16;
             // PUSH return address (Instruction size 3)
             uint16_t return_addr = instr.source_address + 3;
-            out << "gb_push16(ctx, 0x" << std::hex << return_addr << std::dec << ");\n";
+            const ir::Function* native = options.opt_size ? find_native_callee(program, instr) : nullptr;
+            if (native) {
+                uint32_t cycles = options.emit_cycle_counting ? group_cycles : 0;
+                out << native_call_step(*native, return_addr, target, cycles) << "\n";
+                break;
+            }
+            out << push_addr_stmt(options, return_addr) << "\n";
             emit_indent();
             out << "ctx->pc = 0x" << std::hex << target << std::dec << ";\n";
             if (options.emit_cycle_counting && group_cycles > 0) {
                 emit_indent(); out << "gb_tick(ctx, " << (int)group_cycles << ");\n";
                 emit_indent(); out << "if (ctx->stopped) return;\n";
             }
+            
+            // Statically resolved callee: call it natively and continue inline
+            // if it returned to us, otherwise leave ctx->pc to the trampoline
+            if (const ir::Function* callee = find_native_callee(program, instr)) {
+                emit_native_call(out, indent, *callee, return_addr);
+                break;
+            }
             emit_indent();
-
-            // For targets in banked area (0x4000-0x7FFF), always use dispatch
             out << "return;\n";
             break;
         }
@@ -1006,31 +1433,39 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
                                (instr.src.value.condition == 1) ? "ctx->f_z" :
                                (instr.src.value.condition == 2) ? "!ctx->f_c" : "ctx->f_c";
             
+            const ir::Function* callee = find_native_callee(program, instr);
+            
             out << "if (" << expr << ") {\n";
-            emit_indent(); out << "    gb_push16(ctx, 0x" << std::hex << return_addr << std::dec << ");\n";
-            emit_indent(); out << "    ctx->pc = 0x" << std::hex << target << std::dec << ";\n";
-            if (options.emit_cycle_counting) {
-                emit_indent(); out << "    gb_tick(ctx, " << (int)instr.cycles_branch_taken << ");\n";
-                emit_indent(); out << "    if (ctx->stopped) return;\n";
+            if (callee && options.opt_size) {
+                uint32_t cycles = options.emit_cycle_counting ? instr.cycles_branch_taken + carry_cycles : 0;
+                emit_indent(); out << "    " << native_call_step(*callee, return_addr, target, cycles) << "\n";
+                emit_indent(); out << "} else { /* " << cond << " */\n";
+            } else if (callee) {
+                emit_indent(); out << "    " << push_addr_stmt(options, return_addr) << "\n";
+                emit_taken_step(target, instr.cycles_branch_taken + carry_cycles);
+                emit_native_call(out, indent + 1, *callee, return_addr);
+                emit_indent(); out << "} else { /* " << cond << " */\n";
+            } else {
+                emit_indent(); out << "    " << push_addr_stmt(options, return_addr) << "\n";
+                emit_taken_step(target, instr.cycles_branch_taken + carry_cycles);
+                emit_indent(); out << "    return;\n";
+                emit_indent(); out << "} /* " << cond << " */\n";
             }
-            emit_indent();
-            out << "    return;\n";
-            emit_indent(); out << "    return;\n";
-            emit_indent(); out << "} /* " << cond << " */\n";
             
             // Branch NOT taken
-            if (next_pc_val != 0) {
-                emit_indent(); out << "ctx->pc = 0x" << std::hex << next_pc_val << std::dec << ";\n";
-            }
-            if (options.emit_cycle_counting && group_cycles > 0) {
-                emit_indent(); out << "gb_tick(ctx, " << (int)group_cycles << ");\n";
-                emit_indent(); out << "if (ctx->stopped) return;\n";
+            emit_next_step(callee ? 1 : 0, true);
+            if (callee) {
+                emit_indent(); out << "}\n";
             }
             break;
         }
             
         case ir::Opcode::RET:
-            out << "gb_ret(ctx);\n";
+            if (options.opt_size && options.emit_cycle_counting && group_cycles > 0) {
+                out << "gb_ret_tick(ctx, " << group_cycles << "); return;\n";
+                break;
+            }
+            out << ret_stmt(options) << "\n";
             if (options.emit_cycle_counting && group_cycles > 0) {
                 emit_indent();
                 out << "gb_tick(ctx, " << (int)group_cycles << ");\n";
@@ -1045,26 +1480,26 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
                                (instr.src.value.condition == 1) ? "ctx->f_z" :
                                (instr.src.value.condition == 2) ? "!ctx->f_c" : "ctx->f_c";
             out << "if (" << expr << ") {\n";
-            emit_indent(); out << "    gb_ret(ctx);\n";
+            if (options.opt_size && options.emit_cycle_counting) {
+                emit_indent(); out << "    gb_ret_tick(ctx, " << 20 + carry_cycles << "); return;\n";
+                emit_indent(); out << "} /* " << cond << " */\n";
+                emit_next_step(0, true);
+                break;
+            }
+            emit_indent(); out << "    " << ret_stmt(options) << "\n";
             if (options.emit_cycle_counting) {
-                emit_indent(); out << "    gb_tick(ctx, 20); /* RET_CC cycles always 20 if taken */\n";
+                emit_indent(); out << "    gb_tick(ctx, " << (int)(20 + carry_cycles) << "); /* RET_CC cycles always 20 if taken */\n";
             }
             emit_indent(); out << "    return;\n";
             emit_indent(); out << "} /* " << cond << " */\n";
             // Not taken: update PC and tick
-            if (next_pc_val != 0) {
-                emit_indent(); out << "ctx->pc = 0x" << std::hex << next_pc_val << std::dec << ";\n";
-            }
-            if (options.emit_cycle_counting && group_cycles > 0) {
-                emit_indent(); out << "gb_tick(ctx, " << (int)group_cycles << ");\n";
-                emit_indent(); out << "if (ctx->stopped) return;\n";
-            }
+            emit_next_step(0, true);
             break;
         }
             
         case ir::Opcode::RETI:
-            out << "ctx->ime = 1;\n";
-            emit_indent(); out << "gb_ret(ctx);\n";
+            out << "ctx->ime = 1; gb_schedule_now(ctx);\n";
+            emit_indent(); out << ret_stmt(options) << "\n";
             if (options.emit_cycle_counting && group_cycles > 0) {
                 emit_indent(); out << "gb_tick(ctx, " << (int)group_cycles << ");\n";
             }
@@ -1075,7 +1510,7 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
             {
                 // Push return address (instruction size 1)
                 uint16_t next_pc = instr.source_address + 1;
-                out << "gb_push16(ctx, 0x" << std::hex << next_pc << std::dec << ");\n";
+                out << push_addr_stmt(options, next_pc) << "\n";
                 emit_indent();
                 
                 uint8_t vector = instr.dst.value.rst_vec;
@@ -1105,12 +1540,31 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
             out << "gb_stop(ctx);\n";
             break;
             
+        case ir::Opcode::BLOCK_COPY:
+        case ir::Opcode::BLOCK_FILL:
+        case ir::Opcode::WAIT_LY: {
+            // The intrinsic runs all but the exiting iteration's tick; false
+            // means it stopped at the loop head
+            uint32_t iteration = options.emit_cycle_counting ? instr.cycles_branch_taken : 0;
+            out << "if (!" << loop_idiom_call(instr, iteration) << ") { ctx->pc = 0x"
+                << std::hex << instr.source_address << std::dec << "; return; }\n";
+            if (next_pc_val != 0) {
+                emit_indent();
+                out << "ctx->pc = 0x" << std::hex << next_pc_val << std::dec << ";\n";
+            }
+            if (options.emit_cycle_counting) {
+                emit_indent(); out << "gb_tick(ctx, " << (int)(instr.cycles + carry_cycles) << ");\n";
+                emit_indent(); out << "if (ctx->stopped) return;\n";
+            }
+            break;
+        }
+            
         case ir::Opcode::DI:
             out << "ctx->ime = 0;\n";
             break;
             
         case ir::Opcode::EI:
-            out << "ctx->ime_pending = 1;\n";
+            out << "ctx->ime_pending = 1; gb_schedule_now(ctx);\n";
             break;
             
         case ir::Opcode::DAA:
@@ -1133,7 +1587,7 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
             if (instr.dst.value.reg8 == 6) {
                 // BIT n,(HL) - read from memory
                 out << "gb_bit(ctx, " << (int)instr.src.value.bit_idx 
-                    << ", gb_read8(ctx, ctx->hl));\n";
+                    << ", gb_read8_fast(ctx, ctx->hl));\n";
             } else {
                 out << "gb_bit(ctx, " << (int)instr.src.value.bit_idx 
                     << ", ctx->" << reg8_names[instr.dst.value.reg8] << ");\n";
@@ -1143,7 +1597,7 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
         case ir::Opcode::SET:
             if (instr.dst.value.reg8 == 6) {
                 // SET n,(HL) - read-modify-write memory
-                out << "gb_write8(ctx, ctx->hl, gb_read8(ctx, ctx->hl) | (1 << " 
+                out << "gb_write8_fast(ctx, ctx->hl, gb_read8_fast(ctx, ctx->hl) | (1 << " 
                     << (int)instr.src.value.bit_idx << "));\n";
             } else {
                 out << "ctx->" << reg8_names[instr.dst.value.reg8] 
@@ -1154,7 +1608,7 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
         case ir::Opcode::RES:
             if (instr.dst.value.reg8 == 6) {
                 // RES n,(HL) - read-modify-write memory
-                out << "gb_write8(ctx, ctx->hl, gb_read8(ctx, ctx->hl) & ~(1 << " 
+                out << "gb_write8_fast(ctx, ctx->hl, gb_read8_fast(ctx, ctx->hl) & ~(1 << " 
                     << (int)instr.src.value.bit_idx << "));\n";
             } else {
                 out << "ctx->" << reg8_names[instr.dst.value.reg8] 
@@ -1165,31 +1619,29 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
         // === I/O Port Operations ===
         case ir::Opcode::IO_READ:
             // LDH A,(n) - read from 0xFF00 + immediate offset
-            out << "ctx->a = gb_read8(ctx, 0xFF00 + 0x" << std::hex << std::setfill('0') 
-                << std::setw(2) << (int)instr.src.value.imm8 << std::dec << ");\n";
+            out << "ctx->a = " << static_read8_expr(0xFF00 + instr.src.value.imm8, true) << ";\n";
             break;
             
         case ir::Opcode::IO_READ_C:
             // LDH A,(C) - read from 0xFF00 + C register
-            out << "ctx->a = gb_read8(ctx, 0xFF00 + ctx->c);\n";
+            out << "ctx->a = gb_io_read(ctx, ctx->c);\n";
             break;
             
         case ir::Opcode::IO_WRITE:
             // LDH (n),A - write to 0xFF00 + immediate offset
-            out << "gb_write8(ctx, 0xFF00 + 0x" << std::hex << std::setfill('0') 
-                << std::setw(2) << (int)instr.dst.value.imm8 << std::dec << ", ctx->a);\n";
+            out << static_write8_stmt(0xFF00 + instr.dst.value.imm8, "ctx->a") << "\n";
             break;
             
         case ir::Opcode::IO_WRITE_C:
             // LDH (C),A - write to 0xFF00 + C register
-            out << "gb_write8(ctx, 0xFF00 + ctx->c, ctx->a);\n";
+            out << "gb_io_write(ctx, ctx->c, ctx->a);\n";
             break;
             
         // === Rotate/Shift Operations ===
         case ir::Opcode::RLC:
             if (instr.dst.value.reg8 == 6) {
                 // RLC (HL) - read, rotate, write back
-                out << "gb_write8(ctx, ctx->hl, gb_rlc(ctx, gb_read8(ctx, ctx->hl)));\n";
+                out << "gb_write8_fast(ctx, ctx->hl, gb_rlc(ctx, gb_read8_fast(ctx, ctx->hl)));\n";
             } else if (instr.extra.type == ir::OperandType::IMM8 && instr.extra.value.imm8 == 1) {
                 // RLCA variant (Z flag always 0)
                 out << "gb_rlca(ctx);\n";
@@ -1201,7 +1653,7 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
             
         case ir::Opcode::RRC:
             if (instr.dst.value.reg8 == 6) {
-                out << "gb_write8(ctx, ctx->hl, gb_rrc(ctx, gb_read8(ctx, ctx->hl)));\n";
+                out << "gb_write8_fast(ctx, ctx->hl, gb_rrc(ctx, gb_read8_fast(ctx, ctx->hl)));\n";
             } else if (instr.extra.type == ir::OperandType::IMM8 && instr.extra.value.imm8 == 1) {
                 out << "gb_rrca(ctx);\n";
             } else {
@@ -1212,7 +1664,7 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
             
         case ir::Opcode::RL:
             if (instr.dst.value.reg8 == 6) {
-                out << "gb_write8(ctx, ctx->hl, gb_rl(ctx, gb_read8(ctx, ctx->hl)));\n";
+                out << "gb_write8_fast(ctx, ctx->hl, gb_rl(ctx, gb_read8_fast(ctx, ctx->hl)));\n";
             } else if (instr.extra.type == ir::OperandType::IMM8 && instr.extra.value.imm8 == 1) {
                 out << "gb_rla(ctx);\n";
             } else {
@@ -1223,7 +1675,7 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
             
         case ir::Opcode::RR:
             if (instr.dst.value.reg8 == 6) {
-                out << "gb_write8(ctx, ctx->hl, gb_rr(ctx, gb_read8(ctx, ctx->hl)));\n";
+                out << "gb_write8_fast(ctx, ctx->hl, gb_rr(ctx, gb_read8_fast(ctx, ctx->hl)));\n";
             } else if (instr.extra.type == ir::OperandType::IMM8 && instr.extra.value.imm8 == 1) {
                 out << "gb_rra(ctx);\n";
             } else {
@@ -1234,7 +1686,7 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
             
         case ir::Opcode::SLA:
             if (instr.dst.value.reg8 == 6) {
-                out << "gb_write8(ctx, ctx->hl, gb_sla(ctx, gb_read8(ctx, ctx->hl)));\n";
+                out << "gb_write8_fast(ctx, ctx->hl, gb_sla(ctx, gb_read8_fast(ctx, ctx->hl)));\n";
             } else {
                 out << "ctx->" << reg8_names[instr.dst.value.reg8] 
                     << " = gb_sla(ctx, ctx->" << reg8_names[instr.dst.value.reg8] << ");\n";
@@ -1243,7 +1695,7 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
             
         case ir::Opcode::SRA:
             if (instr.dst.value.reg8 == 6) {
-                out << "gb_write8(ctx, ctx->hl, gb_sra(ctx, gb_read8(ctx, ctx->hl)));\n";
+                out << "gb_write8_fast(ctx, ctx->hl, gb_sra(ctx, gb_read8_fast(ctx, ctx->hl)));\n";
             } else {
                 out << "ctx->" << reg8_names[instr.dst.value.reg8] 
                     << " = gb_sra(ctx, ctx->" << reg8_names[instr.dst.value.reg8] << ");\n";
@@ -1252,7 +1704,7 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
             
         case ir::Opcode::SRL:
             if (instr.dst.value.reg8 == 6) {
-                out << "gb_write8(ctx, ctx->hl, gb_srl(ctx, gb_read8(ctx, ctx->hl)));\n";
+                out << "gb_write8_fast(ctx, ctx->hl, gb_srl(ctx, gb_read8_fast(ctx, ctx->hl)));\n";
             } else {
                 out << "ctx->" << reg8_names[instr.dst.value.reg8] 
                     << " = gb_srl(ctx, ctx->" << reg8_names[instr.dst.value.reg8] << ");\n";
@@ -1261,7 +1713,7 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
             
         case ir::Opcode::SWAP:
             if (instr.dst.value.reg8 == 6) {
-                out << "gb_write8(ctx, ctx->hl, gb_swap(ctx, gb_read8(ctx, ctx->hl)));\n";
+                out << "gb_write8_fast(ctx, ctx->hl, gb_swap(ctx, gb_read8_fast(ctx, ctx->hl)));\n";
             } else {
                 out << "ctx->" << reg8_names[instr.dst.value.reg8] 
                     << " = gb_swap(ctx, ctx->" << reg8_names[instr.dst.value.reg8] << ");\n";
@@ -1291,38 +1743,874 @@ static void emit_ir_instruction(std::ostream& out, const ir::IRInstruction& inst
     }
     
     // Emit cycle counting and PPU tick
-    bool is_control_flow = (instr.opcode == ir::Opcode::RET || 
-                            instr.opcode == ir::Opcode::RETI ||
-                            instr.opcode == ir::Opcode::RET_CC ||
-                            instr.opcode == ir::Opcode::JUMP ||
-                            instr.opcode == ir::Opcode::JUMP_CC ||
-                            instr.opcode == ir::Opcode::JUMP_REG ||
-                            instr.opcode == ir::Opcode::JR ||
-                            instr.opcode == ir::Opcode::JR_CC ||
-                            instr.opcode == ir::Opcode::CALL ||
-                            instr.opcode == ir::Opcode::CALL_CC ||
-                            instr.opcode == ir::Opcode::RST ||
-                            instr.opcode == ir::Opcode::HALT ||
-                            instr.opcode == ir::Opcode::STOP);
+    bool is_control_flow = is_control_flow_op(instr.opcode);
 
     if (is_last_in_group && !is_control_flow) {
         // Update PC for correct resumption if stopped
-        if (next_pc_val != 0) {
-            emit_indent();
-            out << "ctx->pc = 0x" << std::hex << next_pc_val << std::dec << ";\n";
-        }
-        
-        if (options.emit_cycle_counting && group_cycles > 0) {
-            emit_indent();
-            out << "gb_tick(ctx, " << (int)group_cycles << ");\n";
-            emit_indent();
-            out << "if (ctx->stopped) return;\n";
-        }
+        emit_next_step(0, poll_stopped);
     }
 }
 
-GeneratedOutput generate_output(const ir::Program& program,
-                                const uint8_t* rom_data,
+/* ============================================================================
+ * Register Caching
+ * ========================================================================== */
+
+// Runtime calls that never read or write CPU registers: memory and I/O
+// accesses and the cycle tick (events only flag interrupts, which are
+// dispatched by the trampoline). Any other call taking ctx observes them.
+static bool is_register_blind_call(const std::string& name) {
+    static const std::set<std::string> blind = {
+        "gb_read8", "gb_write8", "gb_read8_fast", "gb_write8_fast",
+        "gb_write8_slow", "gb_read16", "gb_write16", "gb_io_read",
+        "gb_io_write", "gb_tick", "gb_schedule_now",
+    };
+    return blind.count(name) != 0;
+}
+
+static bool is_ident_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// True if the line passes ctx to a call that can observe CPU registers
+static bool line_observes_registers(const std::string& line) {
+    for (size_t pos = line.find("(ctx"); pos != std::string::npos;
+         pos = line.find("(ctx", pos + 1)) {
+        size_t after = pos + 4;
+        if (after < line.size() && is_ident_char(line[after])) continue;
+        size_t start = pos;
+        while (start > 0 && is_ident_char(line[start - 1])) start--;
+        if (start == pos) continue;  // cast or grouping, not a call
+        if (!is_register_blind_call(line.substr(start, pos - start))) return true;
+    }
+    return false;
+}
+
+// Rewrites ctx->reg references to the cached register file
+static std::string use_cached_registers(const std::string& line) {
+    static const std::set<std::string> regs = {
+        "a", "f", "b", "c", "d", "e", "h", "l", "af", "bc", "de", "hl",
+        "sp", "pc", "f_z", "f_n", "f_h", "f_c",
+    };
+    std::string out;
+    size_t pos = 0;
+    for (size_t hit = line.find("ctx->"); hit != std::string::npos;
+         hit = line.find("ctx->", pos)) {
+        size_t end = hit + 5;
+        while (end < line.size() && is_ident_char(line[end])) end++;
+        bool whole = hit == 0 || !is_ident_char(line[hit - 1]);
+        std::string field = line.substr(hit + 5, end - hit - 5);
+        out += line.substr(pos, hit - pos);
+        out += whole && regs.count(field) ? "regs." + field : line.substr(hit, end - hit);
+        pos = end;
+    }
+    return out + line.substr(pos);
+}
+
+/**
+ * @brief Moves a generated function body onto cached registers
+ *
+ * The body works on a GBRegisters local loaded at entry, which the host
+ * compiler can keep in registers since no runtime call can alias it. Lines
+ * calling into code that observes CPU state (helpers, native callees,
+ * dispatch, the interpreter) keep addressing ctx and are bracketed by a
+ * store and a reload; every return stores first.
+ */
+static std::string cache_registers_in_body(const std::string& body) {
+    std::istringstream in(body);
+    std::string out;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::string indent = line.substr(0, line.find_first_not_of(' '));
+        if (line_observes_registers(line)) {
+            out += indent + "gb_regs_store(ctx, &regs);\n" + line + "\n" +
+                   indent + "gb_regs_load(&regs, ctx);\n";
+            continue;
+        }
+        std::string cached = use_cached_registers(line);
+        std::string synced;
+        size_t pos = 0;
+        for (size_t hit = cached.find("return;"); hit != std::string::npos;
+             hit = cached.find("return;", pos)) {
+            synced += cached.substr(pos, hit - pos);
+            synced += "{ gb_regs_store(ctx, &regs); return; }";
+            pos = hit + 7;
+        }
+        out += synced + cached.substr(pos) + "\n";
+    }
+    return out;
+}
+
+/* ============================================================================
+ * Lane Kernels
+ * ========================================================================== */
+
+// Rewrites ctx->reg references to lane i of a GBSoARegs register file
+static std::string use_lane_registers(const std::string& line) {
+    static const std::set<std::string> regs = {
+        "a", "b", "c", "d", "e", "h", "l", "f_z", "f_n", "f_h", "f_c",
+    };
+    std::string out;
+    size_t pos = 0;
+    for (size_t hit = line.find("ctx->"); hit != std::string::npos;
+         hit = line.find("ctx->", pos)) {
+        size_t end = hit + 5;
+        while (end < line.size() && is_ident_char(line[end])) end++;
+        bool whole = hit == 0 || !is_ident_char(line[hit - 1]);
+        std::string field = line.substr(hit + 5, end - hit - 5);
+        out += line.substr(pos, hit - pos);
+        out += whole && regs.count(field) ? "s->" + field + "[i]" : line.substr(hit, end - hit);
+        pos = end;
+    }
+    return out + line.substr(pos);
+}
+
+// Memory a kernel may access: fixed addresses with no side effects beyond
+// what gb_wram_write and gb_hram_write already handle
+static bool is_lane_memory(uint16_t addr) {
+    return (addr >= 0xC000 && addr < 0xD000) || (addr >= 0xFF80 && addr < 0xFFFF);
+}
+
+/**
+ * @brief Lane loop body of one non-branching IR instruction
+ *
+ * Only register, flag and WRAM0/HRAM operations qualify: anything that can
+ * reach I/O, banked memory or the stack, or changes control flow, keeps the
+ * block scalar. Flags are computed inline, honouring flag liveness.
+ * @return false if kernels cannot run the instruction
+ */
+static bool lane_stmt(const ir::IRInstruction& instr, std::string& stmt) {
+    static const char* pairs[3][2] = {{"b", "c"}, {"d", "e"}, {"h", "l"}};
+    auto reg = [](const ir::Operand& op) {
+        return op.type == ir::OperandType::REG8 ? get_reg8_name(op.value.reg8) : nullptr;
+    };
+    switch (instr.opcode) {
+        case ir::Opcode::NOP:
+        case ir::Opcode::LABEL:
+        case ir::Opcode::COMMENT:
+        case ir::Opcode::SOURCE_LOC:
+            stmt.clear();
+            return true;
+        case ir::Opcode::MOV_REG_REG:
+            if (!reg(instr.dst) || !reg(instr.src)) return false;
+            stmt = std::string("ctx->") + reg(instr.dst) + " = ctx->" + reg(instr.src) + ";";
+            break;
+        case ir::Opcode::MOV_REG_IMM8:
+            if (!reg(instr.dst)) return false;
+            stmt = std::string("ctx->") + reg(instr.dst) + " = " + hex_literal(instr.src.value.imm8, 2) + ";";
+            break;
+        case ir::Opcode::MOV_REG_IMM16: {
+            if (instr.dst.value.reg16 > 2) return false;
+            const char* const* pair = pairs[instr.dst.value.reg16];
+            stmt = std::string("ctx->") + pair[0] + " = " + hex_literal(instr.src.value.imm16 >> 8, 2) +
+                   "; ctx->" + pair[1] + " = " + hex_literal(instr.src.value.imm16 & 0xFF, 2) + ";";
+            break;
+        }
+        case ir::Opcode::INC16:
+        case ir::Opcode::DEC16: {
+            if (instr.dst.value.reg16 > 2) return false;
+            const char* const* pair = pairs[instr.dst.value.reg16];
+            std::string hi = std::string("ctx->") + pair[0], lo = std::string("ctx->") + pair[1];
+            stmt = "{ uint16_t v = (uint16_t)((" + hi + " << 8 | " + lo + ")" +
+                   (instr.opcode == ir::Opcode::INC16 ? " + 1" : " - 1") + "); " +
+                   hi + " = (uint8_t)(v >> 8); " + lo + " = (uint8_t)v; }";
+            break;
+        }
+        case ir::Opcode::ADD8:
+        case ir::Opcode::ADC8:
+        case ir::Opcode::SUB8:
+        case ir::Opcode::SBC8:
+        case ir::Opcode::AND8:
+        case ir::Opcode::OR8:
+        case ir::Opcode::XOR8:
+        case ir::Opcode::CP8:
+            if (instr.src.type != ir::OperandType::IMM8 && !reg(instr.src)) return false;
+            stmt = alu8_stmt(instr, "", true);
+            if (stmt.compare(0, 2, "/*") == 0) stmt.clear();  // CP with no live flags
+            if (stmt.empty()) return true;
+            break;
+        case ir::Opcode::INC8:
+        case ir::Opcode::DEC8:
+            if (!reg(instr.dst)) return false;
+            stmt = incdec8_stmt(instr, true);
+            break;
+        case ir::Opcode::CPL:
+            stmt = "ctx->a = ~ctx->a; ctx->f_n = 1; ctx->f_h = 1;";
+            break;
+        case ir::Opcode::SCF:
+            stmt = "ctx->f_n = 0; ctx->f_h = 0; ctx->f_c = 1;";
+            break;
+        case ir::Opcode::CCF:
+            stmt = "ctx->f_n = 0; ctx->f_h = 0; ctx->f_c = !ctx->f_c;";
+            break;
+        case ir::Opcode::BIT:
+            if (!reg(instr.dst)) return false;
+            stmt = std::string("ctx->f_z = !(ctx->") + reg(instr.dst) + " & " +
+                   hex_literal(1u << instr.src.value.bit_idx, 2) + "); ctx->f_n = 0; ctx->f_h = 1;";
+            break;
+        case ir::Opcode::LOAD8:
+        case ir::Opcode::IO_READ: {
+            uint16_t addr = instr.opcode == ir::Opcode::IO_READ ? 0xFF00 + instr.src.value.imm8
+                                                                : instr.src.value.imm16;
+            if (instr.opcode == ir::Opcode::LOAD8 && instr.src.type != ir::OperandType::IMM16) return false;
+            if (!is_lane_memory(addr)) return false;
+            const char* dst = instr.opcode == ir::Opcode::LOAD8 ? reg(instr.dst) : "a";
+            if (!dst) dst = "a";
+            stmt = std::string("ctx->") + dst + " = " + static_read8_expr(addr, true) + ";";
+            break;
+        }
+        case ir::Opcode::STORE8:
+        case ir::Opcode::IO_WRITE: {
+            uint16_t addr = instr.opcode == ir::Opcode::IO_WRITE ? 0xFF00 + instr.dst.value.imm8
+                                                                 : instr.dst.value.imm16;
+            if (instr.opcode == ir::Opcode::STORE8 && instr.dst.type != ir::OperandType::IMM16) return false;
+            if (!is_lane_memory(addr)) return false;
+            std::string value = "ctx->a";
+            if (instr.opcode == ir::Opcode::STORE8 && instr.src.type == ir::OperandType::IMM8) {
+                value = hex_literal(instr.src.value.imm8, 2);
+            } else if (instr.opcode == ir::Opcode::STORE8 && reg(instr.src)) {
+                value = std::string("ctx->") + reg(instr.src);
+            }
+            stmt = static_write8_stmt(addr, value);
+            break;
+        }
+        default:
+            return false;
+    }
+    stmt = use_lane_registers(stmt);
+    // Memory goes through the lane's own context
+    if (stmt.find("(ctx") != std::string::npos || stmt.find("ctx->") != std::string::npos) {
+        stmt = "{ GBContext* ctx = s->ctx[i]; " + stmt + " }";
+    }
+    return true;
+}
+
+/**
+ * @brief Lane kernel of a block, one loop over the lanes per instruction
+ *
+ * The block may end in a jump to a fixed address, taken per lane for a
+ * conditional one, or fall through; each lane's next PC and the cycles
+ * of its path are left in s->pc and s->cycles for the batch to apply.
+ * @return false if the block has an instruction kernels cannot run
+ */
+static bool emit_lane_kernel(std::ostream& out, const ir::BasicBlock& block, const std::string& name) {
+    std::vector<std::string> stmts;
+    uint32_t cycles = 0;
+    const ir::IRInstruction* jump = nullptr;
+    for (const auto& instr : block.instructions) {
+        if (jump) {
+            if (instr.opcode != ir::Opcode::LABEL && instr.opcode != ir::Opcode::COMMENT &&
+                instr.opcode != ir::Opcode::SOURCE_LOC) return false;
+            continue;
+        }
+        if (instr.opcode == ir::Opcode::JUMP || instr.opcode == ir::Opcode::JUMP_CC) {
+            if (instr.dst.type != ir::OperandType::IMM16) return false;
+            jump = &instr;
+            continue;
+        }
+        std::string stmt;
+        if (!lane_stmt(instr, stmt)) return false;
+        if (!stmt.empty()) stmts.push_back(stmt);
+        cycles += instr.cycles;
+    }
+    if (stmts.empty() && !jump) return false;
+    
+    out << "/* Block at " << std::hex << std::setfill('0');
+    if (block.bank > 0) out << std::setw(2) << (int)block.bank << ":";
+    out << std::setw(4) << block.start_address << std::dec << " */\n";
+    out << "static void " << name << "(GBSoARegs* s, int n) {\n";
+    for (const auto& stmt : stmts) {
+        out << "    for (int i = 0; i < n; i++) " << (stmt[0] == '{' ? stmt : "{ " + stmt + " }") << "\n";
+    }
+    if (jump && jump->opcode == ir::Opcode::JUMP_CC) {
+        uint8_t cc = jump->src.value.condition;
+        const char* flag = cc < 2 ? "f_z" : "f_c";
+        out << "    for (int i = 0; i < n; i++) {\n";
+        out << "        int taken = " << (cc & 1 ? "" : "!") << "s->" << flag << "[i];\n";
+        out << "        s->pc[i] = taken ? " << hex_literal(jump->dst.value.imm16, 4) << " : "
+            << hex_literal(block.end_address, 4) << ";\n";
+        out << "        s->cycles[i] = taken ? " << cycles + jump->cycles_branch_taken << " : "
+            << cycles + jump->cycles << ";\n";
+        out << "    }\n";
+    } else {
+        uint16_t next = jump ? jump->dst.value.imm16 : block.end_address;
+        if (jump) cycles += jump->cycles;
+        out << "    for (int i = 0; i < n; i++) { s->pc[i] = " << hex_literal(next, 4)
+            << "; s->cycles[i] = " << cycles << "; }\n";
+    }
+    out << "}\n\n";
+    return true;
+}
+
+/* ============================================================================
+ * Output Generation
+ * ========================================================================== */
+
+// Resume index of each block start within a function
+using EntryIndices = std::map<uint16_t, uint16_t>;
+
+// Attribute placing a function with the hot or cold code (gbrecomp --profile)
+static const char* function_attribute(const ir::Function& func) {
+    if (func.hot) return "GBRECOMP_HOT ";
+    if (func.cold) return "GBRECOMP_COLD ";
+    return "";
+}
+
+// Largest function copied into a predecessor, in IR instructions
+static constexpr size_t SUPERBLOCK_TAIL_LIMIT = 64;
+
+/**
+ * @brief Functions emitted inside func's body to form a superblock
+ * 
+ * Follows the unconditional same-bank jumps and fallthroughs that would
+ * otherwise leave func for another function's entry, and takes in those
+ * functions while they are small and the budget lasts. Their blocks get
+ * local labels, so the jumps become gotos instead of trips through the
+ * trampoline; the tails are still emitted on their own as well. RAM code
+ * is never taken in, as its overlay guard must run on every entry.
+ */
+static std::vector<const ir::Function*> superblock_tails(const ir::Program& program,
+                                                         const ir::Function& func,
+                                                         size_t budget) {
+    std::vector<const ir::Function*> tails;
+    if (budget == 0 || func.entry_address >= 0x8000) return tails;
+    
+    std::set<uint16_t> starts;
+    for (uint32_t id : func.block_ids) {
+        auto it = program.blocks.find(id);
+        if (it != program.blocks.end()) starts.insert(it->second.start_address);
+    }
+    std::set<std::string> taken = {func.name};
+    
+    // Breadth first from func, so the nearest tails win the budget
+    std::vector<const ir::Function*> queue = {&func};
+    for (size_t q = 0; q < queue.size(); q++) {
+        const ir::Function& from = *queue[q];
+        for (uint32_t id : from.block_ids) {
+            auto block_it = program.blocks.find(id);
+            if (block_it == program.blocks.end()) continue;
+            const ir::BasicBlock& block = block_it->second;
+            
+            // Same rules as the emitter: unconditional jumps stay in the
+            // bank only within bank 0, fallthroughs within any bank
+            std::string name;
+            const ir::IRInstruction* last = nullptr;
+            for (auto it = block.instructions.rbegin(); it != block.instructions.rend(); ++it) {
+                if (it->opcode != ir::Opcode::NOP) { last = &*it; break; }
+            }
+            if (last && last->opcode == ir::Opcode::JUMP) {
+                if (last->dst.type != ir::OperandType::IMM16) continue;
+                uint16_t target = last->dst.value.imm16;
+                if (last->source_bank > 0 || target >= 0x4000) continue;
+                name = program.make_function_name(0, target);
+            } else if (last && last->opcode == ir::Opcode::RET) {
+                continue;
+            } else {
+                if (starts.count(block.end_address)) continue;
+                name = program.make_function_name(from.bank, block.end_address);
+            }
+            if (taken.count(name)) continue;
+            
+            auto func_it = program.functions.find(name);
+            if (func_it == program.functions.end()) continue;
+            const ir::Function& tail = func_it->second;
+            if (tail.entry_address >= 0x8000) continue;
+            
+            // Small enough, and no label clashes with blocks already here
+            size_t size = 0;
+            bool clash = false;
+            for (uint32_t tail_id : tail.block_ids) {
+                auto it = program.blocks.find(tail_id);
+                if (it == program.blocks.end()) continue;
+                size += it->second.instructions.size();
+                clash |= starts.count(it->second.start_address) > 0;
+            }
+            if (clash || size > SUPERBLOCK_TAIL_LIMIT || size > budget) continue;
+            
+            budget -= size;
+            for (uint32_t tail_id : tail.block_ids) {
+                auto it = program.blocks.find(tail_id);
+                if (it != program.blocks.end()) starts.insert(it->second.start_address);
+            }
+            taken.insert(name);
+            tails.push_back(&tail);
+            queue.push_back(&tail);
+        }
+    }
+    return tails;
+}
+
+/**
+ * @brief Emit one recompiled function
+ * 
+ * Only reads the program, so functions are generated concurrently.
+ */
+static void emit_function(std::ostream& out, const ir::Program& program, const ir::Function& func,
+                          const EntryIndices& indices, const GeneratorOptions& base_options) {
+    // Hot functions from a runtime profile trade code size for speed. Cold
+    // ones, and with --opt-size all but the hot ones, go the other way:
+    // their most repeated sequences become calls to runtime helpers.
+    bool for_size = !func.hot && (func.cold || base_options.opt_size);
+    GeneratorOptions tuned_options;
+    const GeneratorOptions* chosen = &base_options;
+    if (func.hot) {
+        tuned_options = base_options;
+        tuned_options.cache_registers = true;
+        tuned_options.timing_mode = TimingMode::Block;
+        tuned_options.opt_size = false;
+        chosen = &tuned_options;
+    } else if (for_size != base_options.opt_size || (for_size && base_options.cache_registers)) {
+        tuned_options = base_options;
+        tuned_options.opt_size = for_size;
+        // The helpers update ctx->pc behind the cached registers' back
+        if (for_size) tuned_options.cache_registers = false;
+        chosen = &tuned_options;
+    }
+    const GeneratorOptions& options = *chosen;
+    
+    out << "/* Function at ";
+    if (func.bank > 0) {
+        out << std::hex << std::setfill('0') << std::setw(2) << (int)func.bank << ":";
+    }
+    out << std::hex << std::setfill('0') << std::setw(4) << func.entry_address << std::dec << " */\n";
+    out << function_attribute(func) << "void " << func.name << "(GBContext* ctx, uint16_t entry) {\n";
+    out << "    GBRT_HOTSPOT_ENTER(ctx, " << (int)func.bank << ", " << hex_literal(func.entry_address, 4) << ");\n";
+    if (options.cache_registers) {
+        out << "    GBRegisters regs;\n";
+        out << "    gb_regs_load(&regs, ctx);\n";
+    }
+    std::ostringstream body_ss;
+    
+    
+    // Blocks of this function and its superblock tails
+    std::vector<uint32_t> sorted_block_ids = func.block_ids;
+    std::set<std::string> local_functions = {func.name};
+    for (const ir::Function* tail : superblock_tails(program, func, options.superblock_budget)) {
+        sorted_block_ids.insert(sorted_block_ids.end(), tail->block_ids.begin(), tail->block_ids.end());
+        local_functions.insert(tail->name);
+    }
+    
+    // Sort block_ids by their start address to ensure proper fallthrough order
+    std::sort(sorted_block_ids.begin(), sorted_block_ids.end(), 
+        [&program](uint32_t a, uint32_t b) {
+            auto it_a = program.blocks.find(a);
+            auto it_b = program.blocks.find(b);
+            if (it_a == program.blocks.end()) return false;
+            if (it_b == program.blocks.end()) return true;
+            return it_a->second.start_address < it_b->second.start_address;
+        });
+        
+    // Resume at a block other than the entry; entry 0 falls through
+    // unless the entry block is not the lowest-addressed one
+    bool entry_first = true;
+    if (!sorted_block_ids.empty()) {
+        auto first_it = program.blocks.find(sorted_block_ids.front());
+        entry_first = first_it == program.blocks.end() ||
+                      first_it->second.start_address == func.entry_address;
+    }
+    if (indices.size() > 1 || !entry_first) {
+        body_ss << "    switch (entry) {\n";
+        for (const auto& [addr, index] : indices) {
+            if (index == 0 && entry_first) continue;
+            body_ss << "        case " << index << ": goto loc_" 
+                      << std::hex << std::setfill('0') << std::setw(4) 
+                      << addr << std::dec << ";\n";
+        }
+        body_ss << "        default: break;\n";
+        body_ss << "    }\n\n";
+    } else {
+        body_ss << "    (void)entry;\n\n";
+    }
+    
+    // ctx->stopped is polled at safe points only: control flow, an
+    // instruction that raises interrupts, before DI (so a due interrupt is
+    // not held off), and whenever MAX_UNPOLLED_CYCLES have gone by. Carried
+    // across fallthroughs into the next block.
+    uint32_t unpolled_cycles = 0;
+    bool group_raises = false;
+    
+    // Emit each block in this function (now sorted by address)
+    for (size_t block_idx = 0; block_idx < sorted_block_ids.size(); block_idx++) {
+        uint32_t block_id = sorted_block_ids[block_idx];
+        auto block_it = program.blocks.find(block_id);
+        if (block_it == program.blocks.end()) continue;
+        const ir::BasicBlock& block = block_it->second;
+        
+        // Generate label from block address
+        body_ss << "loc_" << std::hex << std::setfill('0') << std::setw(4) 
+                  << block.start_address << std::dec << ":\n";
+        
+        // In block timing mode, cycles of straight-line groups are deferred
+        // and charged at the next split point: a control-flow instruction,
+        // the end of the block, or an access to timing-sensitive I/O.
+        bool block_timing = options.timing_mode == TimingMode::Block;
+        uint32_t pending_cycles = 0;
+        
+        // Emit each IR instruction, grouped by source address
+        uint32_t group_cycles = 0;
+        for (size_t i = 0; i < block.instructions.size(); ++i) {
+            const auto& ir_instr = block.instructions[i];
+            group_cycles += ir_instr.cycles;
+            
+            uint16_t next_pc = 0;
+            bool is_last_in_group = true;
+            
+            // Identify if this is the last IR instruction for this GameBoy instruction
+            if (i + 1 < block.instructions.size()) {
+                if (block.instructions[i+1].source_address == ir_instr.source_address && ir_instr.source_address != 0) {
+                    is_last_in_group = false;
+                    next_pc = ir_instr.source_address;
+                } else {
+                    next_pc = block.instructions[i+1].source_address;
+                }
+            } else {
+                next_pc = block.end_address;
+            }
+            
+            // If it's the last in group, we use the accumulated cycles
+            // Actually, let's just use ir_instr.cycles if we don't want to refactor cycles accumulation yet.
+            // Re-think: better to pass the accumulated cycles only at the end.
+            
+            uint32_t cycles_to_pass = is_last_in_group ? group_cycles : 0;
+            if (is_last_in_group) group_cycles = 0; // Reset for next group
+            
+            uint32_t carry_cycles = 0;
+            if (block_timing) {
+                if (is_timing_sensitive(ir_instr) && pending_cycles > 0) {
+                    body_ss << "    gb_tick(ctx, " << pending_cycles << ");\n";
+                    pending_cycles = 0;
+                }
+                if (is_last_in_group) {
+                    bool block_exit = is_control_flow_op(ir_instr.opcode) ||
+                                      i + 1 == block.instructions.size();
+                    if (block_exit) {
+                        carry_cycles = pending_cycles;
+                        cycles_to_pass += pending_cycles;
+                        pending_cycles = 0;
+                    } else {
+                        pending_cycles += cycles_to_pass;
+                        cycles_to_pass = 0;
+                        is_last_in_group = false;
+                    }
+                }
+            }
+            
+            bool poll = true;
+            group_raises |= raises_interrupts(ir_instr);
+            if (!block_timing && is_last_in_group) {
+                unpolled_cycles += cycles_to_pass;
+                bool before_di = false;
+                for (size_t j = i + 1; j < block.instructions.size() &&
+                     block.instructions[j].source_address == next_pc; j++) {
+                    before_di |= block.instructions[j].opcode == ir::Opcode::DI;
+                }
+                poll = is_control_flow_op(ir_instr.opcode) || group_raises || before_di ||
+                       unpolled_cycles >= MAX_UNPOLLED_CYCLES;
+                if (poll) unpolled_cycles = 0;
+                group_raises = false;
+            }
+            
+            emit_ir_instruction(body_ss, ir_instr, program, 1, options, next_pc, cycles_to_pass, is_last_in_group, local_functions, carry_cycles, poll);
+        }
+        
+        // Check if block falls through
+        bool falls_through = true;
+        uint16_t fallthrough_addr = block.end_address;
+        
+        // Find the last non-NOP instruction
+        for (auto it = block.instructions.rbegin(); it != block.instructions.rend(); ++it) {
+            if (it->opcode == ir::Opcode::NOP) continue;
+            
+            // Unconditional terminators do not fall through
+            if (it->opcode == ir::Opcode::JUMP || 
+                it->opcode == ir::Opcode::RET) {
+                falls_through = false;
+            }
+            break;
+        }
+        
+        bool next_is_fallthrough = false;
+        if (block_idx + 1 < sorted_block_ids.size()) {
+            uint32_t next_id = sorted_block_ids[block_idx + 1];
+            auto next_it = program.blocks.find(next_id);
+            if (next_it != program.blocks.end()) {
+                if (next_it->second.start_address == fallthrough_addr) {
+                    next_is_fallthrough = true;
+                }
+            }
+        }
+        
+        if (falls_through && !next_is_fallthrough) {
+                // Debug specific function 27eb
+                if (func.name == "func_27eb") {
+                    std::cerr << "DEBUG: found func_27eb falling through to 0x" << std::hex << fallthrough_addr << std::dec << "\n";
+                }
+
+                // Check if fallthrough target exists as a block in this function
+                bool fallthrough_exists_in_function = false;
+                for (uint32_t fn_block_id : sorted_block_ids) {
+                    auto fn_block_it = program.blocks.find(fn_block_id);
+                    if (fn_block_it != program.blocks.end() && 
+                        fn_block_it->second.start_address == fallthrough_addr) {
+                        fallthrough_exists_in_function = true;
+                        break;
+                    }
+                }
+                
+                // Only emit goto if the target block exists in this function
+                if (fallthrough_exists_in_function) {
+                    // Emit explicit goto to fallthrough block
+                    body_ss << "    goto loc_" << std::hex << std::setfill('0') 
+                              << std::setw(4) << fallthrough_addr << std::dec 
+                              << "; /* fallthrough */\n";
+                } else {
+                    if (func.name == "func_27eb") {
+                         std::cerr << "DEBUG: func_27eb fallthrough not in function. Searching targets...\n";
+                    }
+                    // Fallthrough to another function?
+                    // Check if any function starts at fallthrough_addr in the same bank
+                    bool found_target_func = false;
+                    for (const auto& kv : program.functions) {
+                        const ir::Function& target_func = kv.second;
+                        if (target_func.bank == func.bank && target_func.entry_address == fallthrough_addr) {
+                            body_ss << "    /* fallthrough to function */\n";
+                            body_ss << "    " << target_func.name << "(ctx, 0);\n";
+                            body_ss << "    return;\n";
+                            found_target_func = true;
+                            if (func.name == "func_27eb") std::cerr << "DEBUG: Found target: " << target_func.name << "\n";
+                            break;
+                        }
+                    }
+                    
+                    if (!found_target_func) {
+                        if (func.name == "func_27eb") std::cerr << "DEBUG: No target function found for 0x" << std::hex << fallthrough_addr << std::dec << "\n";
+                        body_ss << "    /* warning: fallthrough to unanalyzed code at 0x" 
+                                  << std::hex << fallthrough_addr << std::dec << " in bank " << (int)func.bank << " */\n";
+                        
+                        body_ss << "    return;\n";
+                    }
+                }
+
+        }
+    }
+    
+    if (options.cache_registers) {
+        out << cache_registers_in_body(body_ss.str());
+        out << "    gb_regs_store(ctx, &regs);\n";
+    } else {
+        out << body_ss.str();
+    }
+    
+    // If function is empty or has no terminator, add a return
+    out << "}\n\n";
+}
+
+/**
+ * @brief Generate every function's source text, in order, on a worker pool
+ */
+static std::vector<std::string> emit_functions(const ir::Program& program,
+                                               const std::vector<const ir::Function*>& funcs,
+                                               const std::vector<const EntryIndices*>& indices,
+                                               const GeneratorOptions& options) {
+    std::vector<std::string> texts(funcs.size());
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t i = next++; i < funcs.size(); i = next++) {
+            std::ostringstream out;
+            emit_function(out, program, *funcs[i], *indices[i], options);
+            texts[i] = out.str();
+        }
+    };
+    
+    unsigned threads = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, funcs.size()));
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++) workers.emplace_back(work);
+    work();
+    for (auto& worker : workers) worker.join();
+    return texts;
+}
+
+/* ============================================================================
+ * Profiling Maps
+ * ========================================================================== */
+
+static uint32_t location_key(uint8_t bank, uint16_t addr) {
+    return static_cast<uint32_t>(bank) << 16 | addr;
+}
+
+// The "bb:aaaa" or "aaaa" of an address comment as a location key, or -1
+static long parse_location(const std::string& text) {
+    auto is_hex = [&text](size_t from, size_t count) {
+        for (size_t i = from; i < from + count; i++) {
+            if (!std::isdigit(static_cast<unsigned char>(text[i])) && (text[i] < 'a' || text[i] > 'f')) return false;
+        }
+        return true;
+    };
+    if (text.size() == 4 && is_hex(0, 4)) return std::stol(text, nullptr, 16);
+    if (text.size() == 7 && text[2] == ':' && is_hex(0, 2) && is_hex(3, 4)) {
+        return std::stol(text.substr(0, 2), nullptr, 16) << 16 | std::stol(text.substr(3), nullptr, 16);
+    }
+    return -1;
+}
+
+// Location of a function body line opening with an address comment, or -1
+static long line_location(const std::string& line) {
+    size_t pos = line.find_first_not_of(' ');
+    if (pos == std::string::npos || line.compare(pos, 3, "/* ") != 0) return -1;
+    size_t end = line.find(" */", pos + 3);
+    if (end == std::string::npos) return -1;
+    return parse_location(line.substr(pos + 3, end - pos - 3));
+}
+
+static std::string json_string(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out += ' ';
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+/**
+ * @brief Disassembly listing of every recompiled instruction, by bank:address
+ *
+ * Takes the IR's disassembly comments, decoding ROM code that has none
+ * (--no-comments). Fills lines with each location's line in the listing.
+ */
+static std::string build_listing(const ir::Program& program, const uint8_t* rom_data, size_t rom_size,
+                                 std::map<uint32_t, size_t>& lines) {
+    std::map<uint32_t, std::string> texts;
+    for (const auto& [id, block] : program.blocks) {
+        for (const auto& instr : block.instructions) {
+            if (instr.source_address == 0) continue;
+            std::string& text = texts[location_key(instr.source_bank, instr.source_address)];
+            if (text.empty()) text = program.strings.view(instr.comment);
+        }
+    }
+    
+    std::ostringstream ss;
+    ss << "; Generated by gbrecomp from " << program.rom_name << "\n";
+    size_t line = 1;
+    for (auto& [key, text] : texts) {
+        uint8_t bank = static_cast<uint8_t>(key >> 16);
+        uint16_t addr = static_cast<uint16_t>(key);
+        if (text.empty()) {
+            text = addr < 0x8000 ? decode_instruction(rom_data, rom_size, addr, bank).disassemble() : "?";
+        }
+        ss << std::hex << std::setfill('0') << std::setw(2) << (int)bank << ":"
+           << std::setw(4) << addr << std::dec << "  " << text << "\n";
+        lines[key] = ++line;
+    }
+    return ss.str();
+}
+
+/**
+ * @brief Record a code file's functions in the symbol map, optionally
+ *        pointing each instruction's C lines at the listing
+ *
+ * With a listing, every line from an instruction's address comment up to
+ * the next one is preceded by a #line naming the instruction's listing
+ * line, so a sample anywhere in its C code is attributed to it; function
+ * headers and trailers are switched back to the file itself. The line
+ * numbers recorded are those of the returned text.
+ */
+static std::string annotate_code_file(const GeneratedOutput::File& file,
+                                      const std::map<uint32_t, size_t>* listing_lines,
+                                      const std::string& listing_file,
+                                      std::vector<std::string>& json_functions) {
+    std::string out;
+    out.reserve(file.content.size() * (listing_lines ? 2 : 1));
+    size_t line_no = 0;
+    bool directed = false;
+    size_t listing_line = 0;
+    auto put = [&](const std::string& line) {
+        out += line;
+        out += '\n';
+        line_no++;
+    };
+    auto back_to_file = [&] {
+        if (!directed) return;
+        put("#line " + std::to_string(line_no + 2) + " \"" + file.name + "\"");
+        directed = false;
+    };
+    
+    bool in_function = false;
+    std::string name;
+    long func_location = -1;
+    size_t first_line = 0;
+    long current = -1;
+    std::ostringstream locations;
+    
+    for (size_t start = 0; start < file.content.size(); ) {
+        size_t end = file.content.find('\n', start);
+        if (end == std::string::npos) end = file.content.size();
+        std::string line = file.content.substr(start, end - start);
+        start = end + 1;
+        
+        if (line.compare(0, 15, "/* Function at ") == 0) {
+            back_to_file();
+            size_t close = line.find(" */", 15);
+            func_location = close == std::string::npos ? -1 : parse_location(line.substr(15, close - 15));
+            in_function = true;
+            name.clear();
+            current = -1;
+            locations.str("");
+            put(line);
+            first_line = line_no;
+            continue;
+        }
+        if (!in_function) {
+            put(line);
+            continue;
+        }
+        if (line == "}") {
+            back_to_file();
+            put(line);
+            in_function = false;
+            uint32_t at = func_location < 0 ? 0 : static_cast<uint32_t>(func_location);
+            json_functions.push_back("    {\"name\": " + json_string(name) + ", \"file\": " + json_string(file.name) +
+                                     ", \"bank\": " + std::to_string(at >> 16) +
+                                     ", \"address\": " + std::to_string(at & 0xFFFF) +
+                                     ", \"lines\": [" + std::to_string(first_line) + ", " + std::to_string(line_no) +
+                                     "],\n     \"locations\": [" + locations.str() + "]}");
+            continue;
+        }
+        if (name.empty()) {
+            size_t paren = line.find("(GBContext* ctx, uint16_t entry)");
+            size_t type = paren == std::string::npos ? paren : line.rfind("void ", paren);
+            if (type != std::string::npos) name = line.substr(type + 5, paren - type - 5);
+        }
+        
+        long key = line_location(line);
+        bool starts = key >= 0 && key != current;
+        if (starts) {
+            current = key;
+            if (listing_lines) {
+                auto it = listing_lines->find(static_cast<uint32_t>(key));
+                if (it != listing_lines->end()) {
+                    listing_line = it->second;
+                    directed = true;
+                }
+            }
+        }
+        if (directed) put("#line " + std::to_string(listing_line) + " \"" + listing_file + "\"");
+        put(line);
+        if (starts) {
+            if (locations.tellp() > 0) locations << ", ";
+            locations << "[" << line_no << ", " << (key >> 16) << ", " << (key & 0xFFFF) << "]";
+        }
+    }
+    return out;
+}
+
+GeneratedOutput generate_output(const ir::Program& program,
+                                const uint8_t* rom_data,
                                 size_t rom_size,
                                 const GeneratorOptions& options) {
     GeneratedOutput output;
@@ -1332,51 +2620,23 @@ GeneratedOutput generate_output(const ir::Program& program,
     header_ss << "/* Generated by gbrecomp */\n";
     header_ss << "#ifndef " << options.output_prefix << "_H\n";
     header_ss << "#define " << options.output_prefix << "_H\n\n";
-    header_ss << "#include \"gbrt.h\"\n\n";
+    header_ss << "#include \"gbrt.h\"\n";
+    header_ss << "#include \"lockstep.h\"\n\n";
     header_ss << "void " << options.output_prefix << "_run(GBContext* ctx);\n";
     header_ss << "void " << options.output_prefix << "_init(GBContext* ctx);\n\n";
+    header_ss << "/* What the optimized code keeps up to date, for gb_lockstep_set_live_masks */\n";
+    header_ss << "extern const GBLiveMask " << options.output_prefix << "_live_masks[];\n";
+    header_ss << "extern const size_t " << options.output_prefix << "_live_mask_count;\n\n";
+    if (options.soa_kernels) {
+        header_ss << "/* Lane kernels of simple blocks, for gb_batch_set_soa_kernels */\n";
+        header_ss << "#include \"batch.h\"\n";
+        header_ss << "extern const GBSoAKernelEntry " << options.output_prefix << "_soa_kernels[];\n";
+        header_ss << "extern const size_t " << options.output_prefix << "_soa_kernel_count;\n\n";
+    }
     header_ss << "#endif\n";
     output.header_content = header_ss.str();
     output.header_file = options.output_prefix + ".h";
     
-    // Generate source
-    std::ostringstream source_ss;
-    source_ss << "/* Generated by gbrecomp from " << program.rom_name << " */\n";
-    source_ss << "#include \"" << options.output_prefix << ".h\"\n";
-    source_ss << "#include \"gbrt.h\"\n";
-    source_ss << "#include <stdio.h>\n";
-    source_ss << "#include <stdlib.h>\n\n";
-    
-    // Forward declarations
-    source_ss << "/* Forward declarations */\n";
-    for (const auto& [name, func] : program.functions) {
-        source_ss << "static void " << func.name << "(GBContext* ctx);\n";
-    }
-    source_ss << "\n";
-    
-    // Generate dispatch function for banked calls
-    source_ss << "/* Bank dispatch - routes calls to the correct bank function */\n";
-    source_ss << "void gb_dispatch(GBContext* ctx, uint16_t addr) {\n";
-    source_ss << "    ctx->pc = addr;\n";
-    source_ss << "    while (!ctx->stopped && !ctx->halted) {\n";
-    source_ss << "        addr = ctx->pc;\n";
-    source_ss << "        uint8_t bank = ctx->rom_bank;\n";
-    source_ss << "        if (addr < 0x4000) bank = 0;\n";
-        
-    /* Debug checks in dispatch loop */
-    source_ss << "        if (gbrt_instruction_limit > 0 && gbrt_instruction_count >= gbrt_instruction_limit) {\n";
-    source_ss << "            fprintf(stderr, \"[LIMIT] Reached instruction limit %llu\\n\", (unsigned long long)gbrt_instruction_limit);\n";
-    source_ss << "            exit(0);\n";
-    source_ss << "        }\n";
-    source_ss << "        gbrt_instruction_count++;\n";
-    source_ss << "        \n";
-    source_ss << "        if (gbrt_trace_enabled) {\n";
-    source_ss << "            fprintf(stderr, \"[TRACE] Dispatch 0x%04X (Bank %d)\\n\", addr, bank);\n";
-    source_ss << "        }\n";
-
-    source_ss << "        switch (addr) {\n";
-    
-    // Group functions by address for the switch statement
     // Map every basic block start address to its function
     struct DispatchEntry {
         uint8_t bank;
@@ -1388,25 +2648,32 @@ GeneratedOutput generate_output(const ir::Program& program,
             return name < o.name;
         }
         bool operator==(const DispatchEntry& o) const {
-            return bank == o.bank && is_entry == o.is_entry; // Treat same bank/entry-status as equal for unique? NO.
-            // We want exact match for std::unique first.
-            // But wait, my manual unique below handles bank collisions.
             return bank == o.bank && name == o.name && is_entry == o.is_entry;
         }
     };
     std::map<uint16_t, std::vector<DispatchEntry>> addr_to_funcs;
-
+    
+    // Per-function resume index of each block: 0 is the function entry,
+    // other blocks are numbered densely in address order
+    std::map<std::string, std::map<uint16_t, uint16_t>> entry_indices;
+    
     for (const auto& [name, func] : program.functions) {
         addr_to_funcs[func.entry_address].push_back({func.bank, func.name, true});
+        std::set<uint16_t> starts;
         for (uint32_t block_id : func.block_ids) {
             auto it = program.blocks.find(block_id);
             if (it != program.blocks.end()) {
                 uint16_t addr = it->second.start_address;
                 if (addr != func.entry_address) {
                     addr_to_funcs[addr].push_back({func.bank, func.name, false});
+                    starts.insert(addr);
                 }
             }
         }
+        auto& indices = entry_indices[func.name];
+        indices[func.entry_address] = 0;
+        uint16_t next_index = 1;
+        for (uint16_t addr : starts) indices[addr] = next_index++;
     }
     
     for (auto& [addr, funcs] : addr_to_funcs) {
@@ -1418,200 +2685,292 @@ GeneratedOutput generate_output(const ir::Program& program,
             return a.bank == b.bank;
         });
         funcs.erase(last, funcs.end());
-
-        source_ss << "            case 0x" << std::hex << std::setfill('0') << std::setw(4) << addr << std::dec << ":\n";
-        if (funcs.size() == 1) {
-            source_ss << "                " << funcs[0].name << "(ctx); break;\n";
-        } else {
-            source_ss << "                switch (bank) {\n";
-            for (const auto& entry : funcs) {
-                source_ss << "                    case " << (int)entry.bank << ": " << entry.name << "(ctx); break;\n";
-            }
-            source_ss << "                    default: gb_interpret(ctx, addr); break;\n";
-            source_ss << "                }\n";
-            source_ss << "                break;\n";
+    }
+    
+    // Generate dispatch tables: one direct-mapped table per ROM bank that
+    // contains code, indexed by address within the bank. Code mapped into
+    // RAM (e.g. the HRAM DMA routine) is rare and stays on a switch.
+    size_t dispatch_banks = std::max<size_t>(2, (rom_size + 0x3FFF) / 0x4000);
+    if (dispatch_banks > 256) dispatch_banks = 256;
+    
+    // Shared header: prototypes of every function and the dispatch lookup
+    // that computed jumps inline, included by the dispatcher and each shard
+    std::string guard = options.output_prefix + "_INTERNAL_H";
+    std::ostringstream internal_ss;
+    internal_ss << "/* Generated by gbrecomp from " << program.rom_name << " */\n";
+    internal_ss << "#ifndef " << guard << "\n";
+    internal_ss << "#define " << guard << "\n\n";
+    internal_ss << "#include \"gbrt.h\"\n";
+    internal_ss << "#include <stdio.h>\n";
+    internal_ss << "#include <stdlib.h>\n\n";
+    
+    internal_ss << "/* Layout of profiled hot and cold code (gbrecomp --profile) */\n";
+    internal_ss << "#if defined(__GNUC__)\n";
+    internal_ss << "#define GBRECOMP_HOT __attribute__((hot))\n";
+    internal_ss << "#define GBRECOMP_COLD __attribute__((cold))\n";
+    internal_ss << "#else\n";
+    internal_ss << "#define GBRECOMP_HOT\n";
+    internal_ss << "#define GBRECOMP_COLD\n";
+    internal_ss << "#endif\n\n";
+    
+    internal_ss << "/* Recompiled functions */\n";
+    for (const auto& [name, func] : program.functions) {
+        internal_ss << function_attribute(func) << "void " << func.name << "(GBContext* ctx, uint16_t entry);\n";
+    }
+    internal_ss << "\n";
+    
+    internal_ss << "/* Dispatch tables - [bank][addr] to function and resume index */\n";
+    internal_ss << "typedef struct {\n";
+    internal_ss << "    void (*func)(GBContext* ctx, uint16_t entry);\n";
+    internal_ss << "    uint16_t entry;\n";
+    internal_ss << "} DispatchSlot;\n\n";
+    internal_ss << "#define DISPATCH_BANKS " << dispatch_banks << "\n";
+    internal_ss << "extern DispatchSlot* dispatch_table[DISPATCH_BANKS];\n\n";
+    
+    internal_ss << "static inline const DispatchSlot* dispatch_lookup(GBContext* ctx, uint16_t addr) {\n";
+    internal_ss << "    uint16_t bank = addr < 0x4000 ? 0 : ctx->rom_bank;\n";
+    internal_ss << "    const DispatchSlot* table = bank < DISPATCH_BANKS ? dispatch_table[bank] : NULL;\n";
+    internal_ss << "    if (addr >= 0x8000 || !table || !table[addr & 0x3FFF].func) return NULL;\n";
+    internal_ss << "    return &table[addr & 0x3FFF];\n";
+    internal_ss << "}\n\n";
+    
+    // Computed jumps call their target directly instead of returning to the
+    // trampoline; ctx->pc already holds the target for the fallback path
+    internal_ss << "static inline void dispatch_native(GBContext* ctx, void (*func)(GBContext* ctx, uint16_t entry), uint16_t entry) {\n";
+    internal_ss << "    if (ctx->native_depth >= GB_MAX_NATIVE_DEPTH) return;\n";
+    internal_ss << "    ctx->native_depth++;\n";
+    internal_ss << "    func(ctx, entry);\n";
+    internal_ss << "    ctx->native_depth--;\n";
+    internal_ss << "}\n\n";
+    
+    internal_ss << "static inline void dispatch_jump(GBContext* ctx) {\n";
+    internal_ss << "    const DispatchSlot* slot = dispatch_lookup(ctx, ctx->pc);\n";
+    internal_ss << "    if (slot) dispatch_native(ctx, slot->func, slot->entry);\n";
+    internal_ss << "}\n\n";
+    internal_ss << "#endif\n";
+    output.internal_header_content = internal_ss.str();
+    output.internal_header_file = options.output_prefix + "_internal.h";
+    
+    // Generate source: dispatch tables, trampoline and entry points
+    std::ostringstream source_ss;
+    source_ss << "/* Generated by gbrecomp from " << program.rom_name << " */\n";
+    source_ss << "#include \"" << output.header_file << "\"\n";
+    source_ss << "#include \"" << output.internal_header_file << "\"\n";
+    source_ss << "#include <stdatomic.h>\n";
+    if (options.rom_embed == RomEmbed::External) {
+        source_ss << "#include <stdio.h>\n";
+        source_ss << "#include <stdlib.h>\n";
+    }
+    source_ss << "\n";
+    
+    source_ss << "typedef struct {\n";
+    source_ss << "    uint8_t bank;\n";
+    source_ss << "    uint16_t addr;\n";
+    source_ss << "    DispatchSlot slot;\n";
+    source_ss << "} DispatchInit;\n\n";
+    source_ss << "DispatchSlot* dispatch_table[DISPATCH_BANKS];\n\n";
+    
+    source_ss << "static const DispatchInit dispatch_init[] = {\n";
+    for (const auto& [addr, funcs] : addr_to_funcs) {
+        if (addr >= 0x8000) continue;
+        for (const auto& entry : funcs) {
+            uint8_t bank = entry.bank;
+            if (addr < 0x4000) bank = 0;
+            else if (bank == 0) bank = 1;
+            if (bank >= dispatch_banks) continue;
+            source_ss << "    { " << (int)bank << ", 0x" << std::hex << std::setfill('0') << std::setw(4) 
+                      << addr << std::dec << ", { " << entry.name << ", " 
+                      << entry_indices[entry.name][addr] << " } },\n";
         }
     }
-    source_ss << "            default: gb_interpret(ctx, addr); break;\n";
+    source_ss << "    { 0, 0, { NULL, 0 } }\n";
+    source_ss << "};\n\n";
+    
+    // Contexts may be initialized from several threads at once; the first
+    // builds the shared tables and the rest wait for it
+    source_ss << "static atomic_int dispatch_state;  /* 0 = unbuilt, 1 = building, 2 = ready */\n\n";
+    source_ss << "static void dispatch_tables_init(void) {\n";
+    source_ss << "    if (atomic_load_explicit(&dispatch_state, memory_order_acquire) == 2) return;\n";
+    source_ss << "    int expected = 0;\n";
+    source_ss << "    if (!atomic_compare_exchange_strong(&dispatch_state, &expected, 1)) {\n";
+    source_ss << "        while (atomic_load_explicit(&dispatch_state, memory_order_acquire) != 2) {\n";
+    source_ss << "        }\n";
+    source_ss << "        return;\n";
+    source_ss << "    }\n";
+    source_ss << "    for (const DispatchInit* init = dispatch_init; init->slot.func; init++) {\n";
+    source_ss << "        DispatchSlot* table = dispatch_table[init->bank];\n";
+    source_ss << "        if (!table) {\n";
+    source_ss << "            table = (DispatchSlot*)calloc(0x4000, sizeof(DispatchSlot));\n";
+    source_ss << "            if (!table) break;\n";
+    source_ss << "            dispatch_table[init->bank] = table;\n";
     source_ss << "        }\n";
+    source_ss << "        table[init->addr & 0x3FFF] = init->slot;\n";
     source_ss << "    }\n";
+    source_ss << "    atomic_store_explicit(&dispatch_state, 2, memory_order_release);\n";
     source_ss << "}\n\n";
     
-    source_ss << "void gb_dispatch_call(GBContext* ctx, uint16_t addr) {\n";
-    source_ss << "    gb_dispatch(ctx, addr);\n";
-    source_ss << "}\n\n";
+    // Registers and flags live before each instruction where -O1 may
+    // have left others stale; lockstep validation compares only these
+    source_ss << "const GBLiveMask " << options.output_prefix << "_live_masks[] = {\n";
+    for (const auto& [key, live] : program.live_masks) {
+        source_ss << "    { " << hex_literal(key, 8) << ", " << hex_literal(live, 3) << " },\n";
+    }
+    source_ss << "    { 0, 0 }\n";
+    source_ss << "};\n";
+    source_ss << "const size_t " << options.output_prefix << "_live_mask_count = "
+              << program.live_masks.size() << ";\n\n";
     
-    // Emit each function with real IR code
-    for (const auto& [name, func] : program.functions) {
-        source_ss << "/* Function at ";
-        if (func.bank > 0) {
-            source_ss << std::hex << std::setfill('0') << std::setw(2) << (int)func.bank << ":";
-        }
-        source_ss << std::hex << std::setfill('0') << std::setw(4) << func.entry_address << std::dec << " */\n";
-        source_ss << "static void " << func.name << "(GBContext* ctx) {\n";
-        
-        // Sort block_ids by their start address to ensure proper fallthrough order
-        std::vector<uint32_t> sorted_block_ids = func.block_ids;
-        std::sort(sorted_block_ids.begin(), sorted_block_ids.end(), 
-            [&program](uint32_t a, uint32_t b) {
-                auto it_a = program.blocks.find(a);
-                auto it_b = program.blocks.find(b);
-                if (it_a == program.blocks.end()) return false;
-                if (it_b == program.blocks.end()) return true;
-                return it_a->second.start_address < it_b->second.start_address;
-            });
-            
-        // Emit computed goto for entry into the correct block
-        source_ss << "    switch (ctx->pc) {\n";
-        for (uint32_t block_id : sorted_block_ids) {
-            auto it = program.blocks.find(block_id);
-            if (it != program.blocks.end()) {
-                source_ss << "        case 0x" << std::hex << std::setfill('0') << std::setw(4) 
-                          << it->second.start_address << std::dec << ": goto loc_" 
-                          << std::hex << std::setfill('0') << std::setw(4) 
-                          << it->second.start_address << std::dec << ";\n";
+    // Lane kernels (--soa), keyed like the dispatch tables; the first
+    // function with a block at an address that kernels can run provides it
+    if (options.soa_kernels) {
+        std::map<uint32_t, std::string> kernels;
+        for (const auto& [name, func] : program.functions) {
+            for (uint32_t block_id : func.block_ids) {
+                auto it = program.blocks.find(block_id);
+                if (it == program.blocks.end()) continue;
+                const ir::BasicBlock& block = it->second;
+                uint16_t addr = block.start_address;
+                if (addr >= 0x8000) continue;
+                uint32_t bank = addr < 0x4000 ? 0 : func.bank == 0 ? 1 : func.bank;
+                uint32_t key = bank << 16 | addr;
+                if (bank >= dispatch_banks || kernels.count(key)) continue;
+                std::string kernel = "soa_" + hex_literal(key, 6).substr(2);
+                if (emit_lane_kernel(source_ss, block, kernel)) kernels[key] = kernel;
             }
         }
-        source_ss << "        default: break;\n";
-        source_ss << "    }\n\n";
-        
-        // Emit each block in this function (now sorted by address)
-        for (size_t block_idx = 0; block_idx < sorted_block_ids.size(); block_idx++) {
-            uint32_t block_id = sorted_block_ids[block_idx];
-            auto block_it = program.blocks.find(block_id);
-            if (block_it == program.blocks.end()) continue;
-            const ir::BasicBlock& block = block_it->second;
-            
-            // Generate label from block address
-            source_ss << "loc_" << std::hex << std::setfill('0') << std::setw(4) 
-                      << block.start_address << std::dec << ":\n";
-            
-            // Emit each IR instruction, grouped by source address
-            uint32_t group_cycles = 0;
-            for (size_t i = 0; i < block.instructions.size(); ++i) {
-                const auto& ir_instr = block.instructions[i];
-                group_cycles += ir_instr.cycles;
-                
-                uint16_t next_pc = 0;
-                bool is_last_in_group = true;
-                
-                // Identify if this is the last IR instruction for this GameBoy instruction
-                if (i + 1 < block.instructions.size()) {
-                    if (block.instructions[i+1].source_address == ir_instr.source_address && ir_instr.source_address != 0) {
-                        is_last_in_group = false;
-                        next_pc = ir_instr.source_address;
-                    } else {
-                        next_pc = block.instructions[i+1].source_address;
-                    }
-                } else {
-                    next_pc = block.end_address;
-                }
-                
-                // If it's the last in group, we use the accumulated cycles
-                // Actually, let's just use ir_instr.cycles if we don't want to refactor cycles accumulation yet.
-                // Re-think: better to pass the accumulated cycles only at the end.
-                
-                uint32_t cycles_to_pass = is_last_in_group ? group_cycles : 0;
-                if (is_last_in_group) group_cycles = 0; // Reset for next group
-                
-                emit_ir_instruction(source_ss, ir_instr, program, 1, options, next_pc, cycles_to_pass, is_last_in_group, func.name);
-            }
-            
-            // Check if block falls through
-            bool falls_through = true;
-            uint16_t fallthrough_addr = block.end_address;
-            
-            // Find the last non-NOP instruction
-            for (auto it = block.instructions.rbegin(); it != block.instructions.rend(); ++it) {
-                if (it->opcode == ir::Opcode::NOP) continue;
-                
-                // Unconditional terminators do not fall through
-                if (it->opcode == ir::Opcode::JUMP || 
-                    it->opcode == ir::Opcode::RET) {
-                    falls_through = false;
-                }
-                break;
-            }
-            
-            bool next_is_fallthrough = false;
-            if (block_idx + 1 < sorted_block_ids.size()) {
-                uint32_t next_id = sorted_block_ids[block_idx + 1];
-                auto next_it = program.blocks.find(next_id);
-                if (next_it != program.blocks.end()) {
-                    if (next_it->second.start_address == fallthrough_addr) {
-                        next_is_fallthrough = true;
-                    }
-                }
-            }
-            
-            if (falls_through && !next_is_fallthrough) {
-                    // Debug specific function 27eb
-                    if (func.name == "func_27eb") {
-                        std::cerr << "DEBUG: found func_27eb falling through to 0x" << std::hex << fallthrough_addr << std::dec << "\n";
-                    }
-
-                    // Check if fallthrough target exists as a block in this function
-                    bool fallthrough_exists_in_function = false;
-                    for (uint32_t fn_block_id : sorted_block_ids) {
-                        auto fn_block_it = program.blocks.find(fn_block_id);
-                        if (fn_block_it != program.blocks.end() && 
-                            fn_block_it->second.start_address == fallthrough_addr) {
-                            fallthrough_exists_in_function = true;
-                            break;
-                        }
-                    }
-                    
-                    // Only emit goto if the target block exists in this function
-                    if (fallthrough_exists_in_function) {
-                        // Emit explicit goto to fallthrough block
-                        source_ss << "    goto loc_" << std::hex << std::setfill('0') 
-                                  << std::setw(4) << fallthrough_addr << std::dec 
-                                  << "; /* fallthrough */\n";
-                    } else {
-                        if (func.name == "func_27eb") {
-                             std::cerr << "DEBUG: func_27eb fallthrough not in function. Searching targets...\n";
-                        }
-                        // Fallthrough to another function?
-                        // Check if any function starts at fallthrough_addr in the same bank
-                        bool found_target_func = false;
-                        for (const auto& kv : program.functions) {
-                            const ir::Function& target_func = kv.second;
-                            if (target_func.bank == func.bank && target_func.entry_address == fallthrough_addr) {
-                                source_ss << "    /* fallthrough to function */\n";
-                                source_ss << "    " << target_func.name << "(ctx);\n";
-                                source_ss << "    return;\n";
-                                found_target_func = true;
-                                if (func.name == "func_27eb") std::cerr << "DEBUG: Found target: " << target_func.name << "\n";
-                                break;
-                            }
-                        }
-                        
-                        if (!found_target_func) {
-                            if (func.name == "func_27eb") std::cerr << "DEBUG: No target function found for 0x" << std::hex << fallthrough_addr << std::dec << "\n";
-                            source_ss << "    /* warning: fallthrough to unanalyzed code at 0x" 
-                                      << std::hex << fallthrough_addr << std::dec << " in bank " << (int)func.bank << " */\n";
-                            
-                            source_ss << "    return;\n";
-                        }
-                    }
-
-            }
+        source_ss << "const GBSoAKernelEntry " << options.output_prefix << "_soa_kernels[] = {\n";
+        for (const auto& [key, kernel] : kernels) {
+            source_ss << "    { " << hex_literal(key, 8) << ", " << kernel << " },\n";
         }
-        
-        // If function is empty or has no terminator, add a return
-        source_ss << "}\n\n";
+        source_ss << "    { 0, NULL }\n";
+        source_ss << "};\n";
+        source_ss << "const size_t " << options.output_prefix << "_soa_kernel_count = "
+                  << kernels.size() << ";\n\n";
     }
     
-    // Extern reference to ROM data
-    source_ss << "/* Extern reference to ROM data */\n";
-    source_ss << "extern const uint8_t rom_data[];\n\n";
+    // Routines copied from ROM to RAM were compiled from the ROM bytes and
+    // are only entered while RAM still holds them. The runtime tracks at
+    // most GB_MAX_OVERLAYS; code in any further ones is interpreted.
+    constexpr size_t max_overlays = 16;
+    std::vector<AnalyzerOptions::RamOverlay> overlays(options.ram_overlays.begin(),
+        options.ram_overlays.begin() + std::min(options.ram_overlays.size(), max_overlays));
+    if (!overlays.empty()) {
+        source_ss << "static const GBOverlay ram_overlays[] = {\n";
+        for (const auto& ov : overlays) {
+            uint32_t bank = ov.rom_addr >> 16;
+            uint32_t rom_offset = bank * 0x4000 + (ov.rom_addr & 0x3FFF);
+            source_ss << "    { " << hex_literal(ov.ram_addr, 4) << ", " << ov.size << ", "
+                      << hex_literal(rom_offset, 6) << " },\n";
+        }
+        source_ss << "};\n\n";
+    }
+    auto overlay_index = [&](uint16_t addr) -> int {
+        for (size_t i = 0; i < options.ram_overlays.size(); i++) {
+            const auto& ov = options.ram_overlays[i];
+            if (addr >= ov.ram_addr && addr < ov.ram_addr + ov.size) return static_cast<int>(i);
+        }
+        return -1;
+    };
     
-    // Emit init and run functions
-    source_ss << "void " << options.output_prefix << "_init(GBContext* ctx) {\n";
-    source_ss << "    /* Load ROM data into context */\n";
-    source_ss << "    gb_context_load_rom(ctx, rom_data, " << rom_size << ");\n";
+    // Fallback for code outside ROM
+    source_ss << "static void dispatch_ram(GBContext* ctx, uint16_t addr) {\n";
+    source_ss << "    switch (addr) {\n";
+    for (const auto& [addr, funcs] : addr_to_funcs) {
+        if (addr < 0x8000) continue;
+        int overlay = overlay_index(addr);
+        if (overlay >= static_cast<int>(max_overlays)) continue;
+        const auto& entry = funcs.front();
+        std::string call = entry.name + "(ctx, " + std::to_string(entry_indices[entry.name][addr]) + ");";
+        if (overlay >= 0 && overlays[overlay].oam_dma && addr == overlays[overlay].ram_addr) {
+            // The whole DMA routine, delay loop included, as one runtime call
+            const auto& ov = overlays[overlay];
+            size_t delay_offset = (ov.rom_addr >> 16) * 0x4000 + (ov.rom_addr & 0x3FFF) + 3;
+            uint8_t delay = delay_offset < rom_size ? rom_data[delay_offset] : 0;
+            call = "gbrt_oam_dma(ctx, " + hex_literal(addr, 4) + ", " + hex_literal(delay, 2) + ");";
+        }
+        source_ss << "        case " << hex_literal(addr, 4) << ":";
+        if (overlay >= 0) {
+            source_ss << "\n            if (gb_overlay_valid(ctx, " << overlay << ")) { " << call << " break; }\n";
+            source_ss << "            gb_interpret(ctx, addr); break;\n";
+        } else {
+            source_ss << " " << call << " break;\n";
+        }
+    }
+    source_ss << "        default: gb_interpret(ctx, addr); break;\n";
+    source_ss << "    }\n";
     source_ss << "}\n\n";
     
+    // Generate dispatch function for banked calls
+    source_ss << "/* Bank dispatch - routes calls to the correct bank function */\n";
+    source_ss << "void gb_dispatch(GBContext* ctx, uint16_t addr) {\n";
+    source_ss << "    GBRT_PROFILE_PUSH(ctx, GB_PROFILE_DISPATCH);\n";
+    source_ss << "    ctx->pc = addr;\n";
+    source_ss << "    while (!ctx->stopped && !ctx->halted) {\n";
+    source_ss << "        GBRT_PROFILE_SWITCH(ctx, GB_PROFILE_DISPATCH);\n";
+    source_ss << "        addr = ctx->pc;\n";
+        
+    /* Instruction limit and tracing, compiled out unless GBRT_INSTRUMENT >= 1 */
+    source_ss << "        GBRT_TRACE(ctx, addr);\n";
+
+    source_ss << "        if (addr >= 0x8000) {\n";
+    source_ss << "            GBRT_PROFILE_SWITCH(ctx, GB_PROFILE_CODE);\n";
+    source_ss << "            dispatch_ram(ctx, addr);\n";
+    source_ss << "            continue;\n";
+    source_ss << "        }\n";
+    source_ss << "        const DispatchSlot* slot = dispatch_lookup(ctx, addr);\n";
+    source_ss << "        if (slot) {\n";
+    source_ss << "            GBRT_PROFILE_SWITCH(ctx, GB_PROFILE_CODE);\n";
+    source_ss << "            slot->func(ctx, slot->entry);\n";
+    source_ss << "        } else {\n";
+    source_ss << "            gb_interpret(ctx, addr);\n";
+    source_ss << "        }\n";
+    source_ss << "    }\n";
+    source_ss << "    GBRT_PROFILE_POP(ctx);\n";
+    source_ss << "}\n\n";
+    
+    source_ss << "void gb_dispatch_call(GBContext* ctx, uint16_t addr) {\n";
+    source_ss << "    gb_dispatch(ctx, addr);\n";
+    source_ss << "}\n\n";
+    
+    // The ROM image is immutable, so contexts use it in place
+    std::string rom_image = options.output_prefix + ".gb";
+    if (options.rom_embed == RomEmbed::External) {
+        // The recompiled code is only valid for this exact ROM; the header
+        // checksum catches a wrong file cheaply
+        uint16_t checksum = rom_size >= 0x150 ? (rom_data[0x14E] << 8) | rom_data[0x14F] : 0;
+        source_ss << "#ifndef GBRECOMP_ROM_PATH\n";
+        source_ss << "#define GBRECOMP_ROM_PATH \"" << rom_image << "\"\n";
+        source_ss << "#endif\n\n";
+        source_ss << "void " << options.output_prefix << "_init(GBContext* ctx) {\n";
+        source_ss << "    /* Map the ROM file; GBRECOMP_ROM overrides the build-time path */\n";
+        source_ss << "    const char* path = getenv(\"GBRECOMP_ROM\");\n";
+        source_ss << "    if (!path) path = GBRECOMP_ROM_PATH;\n";
+        source_ss << "    if (!gb_context_map_rom(ctx, path) || ctx->rom_size != " << rom_size;
+        if (rom_size >= 0x150) {
+            source_ss << " ||\n        ((ctx->rom[0x14E] << 8) | ctx->rom[0x14F]) != " << hex_literal(checksum, 4);
+        }
+        source_ss << ") {\n";
+        source_ss << "        fprintf(stderr, \"Cannot map ROM %s (expected " << program.rom_name << ")\\n\", path);\n";
+        source_ss << "        exit(1);\n";
+        source_ss << "    }\n";
+        source_ss << "    dispatch_tables_init();\n";
+    if (!overlays.empty()) {
+        source_ss << "    gb_overlays_attach(ctx, ram_overlays, " << overlays.size() << ");\n";
+    }
+        source_ss << "}\n\n";
+    } else {
+        source_ss << "/* Extern reference to ROM data */\n";
+        source_ss << "extern const uint8_t rom_data[];\n\n";
+        source_ss << "void " << options.output_prefix << "_init(GBContext* ctx) {\n";
+        source_ss << "    /* Use the linked-in ROM data in place */\n";
+        source_ss << "    gb_context_attach_rom(ctx, rom_data, " << rom_size << ");\n";
+        source_ss << "    dispatch_tables_init();\n";
+    if (!overlays.empty()) {
+        source_ss << "    gb_overlays_attach(ctx, ram_overlays, " << overlays.size() << ");\n";
+    }
+        source_ss << "}\n\n";
+    }
+    
     source_ss << "void " << options.output_prefix << "_run(GBContext* ctx) {\n";
     source_ss << "    // Start the trampoline loop - execution will stay here until stopped\n";
     source_ss << "    gb_dispatch(ctx, ctx->pc);\n";
@@ -1620,30 +2979,172 @@ GeneratedOutput generate_output(const ir::Program& program,
     output.source_content = source_ss.str();
     output.source_file = options.output_prefix + ".c";
     
-    // Generate ROM data
+    // Function bodies go to code shards so the host compiler can build them
+    // in parallel. Shards close at the size budget and, if asked, at every
+    // change of ROM bank. Past a quarter of the budget they also close before
+    // any function whose name hashes to a cut point, so an edit only moves the
+    // boundaries of its own shard. Shards are named after their first
+    // function for the same reason. With a runtime profile the hot functions
+    // come first and the cold ones last, each in shards of their own, so the
+    // code that runs is packed together.
+    std::vector<const ir::Function*> funcs;
+    funcs.reserve(program.functions.size());
+    for (const auto& [name, func] : program.functions) funcs.push_back(&func);
+    if (options.shard_by_bank) {
+        std::stable_sort(funcs.begin(), funcs.end(),
+                         [](const ir::Function* a, const ir::Function* b) { return a->bank < b->bank; });
+    }
+    auto heat = [](const ir::Function* func) { return func->hot ? 0 : func->cold ? 2 : 1; };
+    std::stable_sort(funcs.begin(), funcs.end(),
+                     [&](const ir::Function* a, const ir::Function* b) { return heat(a) < heat(b); });
+    std::vector<const EntryIndices*> func_indices;
+    func_indices.reserve(funcs.size());
+    for (const ir::Function* func : funcs) func_indices.push_back(&entry_indices[func->name]);
+    
+    std::vector<std::string> texts = emit_functions(program, funcs, func_indices, options);
+    
+    output.function_hashes.reserve(funcs.size());
+    for (size_t i = 0; i < funcs.size(); i++) {
+        output.function_hashes.push_back({funcs[i]->name, ir::hash_function(program, *funcs[i]),
+                                          hash_string(texts[i])});
+    }
+    
+    std::string shard;
+    std::string shard_first;
+    int shard_heat = 1;
+    auto flush_shard = [&] {
+        static const char* const heat_names[] = {"_code_hot_", "_code_", "_code_cold_"};
+        std::string name = options.output_prefix + heat_names[shard_heat] + shard_first + ".c";
+        std::string content = "/* Generated by gbrecomp from " + program.rom_name + " */\n";
+        content += "#include \"" + output.internal_header_file + "\"\n\n";
+        output.code_files.push_back({name, content + shard});
+        shard.clear();
+    };
+    for (size_t i = 0; i < funcs.size(); i++) {
+        bool over_budget = options.shard_bytes && shard.size() + texts[i].size() > options.shard_bytes;
+        bool cut_point = options.shard_bytes && shard.size() >= options.shard_bytes / 4 &&
+                         hash_string(funcs[i]->name) % 8 == 0;
+        bool new_bank = options.shard_by_bank && i > 0 && funcs[i]->bank != funcs[i - 1]->bank;
+        bool new_heat = i > 0 && heat(funcs[i]) != heat(funcs[i - 1]);
+        if (!shard.empty() && (over_budget || cut_point || new_bank || new_heat)) flush_shard();
+        if (shard.empty()) {
+            shard_first = funcs[i]->name;
+            shard_heat = heat(funcs[i]);
+        }
+        shard += texts[i];
+    }
+    if (!shard.empty()) flush_shard();
+    
+    // The profiling side-cars are taken from the finished shards, so their
+    // line numbers are those of the files written
+    if (options.emit_symbol_map || options.emit_line_directives) {
+        std::map<uint32_t, size_t> listing_lines;
+        if (options.emit_line_directives) {
+            output.listing_file = options.output_prefix + ".lst";
+            output.listing_content = build_listing(program, rom_data, rom_size, listing_lines);
+        }
+        std::vector<std::string> json_functions;
+        for (auto& file : output.code_files) {
+            file.content = annotate_code_file(file, options.emit_line_directives ? &listing_lines : nullptr,
+                                              output.listing_file, json_functions);
+        }
+        if (options.emit_symbol_map) {
+            std::string map = "{\n  \"rom\": " + json_string(program.rom_name) + ",\n  \"listing\": ";
+            map += output.listing_file.empty() ? "null" : json_string(output.listing_file);
+            map += ",\n  \"functions\": [\n";
+            for (size_t i = 0; i < json_functions.size(); i++) {
+                map += json_functions[i] + (i + 1 < json_functions.size() ? ",\n" : "\n");
+            }
+            map += "  ]\n}\n";
+            output.symbol_map_file = options.output_prefix + ".symbols.json";
+            output.symbol_map_content = map;
+        }
+    }
+    
+    // Generate ROM data. A hex initializer is portable but parses slowly for
+    // multi-megabyte ROMs; the other modes ship the binary next to the code.
+    if (options.rom_embed != RomEmbed::Array) {
+        output.rom_image_content.assign(reinterpret_cast<const char*>(rom_data), rom_size);
+        output.rom_image_file = rom_image;
+    }
     std::ostringstream rom_ss;
-    rom_ss << "/* ROM data */\n";
-    rom_ss << "#include <stdint.h>\n";
-    rom_ss << "#include <stddef.h>\n\n";
-    rom_ss << "const uint8_t rom_data[" << rom_size << "] = {\n";
-    for (size_t i = 0; i < rom_size; i++) {
-        if (i % 16 == 0) rom_ss << "    ";
-        rom_ss << "0x" << std::hex << std::setfill('0') << std::setw(2) 
-               << (int)rom_data[i];
-        if (i < rom_size - 1) rom_ss << ",";
-        if (i % 16 == 15 || i == rom_size - 1) rom_ss << "\n";
-        else rom_ss << " ";
-    }
-    rom_ss << std::dec << "};\n";
-    rom_ss << "const size_t rom_size = " << rom_size << ";\n";
-    output.rom_data_content = rom_ss.str();
-    output.rom_data_file = options.output_prefix + "_rom.c";
+    switch (options.rom_embed) {
+    case RomEmbed::Array:
+        rom_ss << "/* ROM data */\n";
+        rom_ss << "#include <stdint.h>\n";
+        rom_ss << "#include <stddef.h>\n\n";
+        rom_ss << "const uint8_t rom_data[" << rom_size << "] = {\n";
+        for (size_t i = 0; i < rom_size; i++) {
+            if (i % 16 == 0) rom_ss << "    ";
+            rom_ss << "0x" << std::hex << std::setfill('0') << std::setw(2) 
+                   << (int)rom_data[i];
+            if (i < rom_size - 1) rom_ss << ",";
+            if (i % 16 == 15 || i == rom_size - 1) rom_ss << "\n";
+            else rom_ss << " ";
+        }
+        rom_ss << std::dec << "};\n";
+        break;
+    case RomEmbed::Incbin:
+        // The assembler resolves .incbin against its working directory, so
+        // the build passes an absolute GBRECOMP_ROM_PATH
+        rom_ss << "/* ROM data, assembled in from " << rom_image << " */\n";
+        rom_ss << "#include <stdint.h>\n";
+        rom_ss << "#include <stddef.h>\n\n";
+        rom_ss << "#ifndef GBRECOMP_ROM_PATH\n";
+        rom_ss << "#define GBRECOMP_ROM_PATH \"" << rom_image << "\"\n";
+        rom_ss << "#endif\n\n";
+        rom_ss << "#if !defined(__GNUC__)\n";
+        rom_ss << "#error \"incbin ROM embedding needs GCC or Clang; regenerate with --rom-embed array\"\n";
+        rom_ss << "#elif defined(__APPLE__)\n";
+        rom_ss << "#define ROM_SECTION \".const_data\"\n";
+        rom_ss << "#define ROM_SYMBOL \"_rom_data\"\n";
+        rom_ss << "#elif defined(_WIN32)\n";
+        rom_ss << "#define ROM_SECTION \".section .rdata,\\\"dr\\\"\"\n";
+        rom_ss << "#define ROM_SYMBOL \"rom_data\"\n";
+        rom_ss << "#else\n";
+        rom_ss << "#define ROM_SECTION \".section .rodata\"\n";
+        rom_ss << "#define ROM_SYMBOL \"rom_data\"\n";
+        rom_ss << "#endif\n\n";
+        rom_ss << "__asm__(ROM_SECTION \"\\n\"\n";
+        rom_ss << "        \".globl \" ROM_SYMBOL \"\\n\"\n";
+        rom_ss << "        \".balign 64\\n\"\n";
+        rom_ss << "        ROM_SYMBOL \":\\n\"\n";
+        rom_ss << "        \".incbin \\\"\" GBRECOMP_ROM_PATH \"\\\"\\n\"\n";
+        rom_ss << "        \".text\\n\");\n\n";
+        rom_ss << "extern const uint8_t rom_data[" << rom_size << "];\n";
+        break;
+    case RomEmbed::Embed:
+        // #embed searches relative to this file, like #include
+        rom_ss << "/* ROM data, embedded from " << rom_image << " */\n";
+        rom_ss << "#include <stdint.h>\n";
+        rom_ss << "#include <stddef.h>\n\n";
+        rom_ss << "#ifndef __has_embed\n";
+        rom_ss << "#error \"#embed needs a C23 preprocessor; regenerate with --rom-embed incbin or array\"\n";
+        rom_ss << "#endif\n\n";
+        rom_ss << "const uint8_t rom_data[" << rom_size << "] = {\n";
+        rom_ss << "#embed \"" << rom_image << "\"\n";
+        rom_ss << "};\n";
+        break;
+    case RomEmbed::External:
+        break;
+    }
+    if (options.rom_embed != RomEmbed::External) {
+        rom_ss << "const size_t rom_size = " << rom_size << ";\n";
+        output.rom_data_content = rom_ss.str();
+        output.rom_data_file = options.output_prefix + "_rom.c";
+    }
     
     // Generate main
     std::ostringstream main_ss;
     main_ss << "/* Main entry point */\n";
     main_ss << "#include \"" << options.output_prefix << ".h\"\n";
     main_ss << "#include \"gbrt.h\"\n";
+    main_ss << "#include \"rewind.h\"\n";
+    main_ss << "#include \"movie.h\"\n";
+    main_ss << "#include \"hotspot.h\"\n";
+    main_ss << "#include \"jit.h\"\n";
+    main_ss << "#include \"mbc.h\"\n";
+    main_ss << "#include \"lockstep.h\"\n";
     main_ss << "#ifdef GB_HAS_SDL2\n";
     main_ss << "#include \"platform_sdl.h\"\n";
     main_ss << "#endif\n";
@@ -1651,42 +3152,187 @@ GeneratedOutput generate_output(const ir::Program& program,
     main_ss << "#include <stdio.h>\n";
     main_ss << "#include <stdlib.h>\n";
     main_ss << "#include <string.h>\n\n";
+    main_ss << "// Print the hotspot counters and write the entry point hints and profile\n";
+    main_ss << "static void finish_hotspots(GBContext* ctx, GBHotspots* hotspots, const char* hints_path,\n";
+    main_ss << "                            const char* profile_path) {\n";
+    main_ss << "    if (!hotspots) return;\n";
+    main_ss << "    gb_hotspots_attach(ctx, NULL);\n";
+    main_ss << "    gb_hotspots_report(hotspots, stderr, 20);\n";
+    main_ss << "    if (hints_path && !gb_hotspots_write_entry_points(hotspots, hints_path)) {\n";
+    main_ss << "        fprintf(stderr, \"Failed to write %s\\n\", hints_path);\n";
+    main_ss << "    }\n";
+    main_ss << "    if (profile_path && !gb_hotspots_write_profile(hotspots, profile_path)) {\n";
+    main_ss << "        fprintf(stderr, \"Failed to write %s\\n\", profile_path);\n";
+    main_ss << "    }\n";
+    main_ss << "    gb_hotspots_destroy(hotspots);\n";
+    main_ss << "}\n\n";
     main_ss << "int main(int argc, char* argv[]) {\n";
+    main_ss << "    bool turbo = false;\n";
+    main_ss << "    int frame_skip = 0;\n";
+    main_ss << "    bool mute = false;\n";
+    main_ss << "    bool present_thread = false;\n";
+    main_ss << "    bool rewind = false;\n";
+    main_ss << "    const char* record_path = NULL;\n";
+    main_ss << "    const char* replay_path = NULL;\n";
+    main_ss << "    uint32_t movie_flags = 0;\n";
+    main_ss << "    const char* hotspots_path = NULL;\n";
+    main_ss << "    const char* profile_path = NULL;\n";
+    main_ss << "    long jit_threshold = -1;\n";
+    main_ss << "    bool perf_map = false;\n";
+    main_ss << "    const char* save_path = \"" << options.output_prefix << ".sav\";\n";
+    main_ss << "    bool trace = false;\n";
+    main_ss << "    bool lockstep = false;\n";
+    main_ss << "    uint64_t instruction_limit = 0;\n\n";
     main_ss << "    // Parse args\n";
     main_ss << "    for (int i = 1; i < argc; i++) {\n";
     main_ss << "        if (strcmp(argv[i], \"--trace\") == 0) {\n";
-    main_ss << "            gbrt_trace_enabled = true;\n";
+    main_ss << "            trace = true;\n";
+    main_ss << "#if GBRT_INSTRUMENT >= 1\n";
     main_ss << "            printf(\"Trace enabled\\n\");\n";
+    main_ss << "#else\n";
+    main_ss << "            printf(\"Trace requires a build with GBRT_INSTRUMENT >= 1\\n\");\n";
+    main_ss << "#endif\n";
     main_ss << "        } else if (strcmp(argv[i], \"--limit\") == 0 && i + 1 < argc) {\n";
-    main_ss << "            gbrt_instruction_limit = strtoull(argv[++i], NULL, 10);\n";
-    main_ss << "            printf(\"Instruction limit: %llu\\n\", (unsigned long long)gbrt_instruction_limit);\n";
+    main_ss << "            instruction_limit = strtoull(argv[++i], NULL, 10);\n";
+    main_ss << "            printf(\"Instruction limit: %llu\\n\", (unsigned long long)instruction_limit);\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--turbo\") == 0) {\n";
+    main_ss << "            turbo = true;\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--frameskip\") == 0 && i + 1 < argc) {\n";
+    main_ss << "            frame_skip = atoi(argv[++i]);\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--mute\") == 0) {\n";
+    main_ss << "            mute = true;\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--present-thread\") == 0) {\n";
+    main_ss << "            present_thread = true;\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--rewind\") == 0) {\n";
+    main_ss << "            rewind = true;\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--record\") == 0 && i + 1 < argc) {\n";
+    main_ss << "            record_path = argv[++i];\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--record-polls\") == 0) {\n";
+    main_ss << "            movie_flags |= GB_MOVIE_PER_POLL;\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--replay\") == 0 && i + 1 < argc) {\n";
+    main_ss << "            replay_path = argv[++i];\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--hotspots\") == 0 && i + 1 < argc) {\n";
+    main_ss << "            hotspots_path = argv[++i];\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--profile\") == 0 && i + 1 < argc) {\n";
+    main_ss << "            profile_path = argv[++i];\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--jit\") == 0 && i + 1 < argc) {\n";
+    main_ss << "            jit_threshold = atol(argv[++i]);\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--perf-map\") == 0) {\n";
+    main_ss << "            perf_map = true;\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--save\") == 0 && i + 1 < argc) {\n";
+    main_ss << "            save_path = argv[++i];\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--no-save\") == 0) {\n";
+    main_ss << "            save_path = NULL;\n";
+    main_ss << "        } else if (strcmp(argv[i], \"--lockstep\") == 0) {\n";
+    main_ss << "            lockstep = true;\n";
     main_ss << "        }\n";
-    main_ss << "    }\n\n";
+    main_ss << "    }\n";
+    main_ss << "#if !GBRT_HOTSPOTS\n";
+    main_ss << "    if (hotspots_path || profile_path) printf(\"Hotspot counters require a build with GBRT_HOTSPOTS=1\\n\");\n";
+    main_ss << "#endif\n";
+    main_ss << "#if !GBRT_JIT\n";
+    main_ss << "    if (jit_threshold >= 0) printf(\"Translation requires a build with GBRT_JIT=1\\n\");\n";
+    main_ss << "#endif\n\n";
     main_ss << "    GBContext* ctx = gb_context_create(NULL);\n";
     main_ss << "    if (!ctx) {\n";
     main_ss << "        fprintf(stderr, \"Failed to create context\\n\");\n";
     main_ss << "        return 1;\n";
     main_ss << "    }\n";
+    main_ss << "    gbrt_set_trace(ctx, trace);\n";
+    main_ss << "    ctx->instruction_limit = instruction_limit;\n";
     main_ss << "    " << options.output_prefix << "_init(ctx);\n";
+    main_ss << "    gb_set_turbo(ctx, turbo, (uint8_t)(frame_skip > 255 ? 255 : frame_skip < 0 ? 0 : frame_skip), mute);\n";
+    main_ss << "    // Hold R to step back through the last minutes of play\n";
+    main_ss << "    GBRewind* rewind_buffer = rewind ? gb_rewind_create(ctx, 0, 0) : NULL;\n";
+    main_ss << "    gb_rewind_attach(ctx, rewind_buffer);\n";
+    main_ss << "    GBHotspots* hotspots = hotspots_path || profile_path ? gb_hotspots_create() : NULL;\n";
+    main_ss << "    gb_hotspots_attach(ctx, hotspots);\n";
+    main_ss << "    // Translate interpreted code once entered N times (0 = default) to host code\n";
+    main_ss << "    GBJit* jit = jit_threshold >= 0 ? gb_jit_create((uint32_t)jit_threshold) : NULL;\n";
+    main_ss << "    if (jit_threshold >= 0 && !jit) printf(\"Translation is not supported on this host\\n\");\n";
+    main_ss << "    // Name translated blocks for perf; recompiled functions already have symbols\n";
+    main_ss << "    if (perf_map && jit && !gb_jit_perf_map(jit)) printf(\"Cannot write the perf map\\n\");\n";
+    main_ss << "    gb_jit_attach(ctx, jit);\n";
+    main_ss << "    // Check every step against an interpreted shadow, stopping at the first difference\n";
+    main_ss << "    GBLockstep* validator = lockstep ? gb_lockstep_create(ctx, 0) : NULL;\n";
+    main_ss << "    if (lockstep && !validator) printf(\"Cannot create the lockstep shadow\\n\");\n";
+    main_ss << "    if (validator) gb_lockstep_set_live_masks(validator, " << options.output_prefix << "_live_masks, "
+            << options.output_prefix << "_live_mask_count);\n";
+    main_ss << "\n";
+    main_ss << "    // Replay a movie headless to its end and verify its checksums\n";
+    main_ss << "    if (replay_path) {\n";
+    main_ss << "        GBMovie* movie = gb_movie_load(replay_path);\n";
+    main_ss << "        if (!movie || !gb_movie_attach(ctx, movie)) {\n";
+    main_ss << "            fprintf(stderr, \"Cannot replay %s\\n\", replay_path);\n";
+    main_ss << "            gb_movie_destroy(movie);\n";
+    main_ss << "            gb_lockstep_destroy(validator);\n";
+    main_ss << "            gb_hotspots_destroy(hotspots);\n";
+    main_ss << "            gb_jit_destroy(jit);\n";
+    main_ss << "            gb_rewind_destroy(rewind_buffer);\n";
+    main_ss << "            gb_context_destroy(ctx);\n";
+    main_ss << "            return 1;\n";
+    main_ss << "        }\n";
+    main_ss << "        gb_lockstep_attach(ctx, validator);\n";
+    main_ss << "        while (!gb_movie_finished(movie) && !(validator && gb_lockstep_diverged(validator))) {\n";
+    main_ss << "            gb_run_frame(ctx);\n";
+    main_ss << "            gb_reset_frame(ctx);\n";
+    main_ss << "            ctx->stopped = 0;\n";
+    main_ss << "        }\n";
+    main_ss << "        uint32_t first = 0;\n";
+    main_ss << "        uint32_t mismatches = gb_movie_mismatches(movie, &first);\n";
+    main_ss << "        if (mismatches) printf(\"Replay diverged: %u checksum(s) differ, first at frame %u\\n\", mismatches, first);\n";
+    main_ss << "        else printf(\"Replay matched: %u frames\\n\", gb_movie_length(movie));\n";
+    main_ss << "        bool diverged = validator && gb_lockstep_diverged(validator);\n";
+    main_ss << "        if (validator) printf(\"Lockstep %s after %llu steps\\n\", diverged ? \"diverged\" : \"matched\",\n";
+    main_ss << "                              (unsigned long long)gb_lockstep_steps(validator));\n";
+    main_ss << "        gb_lockstep_attach(ctx, NULL);\n";
+    main_ss << "        gb_lockstep_destroy(validator);\n";
+    main_ss << "        gb_movie_attach(ctx, NULL);\n";
+    main_ss << "        gb_movie_destroy(movie);\n";
+    main_ss << "        finish_hotspots(ctx, hotspots, hotspots_path, profile_path);\n";
+    main_ss << "        gb_jit_attach(ctx, NULL);\n";
+    main_ss << "        gb_jit_destroy(jit);\n";
+    main_ss << "        gb_rewind_attach(ctx, NULL);\n";
+    main_ss << "        gb_rewind_destroy(rewind_buffer);\n";
+    main_ss << "        gb_context_destroy(ctx);\n";
+    main_ss << "        return mismatches || diverged ? 1 : 0;\n";
+    main_ss << "    }\n";
+    main_ss << "    // Keep battery RAM in its save file; the mapping is written back as it changes\n";
+    main_ss << "    if (save_path && ctx->mbc_battery && !gb_mbc_map_save(ctx, save_path)) {\n";
+    main_ss << "        fprintf(stderr, \"Cannot use save file %s\\n\", save_path);\n";
+    main_ss << "    }\n";
+    main_ss << "    gb_lockstep_attach(ctx, validator);\n";
+    main_ss << "    GBMovie* movie = record_path ? gb_movie_create(ctx, movie_flags, 0) : NULL;\n";
+    main_ss << "    gb_movie_attach(ctx, movie);\n";
     main_ss << "\n";
     main_ss << "#ifdef GB_HAS_SDL2\n";
     main_ss << "    // Initialize SDL2 platform with 3x scaling\n";
     main_ss << "    if (!gb_platform_init(3)) {\n";
     main_ss << "        fprintf(stderr, \"Failed to initialize platform\\n\");\n";
+    main_ss << "        gb_movie_destroy(movie);\n";
+    main_ss << "        gb_lockstep_destroy(validator);\n";
+    main_ss << "        gb_hotspots_destroy(hotspots);\n";
+    main_ss << "        gb_jit_destroy(jit);\n";
+    main_ss << "        gb_rewind_destroy(rewind_buffer);\n";
     main_ss << "        gb_context_destroy(ctx);\n";
     main_ss << "        return 1;\n";
     main_ss << "    }\n";
     main_ss << "\n";
-    main_ss << "    // Run the game loop\n";
-    main_ss << "    while (1) {\n";
-    main_ss << "        gb_run_frame(ctx);\n";
-    main_ss << "        if (!gb_platform_poll_events(ctx)) break;\n";
-    main_ss << "        if (ctx->frame_done) {\n";
-    main_ss << "            const uint32_t* fb = gb_get_framebuffer(ctx);\n";
-    main_ss << "            if (fb) gb_platform_render_frame(fb);\n";
-    main_ss << "            gb_reset_frame(ctx);\n";
-    main_ss << "            ctx->stopped = 0;\n";
-    main_ss << "            gb_platform_vsync();\n";
+    main_ss << "    // --present-thread emulates on a worker while this thread presents\n";
+    main_ss << "    if (!present_thread || !gb_platform_run_threaded(ctx)) {\n";
+    main_ss << "        gb_platform_bind_framebuffer(ctx);\n";
+    main_ss << "\n";
+    main_ss << "        // Run the game loop\n";
+    main_ss << "        while (1) {\n";
+    main_ss << "            gb_run_frame(ctx);\n";
+    main_ss << "            gb_platform_pump_audio(ctx);\n";
+    main_ss << "            if (!gb_platform_poll_events(ctx)) break;\n";
+    main_ss << "            if (ctx->frame_done) {\n";
+    main_ss << "                if (gb_frame_drawn(ctx)) gb_platform_render_frame(gb_get_framebuffer(ctx));\n";
+    main_ss << "                gb_reset_frame(ctx);\n";
+    main_ss << "                ctx->stopped = 0;\n";
+    main_ss << "                if (!ctx->turbo) gb_platform_vsync();\n";
+    main_ss << "            }\n";
     main_ss << "        }\n";
     main_ss << "    }\n";
     main_ss << "    gb_platform_shutdown();\n";
@@ -1697,8 +3343,21 @@ GeneratedOutput generate_output(const ir::Program& program,
     main_ss << "    printf(\"Registers: A=%02X B=%02X C=%02X\\n\", ctx->a, ctx->b, ctx->c);\n";
     main_ss << "#endif\n";
     main_ss << "\n";
+    main_ss << "    if (movie && !gb_movie_save(movie, record_path)) {\n";
+    main_ss << "        fprintf(stderr, \"Failed to write %s\\n\", record_path);\n";
+    main_ss << "    }\n";
+    main_ss << "    gb_movie_attach(ctx, NULL);\n";
+    main_ss << "    gb_movie_destroy(movie);\n";
+    main_ss << "    bool diverged = validator && gb_lockstep_diverged(validator);\n";
+    main_ss << "    gb_lockstep_attach(ctx, NULL);\n";
+    main_ss << "    gb_lockstep_destroy(validator);\n";
+    main_ss << "    finish_hotspots(ctx, hotspots, hotspots_path, profile_path);\n";
+    main_ss << "    gb_jit_attach(ctx, NULL);\n";
+    main_ss << "    gb_jit_destroy(jit);\n";
+    main_ss << "    gb_rewind_attach(ctx, NULL);\n";
+    main_ss << "    gb_rewind_destroy(rewind_buffer);\n";
     main_ss << "    gb_context_destroy(ctx);\n";
-    main_ss << "    return 0;\n";
+    main_ss << "    return diverged ? 1 : 0;\n";
     main_ss << "}\n";
     output.main_content = main_ss.str();
     output.main_file = options.output_prefix + "_main.c";
@@ -1717,28 +3376,115 @@ GeneratedOutput generate_output(const ir::Program& program,
     cmake_ss << "# Create runtime library with PPU and platform support\n";
     cmake_ss << "add_library(gbrt STATIC\n";
     cmake_ss << "    ${GBRT_DIR}/src/gbrt.c\n";
+    cmake_ss << "    ${GBRT_DIR}/src/mbc.c\n";
     cmake_ss << "    ${GBRT_DIR}/src/ppu.c\n";
     cmake_ss << "    ${GBRT_DIR}/src/audio.c\n";
     cmake_ss << "    ${GBRT_DIR}/src/interpreter.c\n";
+    cmake_ss << "    ${GBRT_DIR}/src/batch.c\n";
+    cmake_ss << "    ${GBRT_DIR}/src/state.c\n";
+    cmake_ss << "    ${GBRT_DIR}/src/rewind.c\n";
+    cmake_ss << "    ${GBRT_DIR}/src/movie.c\n";
+    cmake_ss << "    ${GBRT_DIR}/src/lockstep.c\n";
+    cmake_ss << "    ${GBRT_DIR}/src/hotspot.c\n";
+    cmake_ss << "    ${GBRT_DIR}/src/jit.c\n";
     cmake_ss << "    ${GBRT_DIR}/src/platform_sdl.c\n";
     cmake_ss << ")\n";
+    cmake_ss << "find_package(Threads REQUIRED)\n";
     cmake_ss << "target_include_directories(gbrt PUBLIC ${GBRT_DIR}/include)\n";
-    cmake_ss << "target_link_libraries(gbrt PUBLIC SDL2::SDL2)\n";
+    cmake_ss << "target_link_libraries(gbrt PUBLIC SDL2::SDL2 Threads::Threads)\n";
     cmake_ss << "target_compile_definitions(gbrt PUBLIC GB_HAS_SDL2)\n\n";
+    cmake_ss << "# Instrumentation level: 0 = none, 1 = counting/tracing, 2 = debug logging\n";
+    cmake_ss << "set(GBRT_INSTRUMENT 0 CACHE STRING \"Runtime instrumentation level (0, 1 or 2)\")\n";
+    cmake_ss << "target_compile_definitions(gbrt PUBLIC GBRT_INSTRUMENT=${GBRT_INSTRUMENT})\n\n";
+    cmake_ss << "# Time profiling split for the benchmark (0 = off, 1 = on)\n";
+    cmake_ss << "set(GBRT_PROFILE 0 CACHE STRING \"Runtime time profiling (0 or 1)\")\n";
+    cmake_ss << "target_compile_definitions(gbrt PUBLIC GBRT_PROFILE=${GBRT_PROFILE})\n\n";
+    cmake_ss << "# Dispatch and interpreter fallback counters (0 = off, 1 = on)\n";
+    cmake_ss << "set(GBRT_HOTSPOTS 0 CACHE STRING \"Runtime dispatch counters (0 or 1)\")\n";
+    cmake_ss << "target_compile_definitions(gbrt PUBLIC GBRT_HOTSPOTS=${GBRT_HOTSPOTS})\n\n";
+    cmake_ss << "# Translation of hot interpreted code to host code (0 = off, 1 = on, x86-64 only)\n";
+    cmake_ss << "set(GBRT_JIT 0 CACHE STRING \"Runtime translation of hot interpreted code (0 or 1)\")\n";
+    cmake_ss << "target_compile_definitions(gbrt PUBLIC GBRT_JIT=${GBRT_JIT})\n\n";
+    cmake_ss << "# Recompiled code, shared by the game and the benchmark\n";
+    const std::string code_lib = options.output_prefix + "_code";
+    cmake_ss << "add_library(" << code_lib << " OBJECT\n";
+    cmake_ss << "    " << output.source_file << "\n";
+    for (const auto& file : output.code_files) {
+        cmake_ss << "    " << file.name << "\n";
+    }
+    if (!output.rom_data_file.empty()) {
+        cmake_ss << "    " << output.rom_data_file << "\n";
+    }
+    cmake_ss << ")\n";
+    cmake_ss << "target_link_libraries(" << code_lib << " PUBLIC gbrt)\n\n";
     cmake_ss << "# Main executable\n";
-    cmake_ss << "add_executable(" << options.output_prefix << "\n";
-    cmake_ss << "    " << options.output_prefix << "_main.c\n";
-    cmake_ss << "    " << options.output_prefix << ".c\n";
-    cmake_ss << "    " << options.output_prefix << "_rom.c\n";
-    cmake_ss << ")\n\n";
-    cmake_ss << "target_link_libraries(" << options.output_prefix << " gbrt)\n";
+    cmake_ss << "add_executable(" << options.output_prefix << " " << options.output_prefix << "_main.c)\n";
+    cmake_ss << "target_link_libraries(" << options.output_prefix << " " << code_lib << " gbrt)\n\n";
+    cmake_ss << "# Headless benchmark: gbrt_bench [--frames N] [--movie FILE] [--json FILE]\n";
+    cmake_ss << "option(GBRT_BENCH \"Build the gbrt_bench headless benchmark\" OFF)\n";
+    cmake_ss << "if(GBRT_BENCH)\n";
+    cmake_ss << "    add_executable(gbrt_bench ${GBRT_DIR}/bench/gbrt_bench.c)\n";
+    cmake_ss << "    target_link_libraries(gbrt_bench " << code_lib << " gbrt)\n";
+    cmake_ss << "    target_compile_definitions(gbrt_bench PRIVATE GBRT_BENCH_INIT=" << options.output_prefix
+             << "_init \"GBRT_BENCH_NAME=\\\"" << options.output_prefix << "\\\"\")\n";
+    if (options.soa_kernels) {
+        cmake_ss << "    target_compile_definitions(gbrt_bench PRIVATE GBRT_BENCH_SOA=" << options.output_prefix
+                 << "_soa_kernels GBRT_BENCH_SOA_COUNT=" << options.output_prefix << "_soa_kernel_count)\n";
+    }
+    cmake_ss << "endif()\n";
+    if (!output.rom_image_file.empty()) {
+        std::string image = "${CMAKE_CURRENT_SOURCE_DIR}/" + output.rom_image_file;
+        cmake_ss << "\n# ROM image: assembled in, or mapped at startup unless GBRECOMP_ROM is set\n";
+        cmake_ss << "target_compile_definitions(" << code_lib
+                 << " PRIVATE \"GBRECOMP_ROM_PATH=\\\"" << image << "\\\"\")\n";
+        if (!output.rom_data_file.empty()) {
+            cmake_ss << "set_source_files_properties(" << output.rom_data_file
+                     << " PROPERTIES OBJECT_DEPENDS \"" << image << "\")\n";
+        }
+    }
     output.cmake_content = cmake_ss.str();
     output.cmake_file = "CMakeLists.txt";
     
     return output;
 }
 
-bool write_output(const GeneratedOutput& output, const std::string& output_dir) {
+/* ============================================================================
+ * Output Manifest
+ * ========================================================================== */
+
+static const char* const MANIFEST_FILE = "gbrecomp.manifest";
+static const char* const MANIFEST_HEADER = "gbrecomp-manifest 1";
+
+/**
+ * @brief Hashes recorded by the previous write_output in a directory
+ */
+struct Manifest {
+    std::map<std::string, uint64_t> files;
+    std::map<std::string, std::pair<uint64_t, uint64_t>> functions;  // ir, text
+};
+
+// A missing or unrecognized manifest reads as empty, forcing a full write
+static Manifest read_manifest(const std::filesystem::path& path) {
+    Manifest manifest;
+    std::ifstream in(path);
+    std::string line;
+    if (!std::getline(in, line) || line != MANIFEST_HEADER) return manifest;
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        std::string kind, name;
+        uint64_t hash = 0, text_hash = 0;
+        ss >> kind >> std::hex >> hash;
+        if (kind == "file" && ss >> name) {
+            manifest.files[name] = hash;
+        } else if (kind == "func" && ss >> text_hash >> name) {
+            manifest.functions[name] = {hash, text_hash};
+        }
+    }
+    return manifest;
+}
+
+bool write_output(const GeneratedOutput& output, const std::string& output_dir,
+                  WriteStats* stats, bool incremental) {
     namespace fs = std::filesystem;
     
     try {
@@ -1748,37 +3494,81 @@ bool write_output(const GeneratedOutput& output, const std::string& output_dir)
             fs::create_directories(out_path);
         }
         
-        // Write header file
-        std::ofstream header_file(out_path / output.header_file);
-        if (!header_file) return false;
-        header_file << output.header_content;
-        header_file.close();
+        Manifest old_manifest;
+        if (incremental) old_manifest = read_manifest(out_path / MANIFEST_FILE);
+        WriteStats local_stats;
+        WriteStats& st = stats ? *stats : local_stats;
         
-        // Write source file
-        std::ofstream source_file(out_path / output.source_file);
-        if (!source_file) return false;
-        source_file << output.source_content;
-        source_file.close();
+        std::ostringstream manifest;
+        manifest << MANIFEST_HEADER << "\n" << std::hex << std::setfill('0');
         
-        // Write ROM data file
-        std::ofstream rom_file(out_path / output.rom_data_file);
-        if (!rom_file) return false;
-        rom_file << output.rom_data_content;
-        rom_file.close();
+        // Skip a file whose hash matches the previous run's and still exists
+        auto write_file = [&](const std::string& name, const std::string& content) {
+            uint64_t hash = hash_string(content);
+            manifest << "file " << std::setw(16) << hash << " " << name << "\n";
+            auto old = old_manifest.files.find(name);
+            if (old != old_manifest.files.end() && old->second == hash && fs::exists(out_path / name)) {
+                st.files_unchanged++;
+                return true;
+            }
+            std::ofstream file(out_path / name, std::ios::binary);
+            if (!file) return false;
+            file << content;
+            st.files_written++;
+            return static_cast<bool>(file);
+        };
         
-        // Write main file
-        std::ofstream main_file(out_path / output.main_file);
-        if (!main_file) return false;
-        main_file << output.main_content;
-        main_file.close();
+        std::set<std::string> produced = {output.header_file, output.internal_header_file,
+                                          output.source_file, output.rom_data_file,
+                                          output.main_file, output.cmake_file};
+        if (!write_file(output.header_file, output.header_content)) return false;
+        if (!write_file(output.source_file, output.source_content)) return false;
         
-        // Write CMakeLists.txt
-        std::ofstream cmake_file(out_path / output.cmake_file);
-        if (!cmake_file) return false;
-        cmake_file << output.cmake_content;
-        cmake_file.close();
+        // Write the shared header and code shards
+        if (!write_file(output.internal_header_file, output.internal_header_content)) return false;
+        for (const auto& file : output.code_files) {
+            if (!write_file(file.name, file.content)) return false;
+            produced.insert(file.name);
+        }
         
-        return true;
+        if (!output.rom_data_file.empty() &&
+            !write_file(output.rom_data_file, output.rom_data_content)) return false;
+        if (!output.rom_image_file.empty()) {
+            if (!write_file(output.rom_image_file, output.rom_image_content)) return false;
+            produced.insert(output.rom_image_file);
+        }
+        if (!output.symbol_map_file.empty()) {
+            if (!write_file(output.symbol_map_file, output.symbol_map_content)) return false;
+            produced.insert(output.symbol_map_file);
+        }
+        if (!output.listing_file.empty()) {
+            if (!write_file(output.listing_file, output.listing_content)) return false;
+            produced.insert(output.listing_file);
+        }
+        if (!write_file(output.main_file, output.main_content)) return false;
+        if (!write_file(output.cmake_file, output.cmake_content)) return false;
+        
+        for (const auto& func : output.function_hashes) {
+            manifest << "func " << std::setw(16) << func.ir_hash << " "
+                     << std::setw(16) << func.text_hash << " " << func.name << "\n";
+            auto old = old_manifest.functions.find(func.name);
+            if (old == old_manifest.functions.end() ||
+                old->second != std::make_pair(func.ir_hash, func.text_hash)) {
+                st.functions_changed++;
+            }
+        }
+        
+        // Shards that were split differently last time would otherwise be
+        // picked up by globbing build scripts
+        for (const auto& [name, hash] : old_manifest.files) {
+            if (!produced.count(name) && fs::remove(out_path / name)) st.files_removed++;
+        }
+        
+        std::ofstream manifest_file(out_path / MANIFEST_FILE);
+        if (!manifest_file) return false;
+        manifest_file << manifest.str();
+        
+        return static_cast<bool>(manifest_file);
     } catch (...) {
         return false;
     }
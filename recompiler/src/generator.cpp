@@ -8,6 +8,7 @@
 #include "recompiler/analyzer.h"
 #include "recompiler/ir/ir.h"
 #include "recompiler/ir/ir_builder.h"
+#include "recompiler/ir/ir_optimizer.h"
 #include "recompiler/codegen/c_emitter.h"
 
 #include <filesystem>
@@ -76,33 +77,17 @@ public:
             std::cout << "\nAnalyzing control flow...\n";
         }
         
-        // Detect standard HRAM DMA routine
-        // Routine: LDH (46),A; LD A,28; DEC A; JR NZ,-3; RET
-        // Hex: E0 46 3E 28 3D 20 FD C9
         AnalyzerOptions analyzer_opts;
         // analyzer_opts.verbose = opts_.verbose; // analyzer options doesn't have verbose
         analyzer_opts.trace_log = false; // can be enabled if needed
         
-        const std::vector<uint8_t> pattern = {0xE0, 0x46, 0x3E, 0x28, 0x3D, 0x20, 0xFD, 0xC9};
-        const std::vector<uint8_t>& data = rom.bytes();
-        
-        auto it = std::search(data.begin(), data.end(), pattern.begin(), pattern.end());
-        if (it != data.end()) {
-             size_t rom_idx = std::distance(data.begin(), it);
-             uint8_t bank = rom_idx / 0x4000;
-             uint16_t offset = rom_idx % 0x4000;
-             if (bank > 0) offset += 0x4000;
-            
-             if (opts_.verbose) {
-                 std::cout << "Detected OAM DMA routine at ROM 0x" << std::hex << rom_idx 
-                           << " (Bank " << (int)bank << ":0x" << offset << "). Mapping to HRAM 0xFF80.\n" << std::dec;
-             }
-             
-             AnalyzerOptions::RamOverlay overlay;
-             overlay.ram_addr = 0xFF80;
-             overlay.rom_addr = AnalysisResult::make_addr(bank, offset);
-             overlay.size = 8;
-             analyzer_opts.ram_overlays.push_back(overlay);
+        // Detect standard HRAM DMA routine
+        if (auto overlay = find_oam_dma_routine(rom)) {
+            if (opts_.verbose) {
+                std::cout << "Detected OAM DMA routine at bank " << (overlay->rom_addr >> 16) << ":0x"
+                          << std::hex << (overlay->rom_addr & 0xFFFF) << ". Mapping to HRAM 0xFF80.\n" << std::dec;
+            }
+            analyzer_opts.ram_overlays.push_back(*overlay);
         }
 
         // Use free function analyze() instead of Analyzer class
@@ -124,6 +109,10 @@ public:
             std::cout << "Generated IR for " << program.functions.size() << " functions\n";
         }
         
+        if (opts_.optimize) {
+            ir::optimize(program, ir::OptLevel::O1);
+        }
+        
         // Generate C code
         if (opts_.verbose) {
             std::cout << "\nGenerating C code...\n";
@@ -133,6 +122,7 @@ public:
         emit_config.emit_address_comments = opts_.emit_comments;
         emit_config.emit_comments = true;
         emit_config.generate_bank_dispatch = opts_.generate_dispatch;
+        emit_config.ram_overlays = analyzer_opts.ram_overlays;
         
         codegen::GeneratedOutput output = codegen::generate_output(
             program, rom.data(), rom.size(), emit_config);
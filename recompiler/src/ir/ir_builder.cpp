@@ -4,8 +4,10 @@
  */
 
 #include "recompiler/ir/ir_builder.h"
+#include "recompiler/hash.h"
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 
 namespace gbrecomp {
 namespace ir {
@@ -63,6 +65,13 @@ Operand Operand::bit_idx(uint8_t b) {
     return op;
 }
 
+Operand Operand::bank(uint8_t b) {
+    Operand op;
+    op.type = OperandType::BANK;
+    op.value.bank = b;
+    return op;
+}
+
 Operand Operand::mem_reg16(uint8_t r) {
     Operand op;
     op.type = OperandType::MEM_REG16;
@@ -142,6 +151,88 @@ FlagEffects FlagEffects::only_c() {
     return f;
 }
 
+uint8_t FlagEffects::mask() const {
+    return (affects_z ? FLAG_Z : 0) | (affects_n ? FLAG_N : 0) |
+           (affects_h ? FLAG_H : 0) | (affects_c ? FLAG_C : 0);
+}
+
+// Flags written by a lowered instruction, matching the gb_* runtime helpers
+static FlagEffects flag_effects_for(const IRInstruction& instr) {
+    FlagEffects f{};
+    switch (instr.opcode) {
+        case Opcode::ADD8:
+        case Opcode::ADC8:
+            return FlagEffects::z0hc();
+        case Opcode::SUB8:
+        case Opcode::SBC8:
+        case Opcode::CP8:
+            return FlagEffects::z1hc();
+        case Opcode::AND8:
+            f = FlagEffects::z0h0();
+            f.fixed_h = f.h_value = true;
+            return f;
+        case Opcode::OR8:
+        case Opcode::XOR8:
+            f = FlagEffects::z0h0();
+            f.fixed_h = true;
+            return f;
+        case Opcode::INC8:
+        case Opcode::DEC8:
+            f.affects_z = f.affects_n = f.affects_h = true;
+            f.fixed_n = true;
+            f.n_value = instr.opcode == Opcode::DEC8;
+            return f;
+        case Opcode::ADD16:
+            f.affects_n = f.affects_h = f.affects_c = true;
+            f.fixed_n = true;
+            return f;
+        case Opcode::ADD_SP_IMM8:
+        case Opcode::LD_HL_SP_N:
+            f = FlagEffects::z0hc();
+            f.fixed_z = true;
+            return f;
+        case Opcode::RLC:
+        case Opcode::RRC:
+        case Opcode::RL:
+        case Opcode::RR:
+        case Opcode::SLA:
+        case Opcode::SRA:
+        case Opcode::SRL:
+        case Opcode::SWAP:
+            f = FlagEffects::z0hc();
+            f.fixed_h = true;
+            // RLCA/RRCA/RLA/RRA always clear Z
+            f.fixed_z = instr.extra.type == OperandType::IMM8 && instr.extra.value.imm8 == 1;
+            if (instr.opcode == Opcode::SWAP) f.fixed_c = true;
+            return f;
+        case Opcode::BIT:
+            f.affects_z = f.affects_n = f.affects_h = true;
+            f.fixed_n = f.fixed_h = f.h_value = true;
+            return f;
+        case Opcode::DAA:
+            f.affects_z = f.affects_h = f.affects_c = true;
+            f.fixed_h = true;
+            return f;
+        case Opcode::CPL:
+            f.affects_n = f.affects_h = true;
+            f.fixed_n = f.fixed_h = f.n_value = f.h_value = true;
+            return f;
+        case Opcode::SCF:
+        case Opcode::CCF:
+            f.affects_n = f.affects_h = f.affects_c = true;
+            f.fixed_n = f.fixed_h = true;
+            f.fixed_c = f.c_value = instr.opcode == Opcode::SCF;
+            return f;
+        case Opcode::POP16:
+            if (instr.dst.type == OperandType::REG16 && instr.dst.value.reg16 == 4) {
+                return FlagEffects::znhc();  // POP AF
+            }
+            return f;
+        default:
+            return f;
+    }
+}
+
 /* ============================================================================
  * IRInstruction Factory Methods
  * ========================================================================== */
@@ -251,7 +342,7 @@ IRInstruction IRInstruction::make_label(uint32_t label_id) {
     return instr;
 }
 
-IRInstruction IRInstruction::make_comment(const std::string& text) {
+IRInstruction IRInstruction::make_comment(uint32_t text) {
     IRInstruction instr;
     instr.opcode = Opcode::NOP;  // Use NOP for comments
     instr.comment = text;
@@ -269,32 +360,21 @@ uint32_t Program::create_block(uint8_t bank, uint16_t addr) {
     block.bank = bank;
     block.start_address = addr;
     block.end_address = addr;
-    block.label = make_address_label(bank, addr);
     blocks[id] = block;
     return id;
 }
 
-uint32_t Program::create_label(const std::string& name) {
-    uint32_t id = next_label_id++;
-    labels[id] = name;
-    label_by_name[name] = id;
-    return id;
+uint32_t Program::create_label(std::string_view name) {
+    return strings.intern(name);
 }
 
-uint32_t Program::get_or_create_label(const std::string& name) {
-    auto it = label_by_name.find(name);
-    if (it != label_by_name.end()) {
-        return it->second;
-    }
-    return create_label(name);
+uint32_t Program::get_or_create_label(std::string_view name) {
+    return strings.intern(name);
 }
 
 std::string Program::get_label_name(uint32_t id) const {
-    auto it = labels.find(id);
-    if (it != labels.end()) {
-        return it->second;
-    }
-    return "unknown_label";
+    std::string_view name = strings.view(id);
+    return name.empty() ? "unknown_label" : std::string(name);
 }
 
 std::string Program::make_address_label(uint8_t bank, uint16_t addr) const {
@@ -328,6 +408,20 @@ Program IRBuilder::build(const AnalysisResult& analysis, const std::string& rom_
     program.rom_name = rom_name;
     program.main_entry = analysis.entry_point;
     program.interrupt_vectors = analysis.interrupt_vectors;
+    program.jump_tables = analysis.jump_tables;
+    if (analysis.rom) {
+        const ROM& rom = *analysis.rom;
+        program.mbc_type = static_cast<uint8_t>(rom.header().mbc_type);
+        program.rom_bank_count = static_cast<uint16_t>(
+            std::max<size_t>(rom.bank_count(), (rom.size() + 0x3FFF) / 0x4000));
+    }
+    program.blocks.reserve(analysis.blocks.size());
+    program_ = &program;
+    
+    // Functions are keyed by name, which does not follow address order,
+    // so collect them and build the sorted table once at the end
+    std::vector<std::pair<std::string, ir::Function>> functions;
+    functions.reserve(analysis.functions.size());
     
     // For each function in analysis, create IR function
     for (const auto& [addr, func] : analysis.functions) {
@@ -338,6 +432,7 @@ Program IRBuilder::build(const AnalysisResult& analysis, const std::string& rom_
         ir_func.is_interrupt_handler = func.is_interrupt_handler;
         
         // Create a block for each block address in this function
+        std::vector<std::pair<uint32_t, const gbrecomp::BasicBlock*>> created;
         for (uint16_t block_addr : func.block_addresses) {
             uint32_t full_addr = (static_cast<uint32_t>(func.bank) << 16) | block_addr;
             auto block_it = analysis.blocks.find(full_addr);
@@ -352,45 +447,254 @@ Program IRBuilder::build(const AnalysisResult& analysis, const std::string& rom_
             
             // Copy end_address from source block for correct fallthrough handling
             dst_block.end_address = src_block.end_address;
+            dst_block.is_entry = src_block.is_function_entry;
+            dst_block.is_interrupt_handler = src_block.is_interrupt_entry;
+            dst_block.is_reachable = src_block.is_reachable;
+            created.emplace_back(block_id, &src_block);
             
-            // Lower each instruction in the block
+            std::vector<const Instruction*> body;
             for (size_t idx : src_block.instruction_indices) {
                 if (idx < analysis.instructions.size()) {
-                    const Instruction& instr = analysis.instructions[idx];
-                    lower_instruction(instr, dst_block);
+                    body.push_back(&analysis.instructions[idx]);
+                }
+            }
+            pending_.clear();
+            if (!options_.recognize_idioms || !lower_loop_idiom(body, dst_block)) {
+                for (const Instruction* instr : body) {
+                    lower_instruction(*instr);
                 }
             }
+            dst_block.instructions = program.arena.copy(pending_);
         }
         
-        program.functions[func.name] = ir_func;
+        link_blocks(program, created);
+        functions.emplace_back(func.name, std::move(ir_func));
     }
     
+    program.functions = FlatMap<std::string, ir::Function>(std::move(functions));
+    program_ = nullptr;
     return program;
 }
 
-void IRBuilder::lower_instruction(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::link_blocks(Program& program,
+                            const std::vector<std::pair<uint32_t, const gbrecomp::BasicBlock*>>& blocks) {
+    std::map<uint16_t, uint32_t> block_at;
+    for (const auto& [id, src] : blocks) {
+        block_at[src->start_address] = id;
+    }
+    
+    for (const auto& [id, src] : blocks) {
+        ir::BasicBlock& block = program.blocks[id];
+        // Successors in another ROM region go through bank dispatch
+        for (uint16_t target : src->successors) {
+            auto it = block_at.find(target);
+            bool same_region = (target < 0x4000) == (block.start_address < 0x4000) && target < 0x8000;
+            if (it == block_at.end() || !same_region) {
+                block.has_external_exit = true;
+                continue;
+            }
+            block.successors.push_back(it->second);
+            program.blocks[it->second].predecessors.push_back(id);
+        }
+        // Returns and JP (HL) leave the function without a listed successor
+        if (src->successors.empty()) {
+            block.has_external_exit = true;
+        }
+    }
+}
+
+/* ============================================================================
+ * Loop Idioms
+ * ========================================================================== */
+
+namespace {
+
+constexpr uint8_t NO_REG = 0xFF;
+
+// Pointer pair and post-step of an (rr) / (HL+) / (HL-) access through A
+struct PointerAccess {
+    uint8_t pair = NO_REG;
+    int8_t step = 0;
+};
+
+bool match_load_a(uint8_t op, PointerAccess& acc) {
+    switch (op) {
+        case 0x0A: acc = {0, 0}; return true;   // LD A,(BC)
+        case 0x1A: acc = {1, 0}; return true;   // LD A,(DE)
+        case 0x2A: acc = {2, 1}; return true;   // LD A,(HL+)
+        case 0x3A: acc = {2, -1}; return true;  // LD A,(HL-)
+        case 0x7E: acc = {2, 0}; return true;   // LD A,(HL)
+        default: return false;
+    }
+}
+
+bool match_store_a(uint8_t op, PointerAccess& acc) {
+    switch (op) {
+        case 0x02: acc = {0, 0}; return true;   // LD (BC),A
+        case 0x12: acc = {1, 0}; return true;   // LD (DE),A
+        case 0x22: acc = {2, 1}; return true;   // LD (HL+),A
+        case 0x32: acc = {2, -1}; return true;  // LD (HL-),A
+        case 0x77: acc = {2, 0}; return true;   // LD (HL),A
+        default: return false;
+    }
+}
+
+// Register pair containing an 8-bit register (B..L), NO_REG for A
+uint8_t pair_of(uint8_t reg8) {
+    return reg8 < 6 ? reg8 / 2 : NO_REG;
+}
+
+} // namespace
+
+/**
+ * Copy and fill loops are a pointer access or two through A, pointer
+ * INC/DECs and a counter decrement, either `DEC r` or `DEC rr; LD A,hi;
+ * OR lo`, ending in JR/JP NZ back to the block start. LY waits are
+ * `LDH A,(44); CP n; JR/JP cc` back to the start. The intrinsics replay
+ * the loop one iteration at a time with the same register, flag and
+ * memory effects, ticking the taken-branch iteration cost between them,
+ * and stop at an iteration boundary when an event needs the trampoline.
+ */
+bool IRBuilder::lower_loop_idiom(const std::vector<const Instruction*>& body, BasicBlock& block) {
+    if (body.size() < 2) return false;
+    const Instruction& branch = *body.back();
+    bool is_jr = branch.opcode == 0x20 || branch.opcode == 0x28 ||
+                 branch.opcode == 0x30 || branch.opcode == 0x38;
+    bool is_jp = branch.opcode == 0xC2 || branch.opcode == 0xCA ||
+                 branch.opcode == 0xD2 || branch.opcode == 0xDA;
+    if (branch.is_cb_prefixed || (!is_jr && !is_jp)) return false;
+    uint16_t target = is_jr ? static_cast<uint16_t>(branch.address + branch.length + branch.offset)
+                            : branch.imm16;
+    if (target != block.start_address) return false;
+    uint8_t cond = static_cast<uint8_t>(branch.condition);
+
+    std::vector<const Instruction*> ops(body.begin(), body.end() - 1);
+    for (const Instruction* op : ops) {
+        if (op->is_cb_prefixed) return false;
+    }
+
+    uint32_t cycles = 0;
+    for (const Instruction* op : ops) cycles += op->cycles;
+
+    IRInstruction idiom;
+    idiom.source_bank = body.front()->bank;
+    idiom.source_address = body.front()->address;
+    idiom.cycles = static_cast<uint8_t>(cycles + branch.cycles);
+    idiom.cycles_branch_taken = static_cast<uint8_t>(cycles + branch.cycles_branch);
+
+    size_t i = 0;
+    auto at = [&](size_t k) -> int { return k < ops.size() ? ops[k]->opcode : -1; };
+
+    if (ops.size() == 2 && at(0) == 0xF0 && ops[0]->imm8 == 0x44 && at(1) == 0xFE) {
+        // LDH A,(LY); CP n
+        idiom.opcode = Opcode::WAIT_LY;
+        idiom.src = Operand::imm8(ops[1]->imm8);
+        idiom.extra = Operand::condition(cond);
+        idiom.flags = FlagEffects::znhc();
+    } else {
+        if (cond != 0) return false;  // counted loops run while NZ
+
+        // Fill value loaded inside the loop: LD A,n or XOR A
+        int fill = -1;
+        bool xor_setup = false;
+        if (at(i) == 0x3E) fill = ops[i++]->imm8;
+        else if (at(i) == 0xAF) { fill = 0; xor_setup = true; i++; }
+
+        PointerAccess src, dst;
+        bool copy = fill < 0 && match_load_a(static_cast<uint8_t>(at(i)), src);
+        if (copy) i++;
+        if (!match_store_a(static_cast<uint8_t>(at(i++)), dst)) return false;
+        if (copy && src.pair == dst.pair) return false;
+
+        // INC rr / DEC rr of the pointers
+        while (i < ops.size()) {
+            uint8_t op = ops[i]->opcode;
+            if ((op & 0xC7) != 0x03 || (op & 0x30) == 0x30) break;
+            uint8_t pair = op >> 4;
+            int8_t delta = (op & 0x08) ? -1 : 1;
+            if (pair == dst.pair) dst.step += delta;
+            else if (copy && pair == src.pair) src.step += delta;
+            else break;
+            i++;
+        }
+        if (dst.step < -1 || dst.step > 1 || src.step < -1 || src.step > 1) return false;
+
+        // Counter: DEC r (B..L) or DEC rr; LD A,hi; OR lo (either order)
+        uint8_t op = static_cast<uint8_t>(at(i));
+        Operand counter;
+        uint8_t counter_pair;
+        if ((op & 0xC7) == 0x05 && (op >> 3) < 6 && i + 1 == ops.size()) {
+            counter = Operand::reg8(op >> 3);
+            counter_pair = pair_of(op >> 3);
+            // The counter's DEC leaves C alone, XOR A would clear it
+            if (xor_setup) return false;
+            idiom.flags = FlagEffects::znhc();
+            idiom.flags.affects_c = false;
+        } else if ((op == 0x0B || op == 0x1B) && i + 3 == ops.size()) {
+            counter_pair = op >> 4;
+            uint8_t hi = counter_pair * 2, lo = hi + 1;
+            uint8_t ld = static_cast<uint8_t>(at(i + 1)), orr = static_cast<uint8_t>(at(i + 2));
+            bool hi_lo = ld == 0x78 + hi && orr == 0xB0 + lo;
+            bool lo_hi = ld == 0x78 + lo && orr == 0xB0 + hi;
+            if (!hi_lo && !lo_hi) return false;
+            // A is clobbered by the test, so a fill needs its value reloaded
+            if (!copy && fill < 0) return false;
+            counter = Operand::reg16(counter_pair);
+            idiom.flags = FlagEffects::znhc();
+        } else {
+            return false;
+        }
+        if (counter_pair == dst.pair || (copy && counter_pair == src.pair)) return false;
+
+        idiom.opcode = copy ? Opcode::BLOCK_COPY : Opcode::BLOCK_FILL;
+        idiom.dst = Operand::reg16(dst.pair);
+        idiom.dst_step = dst.step;
+        if (copy) {
+            idiom.src = Operand::reg16(src.pair);
+            idiom.src_step = src.step;
+        } else {
+            idiom.src = fill >= 0 ? Operand::imm8(static_cast<uint8_t>(fill)) : Operand::reg8(7);
+        }
+        idiom.extra = counter;
+    }
+
+    if (options_.emit_comments) {
+        for (const Instruction* instr : body) {
+            IRInstruction comment;
+            comment.opcode = Opcode::NOP;
+            comment.comment = program_->strings.intern(disassemble(*instr));
+            comment.source_bank = instr->bank;
+            comment.source_address = instr->address;
+            pending_.push_back(comment);
+        }
+    }
+    pending_.push_back(idiom);
+    return true;
+}
+
+void IRBuilder::lower_instruction(const Instruction& instr) {
     // Add a comment with the disassembly
     if (options_.emit_comments) {
         IRInstruction comment;
         comment.opcode = Opcode::NOP;
-        comment.comment = disassemble(instr);
+        comment.comment = program_->strings.intern(disassemble(instr));
         comment.source_bank = instr.bank;
         comment.source_address = instr.address;
-        block.instructions.push_back(comment);
+        pending_.push_back(comment);
     }
     
     // Lower based on instruction type
     switch (instr.type) {
         case InstructionType::NOP:
-            emit(block, IRInstruction::make_nop(instr.bank, instr.address), instr);
+            emit(IRInstruction::make_nop(instr.bank, instr.address), instr);
             break;
             
         case InstructionType::LD_R_R:
-            lower_load_r_r(instr, block);
+            lower_load_r_r(instr);
             break;
             
         case InstructionType::LD_R_N:
-            lower_load_r_imm(instr, block);
+            lower_load_r_imm(instr);
             break;
             
         case InstructionType::LD_R_HL:
@@ -401,7 +705,7 @@ void IRBuilder::lower_instruction(const Instruction& instr, ir::BasicBlock& bloc
         case InstructionType::LD_A_HLD:
         case InstructionType::LDH_A_N:
         case InstructionType::LDH_A_C:
-            lower_load_mem(instr, block);
+            lower_load_mem(instr);
             break;
             
         case InstructionType::LD_HL_R:
@@ -413,7 +717,7 @@ void IRBuilder::lower_instruction(const Instruction& instr, ir::BasicBlock& bloc
         case InstructionType::LD_HLD_A:
         case InstructionType::LDH_N_A:
         case InstructionType::LDH_C_A:
-            lower_store_mem(instr, block);
+            lower_store_mem(instr);
             break;
             
         case InstructionType::LD_RR_NN:
@@ -422,7 +726,7 @@ void IRBuilder::lower_instruction(const Instruction& instr, ir::BasicBlock& bloc
         case InstructionType::LD_HL_SP_N:
         case InstructionType::PUSH:
         case InstructionType::POP:
-            lower_16bit_load(instr, block);
+            lower_16bit_load(instr);
             break;
             
         case InstructionType::ADD_A_R:
@@ -441,7 +745,7 @@ void IRBuilder::lower_instruction(const Instruction& instr, ir::BasicBlock& bloc
         case InstructionType::OR_A_HL:
         case InstructionType::XOR_A_HL:
         case InstructionType::CP_A_HL:
-            lower_alu_r(instr, block);
+            lower_alu_r(instr);
             break;
             
         case InstructionType::ADD_A_N:
@@ -452,7 +756,7 @@ void IRBuilder::lower_instruction(const Instruction& instr, ir::BasicBlock& bloc
         case InstructionType::OR_A_N:
         case InstructionType::XOR_A_N:
         case InstructionType::CP_A_N:
-            lower_alu_imm(instr, block);
+            lower_alu_imm(instr);
             break;
             
         case InstructionType::INC_R:
@@ -461,12 +765,12 @@ void IRBuilder::lower_instruction(const Instruction& instr, ir::BasicBlock& bloc
         case InstructionType::DEC_HL_IND:
         case InstructionType::INC_RR:
         case InstructionType::DEC_RR:
-            lower_inc_dec(instr, block);
+            lower_inc_dec(instr);
             break;
             
         case InstructionType::ADD_HL_RR:
         case InstructionType::ADD_SP_N:
-            lower_16bit_alu(instr, block);
+            lower_16bit_alu(instr);
             break;
             
         case InstructionType::RLCA:
@@ -489,7 +793,7 @@ void IRBuilder::lower_instruction(const Instruction& instr, ir::BasicBlock& bloc
         case InstructionType::SRA_HL:
         case InstructionType::SRL_HL:
         case InstructionType::SWAP_HL:
-            lower_rotate_shift(instr, block);
+            lower_rotate_shift(instr);
             break;
             
         case InstructionType::BIT_N_R:
@@ -498,7 +802,7 @@ void IRBuilder::lower_instruction(const Instruction& instr, ir::BasicBlock& bloc
         case InstructionType::SET_N_HL:
         case InstructionType::RES_N_R:
         case InstructionType::RES_N_HL:
-            lower_bit_op(instr, block);
+            lower_bit_op(instr);
             break;
             
         case InstructionType::JP_NN:
@@ -512,7 +816,7 @@ void IRBuilder::lower_instruction(const Instruction& instr, ir::BasicBlock& bloc
                 }
                 ir.cycles = instr.cycles;
                 ir.cycles_branch_taken = instr.cycles_branch;
-                emit(block, ir, instr);
+                emit(ir, instr);
             }
             break;
             
@@ -523,7 +827,7 @@ void IRBuilder::lower_instruction(const Instruction& instr, ir::BasicBlock& bloc
                 ir.opcode = Opcode::JUMP;
                 ir.dst = Operand::reg16(2);  // HL = register index 2
                 ir.cycles = instr.cycles;
-                emit(block, ir, instr);
+                emit(ir, instr);
             }
             break;
             
@@ -540,7 +844,7 @@ void IRBuilder::lower_instruction(const Instruction& instr, ir::BasicBlock& bloc
                 }
                 ir.cycles = instr.cycles;
                 ir.cycles_branch_taken = instr.cycles_branch;
-                emit(block, ir, instr);
+                emit(ir, instr);
             }
             break;
             
@@ -561,14 +865,14 @@ void IRBuilder::lower_instruction(const Instruction& instr, ir::BasicBlock& bloc
                 }
                 ir.cycles = instr.cycles;
                 ir.cycles_branch_taken = instr.cycles_branch;
-                emit(block, ir, instr);
+                emit(ir, instr);
             }
             break;
             
         case InstructionType::RET:
         case InstructionType::RET_CC:
         case InstructionType::RETI:
-            lower_ret(instr, block);
+            lower_ret(instr);
             break;
             
         case InstructionType::DAA:
@@ -579,43 +883,45 @@ void IRBuilder::lower_instruction(const Instruction& instr, ir::BasicBlock& bloc
         case InstructionType::STOP:
         case InstructionType::DI:
         case InstructionType::EI:
-            lower_misc(instr, block);
+            lower_misc(instr);
             break;
             
         default:
             // Emit NOP for unhandled instructions (stub)
-            emit(block, IRInstruction::make_nop(instr.bank, instr.address), instr);
+            emit(IRInstruction::make_nop(instr.bank, instr.address), instr);
             break;
     }
 }
 
-void IRBuilder::emit(ir::BasicBlock& block, IRInstruction ir_instr, 
-                     const Instruction& src) {
+void IRBuilder::emit(IRInstruction ir_instr, const Instruction& src) {
     if (options_.emit_source_locations) {
         ir_instr.source_bank = src.bank;
         ir_instr.source_address = src.address;
     }
-    block.instructions.push_back(ir_instr);
+    if (ir_instr.flags.mask() == 0) {
+        ir_instr.flags = flag_effects_for(ir_instr);
+    }
+    pending_.push_back(ir_instr);
 }
 
 // ========== Lowering Stubs ==========
 
-void IRBuilder::lower_load_r_r(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::lower_load_r_r(const Instruction& instr) {
     uint8_t dst = static_cast<uint8_t>(instr.reg8_dst);
     uint8_t src = static_cast<uint8_t>(instr.reg8_src);
-    emit(block, IRInstruction::make_mov_reg_reg(dst, src, instr.bank, instr.address), instr);
+    emit(IRInstruction::make_mov_reg_reg(dst, src, instr.bank, instr.address), instr);
 }
 
-void IRBuilder::lower_load_r_imm(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::lower_load_r_imm(const Instruction& instr) {
     IRInstruction ir;
     ir.opcode = Opcode::MOV_REG_IMM8;
     ir.dst = Operand::reg8(static_cast<uint8_t>(instr.reg8_dst));
     ir.src = Operand::imm8(instr.imm8);
     ir.cycles = instr.cycles;
-    emit(block, ir, instr);
+    emit(ir, instr);
 }
 
-void IRBuilder::lower_load_mem(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::lower_load_mem(const Instruction& instr) {
     IRInstruction ir;
     ir.opcode = Opcode::LOAD8;
     ir.dst = Operand::reg8(7);  // A register
@@ -648,14 +954,14 @@ void IRBuilder::lower_load_mem(const Instruction& instr, ir::BasicBlock& block)
             ir.opcode = Opcode::IO_READ_C;
             ir.dst = Operand::reg8(7);  // A register
             ir.cycles = instr.cycles;
-            emit(block, ir, instr);
+            emit(ir, instr);
             return;  // Early return - already emitted
         default:
             break;
     }
     
     ir.cycles = instr.cycles;
-    emit(block, ir, instr);
+    emit(ir, instr);
     
     // Handle HL increment/decrement for LDI/LDD instructions
     if (instr.type == InstructionType::LD_A_HLI) {
@@ -664,18 +970,18 @@ void IRBuilder::lower_load_mem(const Instruction& instr, ir::BasicBlock& block)
         inc_ir.opcode = Opcode::INC16;
         inc_ir.dst = Operand::reg16(static_cast<uint8_t>(Reg16::HL));
         inc_ir.cycles = 0;  // Included in the original instruction's cycles
-        emit(block, inc_ir, instr);
+        emit(inc_ir, instr);
     } else if (instr.type == InstructionType::LD_A_HLD) {
         // LD A,(HL-) - decrement HL after load
         IRInstruction dec_ir;
         dec_ir.opcode = Opcode::DEC16;
         dec_ir.dst = Operand::reg16(static_cast<uint8_t>(Reg16::HL));
         dec_ir.cycles = 0;  // Included in the original instruction's cycles
-        emit(block, dec_ir, instr);
+        emit(dec_ir, instr);
     }
 }
 
-void IRBuilder::lower_store_mem(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::lower_store_mem(const Instruction& instr) {
     IRInstruction ir;
     ir.opcode = Opcode::STORE8;
     ir.src = Operand::reg8(static_cast<uint8_t>(Reg8::A));  // A register
@@ -710,14 +1016,14 @@ void IRBuilder::lower_store_mem(const Instruction& instr, ir::BasicBlock& block)
             ir.opcode = Opcode::IO_WRITE_C;
             ir.src = Operand::reg8(7);  // A register
             ir.cycles = instr.cycles;
-            emit(block, ir, instr);
+            emit(ir, instr);
             return;  // Early return - already emitted
         default:
             break;
     }
     
     ir.cycles = instr.cycles;
-    emit(block, ir, instr);
+    emit(ir, instr);
     
     // Handle HL increment/decrement for LDI/LDD instructions
     if (instr.type == InstructionType::LD_HLI_A) {
@@ -726,18 +1032,18 @@ void IRBuilder::lower_store_mem(const Instruction& instr, ir::BasicBlock& block)
         inc_ir.opcode = Opcode::INC16;
         inc_ir.dst = Operand::reg16(static_cast<uint8_t>(Reg16::HL));
         inc_ir.cycles = 0;  // Included in the original instruction's cycles
-        emit(block, inc_ir, instr);
+        emit(inc_ir, instr);
     } else if (instr.type == InstructionType::LD_HLD_A) {
         // LD (HL-),A - decrement HL after store
         IRInstruction dec_ir;
         dec_ir.opcode = Opcode::DEC16;
         dec_ir.dst = Operand::reg16(static_cast<uint8_t>(Reg16::HL));
         dec_ir.cycles = 0;  // Included in the original instruction's cycles
-        emit(block, dec_ir, instr);
+        emit(dec_ir, instr);
     }
 }
 
-void IRBuilder::lower_alu_r(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::lower_alu_r(const Instruction& instr) {
     IRInstruction ir;
     switch (instr.type) {
         case InstructionType::ADD_A_R:
@@ -775,12 +1081,22 @@ void IRBuilder::lower_alu_r(const Instruction& instr, ir::BasicBlock& block) {
         default:
             ir.opcode = Opcode::NOP;
     }
-    ir.src = Operand::reg8(static_cast<uint8_t>(instr.reg8_src));
+    switch (instr.type) {
+        case InstructionType::ADD_A_HL: case InstructionType::ADC_A_HL:
+        case InstructionType::SUB_A_HL: case InstructionType::SBC_A_HL:
+        case InstructionType::AND_A_HL: case InstructionType::OR_A_HL:
+        case InstructionType::XOR_A_HL: case InstructionType::CP_A_HL:
+            ir.src = Operand::reg8(6);  // 6 = HL_IND, signals memory operand to emitter
+            break;
+        default:
+            ir.src = Operand::reg8(static_cast<uint8_t>(instr.reg8_src));
+            break;
+    }
     ir.cycles = instr.cycles;
-    emit(block, ir, instr);
+    emit(ir, instr);
 }
 
-void IRBuilder::lower_alu_imm(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::lower_alu_imm(const Instruction& instr) {
     IRInstruction ir;
     switch (instr.type) {
         case InstructionType::ADD_A_N: ir.opcode = Opcode::ADD8; break;
@@ -795,10 +1111,10 @@ void IRBuilder::lower_alu_imm(const Instruction& instr, ir::BasicBlock& block) {
     }
     ir.src = Operand::imm8(instr.imm8);
     ir.cycles = instr.cycles;
-    emit(block, ir, instr);
+    emit(ir, instr);
 }
 
-void IRBuilder::lower_inc_dec(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::lower_inc_dec(const Instruction& instr) {
     IRInstruction ir;
     switch (instr.type) {
         case InstructionType::INC_R: ir.opcode = Opcode::INC8; break;
@@ -820,10 +1136,10 @@ void IRBuilder::lower_inc_dec(const Instruction& instr, ir::BasicBlock& block) {
         ir.dst = Operand::reg8(static_cast<uint8_t>(instr.reg8_dst));
     }
     ir.cycles = instr.cycles;
-    emit(block, ir, instr);
+    emit(ir, instr);
 }
 
-void IRBuilder::lower_rotate_shift(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::lower_rotate_shift(const Instruction& instr) {
     IRInstruction ir;
     
     // Determine opcode based on instruction type
@@ -897,10 +1213,10 @@ void IRBuilder::lower_rotate_shift(const Instruction& instr, ir::BasicBlock& blo
     }
     
     ir.cycles = instr.cycles;
-    emit(block, ir, instr);
+    emit(ir, instr);
 }
 
-void IRBuilder::lower_bit_op(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::lower_bit_op(const Instruction& instr) {
     IRInstruction ir;
     switch (instr.type) {
         case InstructionType::BIT_N_R:
@@ -921,10 +1237,10 @@ void IRBuilder::lower_bit_op(const Instruction& instr, ir::BasicBlock& block) {
     ir.dst = Operand::reg8(static_cast<uint8_t>(instr.reg8_dst));
     ir.src = Operand::bit_idx(instr.bit_index);
     ir.cycles = instr.cycles;
-    emit(block, ir, instr);
+    emit(ir, instr);
 }
 
-void IRBuilder::lower_jump(const Instruction& instr, ir::BasicBlock& block, Program& prog) {
+void IRBuilder::lower_jump(const Instruction& instr, Program& prog) {
     IRInstruction ir;
     ir.opcode = instr.is_conditional ? Opcode::JUMP_CC : Opcode::JUMP;
     ir.dst = Operand::imm16(instr.imm16);
@@ -933,10 +1249,10 @@ void IRBuilder::lower_jump(const Instruction& instr, ir::BasicBlock& block, Prog
     }
     ir.cycles = instr.cycles;
     ir.cycles_branch_taken = instr.cycles_branch;
-    emit(block, ir, instr);
+    emit(ir, instr);
 }
 
-void IRBuilder::lower_call(const Instruction& instr, ir::BasicBlock& block, Program& prog) {
+void IRBuilder::lower_call(const Instruction& instr, Program& prog) {
     IRInstruction ir;
     if (instr.type == InstructionType::RST) {
         ir.opcode = Opcode::RST;
@@ -950,10 +1266,10 @@ void IRBuilder::lower_call(const Instruction& instr, ir::BasicBlock& block, Prog
     }
     ir.cycles = instr.cycles;
     ir.cycles_branch_taken = instr.cycles_branch;
-    emit(block, ir, instr);
+    emit(ir, instr);
 }
 
-void IRBuilder::lower_ret(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::lower_ret(const Instruction& instr) {
     IRInstruction ir;
     switch (instr.type) {
         case InstructionType::RET: ir.opcode = Opcode::RET; break;
@@ -966,10 +1282,10 @@ void IRBuilder::lower_ret(const Instruction& instr, ir::BasicBlock& block) {
     }
     ir.cycles = instr.cycles;
     ir.cycles_branch_taken = instr.cycles_branch;
-    emit(block, ir, instr);
+    emit(ir, instr);
 }
 
-void IRBuilder::lower_misc(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::lower_misc(const Instruction& instr) {
     IRInstruction ir;
     switch (instr.type) {
         case InstructionType::DAA: ir.opcode = Opcode::DAA; break;
@@ -983,15 +1299,15 @@ void IRBuilder::lower_misc(const Instruction& instr, ir::BasicBlock& block) {
         default: ir.opcode = Opcode::NOP;
     }
     ir.cycles = instr.cycles;
-    emit(block, ir, instr);
+    emit(ir, instr);
 }
 
-void IRBuilder::lower_io(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::lower_io(const Instruction& instr) {
     // Stub
-    emit(block, IRInstruction::make_nop(instr.bank, instr.address), instr);
+    emit(IRInstruction::make_nop(instr.bank, instr.address), instr);
 }
 
-void IRBuilder::lower_16bit_load(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::lower_16bit_load(const Instruction& instr) {
     IRInstruction ir;
     switch (instr.type) {
         case InstructionType::LD_RR_NN:
@@ -1028,11 +1344,11 @@ void IRBuilder::lower_16bit_load(const Instruction& instr, ir::BasicBlock& block
             ir.opcode = Opcode::NOP;
     }
     ir.cycles = instr.cycles;
-    emit(block, ir, instr);
+    emit(ir, instr);
 }
 
 
-void IRBuilder::lower_16bit_alu(const Instruction& instr, ir::BasicBlock& block) {
+void IRBuilder::lower_16bit_alu(const Instruction& instr) {
     IRInstruction ir;
     switch (instr.type) {
         case InstructionType::ADD_HL_RR:
@@ -1048,7 +1364,7 @@ void IRBuilder::lower_16bit_alu(const Instruction& instr, ir::BasicBlock& block)
             ir.opcode = Opcode::NOP;
     }
     ir.cycles = instr.cycles;
-    emit(block, ir, instr);
+    emit(ir, instr);
 }
 
 /* ============================================================================
@@ -1097,19 +1413,68 @@ const char* opcode_name(Opcode op) {
         case Opcode::BIT: return "BIT";
         case Opcode::SET: return "SET";
         case Opcode::RES: return "RES";
+        case Opcode::BLOCK_COPY: return "BLOCK_COPY";
+        case Opcode::BLOCK_FILL: return "BLOCK_FILL";
+        case Opcode::WAIT_LY: return "WAIT_LY";
         default: return "???";
     }
 }
 
-std::string format_instruction(const IRInstruction& instr) {
+std::string format_instruction(const Program& program, const IRInstruction& instr) {
     std::ostringstream ss;
     ss << opcode_name(instr.opcode);
-    if (!instr.comment.empty()) {
-        ss << " ; " << instr.comment;
+    std::string_view comment = program.strings.view(instr.comment);
+    if (!comment.empty()) {
+        ss << " ; " << comment;
     }
     return ss.str();
 }
 
+namespace {
+
+void hash_operand(Hasher& h, const Operand& op) {
+    h.u64(static_cast<uint8_t>(op.type));
+    switch (op.type) {
+        case OperandType::NONE: break;
+        case OperandType::IMM16:
+        case OperandType::ADDR:
+        case OperandType::MEM_IMM16: h.u64(op.value.imm16); break;
+        case OperandType::LABEL_REF: h.u64(op.value.label_id); break;
+        default: h.u64(op.value.reg8); break;
+    }
+}
+
+} // namespace
+
+uint64_t hash_function(const Program& program, const Function& func) {
+    Hasher h;
+    h.str(func.name).u64(func.bank).u64(func.entry_address).u64(func.is_interrupt_handler);
+    h.u64(func.hot | func.cold << 1);
+    for (uint32_t id : func.block_ids) {
+        auto it = program.blocks.find(id);
+        if (it == program.blocks.end()) continue;
+        const BasicBlock& block = it->second;
+        h.u64(block.bank).u64(block.start_address).u64(block.end_address);
+        h.u64(block.is_entry | block.is_interrupt_handler << 1 | block.has_external_exit << 2);
+        for (const IRInstruction& instr : block.instructions) {
+            h.u64(static_cast<uint32_t>(instr.opcode));
+            hash_operand(h, instr.dst);
+            hash_operand(h, instr.src);
+            hash_operand(h, instr.extra);
+            h.u64(instr.source_bank).u64(instr.source_address);
+            h.u64(instr.cycles).u64(instr.cycles_branch_taken);
+            const FlagEffects& f = instr.flags;
+            h.u64(f.affects_z | f.affects_n << 1 | f.affects_h << 2 | f.affects_c << 3 |
+                  f.fixed_z << 4 | f.fixed_n << 5 | f.fixed_h << 6 | f.fixed_c << 7 |
+                  f.z_value << 8 | f.n_value << 9 | f.h_value << 10 | f.c_value << 11);
+            h.u64(instr.live_flags);
+            h.u64(static_cast<uint8_t>(instr.dst_step)).u64(static_cast<uint8_t>(instr.src_step));
+            h.str(program.strings.view(instr.comment));
+        }
+    }
+    return h.digest();
+}
+
 void dump_program(const Program& program, std::ostream& out) {
     out << "Program: " << program.rom_name << "\n";
     out << "Functions: " << program.functions.size() << "\n";
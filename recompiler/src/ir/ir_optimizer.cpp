@@ -1,27 +1,683 @@
 /**
  * @file ir_optimizer.cpp
- * @brief IR optimization passes (MVP stubs)
+ * @brief IR optimization passes
  */
 
 #include "recompiler/ir/ir_optimizer.h"
 
+#include <map>
+#include <vector>
+
 namespace gbrecomp {
 namespace ir {
 
 /* ============================================================================
- * Optimization Pass Implementations (Stubs)
+ * Optimization Pass Implementations
+ * ========================================================================== */
+
+/* ============================================================================
+ * Constant Propagation
  * ========================================================================== */
 
+namespace {
+
+constexpr int UNKNOWN = -1;
+constexpr uint8_t REG_C = 1;   // reg8 index of C, the LDH (C) offset
+
+/**
+ * Register values known at a point of a block. Facts never cross block
+ * boundaries: any block start can be entered through dispatch with
+ * arbitrary register contents.
+ */
+struct RegState {
+    int r[8];                   // Indexed like reg8 operands; slot 6 is (HL)
+    int sp;
+    int bank;                   // Switchable ROM bank set by a constant MBC write
+    std::vector<int> stack;     // Values pushed in this block, top at the back
+    
+    RegState() { clear(); }
+    
+    void clear() {
+        for (int& v : r) v = UNKNOWN;
+        sp = UNKNOWN;
+        bank = UNKNOWN;
+        stack.clear();
+    }
+    
+    int reg(uint8_t idx) const { return idx < 8 && idx != 6 ? r[idx] : UNKNOWN; }
+    
+    void set_reg(uint8_t idx, int value) {
+        if (idx < 8 && idx != 6) r[idx] = value < 0 ? UNKNOWN : (value & 0xFF);
+    }
+    
+    // BC, DE, HL, SP and AF; the F half of AF is never tracked
+    int pair(uint8_t idx) const {
+        if (idx == 3) return sp;
+        if (idx > 2) return UNKNOWN;
+        int hi = r[idx * 2], lo = r[idx * 2 + 1];
+        return hi < 0 || lo < 0 ? UNKNOWN : (hi << 8) | lo;
+    }
+    
+    void set_pair(uint8_t idx, int value) {
+        if (idx == 3) {
+            sp = value < 0 ? UNKNOWN : (value & 0xFFFF);
+        } else if (idx == 4) {
+            r[7] = UNKNOWN;
+        } else if (idx < 3) {
+            set_reg(idx * 2, value < 0 ? UNKNOWN : (value >> 8) & 0xFF);
+            set_reg(idx * 2 + 1, value < 0 ? UNKNOWN : value & 0xFF);
+        }
+    }
+};
+
+// Result of a rotate/shift/bit op on a known value; rotates through carry
+// depend on a flag that is not tracked
+int eval_cb(const IRInstruction& instr, int v) {
+    if (v < 0) return UNKNOWN;
+    switch (instr.opcode) {
+        case Opcode::RLC:  return ((v << 1) | (v >> 7)) & 0xFF;
+        case Opcode::RRC:  return ((v >> 1) | (v << 7)) & 0xFF;
+        case Opcode::SLA:  return (v << 1) & 0xFF;
+        case Opcode::SRA:  return (v >> 1) | (v & 0x80);
+        case Opcode::SRL:  return v >> 1;
+        case Opcode::SWAP: return ((v << 4) | (v >> 4)) & 0xFF;
+        case Opcode::SET:  return v | (1 << instr.src.value.bit_idx);
+        case Opcode::RES:  return v & ~(1 << instr.src.value.bit_idx);
+        default:           return UNKNOWN;
+    }
+}
+
+bool is_reg8(const Operand& op) {
+    return op.type == OperandType::REG8 && op.value.reg8 != 6;
+}
+
+// Rewrites a known 8-bit register source into an immediate
+bool fold_reg8_source(Operand& src, const RegState& st) {
+    if (!is_reg8(src)) return false;
+    int v = st.reg(src.value.reg8);
+    if (v < 0) return false;
+    src = Operand::imm8(static_cast<uint8_t>(v));
+    return true;
+}
+
+// Rewrites a known 16-bit address register into a constant address
+bool fold_address(Operand& addr, const RegState& st) {
+    if (addr.type != OperandType::REG16) return false;
+    int v = st.pair(addr.value.reg16);
+    if (v < 0) return false;
+    addr = Operand::imm16(static_cast<uint16_t>(v));
+    return true;
+}
+
+bool propagate_block(BasicBlock& block) {
+    bool changed = false;
+    RegState st;
+    
+    for (IRInstruction& instr : block.instructions) {
+        switch (instr.opcode) {
+            case Opcode::NOP:
+            case Opcode::LABEL:
+            case Opcode::COMMENT:
+            case Opcode::SOURCE_LOC:
+            case Opcode::DI:
+            case Opcode::EI:
+            case Opcode::SCF:
+            case Opcode::CCF:
+            case Opcode::BIT:
+            case Opcode::BANK_HINT:
+                break;
+            
+            case Opcode::MOV_REG_REG: {
+                int v = st.reg(instr.src.value.reg8);
+                if (v >= 0) {
+                    instr.opcode = Opcode::MOV_REG_IMM8;
+                    instr.src = Operand::imm8(static_cast<uint8_t>(v));
+                    changed = true;
+                }
+                st.set_reg(instr.dst.value.reg8, v);
+                break;
+            }
+            
+            case Opcode::MOV_REG_IMM8:
+                st.set_reg(instr.dst.value.reg8, instr.src.value.imm8);
+                break;
+            
+            case Opcode::MOV_REG_IMM16:
+                st.set_pair(instr.dst.value.reg16, instr.src.value.imm16);
+                if (instr.dst.value.reg16 == 3) st.stack.clear();
+                break;
+            
+            case Opcode::MOV_REG_REG16: {
+                int v = st.pair(instr.src.value.reg16);
+                if (v >= 0) {
+                    instr.opcode = Opcode::MOV_REG_IMM16;
+                    instr.src = Operand::imm16(static_cast<uint16_t>(v));
+                    changed = true;
+                }
+                st.set_pair(instr.dst.value.reg16, v);
+                if (instr.dst.value.reg16 == 3) st.stack.clear();
+                break;
+            }
+            
+            case Opcode::LOAD8:
+                changed |= fold_address(instr.src, st);
+                if (instr.src.type == OperandType::REG8 && st.reg(REG_C) >= 0) {
+                    instr.src = Operand::imm16(static_cast<uint16_t>(0xFF00 | st.reg(REG_C)));
+                    changed = true;
+                }
+                st.set_reg(instr.dst.type == OperandType::REG8 ? instr.dst.value.reg8 : 7, UNKNOWN);
+                break;
+            
+            case Opcode::IO_READ_C:
+                if (st.reg(REG_C) >= 0) {
+                    instr.opcode = Opcode::LOAD8;
+                    instr.src = Operand::imm16(static_cast<uint16_t>(0xFF00 | st.reg(REG_C)));
+                    changed = true;
+                }
+                st.set_reg(7, UNKNOWN);
+                break;
+            
+            case Opcode::IO_READ:
+                st.set_reg(7, UNKNOWN);
+                break;
+            
+            case Opcode::IO_WRITE_C:
+                if (st.reg(REG_C) >= 0) {
+                    instr.opcode = Opcode::STORE8;
+                    instr.dst = Operand::imm16(static_cast<uint16_t>(0xFF00 | st.reg(REG_C)));
+                    changed = true;
+                }
+                [[fallthrough]];
+            case Opcode::STORE8:
+            case Opcode::IO_WRITE:
+                if (instr.opcode == Opcode::STORE8) {
+                    changed |= fold_address(instr.dst, st);
+                    changed |= fold_reg8_source(instr.src, st);
+                    // Constant write to the ROM bank register: 0x2000-0x2FFF
+                    // selects the low bank bits on every MBC, 0 maps to 1
+                    if (instr.dst.type == OperandType::IMM16 &&
+                        instr.dst.value.imm16 >= 0x2000 && instr.dst.value.imm16 < 0x3000) {
+                        st.bank = instr.src.type == OperandType::IMM8
+                                ? (instr.src.value.imm8 ? instr.src.value.imm8 : 1)
+                                : UNKNOWN;
+                    }
+                }
+                st.stack.clear();  // May overwrite a pushed value
+                break;
+            
+            case Opcode::STORE16:
+                st.stack.clear();
+                break;
+            
+            case Opcode::PUSH16:
+                st.stack.push_back(st.pair(instr.dst.value.reg16));
+                if (st.sp >= 0) st.sp = (st.sp - 2) & 0xFFFF;
+                break;
+            
+            case Opcode::POP16: {
+                int v = UNKNOWN;
+                if (!st.stack.empty()) {
+                    v = st.stack.back();
+                    st.stack.pop_back();
+                }
+                st.set_pair(instr.dst.value.reg16, v);
+                if (st.sp >= 0) st.sp = (st.sp + 2) & 0xFFFF;
+                break;
+            }
+            
+            case Opcode::ADD8:
+            case Opcode::SUB8:
+            case Opcode::AND8:
+            case Opcode::OR8:
+            case Opcode::XOR8:
+            case Opcode::CP8:
+            case Opcode::ADC8:
+            case Opcode::SBC8: {
+                changed |= fold_reg8_source(instr.src, st);
+                int a = st.reg(7);
+                int v = instr.src.type == OperandType::IMM8 ? instr.src.value.imm8 : UNKNOWN;
+                int res = UNKNOWN;
+                if (a >= 0 && v >= 0) {
+                    switch (instr.opcode) {
+                        case Opcode::ADD8: res = a + v; break;
+                        case Opcode::SUB8: res = a - v; break;
+                        case Opcode::AND8: res = a & v; break;
+                        case Opcode::OR8:  res = a | v; break;
+                        case Opcode::XOR8: res = a ^ v; break;
+                        case Opcode::CP8:  res = a; break;
+                        default: break;  // Carry is not tracked
+                    }
+                }
+                // XOR A / SUB A clear A whatever its value
+                if ((instr.opcode == Opcode::XOR8 || instr.opcode == Opcode::SUB8) &&
+                    is_reg8(instr.src) && instr.src.value.reg8 == 7) {
+                    res = 0;
+                }
+                st.set_reg(7, res < 0 ? UNKNOWN : res & 0xFF);
+                break;
+            }
+            
+            case Opcode::INC8:
+            case Opcode::DEC8: {
+                int v = st.reg(instr.dst.value.reg8);
+                if (v >= 0) v = (v + (instr.opcode == Opcode::INC8 ? 1 : -1)) & 0xFF;
+                st.set_reg(instr.dst.value.reg8, v);
+                break;
+            }
+            
+            case Opcode::INC16:
+            case Opcode::DEC16: {
+                int v = st.pair(instr.dst.value.reg16);
+                if (v >= 0) v = (v + (instr.opcode == Opcode::INC16 ? 1 : -1)) & 0xFFFF;
+                st.set_pair(instr.dst.value.reg16, v);
+                if (instr.dst.value.reg16 == 3) st.stack.clear();
+                break;
+            }
+            
+            case Opcode::ADD16: {
+                int hl = st.pair(2), v = st.pair(instr.src.value.reg16);
+                st.set_pair(2, hl >= 0 && v >= 0 ? hl + v : UNKNOWN);
+                break;
+            }
+            
+            case Opcode::LD_HL_SP_N:
+                st.set_pair(2, st.sp >= 0 ? st.sp + instr.src.value.offset : UNKNOWN);
+                break;
+            
+            case Opcode::ADD_SP_IMM8:
+                st.set_pair(3, st.sp >= 0 ? st.sp + instr.src.value.offset : UNKNOWN);
+                st.stack.clear();
+                break;
+            
+            case Opcode::RLC:
+            case Opcode::RRC:
+            case Opcode::RL:
+            case Opcode::RR:
+            case Opcode::SLA:
+            case Opcode::SRA:
+            case Opcode::SRL:
+            case Opcode::SWAP:
+            case Opcode::SET:
+            case Opcode::RES:
+                st.set_reg(instr.dst.value.reg8, eval_cb(instr, st.reg(instr.dst.value.reg8)));
+                break;
+            
+            case Opcode::CPL:
+                st.set_reg(7, st.reg(7) >= 0 ? ~st.reg(7) : UNKNOWN);
+                break;
+            
+            case Opcode::DAA:
+                st.set_reg(7, UNKNOWN);
+                break;
+            
+            case Opcode::CALL:
+            case Opcode::CALL_CC:
+                // Direct calls into the switchable region after a constant
+                // bank write can be resolved to that bank's function
+                if (st.bank >= 0 && instr.dst.type == OperandType::IMM16 &&
+                    instr.dst.value.imm16 >= 0x4000 && instr.dst.value.imm16 < 0x8000 &&
+                    instr.extra.type == OperandType::NONE) {
+                    instr.extra = Operand::bank(static_cast<uint8_t>(st.bank));
+                    changed = true;
+                }
+                st.clear();
+                break;
+            
+            default:
+                // Returns, RST, JP (HL), HALT/STOP and anything unmodelled
+                st.clear();
+                break;
+        }
+    }
+    return changed;
+}
+
+} // namespace
+
 bool ConstantPropagation::run(Program& program) {
-    // Stub - no optimization performed in MVP
-    (void)program;
-    return false;
+    bool changed = false;
+    for (auto& [id, block] : program.blocks) {
+        changed |= propagate_block(block);
+    }
+    return changed;
+}
+
+/* ============================================================================
+ * Liveness
+ * ========================================================================== */
+
+// Anything that leaves the function may reach code that reads any register
+// or flag: callees, callers, interrupt returns and dispatch
+static bool leaves_function(const IRInstruction& instr) {
+    switch (instr.opcode) {
+        case Opcode::CALL:
+        case Opcode::CALL_CC:
+        case Opcode::RST:
+        case Opcode::RET:
+        case Opcode::RET_CC:
+        case Opcode::RETI:
+        case Opcode::JUMP_REG:
+        case Opcode::HALT:
+        case Opcode::STOP:
+        case Opcode::CROSS_BANK_CALL:
+        case Opcode::CROSS_BANK_JUMP:
+            return true;
+        case Opcode::JUMP:
+            return instr.dst.type == OperandType::REG16;  // JP (HL)
+        default:
+            return false;
+    }
+}
+
+// Flags an instruction reads before writing any
+static uint8_t flags_read(const IRInstruction& instr) {
+    if (leaves_function(instr)) return FLAG_ALL;
+    switch (instr.opcode) {
+        case Opcode::ADC8:
+        case Opcode::SBC8:
+        case Opcode::RL:
+        case Opcode::RR:
+        case Opcode::CCF:
+            return FLAG_C;
+        case Opcode::DAA:
+            return FLAG_N | FLAG_H | FLAG_C;
+        case Opcode::JUMP_CC:
+        case Opcode::JR_CC:
+            return instr.src.value.condition < 2 ? FLAG_Z : FLAG_C;
+        case Opcode::PUSH16:
+            return instr.dst.value.reg16 == 4 ? FLAG_ALL : 0;  // PUSH AF
+        default:
+            return 0;
+    }
+}
+
+static bool is_branch(Opcode op) {
+    return op == Opcode::JUMP || op == Opcode::JUMP_CC ||
+           op == Opcode::JR || op == Opcode::JR_CC;
+}
+
+/**
+ * Backward dataflow over one function's blocks to a fixed point.
+ * transfer(block, live_out, annotate) returns the block's live-in set and
+ * is called once more with annotate set after convergence. Exits that
+ * leave the function see exit_live.
+ */
+template <typename Transfer>
+static void solve_backward(Program& program, const Function& func,
+                           uint32_t exit_live, Transfer transfer) {
+    std::map<uint32_t, uint32_t> live_in;
+    auto live_out = [&](const BasicBlock& block) {
+        uint32_t live = block.has_external_exit ? exit_live : 0;
+        for (uint32_t succ : block.successors) {
+            auto it = live_in.find(succ);
+            if (it != live_in.end()) live |= it->second;
+        }
+        return live;
+    };
+    
+    // Live sets only grow; visiting in reverse order converges quickly
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (auto it = func.block_ids.rbegin(); it != func.block_ids.rend(); ++it) {
+            auto block_it = program.blocks.find(*it);
+            if (block_it == program.blocks.end()) continue;
+            uint32_t in = transfer(block_it->second, live_out(block_it->second), false);
+            uint32_t& slot = live_in[*it];
+            if (in != slot) {
+                slot = in;
+                progress = true;
+            }
+        }
+    }
+    
+    for (uint32_t id : func.block_ids) {
+        auto block_it = program.blocks.find(id);
+        if (block_it == program.blocks.end()) continue;
+        transfer(block_it->second, live_out(block_it->second), true);
+    }
+}
+
+/* ============================================================================
+ * Dead Code Elimination
+ * ========================================================================== */
+
+namespace {
+
+// Liveness bits: reg8 index for B-L and A, SP in the unused (HL) slot,
+// flags above them
+constexpr uint32_t LIVE_SP = 1u << 6;
+constexpr uint32_t LIVE_FLAGS = static_cast<uint32_t>(FLAG_ALL) << 8;
+constexpr uint32_t LIVE_ALL = 0xBF | LIVE_SP | LIVE_FLAGS;
+
+// Register read or written by an 8-bit operand; (HL) reads H and L
+uint32_t reg8_bits(uint8_t idx, bool as_use) {
+    if (idx == 6) return as_use ? (1u << 4) | (1u << 5) : 0;
+    return idx < 8 ? 1u << idx : 0;
+}
+
+uint32_t reg16_bits(uint8_t idx) {
+    switch (idx) {
+        case 0: return 0x03;                    // BC
+        case 1: return 0x0C;                    // DE
+        case 2: return 0x30;                    // HL
+        case 3: return LIVE_SP;
+        case 4: return (1u << 7) | LIVE_FLAGS;  // AF
+        default: return 0;
+    }
+}
+
+uint32_t operand_use(const Operand& op) {
+    if (op.type == OperandType::REG8) return reg8_bits(op.value.reg8, true);
+    if (op.type == OperandType::REG16) return reg16_bits(op.value.reg16);
+    return 0;
+}
+
+// Registers and flags an instruction reads and writes
+void reg_effects(const IRInstruction& instr, uint32_t& use, uint32_t& def) {
+    use = static_cast<uint32_t>(flags_read(instr)) << 8;
+    def = static_cast<uint32_t>(instr.flags.mask()) << 8;
+    if (leaves_function(instr)) {
+        use = LIVE_ALL;
+        return;
+    }
+    
+    const uint32_t A = 1u << 7, C = 1u << 1, HL = 0x30;
+    switch (instr.opcode) {
+        case Opcode::MOV_REG_REG:
+            use |= reg8_bits(instr.src.value.reg8, true);
+            def |= reg8_bits(instr.dst.value.reg8, false);
+            break;
+        case Opcode::MOV_REG_IMM8:
+            def |= reg8_bits(instr.dst.value.reg8, false);
+            break;
+        case Opcode::MOV_REG_IMM16:
+            def |= reg16_bits(instr.dst.value.reg16);
+            break;
+        case Opcode::MOV_REG_REG16:
+            use |= reg16_bits(instr.src.value.reg16);
+            def |= reg16_bits(instr.dst.value.reg16);
+            break;
+        case Opcode::LD_HL_SP_N:
+            use |= LIVE_SP;
+            def |= HL;
+            break;
+        case Opcode::LOAD8:
+            use |= instr.src.type == OperandType::REG8 ? C : operand_use(instr.src);
+            def |= reg8_bits(instr.dst.value.reg8, false);
+            break;
+        case Opcode::STORE8:
+            use |= instr.dst.type == OperandType::REG8 ? C : operand_use(instr.dst);
+            use |= operand_use(instr.src);
+            break;
+        case Opcode::STORE16:
+            use |= operand_use(instr.src);
+            break;
+        case Opcode::PUSH16:
+            use |= reg16_bits(instr.dst.value.reg16) | LIVE_SP;
+            def |= LIVE_SP;
+            break;
+        case Opcode::POP16:
+            use |= LIVE_SP;
+            def |= reg16_bits(instr.dst.value.reg16) | LIVE_SP;
+            break;
+        case Opcode::ADD8:
+        case Opcode::ADC8:
+        case Opcode::SUB8:
+        case Opcode::SBC8:
+        case Opcode::AND8:
+        case Opcode::OR8:
+        case Opcode::XOR8:
+            def |= A;
+            [[fallthrough]];
+        case Opcode::CP8:
+            use |= A | operand_use(instr.src);
+            break;
+        case Opcode::INC8:
+        case Opcode::DEC8:
+        case Opcode::RLC:
+        case Opcode::RRC:
+        case Opcode::RL:
+        case Opcode::RR:
+        case Opcode::SLA:
+        case Opcode::SRA:
+        case Opcode::SRL:
+        case Opcode::SWAP:
+        case Opcode::SET:
+        case Opcode::RES:
+            use |= reg8_bits(instr.dst.value.reg8, true);
+            def |= reg8_bits(instr.dst.value.reg8, false);
+            break;
+        case Opcode::BIT:
+            use |= reg8_bits(instr.dst.value.reg8, true);
+            break;
+        case Opcode::ADD16:
+            use |= HL | operand_use(instr.src);
+            def |= HL;
+            break;
+        case Opcode::ADD_SP_IMM8:
+            use |= LIVE_SP;
+            def |= LIVE_SP;
+            break;
+        case Opcode::INC16:
+        case Opcode::DEC16:
+            use |= reg16_bits(instr.dst.value.reg16);
+            def |= reg16_bits(instr.dst.value.reg16);
+            break;
+        case Opcode::DAA:
+        case Opcode::CPL:
+            use |= A;
+            def |= A;
+            break;
+        case Opcode::IO_READ:
+            def |= A;
+            break;
+        case Opcode::IO_READ_C:
+            use |= C;
+            def |= A;
+            break;
+        case Opcode::IO_WRITE:
+            use |= A;
+            break;
+        case Opcode::IO_WRITE_C:
+            use |= A | C;
+            break;
+        case Opcode::BLOCK_COPY:
+        case Opcode::BLOCK_FILL:
+            use |= operand_use(instr.dst) | operand_use(instr.src) | operand_use(instr.extra);
+            def |= operand_use(instr.dst) | operand_use(instr.extra) | A;
+            if (instr.opcode == Opcode::BLOCK_COPY) def |= operand_use(instr.src);
+            break;
+        case Opcode::WAIT_LY:
+            def |= A;
+            break;
+        default:
+            break;
+    }
+}
+
+// Whether an instruction does nothing besides writing registers and flags
+bool is_pure(const IRInstruction& instr) {
+    switch (instr.opcode) {
+        case Opcode::MOV_REG_REG:
+        case Opcode::MOV_REG_IMM8:
+        case Opcode::MOV_REG_IMM16:
+        case Opcode::MOV_REG_REG16:
+        case Opcode::LD_HL_SP_N:
+        case Opcode::INC16:
+        case Opcode::DEC16:
+        case Opcode::ADD16:
+        case Opcode::DAA:
+        case Opcode::CPL:
+        case Opcode::SCF:
+        case Opcode::CCF:
+            return true;
+        case Opcode::ADD8:
+        case Opcode::ADC8:
+        case Opcode::SUB8:
+        case Opcode::SBC8:
+        case Opcode::AND8:
+        case Opcode::OR8:
+        case Opcode::XOR8:
+        case Opcode::CP8:
+            return !(instr.src.type == OperandType::REG8 && instr.src.value.reg8 == 6);
+        case Opcode::INC8:
+        case Opcode::DEC8:
+        case Opcode::RLC:
+        case Opcode::RRC:
+        case Opcode::RL:
+        case Opcode::RR:
+        case Opcode::SLA:
+        case Opcode::SRA:
+        case Opcode::SRL:
+        case Opcode::SWAP:
+        case Opcode::SET:
+        case Opcode::RES:
+        case Opcode::BIT:
+            return instr.dst.value.reg8 != 6;
+        case Opcode::LOAD8: {
+            // Constant-address reads outside I/O have no side effects
+            if (instr.src.type != OperandType::IMM16) return false;
+            uint16_t addr = instr.src.value.imm16;
+            return addr < 0xFF00 || (addr >= 0xFF80 && addr != 0xFFFF);
+        }
+        default:
+            return false;
+    }
 }
 
+} // namespace
+
 bool DeadCodeElimination::run(Program& program) {
-    // Stub - no optimization performed in MVP
-    (void)program;
-    return false;
+    bool changed = false;
+    
+    for (const auto& [name, func] : program.functions) {
+        solve_backward(program, func, LIVE_ALL,
+            [&changed](BasicBlock& block, uint32_t live, bool annotate) {
+                bool terminator = true;
+                for (auto it = block.instructions.rbegin(); it != block.instructions.rend(); ++it) {
+                    IRInstruction& instr = *it;
+                    if (instr.opcode == Opcode::NOP) continue;
+                    if (!terminator && is_branch(instr.opcode)) live = LIVE_ALL;
+                    terminator = false;
+                    uint32_t use, def;
+                    reg_effects(instr, use, def);
+                    if (def != 0 && (def & live) == 0 && is_pure(instr)) {
+                        // Keep the cycles, drop the work
+                        if (annotate) {
+                            instr.opcode = Opcode::NOP;
+                            instr.flags = FlagEffects::none();
+                            changed = true;
+                        }
+                        continue;
+                    }
+                    live = (live & ~def) | use;
+                }
+                return live;
+            });
+    }
+    
+    return changed;
 }
 
 bool UnreachableBlockElimination::run(Program& program) {
@@ -30,10 +686,71 @@ bool UnreachableBlockElimination::run(Program& program) {
     return false;
 }
 
+/* ============================================================================
+ * Flag Elimination
+ * ========================================================================== */
+
 bool FlagElimination::run(Program& program) {
-    // Stub - no optimization performed in MVP
-    (void)program;
-    return false;
+    bool changed = false;
+    
+    for (const auto& [name, func] : program.functions) {
+        solve_backward(program, func, FLAG_ALL,
+            [&changed](BasicBlock& block, uint32_t live, bool annotate) {
+                bool terminator = true;
+                for (auto it = block.instructions.rbegin(); it != block.instructions.rend(); ++it) {
+                    IRInstruction& instr = *it;
+                    if (instr.opcode == Opcode::NOP) continue;
+                    // A branch in the middle of a block is not modelled
+                    if (!terminator && is_branch(instr.opcode)) live = FLAG_ALL;
+                    terminator = false;
+                    if (annotate) {
+                        instr.live_flags = static_cast<uint8_t>(live);
+                        if (instr.flags.mask() & ~live) changed = true;
+                    }
+                    live = (live & ~instr.flags.mask()) | flags_read(instr);
+                }
+                return live;
+            });
+    }
+    
+    return changed;
+}
+
+/* ============================================================================
+ * Live Masks
+ * ========================================================================== */
+
+void record_live_masks(Program& program) {
+    program.live_masks.clear();
+    
+    for (const auto& [name, func] : program.functions) {
+        solve_backward(program, func, LIVE_ALL,
+            [&program](BasicBlock& block, uint32_t live, bool annotate) {
+                bool terminator = true;
+                for (size_t i = block.instructions.size(); i-- > 0;) {
+                    const IRInstruction& instr = block.instructions[i];
+                    if (instr.opcode != Opcode::NOP) {
+                        if (!terminator && is_branch(instr.opcode)) live = LIVE_ALL;
+                        terminator = false;
+                        uint32_t use, def;
+                        reg_effects(instr, use, def);
+                        live = (live & ~def) | use;
+                    }
+                    // Only the first IR instruction of a source instruction
+                    // starts it, which is where execution can stop
+                    if (!annotate || (i > 0 && block.instructions[i - 1].source_address == instr.source_address)) {
+                        continue;
+                    }
+                    uint16_t addr = instr.source_address;
+                    uint32_t key = (addr < 0x4000 ? 0u : static_cast<uint32_t>(block.bank)) << 16 | addr;
+                    auto [it, inserted] = program.live_masks.try_emplace(key, static_cast<uint16_t>(live));
+                    if (!inserted) it->second &= static_cast<uint16_t>(live);
+                }
+                return live;
+            });
+    }
+    
+    std::erase_if(program.live_masks, [](const auto& entry) { return entry.second == LIVE_ALL; });
 }
 
 /* ============================================================================
@@ -49,20 +766,23 @@ int optimize(Program& program, OptLevel level) {
     
     // O1: Basic optimizations
     if (level >= OptLevel::O1) {
-        ConstantPropagation cp;
-        if (cp.run(program)) changes++;
-        
+        // Before propagation, so it sees the source program's uses: code
+        // stopped at a poll resumes there through the interpreter, which
+        // reads registers that folded instructions no longer do
         DeadCodeElimination dce;
         if (dce.run(program)) changes++;
         
+        ConstantPropagation cp;
+        if (cp.run(program)) changes++;
+        
         UnreachableBlockElimination ube;
         if (ube.run(program)) changes++;
-    }
-    
-    // O2: More aggressive
-    if (level >= OptLevel::O2) {
+        
+        // Runs last so it sees the final instruction stream
         FlagElimination fe;
         if (fe.run(program)) changes++;
+        
+        record_live_masks(program);
     }
     
     return changes;
@@ -8,7 +8,9 @@
 #include "recompiler/analyzer.h"
 #include "recompiler/ir/ir.h"
 #include "recompiler/ir/ir_builder.h"
+#include "recompiler/ir/ir_optimizer.h"
 #include "recompiler/codegen/c_emitter.h"
+#include "recompiler/profile.h"
 
 #include <iostream>
 #include <string>
@@ -17,6 +19,7 @@
 #include <vector>
 #include <algorithm>
 #include <filesystem>
+#include <fstream>
 
 namespace fs = std::filesystem;
 
@@ -45,6 +48,24 @@ void print_usage(const char* program) {
     std::cout << "  --single-function     Generate all code in a single function\n";
     std::cout << "  --no-comments         Don't include disassembly comments\n";
     std::cout << "  --bank <n>            Only process bank n\n";
+    std::cout << "  -j, --jobs <n>        Worker threads for analysis and codegen (default: all cores)\n";
+    std::cout << "  --shard-size <KiB>    Split generated code into files of about this size (default: 1024, 0 = one file)\n";
+    std::cout << "  --shard-by-bank       Also start a new code file at every ROM bank\n";
+    std::cout << "  --rom-embed <mode>    ROM image: array (default), incbin, embed or external (mapped at startup)\n";
+    std::cout << "  --no-cache            Ignore the analysis cache and rewrite every output file\n";
+    std::cout << "  --timing <mode>       Cycle accounting: instruction (default) or block\n";
+    std::cout << "  -O0, -O1, -O2         IR optimization level (default: -O1)\n";
+    std::cout << "  --cache-registers     Keep CPU registers in C locals in generated functions\n";
+    std::cout << "  --superblock <n>      IR instructions a function may inline from jump targets (default: 256, 0 = off)\n";
+    std::cout << "  --opt-size            Compile code not found hot by --profile for size (runtime helpers\n";
+    std::cout << "                        for repeated sequences); cold profiled code always is\n";
+    std::cout << "  --soa                 Also emit lane kernels of simple blocks for grouped batches\n";
+    std::cout << "                        (<prefix>_soa_kernels, see batch.h)\n";
+    std::cout << "  --entry-points <file> Also analyze the bank:addr entry points listed in file\n";
+    std::cout << "  --profile <file>      Use a runtime profile (GBRT_HOTSPOTS build, --profile) to add\n";
+    std::cout << "                        interpreted code and lay out and speed up hot functions\n";
+    std::cout << "  --symbol-map          Write <rom>.symbols.json mapping generated C lines to bank:address\n";
+    std::cout << "  --line-directives     Attribute generated code to a disassembly listing (<rom>.lst) with #line\n";
     std::cout << "  -h, --help            Show this help\n";
 }
 
@@ -61,6 +82,47 @@ std::string sanitize_prefix(const std::string& name) {
     return result;
 }
 
+/**
+ * @brief Read an entry points file: one hex "bank:addr" (or "addr") per line, # comments
+ * @return false if the file cannot be read or a line does not parse
+ */
+bool load_entry_points(const std::string& path, std::vector<uint32_t>& out) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error: Cannot read entry points file " << path << "\n";
+        return false;
+    }
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++) {
+        line = line.substr(0, line.find('#'));
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos) continue;
+        size_t end = line.find_last_not_of(" \t\r");
+        std::string text = line.substr(start, end - start + 1);
+
+        size_t colon = text.find(':');
+        unsigned long bank = 0, addr = 0;
+        try {
+            size_t used = 0;
+            if (colon != std::string::npos) {
+                bank = std::stoul(text.substr(0, colon), &used, 16);
+                if (used != colon) throw std::invalid_argument(text);
+            }
+            std::string offset = text.substr(colon == std::string::npos ? 0 : colon + 1);
+            addr = std::stoul(offset, &used, 16);
+            if (used != offset.size()) throw std::invalid_argument(text);
+        } catch (const std::exception&) {
+            bank = 0x100;
+        }
+        if (bank > 0xFF || addr > 0xFFFF) {
+            std::cerr << "Error: " << path << ":" << number << ": expected bank:addr, got \"" << text << "\"\n";
+            return false;
+        }
+        out.push_back(gbrecomp::AnalysisResult::make_addr(static_cast<uint8_t>(bank), static_cast<uint16_t>(addr)));
+    }
+    return true;
+}
+
 int main(int argc, char* argv[]) {
     // Parse command line
     if (argc < 2) {
@@ -79,6 +141,21 @@ int main(int argc, char* argv[]) {
     bool single_function = false;
     bool emit_comments = true;
     int specific_bank = -1;
+    auto timing_mode = gbrecomp::codegen::TimingMode::Instruction;
+    auto opt_level = gbrecomp::ir::OptLevel::O1;
+    bool cache_registers = false;
+    bool opt_size = false;
+    bool soa_kernels = false;
+    size_t superblock_budget = 256;
+    unsigned jobs = 0;
+    size_t shard_kib = 1024;
+    bool shard_by_bank = false;
+    bool use_cache = true;
+    auto rom_embed = gbrecomp::codegen::RomEmbed::Array;
+    std::vector<std::string> entry_point_files;
+    std::string profile_path;
+    bool symbol_map = false;
+    bool line_directives = false;
     
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -110,6 +187,80 @@ int main(int argc, char* argv[]) {
             if (i + 1 < argc) {
                 specific_bank = std::stoi(argv[++i]);
             }
+        } else if (arg == "-j" || arg == "--jobs") {
+            if (i + 1 < argc) {
+                jobs = static_cast<unsigned>(std::stoul(argv[++i]));
+            }
+        } else if (arg == "--shard-size") {
+            if (i + 1 < argc) {
+                shard_kib = std::stoul(argv[++i]);
+            }
+        } else if (arg == "--shard-by-bank") {
+            shard_by_bank = true;
+        } else if (arg == "--symbol-map") {
+            symbol_map = true;
+        } else if (arg == "--line-directives") {
+            line_directives = true;
+        } else if (arg == "--rom-embed" || arg.rfind("--rom-embed=", 0) == 0) {
+            std::string mode;
+            if (arg.size() > 11) {
+                mode = arg.substr(12);
+            } else if (i + 1 < argc) {
+                mode = argv[++i];
+            }
+            if (mode == "array") {
+                rom_embed = gbrecomp::codegen::RomEmbed::Array;
+            } else if (mode == "incbin") {
+                rom_embed = gbrecomp::codegen::RomEmbed::Incbin;
+            } else if (mode == "embed") {
+                rom_embed = gbrecomp::codegen::RomEmbed::Embed;
+            } else if (mode == "external") {
+                rom_embed = gbrecomp::codegen::RomEmbed::External;
+            } else {
+                std::cerr << "Unknown ROM embed mode: " << mode << "\n";
+                return 1;
+            }
+        } else if (arg == "--no-cache") {
+            use_cache = false;
+        } else if (arg == "--timing" || arg.rfind("--timing=", 0) == 0) {
+            std::string mode;
+            if (arg.size() > 8) {
+                mode = arg.substr(9);
+            } else if (i + 1 < argc) {
+                mode = argv[++i];
+            }
+            if (mode == "block") {
+                timing_mode = gbrecomp::codegen::TimingMode::Block;
+            } else if (mode == "instruction") {
+                timing_mode = gbrecomp::codegen::TimingMode::Instruction;
+            } else {
+                std::cerr << "Unknown timing mode: " << mode << "\n";
+                return 1;
+            }
+        } else if (arg == "-O0") {
+            opt_level = gbrecomp::ir::OptLevel::O0;
+        } else if (arg == "-O1") {
+            opt_level = gbrecomp::ir::OptLevel::O1;
+        } else if (arg == "-O2") {
+            opt_level = gbrecomp::ir::OptLevel::O2;
+        } else if (arg == "--cache-registers") {
+            cache_registers = true;
+        } else if (arg == "--opt-size") {
+            opt_size = true;
+        } else if (arg == "--soa") {
+            soa_kernels = true;
+        } else if (arg == "--superblock") {
+            if (i + 1 < argc) {
+                superblock_budget = std::stoul(argv[++i]);
+            }
+        } else if (arg == "--entry-points") {
+            if (i + 1 < argc) {
+                entry_point_files.push_back(argv[++i]);
+            }
+        } else if (arg == "--profile") {
+            if (i + 1 < argc) {
+                profile_path = argv[++i];
+            }
         } else if (arg[0] != '-') {
             rom_path = arg;
         } else {
@@ -171,30 +322,48 @@ int main(int argc, char* argv[]) {
     gbrecomp::AnalyzerOptions analyze_opts;
     analyze_opts.trace_log = trace_log;
     analyze_opts.max_instructions = limit_instructions;
+    analyze_opts.jobs = jobs;
+    for (const auto& path : entry_point_files) {
+        if (!load_entry_points(path, analyze_opts.entry_points)) return 1;
+    }
+    std::optional<gbrecomp::RuntimeProfile> profile;
+    if (!profile_path.empty()) {
+        std::string error;
+        profile = gbrecomp::load_profile(profile_path, error);
+        if (!profile) {
+            std::cerr << "Error: " << error << "\n";
+            return 1;
+        }
+        gbrecomp::add_profile_hints(*profile, analyze_opts);
+    }
+    if (!analyze_opts.entry_points.empty() || !analyze_opts.jump_targets.empty()) {
+        std::cout << "Using " << analyze_opts.entry_points.size() << " extra entry points";
+        if (!analyze_opts.jump_targets.empty()) std::cout << ", " << analyze_opts.jump_targets.size() << " jump targets";
+        std::cout << "\n";
+    }
 
     // Detect standard HRAM DMA routine
-    // Routine: LDH (46),A; LD A,28; DEC A; JR NZ,-3; RET
-    const std::vector<uint8_t> pattern = {0xE0, 0x46, 0x3E, 0x28, 0x3D, 0x20, 0xFD, 0xC9};
-    const std::vector<uint8_t>& data = rom.bytes();
-    
-    auto it = std::search(data.begin(), data.end(), pattern.begin(), pattern.end());
-    if (it != data.end()) {
-            size_t rom_idx = std::distance(data.begin(), it);
-            uint8_t bank = rom_idx / 0x4000;
-            uint16_t offset = rom_idx % 0x4000;
-            if (bank > 0) offset += 0x4000;
-        
-            std::cout << "Detected OAM DMA routine at ROM 0x" << std::hex << rom_idx 
-                        << " (Bank " << (int)bank << ":0x" << offset << "). Mapping to HRAM 0xFF80.\n" << std::dec;
-            
-            gbrecomp::AnalyzerOptions::RamOverlay overlay;
-            overlay.ram_addr = 0xFF80;
-            overlay.rom_addr = gbrecomp::AnalysisResult::make_addr(bank, offset);
-            overlay.size = 8;
-            analyze_opts.ram_overlays.push_back(overlay);
+    if (auto overlay = gbrecomp::find_oam_dma_routine(rom)) {
+        std::cout << "Detected OAM DMA routine at bank " << (overlay->rom_addr >> 16) << ":0x"
+                  << std::hex << (overlay->rom_addr & 0xFFFF) << ". Mapping to HRAM 0xFF80.\n" << std::dec;
+        analyze_opts.ram_overlays.push_back(*overlay);
     }
 
-    auto analysis = gbrecomp::analyze(rom, analyze_opts);
+    // Reuse the previous run's analysis when the ROM and hints are unchanged.
+    // Tracing and limits want a real exploration, so they bypass the cache.
+    fs::path out_path = output_dir;
+    fs::path cache_path = out_path / "gbrecomp.analysis";
+    bool cacheable = use_cache && !trace_log && limit_instructions == 0;
+    uint64_t cache_key = gbrecomp::analysis_cache_key(rom, analyze_opts);
+    
+    std::optional<gbrecomp::AnalysisResult> cached;
+    if (cacheable) {
+        cached = gbrecomp::load_analysis(rom, analyze_opts, cache_path.string(), cache_key);
+    }
+    if (cached) {
+        std::cout << "  Loaded analysis cache " << cache_path << "\n";
+    }
+    auto analysis = cached ? std::move(*cached) : gbrecomp::analyze(rom, analyze_opts);
     
     std::cout << "  Found " << analysis.stats.total_functions << " functions\n";
     std::cout << "  Found " << analysis.stats.total_blocks << " basic blocks\n";
@@ -213,6 +382,7 @@ int main(int argc, char* argv[]) {
     
     gbrecomp::ir::BuilderOptions ir_opts;
     ir_opts.emit_comments = emit_comments;
+    ir_opts.recognize_idioms = opt_level != gbrecomp::ir::OptLevel::O0;
     
     gbrecomp::ir::IRBuilder builder(ir_opts);
     auto ir_program = builder.build(analysis, rom.name());
@@ -220,6 +390,13 @@ int main(int argc, char* argv[]) {
     std::cout << "  " << ir_program.blocks.size() << " IR blocks\n";
     std::cout << "  " << ir_program.functions.size() << " IR functions\n";
     
+    if (profile) {
+        auto stats = gbrecomp::apply_profile(*profile, ir_program);
+        std::cout << "  Profile: " << stats.hot << " hot, " << stats.cold << " cold functions\n";
+    }
+    
+    gbrecomp::ir::optimize(ir_program, opt_level);
+    
     // Generate code
     std::cout << "\nGenerating C code...\n";
     
@@ -228,31 +405,67 @@ int main(int argc, char* argv[]) {
     gen_opts.output_dir = output_dir;
     gen_opts.emit_comments = emit_comments;
     gen_opts.single_function_mode = single_function;
+    gen_opts.timing_mode = timing_mode;
+    gen_opts.cache_registers = cache_registers;
+    gen_opts.opt_size = opt_size;
+    gen_opts.soa_kernels = soa_kernels;
+    gen_opts.superblock_budget = superblock_budget;
+    gen_opts.shard_bytes = shard_kib * 1024;
+    gen_opts.shard_by_bank = shard_by_bank;
+    gen_opts.jobs = jobs;
+    gen_opts.rom_embed = rom_embed;
+    gen_opts.ram_overlays = analyze_opts.ram_overlays;
+    gen_opts.emit_symbol_map = symbol_map;
+    gen_opts.emit_line_directives = line_directives;
     
     auto output = gbrecomp::codegen::generate_output(
         ir_program, rom.data(), rom.size(), gen_opts);
     
     // Create output directory
-    fs::path out_path = output_dir;
     if (!fs::exists(out_path)) {
         std::cout << "Creating output directory: " << out_path << "\n";
         fs::create_directories(out_path);
     }
     
+    if (cacheable && !cached && !gbrecomp::save_analysis(analysis, cache_path.string(), cache_key)) {
+        std::cerr << "Warning: Failed to write analysis cache " << cache_path << "\n";
+    }
+    
     // Write output files
-    if (!gbrecomp::codegen::write_output(output, output_dir)) {
+    gbrecomp::codegen::WriteStats write_stats;
+    if (!gbrecomp::codegen::write_output(output, output_dir, &write_stats, use_cache)) {
         std::cerr << "Error: Failed to write output files\n";
         return 1;
     }
+    std::cout << "  " << write_stats.functions_changed << " functions changed, "
+              << write_stats.files_written << " files written, "
+              << write_stats.files_unchanged << " unchanged";
+    if (write_stats.files_removed) {
+        std::cout << ", " << write_stats.files_removed << " stale removed";
+    }
+    std::cout << "\n";
     
     std::cout << "\nGenerated files:\n";
     std::cout << "  " << (out_path / output.header_file) << "\n";
+    std::cout << "  " << (out_path / output.internal_header_file) << "\n";
     std::cout << "  " << (out_path / output.source_file) << "\n";
+    for (const auto& file : output.code_files) {
+        std::cout << "  " << (out_path / file.name) << "\n";
+    }
     std::cout << "  " << (out_path / output.main_file) << "\n";
     std::cout << "  " << (out_path / output.cmake_file) << "\n";
     if (!output.rom_data_file.empty()) {
         std::cout << "  " << (out_path / output.rom_data_file) << "\n";
     }
+    if (!output.rom_image_file.empty()) {
+        std::cout << "  " << (out_path / output.rom_image_file) << "\n";
+    }
+    if (!output.symbol_map_file.empty()) {
+        std::cout << "  " << (out_path / output.symbol_map_file) << "\n";
+    }
+    if (!output.listing_file.empty()) {
+        std::cout << "  " << (out_path / output.listing_file) << "\n";
+    }
     
     std::cout << "\nBuild instructions:\n";
     std::cout << "  cd " << out_path << "\n";
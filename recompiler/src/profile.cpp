@@ -0,0 +1,238 @@
+/**
+ * @file profile.cpp
+ * @brief Runtime profile loading and hot/cold function marking
+ */
+
+#include "recompiler/profile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+namespace gbrecomp {
+
+/* ============================================================================
+ * JSON Reader
+ * ========================================================================== */
+
+namespace {
+
+/**
+ * @brief Just enough JSON for the profile: objects, arrays, strings and
+ * non-negative integers. Fields the reader does not know are skipped.
+ */
+class JsonReader {
+public:
+    explicit JsonReader(std::string text) : text_(std::move(text)) {}
+
+    bool failed() const { return !error_.empty(); }
+    const std::string& error() const { return error_; }
+
+    bool consume(char c) {
+        skip_space();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!consume(c)) fail(std::string("expected '") + c + "'");
+    }
+
+    std::string string() {
+        expect('"');
+        std::string out;
+        while (!failed() && pos_ < text_.size() && text_[pos_] != '"') {
+            if (text_[pos_] == '\\' && pos_ + 1 < text_.size()) pos_++;
+            out += text_[pos_++];
+        }
+        expect('"');
+        return out;
+    }
+
+    uint64_t number() {
+        skip_space();
+        if (pos_ >= text_.size() || !std::isdigit(static_cast<unsigned char>(text_[pos_]))) {
+            fail("expected a number");
+            return 0;
+        }
+        uint64_t value = 0;
+        while (pos_ < text_.size() && std::isdigit(static_cast<unsigned char>(text_[pos_]))) {
+            value = value * 10 + static_cast<uint64_t>(text_[pos_++] - '0');
+        }
+        return value;
+    }
+
+    // Skip any value
+    void skip() {
+        skip_space();
+        if (pos_ >= text_.size()) return fail("unexpected end");
+        char c = text_[pos_];
+        if (c == '"') {
+            string();
+        } else if (c == '{' || c == '[') {
+            char close = c == '{' ? '}' : ']';
+            pos_++;
+            if (consume(close)) return;
+            do {
+                if (c == '{') {
+                    string();
+                    expect(':');
+                }
+                skip();
+            } while (!failed() && consume(','));
+            expect(close);
+        } else {
+            while (pos_ < text_.size() && (std::isalnum(static_cast<unsigned char>(text_[pos_])) ||
+                                           text_[pos_] == '-' || text_[pos_] == '+' || text_[pos_] == '.')) {
+                pos_++;
+            }
+        }
+    }
+
+    void fail(const std::string& what) {
+        if (error_.empty()) error_ = what + " at offset " + std::to_string(pos_);
+    }
+
+private:
+    void skip_space() {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) pos_++;
+    }
+
+    std::string text_;
+    size_t pos_ = 0;
+    std::string error_;
+};
+
+// Calls f(key) for each member of an object; f reads the value
+template <typename F>
+void read_object(JsonReader& in, F&& f) {
+    in.expect('{');
+    if (in.failed() || in.consume('}')) return;
+    do {
+        std::string key = in.string();
+        in.expect(':');
+        if (in.failed()) return;
+        f(key);
+    } while (!in.failed() && in.consume(','));
+    in.expect('}');
+}
+
+} // namespace
+
+/* ============================================================================
+ * Profiles
+ * ========================================================================== */
+
+std::optional<RuntimeProfile> load_profile(const std::string& path, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot read " + path;
+        return std::nullopt;
+    }
+    std::ostringstream text;
+    text << file.rdbuf();
+
+    JsonReader in(text.str());
+    RuntimeProfile profile;
+    std::string format;
+    uint64_t version = 0;
+    read_object(in, [&](const std::string& key) {
+        if (key == "format") {
+            format = in.string();
+        } else if (key == "version") {
+            version = in.number();
+        } else if (key == "sites") {
+            in.expect('[');
+            if (in.failed() || in.consume(']')) return;
+            do {
+                RuntimeProfile::Site site;
+                uint64_t bank = 0, addr = 0;
+                read_object(in, [&](const std::string& field) {
+                    if (field == "bank") bank = in.number();
+                    else if (field == "addr") addr = in.number();
+                    else if (field == "calls") site.calls = in.number();
+                    else if (field == "fallbacks") site.fallbacks = in.number();
+                    else if (field == "instructions") site.instructions = in.number();
+                    else if (field == "jumps") site.jumps = in.number();
+                    else in.skip();
+                });
+                if (bank > 0xFF || addr > 0xFFFF) in.fail("site out of range");
+                site.bank = static_cast<uint8_t>(bank);
+                site.addr = static_cast<uint16_t>(addr);
+                profile.sites.push_back(site);
+            } while (!in.failed() && in.consume(','));
+            in.expect(']');
+        } else {
+            in.skip();
+        }
+    });
+
+    if (in.failed()) {
+        error = path + ": " + in.error();
+        return std::nullopt;
+    }
+    if (format != "gbrt-profile" || version != 1) {
+        error = path + ": not a version 1 gbrt-profile";
+        return std::nullopt;
+    }
+    return profile;
+}
+
+void add_profile_hints(const RuntimeProfile& profile, AnalyzerOptions& options) {
+    for (const auto& site : profile.sites) {
+        if (site.addr >= 0x8000) continue;
+        uint32_t addr = AnalysisResult::make_addr(site.bank, site.addr);
+        if (site.fallbacks) options.entry_points.push_back(addr);
+        if (site.jumps) options.jump_targets.push_back(addr);
+    }
+}
+
+ProfileStats apply_profile(const RuntimeProfile& profile, ir::Program& program, double hot_share) {
+    std::map<uint32_t, ir::Function*> by_entry;
+    for (auto& [name, func] : program.functions) {
+        by_entry[AnalysisResult::make_addr(func.bank, func.entry_address)] = &func;
+    }
+
+    std::map<ir::Function*, uint64_t> weights;
+    uint64_t total = 0;
+    for (const auto& site : profile.sites) {
+        auto it = by_entry.find(AnalysisResult::make_addr(site.bank, site.addr));
+        if (it == by_entry.end()) continue;
+        uint64_t weight = site.calls + site.instructions;
+        weights[it->second] += weight;
+        total += weight;
+    }
+
+    // Ties keep name order, so the hot set does not depend on pointer values
+    std::vector<std::pair<uint64_t, ir::Function*>> ranked;
+    for (auto& [name, func] : program.functions) {
+        auto it = weights.find(&func);
+        if (it != weights.end() && it->second) ranked.push_back({it->second, &func});
+    }
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    ProfileStats stats;
+    uint64_t covered = 0;
+    for (const auto& [weight, func] : ranked) {
+        if (covered >= hot_share * static_cast<double>(total)) break;
+        func->hot = true;
+        covered += weight;
+        stats.hot++;
+    }
+    for (auto& [name, func] : program.functions) {
+        auto it = weights.find(&func);
+        if (it == weights.end() || it->second == 0) {
+            func.cold = true;
+            stats.cold++;
+        }
+    }
+    return stats;
+}
+
+} // namespace gbrecomp
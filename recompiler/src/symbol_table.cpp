@@ -8,6 +8,7 @@
 #include <unordered_map>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 
 namespace gbrecomp {
 
@@ -0,0 +1,316 @@
+/**
+ * @file gbrt_bench.c
+ * @brief Headless benchmark for a recompiled ROM
+ *
+ * Runs the game for a number of frames without a window, optionally driven
+ * by an input movie (movie.h), and prints throughput as JSON. Built by the
+ * generated project when configured with -DGBRT_BENCH=ON, which defines
+ * GBRT_BENCH_INIT as its <prefix>_init and GBRT_BENCH_NAME as the ROM name;
+ * configure with -DGBRT_PROFILE=1 as well to get the time split, and with
+ * -DGBRT_HOTSPOTS=1 for --hotspots, which reports interpreter fallbacks and
+ * writes them as a gbrecomp entry points file, and --profile, which writes
+ * the counters for gbrecomp --profile. With -DGBRT_JIT=1, --jit N
+ * translates interpreted code to host code once entered N times (jit.h).
+ *
+ * --batch N instead runs N identical instances as a batch (batch.h) on
+ * --threads T workers (default 1), grouped K at a time with --group K,
+ * and reports instance frames per second. --soa also runs the groups
+ * through the program's lane kernels; the generated project defines
+ * GBRT_BENCH_SOA and GBRT_BENCH_SOA_COUNT when it was made with
+ * gbrecomp --soa.
+ *
+ * Usage: gbrt_bench [--frames N] [--warmup N] [--movie FILE] [--json FILE]
+ *                   [--hotspots FILE] [--profile FILE] [--jit N]
+ *                   [--batch N [--threads T] [--group K] [--soa]]
+ */
+
+#include "gbrt.h"
+#include "audio.h"
+#include "movie.h"
+#include "hotspot.h"
+#include "jit.h"
+#include "batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifndef GBRT_BENCH_INIT
+#error "GBRT_BENCH_INIT must name the generated <prefix>_init function"
+#endif
+#ifndef GBRT_BENCH_NAME
+#define GBRT_BENCH_NAME "rom"
+#endif
+
+#define BENCH_CPU_CLOCK 4194304.0
+#define BENCH_FRAMES    3600
+
+void GBRT_BENCH_INIT(GBContext* ctx);
+#ifdef GBRT_BENCH_SOA
+extern const GBSoAKernelEntry GBRT_BENCH_SOA[];
+extern const size_t GBRT_BENCH_SOA_COUNT;
+#endif
+
+static double wall_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static uint32_t run_frame(GBContext* ctx) {
+    uint32_t cycles = gb_run_frame(ctx);
+    gb_audio_read_samples(ctx, NULL, (size_t)-1);
+    gb_reset_frame(ctx);
+    ctx->stopped = 0;
+    return cycles;
+}
+
+static int run_batch(long count, long threads, long group, bool soa,
+                     long frames, long warmup, const char* json_path) {
+    GBBatch* batch = gb_batch_create((size_t)count, (unsigned)threads, GBRT_BENCH_INIT);
+    if (!batch) {
+        fprintf(stderr, "Failed to create batch\n");
+        return 1;
+    }
+    gb_batch_set_group_size(batch, (unsigned)group);
+    if (soa) {
+#ifdef GBRT_BENCH_SOA
+        gb_batch_set_soa_kernels(batch, GBRT_BENCH_SOA, GBRT_BENCH_SOA_COUNT);
+#else
+        fprintf(stderr, "Lane kernels require a program generated with gbrecomp --soa\n");
+        soa = false;
+#endif
+    }
+
+    double seconds = 0;
+    uint64_t cycles = 0;
+    for (long i = 0; i < warmup + frames; i++) {
+        double start = wall_seconds();
+        gb_batch_run_frame(batch, NULL);
+        if (i >= warmup) seconds += wall_seconds() - start;
+        for (long k = 0; k < count; k++) {
+            GBContext* ctx = gb_batch_context(batch, (size_t)k);
+            gb_audio_read_samples(ctx, NULL, (size_t)-1);
+            if (i >= warmup) cycles += ctx->frame_cycles;
+        }
+    }
+    if (seconds <= 0) seconds = 1e-9;
+    GBBatchStats stats;
+    gb_batch_get_stats(batch, &stats);
+
+    FILE* out = json_path ? fopen(json_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Cannot write %s\n", json_path);
+        out = stdout;
+    }
+    double instance_fps = (double)count * frames / seconds;
+    fprintf(out, "{\n");
+    fprintf(out, "  \"rom\": \"%s\",\n", GBRT_BENCH_NAME);
+    fprintf(out, "  \"instances\": %ld,\n", count);
+    fprintf(out, "  \"threads\": %ld,\n", threads);
+    fprintf(out, "  \"group\": %ld,\n", group);
+    fprintf(out, "  \"soa\": %s,\n", soa ? "true" : "false");
+    fprintf(out, "  \"frames\": %ld,\n", frames);
+    fprintf(out, "  \"seconds\": %.6f,\n", seconds);
+    fprintf(out, "  \"instance_fps\": %.2f,\n", instance_fps);
+    fprintf(out, "  \"emulated_mhz\": %.3f,\n", cycles / seconds / 1e6);
+    fprintf(out, "  \"steps\": %llu,\n", (unsigned long long)stats.steps);
+    fprintf(out, "  \"shared_steps\": %llu,\n", (unsigned long long)stats.shared_steps);
+    fprintf(out, "  \"soa_runs\": %llu,\n", (unsigned long long)stats.soa_runs);
+    fprintf(out, "  \"soa_lanes\": %llu\n", (unsigned long long)stats.soa_lanes);
+    fprintf(out, "}\n");
+    if (out != stdout) fclose(out);
+
+    fprintf(stderr, "%s: %ld instances x %ld frames in %.3f s, %.1f instance fps "
+            "(group %ld%s, %.1f%% shared steps",
+            GBRT_BENCH_NAME, count, frames, seconds, instance_fps, group, soa ? ", soa" : "",
+            stats.steps ? 100.0 * stats.shared_steps / stats.steps : 0.0);
+    if (soa) {
+        fprintf(stderr, ", %.1f%% of steps in kernels, %.1f lanes per kernel",
+                stats.steps ? 100.0 * stats.soa_lanes / stats.steps : 0.0,
+                stats.soa_runs ? (double)stats.soa_lanes / stats.soa_runs : 0.0);
+    }
+    fprintf(stderr, ")\n");
+    gb_batch_destroy(batch);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    long frames = -1;
+    long warmup = 0;
+    const char* movie_path = NULL;
+    const char* json_path = NULL;
+    const char* hotspots_path = NULL;
+    const char* profile_path = NULL;
+    long jit_threshold = -1;
+    long batch_count = 0;
+    long threads = 1;
+    long group = 1;
+    bool soa = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--movie") == 0 && i + 1 < argc) {
+            movie_path = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--hotspots") == 0 && i + 1 < argc) {
+            hotspots_path = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_path = argv[++i];
+        } else if (strcmp(argv[i], "--jit") == 0 && i + 1 < argc) {
+            jit_threshold = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_count = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--group") == 0 && i + 1 < argc) {
+            group = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--soa") == 0) {
+            soa = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--frames N] [--warmup N] [--movie FILE] [--json FILE] "
+                    "[--hotspots FILE] [--profile FILE] [--jit N] "
+                    "[--batch N [--threads T] [--group K] [--soa]]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (batch_count > 0) {
+        return run_batch(batch_count, threads, group, soa, frames < 0 ? BENCH_FRAMES : frames,
+                         warmup, json_path);
+    }
+
+    GBContext* ctx = gb_context_create(NULL);
+    if (!ctx) {
+        fprintf(stderr, "Failed to create context\n");
+        return 1;
+    }
+    GBRT_BENCH_INIT(ctx);
+
+    GBMovie* movie = NULL;
+    if (movie_path) {
+        movie = gb_movie_load(movie_path);
+        if (!movie || !gb_movie_attach(ctx, movie)) {
+            fprintf(stderr, "Cannot replay %s\n", movie_path);
+            gb_movie_destroy(movie);
+            gb_context_destroy(ctx);
+            return 1;
+        }
+        if (frames < 0) frames = (long)gb_movie_length(movie) - warmup;
+    }
+    if (frames < 0) frames = BENCH_FRAMES;
+
+    GBHotspots* hotspots = NULL;
+    if (hotspots_path || profile_path) {
+#if !GBRT_HOTSPOTS
+        fprintf(stderr, "Hotspot counters require a build with GBRT_HOTSPOTS=1\n");
+#endif
+        hotspots = gb_hotspots_create();
+        gb_hotspots_attach(ctx, hotspots);
+    }
+
+    GBJit* jit = NULL;
+    if (jit_threshold >= 0) {
+#if !GBRT_JIT
+        fprintf(stderr, "Translation requires a build with GBRT_JIT=1\n");
+#endif
+        jit = gb_jit_create((uint32_t)jit_threshold);
+        if (!jit) fprintf(stderr, "Translation is not supported on this host\n");
+        gb_jit_attach(ctx, jit);
+    }
+
+    for (long i = 0; i < warmup; i++) run_frame(ctx);
+
+    uint64_t cycles = 0;
+    gbrt_profile_reset(ctx);
+    double start = wall_seconds();
+    for (long i = 0; i < frames; i++) {
+        cycles += run_frame(ctx);
+    }
+    double seconds = wall_seconds() - start;
+    gbrt_profile_switch(ctx, GB_PROFILE_OTHER);
+    if (seconds <= 0) seconds = 1e-9;
+
+    uint32_t first_mismatch = 0;
+    uint32_t mismatches = movie ? gb_movie_mismatches(movie, &first_mismatch) : 0;
+
+    FILE* out = json_path ? fopen(json_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Cannot write %s\n", json_path);
+        out = stdout;
+    }
+    fprintf(out, "{\n");
+    fprintf(out, "  \"rom\": \"%s\",\n", GBRT_BENCH_NAME);
+    fprintf(out, "  \"frames\": %ld,\n", frames);
+    fprintf(out, "  \"warmup_frames\": %ld,\n", warmup);
+    fprintf(out, "  \"seconds\": %.6f,\n", seconds);
+    fprintf(out, "  \"fps\": %.2f,\n", frames / seconds);
+    fprintf(out, "  \"emulated_mhz\": %.3f,\n", cycles / seconds / 1e6);
+    fprintf(out, "  \"realtime_factor\": %.2f,\n", cycles / seconds / BENCH_CPU_CLOCK);
+    if (jit) {
+        fprintf(out, "  \"jit\": { \"threshold\": %u, \"blocks\": %llu },\n",
+                gb_jit_threshold(jit), (unsigned long long)gb_jit_blocks(jit));
+    }
+    if (movie) {
+        fprintf(out, "  \"movie\": { \"path\": \"%s\", \"mismatches\": %u, \"first_mismatch\": %u },\n",
+                movie_path, mismatches, first_mismatch);
+    }
+#if GBRT_PROFILE
+    static const char* const names[GB_PROFILE_COUNT] = {
+        "other", "generated_code", "dispatch", "interpreter", "ppu", "audio",
+    };
+    uint64_t total = 0;
+    for (int s = 0; s < GB_PROFILE_COUNT; s++) total += ctx->profile_ticks[s];
+    fprintf(out, "  \"profile\": {\n");
+    for (int s = 0; s < GB_PROFILE_COUNT; s++) {
+        double share = total ? (double)ctx->profile_ticks[s] / (double)total : 0.0;
+        fprintf(out, "    \"%s\": { \"seconds\": %.6f, \"share\": %.4f }%s\n",
+                names[s], share * seconds, share, s + 1 < GB_PROFILE_COUNT ? "," : "");
+    }
+    fprintf(out, "  }\n");
+#else
+    fprintf(out, "  \"profile\": null\n");
+#endif
+    fprintf(out, "}\n");
+    if (out != stdout) fclose(out);
+
+    fprintf(stderr, "%s: %ld frames in %.3f s, %.1f fps, %.2f MHz (%.1fx realtime)\n",
+            GBRT_BENCH_NAME, frames, seconds, frames / seconds, cycles / seconds / 1e6,
+            cycles / seconds / BENCH_CPU_CLOCK);
+    if (mismatches) {
+        fprintf(stderr, "Movie diverged: %u checksum(s) differ, first at frame %u\n",
+                mismatches, first_mismatch);
+    }
+
+    if (hotspots) {
+        gb_hotspots_attach(ctx, NULL);
+        gb_hotspots_report(hotspots, stderr, 20);
+        if (hotspots_path && !gb_hotspots_write_entry_points(hotspots, hotspots_path)) {
+            fprintf(stderr, "Cannot write %s\n", hotspots_path);
+        }
+        if (profile_path && !gb_hotspots_write_profile(hotspots, profile_path)) {
+            fprintf(stderr, "Cannot write %s\n", profile_path);
+        }
+        gb_hotspots_destroy(hotspots);
+    }
+    gb_jit_attach(ctx, NULL);
+    gb_jit_destroy(jit);
+    gb_movie_attach(ctx, NULL);
+    gb_movie_destroy(movie);
+    gb_context_destroy(ctx);
+    return mismatches ? 3 : 0;
+}
@@ -16,11 +16,43 @@ extern "C" {
  * Public Interface
  * ========================================================================== */
 
+/** Output rate used until gb_audio_set_sample_rate() is called */
+#define GB_AUDIO_DEFAULT_RATE 44100
+
 /**
  * @brief Create audio subsystem state
  */
 void* gb_audio_create(void);
 
+/**
+ * @brief Bytes of audio state, for embedding it in a larger allocation
+ */
+size_t gb_audio_size(void);
+
+/**
+ * @brief Initialize zeroed storage of gb_audio_size() bytes as audio state
+ */
+void gb_audio_init(void* apu);
+
+/**
+ * @brief Bytes of emulated audio state written by gb_audio_save_state()
+ */
+size_t gb_audio_state_size(void);
+
+/**
+ * @brief Copy the emulated channel and sequencer state
+ *
+ * Output rate and synthesized samples are host state and not included.
+ */
+void gb_audio_save_state(const void* apu, void* out);
+
+/**
+ * @brief Restore state saved by gb_audio_save_state()
+ *
+ * Synthesis continues from the samples already buffered.
+ */
+void gb_audio_load_state(void* apu, const void* in);
+
 /**
  * @brief Destroy audio subsystem state
  */
@@ -47,12 +79,49 @@ void gb_audio_write(GBContext* ctx, uint16_t addr, uint8_t value);
 void gb_audio_step(GBContext* ctx, uint32_t cycles);
 
 /**
- * @brief Get current sample for left/right channels
- * @param apu Audio state
- * @param left Pointer to store left sample
- * @param right Pointer to store right sample
+ * @brief Cycles until the next frame sequencer step
+ * @return Cycle count, or 0 if the APU is powered off
+ */
+uint32_t gb_audio_cycles_until_event(GBContext* ctx);
+
+/**
+ * @brief Set the output sample rate
+ *
+ * The 4.19 MHz APU is resampled directly to this rate by the band-limited
+ * synthesis, so hosts at 48 kHz (or anything else) need no second stage.
+ * @param ctx CPU context
+ * @param rate Output rate in Hz
+ */
+void gb_audio_set_sample_rate(GBContext* ctx, uint32_t rate);
+
+/**
+ * @brief Get the output sample rate in Hz
+ */
+uint32_t gb_audio_get_sample_rate(GBContext* ctx);
+
+/**
+ * @brief Drain synthesized samples into a caller-provided buffer
+ *
+ * Samples are produced in blocks whenever the APU is synced (register
+ * access, frame sequencer steps and the end of gb_run_frame), about one
+ * frame's worth per gb_run_frame call.
+ * @param ctx CPU context
+ * @param out Interleaved stereo int16 buffer with room for frames frames,
+ *            or NULL to discard
+ * @param frames Maximum stereo frames to read
+ * @return Stereo frames written
+ */
+size_t gb_audio_read_samples(GBContext* ctx, int16_t* out, size_t frames);
+
+/**
+ * @brief Same as gb_audio_read_samples() with float output in [-1, 1)
+ */
+size_t gb_audio_read_samples_f32(GBContext* ctx, float* out, size_t frames);
+
+/**
+ * @brief Stereo frames ready to be read
  */
-void gb_audio_get_samples(void* apu, int16_t* left, int16_t* right);
+size_t gb_audio_samples_available(GBContext* ctx);
 
 #ifdef __cplusplus
 }
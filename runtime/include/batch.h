@@ -0,0 +1,173 @@
+/**
+ * @file batch.h
+ * @brief Run many independent emulator instances on a worker pool
+ *
+ * A batch owns its contexts and a pool of worker threads. Each
+ * gb_batch_run_frame() call applies one input per instance, runs one frame
+ * of every instance in parallel and returns once all of them are done.
+ *
+ * Instances of the same ROM often run the same code. With a group size
+ * set, each worker claims that many instances at once and interleaves
+ * their frames a step at a time, ordering every round by the bank:address
+ * each instance enters next so that instances at the same entry call the
+ * same recompiled function back to back. Instances still keep their own
+ * registers, memory and timing, so results do not depend on the grouping;
+ * only cache and branch-predictor locality does. gb_batch_get_stats()
+ * tells how many steps shared their entry with the step before.
+ *
+ * Programs generated with gbrecomp --soa also export lane kernels: blocks
+ * made only of register, flag and fixed WRAM0/HRAM operations, compiled to
+ * run one instruction across a whole structure-of-arrays register file
+ * (GBSoARegs) at a time. Once set with gb_batch_set_soa_kernels(), grouped
+ * instances take one block per round instead of one step, and instances
+ * entering a block that has a kernel run it together; the others run about
+ * a scanline, up to a poll point. Kernels charge their cycles at the end of
+ * the block, so an interrupt or the end of a frame can be taken a block
+ * later than with scalar code, within the latency polling already allows.
+ */
+
+#ifndef GB_BATCH_H
+#define GB_BATCH_H
+
+#include "gbrt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct GBBatch GBBatch;
+
+/** Largest group gb_batch_set_group_size() accepts */
+#define GB_BATCH_MAX_GROUP 64
+
+/** Lanes a SoA kernel runs at once */
+#define GB_SOA_LANES GB_BATCH_MAX_GROUP
+
+/**
+ * @brief Registers of several instances, one array per register
+ *
+ * A kernel reads and writes lanes 0..n-1 and sets each lane's next PC and
+ * the cycles its path through the block took.
+ */
+typedef struct {
+    uint8_t a[GB_SOA_LANES], b[GB_SOA_LANES], c[GB_SOA_LANES], d[GB_SOA_LANES];
+    uint8_t e[GB_SOA_LANES], h[GB_SOA_LANES], l[GB_SOA_LANES];
+    uint8_t f_z[GB_SOA_LANES], f_n[GB_SOA_LANES], f_h[GB_SOA_LANES], f_c[GB_SOA_LANES];
+    uint16_t pc[GB_SOA_LANES];
+    uint16_t cycles[GB_SOA_LANES];
+    GBContext* ctx[GB_SOA_LANES];   /**< For the kernels' WRAM0 and HRAM accesses */
+} GBSoARegs;
+
+typedef void (*GBSoAKernel)(GBSoARegs* s, int n);
+
+/**
+ * @brief Kernel of the block entered at bank:address
+ *
+ * Generated as <prefix>_soa_kernels, sorted by key; the bank is 0 below
+ * 0x4000 like the dispatch tables.
+ */
+typedef struct {
+    uint32_t key;           /**< bank << 16 | address */
+    GBSoAKernel kernel;
+} GBSoAKernelEntry;
+
+/**
+ * @brief Joypad state for one instance for one frame
+ */
+typedef struct {
+    uint8_t buttons;    /**< Active low: Start, Select, B, A */
+    uint8_t dpad;       /**< Active low: Down, Up, Left, Right */
+} GBBatchInput;
+
+/**
+ * @brief Read-only view of one instance after a frame
+ *
+ * Pointers stay valid until the next gb_batch_run_frame() or destroy.
+ */
+typedef struct {
+    const void* pixels;     /**< Display in the selected pixel format, NULL in index mode */
+    const uint8_t* shades;  /**< 160x144 2-bit shades */
+    const uint8_t* wram;    /**< 0xC000-0xDFFF (bank 1 follows bank 0) */
+    const uint8_t* hram;    /**< 0xFF80-0xFFFE */
+    uint32_t frame_cycles;  /**< Cycles the last frame took */
+} GBBatchView;
+
+/**
+ * @brief Convergence of grouped execution since the batch was created
+ */
+typedef struct {
+    uint64_t steps;         /**< Steps run in groups */
+    uint64_t shared_steps;  /**< Steps entered at the same bank:address as the one before */
+    uint64_t soa_runs;      /**< Kernel calls */
+    uint64_t soa_lanes;     /**< Blocks run by kernels, summed over their lanes */
+} GBBatchStats;
+
+/**
+ * @brief Create a batch of identical instances
+ * @param count Number of instances
+ * @param threads Worker threads including the caller (0 = one per core)
+ * @param init Called once per new context, typically the generated
+ *             <prefix>_init, which attaches the shared ROM image
+ * @return The batch, or NULL on allocation failure
+ */
+GBBatch* gb_batch_create(size_t count, unsigned threads, void (*init)(GBContext* ctx));
+
+/**
+ * @brief Stop the workers and destroy every instance
+ */
+void gb_batch_destroy(GBBatch* batch);
+
+/**
+ * @brief Number of instances in the batch
+ */
+size_t gb_batch_count(const GBBatch* batch);
+
+/**
+ * @brief Direct access to one instance, e.g. to configure or reset it
+ *
+ * Must not be used while gb_batch_run_frame() is running.
+ */
+GBContext* gb_batch_context(GBBatch* batch, size_t index);
+
+/**
+ * @brief Run one frame of every instance in parallel
+ * @param inputs One entry per instance, or NULL to keep the current input
+ */
+void gb_batch_run_frame(GBBatch* batch, const GBBatchInput* inputs);
+
+/**
+ * @brief Describe the state of one instance after the last frame
+ */
+void gb_batch_view(GBBatch* batch, size_t index, GBBatchView* view);
+
+/**
+ * @brief Interleave the frames of this many instances per worker claim
+ *
+ * 0 or 1 runs each instance's frame straight through (the default); larger
+ * values are clamped to GB_BATCH_MAX_GROUP. Must not be called while
+ * gb_batch_run_frame() is running.
+ */
+void gb_batch_set_group_size(GBBatch* batch, unsigned size);
+
+/**
+ * @brief Run grouped instances through lane kernels where they have one
+ * @param entries The generated <prefix>_soa_kernels, sorted by key, or NULL
+ *                to go back to stepping every instance on its own
+ * @param count The generated <prefix>_soa_kernel_count
+ *
+ * Only used with a group size above 1; instances with a lockstep checker
+ * attached always run scalar code. Must not be called while
+ * gb_batch_run_frame() is running.
+ */
+void gb_batch_set_soa_kernels(GBBatch* batch, const GBSoAKernelEntry* entries, size_t count);
+
+/**
+ * @brief Read the grouped execution counters
+ */
+void gb_batch_get_stats(const GBBatch* batch, GBBatchStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GB_BATCH_H */
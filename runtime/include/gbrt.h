@@ -13,6 +13,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,11 +31,36 @@ typedef enum {
     GB_MODEL_SGB,   /**< Super GameBoy */
 } GBModel;
 
+/**
+ * @brief Display output pixel format
+ */
+typedef enum {
+    GB_PIXEL_ARGB8888,  /**< 32-bit, matches SDL_PIXELFORMAT_ARGB8888 (default) */
+    GB_PIXEL_RGB565,    /**< 16-bit, matches SDL_PIXELFORMAT_RGB565 */
+    GB_PIXEL_INDEX,     /**< No color output, only the 2-bit shade buffer */
+} GBPixelFormat;
+
+/** Most ranges a frame delta can hold (every other line changed) */
+#define GB_MAX_LINE_RANGES 72
+
+/**
+ * @brief Display lines changed since the last gb_get_frame_delta()
+ */
+typedef struct {
+    uint64_t hash;          /**< Hash of the current frame's shades; equal frames hash equal */
+    uint8_t changed;        /**< Lines changed in total */
+    uint8_t range_count;    /**< Entries of ranges in use */
+    struct {
+        uint8_t first;      /**< First changed line */
+        uint8_t count;      /**< Consecutive changed lines from first */
+    } ranges[GB_MAX_LINE_RANGES];
+} GBFrameDelta;
+
 /**
  * @brief Runtime configuration
  */
 typedef struct {
-    GBModel model;
+    GBModel model;          /**< GB_MODEL_CGB enables CGB mode (CGB-only cartridges always do) */
     bool enable_bootrom;
     bool enable_audio;
     bool enable_serial;
@@ -45,10 +71,171 @@ typedef struct {
  * Debugging
  * ========================================================================== */
 
-extern bool gbrt_trace_enabled;
-extern uint64_t gbrt_instruction_count;
-extern uint64_t gbrt_instruction_limit;
+/**
+ * @brief Compile-time instrumentation level
+ *
+ *   0 - none: dispatch and interpreter loops carry no checks (release)
+ *   1 - instruction counting, instruction limit and switchable tracing
+ *   2 - level 1 plus the debug logging categories of gbrt_debug.h
+ */
+#ifndef GBRT_INSTRUMENT
+#define GBRT_INSTRUMENT 0
+#endif
+
+struct GBContext;
+
+/**
+ * @brief Instrumentation hook run per dispatch / interpreted instruction
+ *
+ * Tracing is switched at runtime by swapping the context's hook
+ * (gbrt_set_trace) rather than by testing a flag on every call.
+ */
+typedef void (*GBTraceHook)(struct GBContext* ctx, uint16_t addr);
+
+/**
+ * @brief Enable or disable per-dispatch tracing (needs GBRT_INSTRUMENT >= 1)
+ */
+void gbrt_set_trace(struct GBContext* ctx, bool enabled);
+
+#if GBRT_INSTRUMENT >= 1
+#define GBRT_TRACE(ctx, addr) (ctx)->trace_hook((ctx), (addr))
+#else
+#define GBRT_TRACE(ctx, addr) ((void)0)
+#endif
+
+/**
+ * @brief Compile-time time profiling (GBRT_PROFILE = 1)
+ *
+ * Splits host time between the run loop, generated code, dispatch, the
+ * interpreter, the PPU and the APU in ctx->profile_ticks, for benchmarks.
+ */
+#ifndef GBRT_PROFILE
+#define GBRT_PROFILE 0
+#endif
+
+typedef enum {
+    GB_PROFILE_OTHER,     /**< Run loop, scheduler and everything not below */
+    GB_PROFILE_CODE,      /**< Recompiled functions */
+    GB_PROFILE_DISPATCH,  /**< gb_dispatch table lookups */
+    GB_PROFILE_INTERP,    /**< gb_interpret */
+    GB_PROFILE_PPU,       /**< ppu_tick, including scanline rendering */
+    GB_PROFILE_AUDIO,     /**< gb_audio_step */
+    GB_PROFILE_COUNT
+} GBProfileSection;
+
+#if GBRT_PROFILE
+/* PUSH/POP bracket a nested section; SWITCH changes the current one */
+#define GBRT_PROFILE_PUSH(ctx, section) \
+    GBProfileSection gbrt_profile_saved_ = gbrt_profile_switch((ctx), (section))
+#define GBRT_PROFILE_POP(ctx) ((void)gbrt_profile_switch((ctx), gbrt_profile_saved_))
+#define GBRT_PROFILE_SWITCH(ctx, section) ((void)gbrt_profile_switch((ctx), (section)))
+#else
+#define GBRT_PROFILE_PUSH(ctx, section) ((void)0)
+#define GBRT_PROFILE_POP(ctx) ((void)0)
+#define GBRT_PROFILE_SWITCH(ctx, section) ((void)0)
+#endif
+
+/**
+ * @brief Compile-time dispatch and fallback counters (GBRT_HOTSPOTS = 1)
+ *
+ * Counts function entries, interpreter fallbacks and computed jump targets
+ * per bank:address into the table attached with gb_hotspots_attach
+ * (hotspot.h). Generated functions count themselves with GBRT_HOTSPOT_ENTER.
+ */
+#ifndef GBRT_HOTSPOTS
+#define GBRT_HOTSPOTS 0
+#endif
 
+void gbrt_hotspot_enter(struct GBContext* ctx, uint8_t bank, uint16_t addr);
+void gbrt_hotspot_jump(struct GBContext* ctx, uint16_t addr);
+
+#if GBRT_HOTSPOTS
+#define GBRT_HOTSPOT_ENTER(ctx, bank, addr) \
+    do { if ((ctx)->hotspots) gbrt_hotspot_enter((ctx), (bank), (addr)); } while (0)
+#define GBRT_HOTSPOT_JUMP(ctx, addr) \
+    do { if ((ctx)->hotspots) gbrt_hotspot_jump((ctx), (addr)); } while (0)
+#define GBRT_HOTSPOT_STEP(ctx) ((void)(ctx)->hotspot_steps++)
+#else
+#define GBRT_HOTSPOT_ENTER(ctx, bank, addr) ((void)0)
+#define GBRT_HOTSPOT_JUMP(ctx, addr) ((void)0)
+#define GBRT_HOTSPOT_STEP(ctx) ((void)0)
+#endif
+
+/**
+ * @brief Compile-time translation of hot interpreted code (GBRT_JIT = 1)
+ *
+ * gb_interpret hands entry points it keeps returning to over to the
+ * translator attached with gb_jit_attach (jit.h).
+ */
+#ifndef GBRT_JIT
+#define GBRT_JIT 0
+#endif
+
+/**
+ * @brief Maximum nesting of direct native calls in generated code
+ *
+ * Statically resolved CALLs invoke the callee as a C function; beyond this
+ * depth they fall back to the dispatch trampoline to bound host stack use.
+ */
+#define GB_MAX_NATIVE_DEPTH 64
+
+/* Save-state dirty tracking granularity: one flag per 256-byte page of
+ * WRAM (8 banks) followed by VRAM (2 banks) */
+#define GB_STATE_WRAM_PAGES 0x80
+#define GB_STATE_VRAM_PAGES 0x40
+#define GB_STATE_PAGES      (GB_STATE_WRAM_PAGES + GB_STATE_VRAM_PAGES)
+
+/* ============================================================================
+ * Event Scheduler
+ * ========================================================================== */
+
+/**
+ * @brief Hardware event slots
+ *
+ * Each hardware unit owns one slot holding the absolute cycle of its next
+ * state change. Generated code only compares ctx->cycles against the
+ * earliest armed deadline (next_event).
+ */
+typedef enum {
+    GB_EVENT_PPU,     /**< PPU mode transition */
+    GB_EVENT_TIMER,   /**< TIMA overflow */
+    GB_EVENT_APU,     /**< APU sample / frame sequencer step */
+    GB_EVENT_SERIAL,  /**< Serial transfer complete */
+    GB_EVENT_DMA,     /**< OAM DMA transfer complete */
+    GB_EVENT_BREAK,   /**< Stop execution at a chosen cycle (lockstep.h) */
+    GB_EVENT_COUNT
+} GBEventType;
+
+/* ============================================================================
+ * Cached Code
+ * ========================================================================== */
+
+/* Flags in GBContext.code_pages; a RAM page with any set is left out of
+ * write_map so its first store reaches gb_code_invalidate */
+#define GB_CODE_DECODED 0x01 /**< Instructions predecoded by the interpreter */
+#define GB_CODE_OVERLAY 0x02 /**< Bytes a recompiled RAM overlay was checked against */
+
+/** Most recompiled RAM overlays a program can attach */
+#define GB_MAX_OVERLAYS 16
+
+/**
+ * @brief Routine copied from ROM to RAM that was recompiled as-is
+ *
+ * The compiled function only stands in for RAM that still holds the ROM
+ * bytes; once the game patches or replaces them the code is interpreted.
+ */
+typedef struct {
+    uint16_t ram_addr;   /**< First byte in RAM */
+    uint16_t size;       /**< Bytes compiled */
+    uint32_t rom_offset; /**< Offset of the original bytes in the ROM image */
+} GBOverlay;
+
+/** Overlay states (GBContext.overlay_state) */
+enum {
+    GB_OVERLAY_UNCHECKED, /**< Not compared since the last store to its pages */
+    GB_OVERLAY_MATCHES,   /**< RAM holds the compiled bytes */
+    GB_OVERLAY_DIFFERS,   /**< RAM holds something else */
+};
 
 /* ============================================================================
  * CPU Context
@@ -94,39 +281,98 @@ typedef struct GBContext {
     uint8_t ime_pending;  /**< IME will be enabled after next instruction */
     uint8_t halted;       /**< CPU is halted */
     uint8_t stopped;      /**< CPU is stopped */
+    uint8_t native_depth; /**< Direct native calls currently on the host stack */
     
     /* Current bank numbers */
-    uint8_t rom_bank;     /**< Current ROM bank (0x4000-0x7FFF) */
-    uint8_t ram_bank;     /**< Current RAM bank */
+    uint16_t rom_bank;    /**< Current ROM bank (0x4000-0x7FFF) */
+    uint16_t rom_bank0;   /**< ROM bank at 0x0000-0x3FFF (nonzero only in MBC1 mode 1) */
+    uint8_t ram_bank;     /**< Current RAM bank, or MBC3 clock register (0x08-0x0C) */
     uint8_t wram_bank;    /**< Current WRAM bank (CGB only) */
     uint8_t vram_bank;    /**< Current VRAM bank (CGB only) */
+    uint8_t cgb;          /**< CGB mode: KEY1, VBK and SVBK are live */
+    uint8_t double_speed; /**< KEY1 speed: log2 of CPU cycles per PPU/APU cycle */
     
-    /* MBC state */
-    uint8_t mbc_type;
-    uint8_t ram_enabled;
+    /* MBC state (mbc.h) */
+    uint8_t mbc_type;     /**< GBMbcType of the cartridge */
+    uint8_t ram_enabled;  /**< ERAM and clock accesses enabled */
     uint8_t mbc_mode;     /**< Banking mode for MBC1 */
+    uint8_t mbc_bank1;    /**< MBC1 low ROM bank register (5 bits) */
+    uint8_t mbc_bank2;    /**< MBC1 upper bank register (2 bits) */
+    uint8_t mbc_rtc;      /**< Cartridge has an MBC3 clock */
+    uint8_t mbc_rumble;   /**< MBC5 cartridge with a rumble motor */
+    uint8_t mbc_battery;  /**< ERAM is battery-backed (gb_mbc_map_save) */
+    uint8_t rtc_latch;    /**< Last value written to the MBC3 latch register */
+    uint8_t rtc[5];       /**< MBC3 clock: seconds, minutes, hours, day low, day high */
+    uint8_t rtc_latched[5]; /**< Clock registers as last latched */
+    uint32_t rtc_sync_cycles; /**< Cycle count the clock was last advanced to */
     
     /* Timing */
     uint32_t cycles;      /**< Cycles executed */
     uint32_t frame_cycles;/**< Cycles this frame */
-    uint32_t last_sync_cycles; /**< Last cycles count synchronized with hardware */
+    uint32_t frame_start; /**< Cycle count the current frame began at */
+    uint32_t last_sync_cycles; /**< Last cycles count synchronized with the PPU */
     uint8_t  frame_done;  /**< Frame is finished and rendered */
     
+    /* Fast-forward */
+    uint8_t  turbo;        /**< Run uncapped (frontend skips frame pacing) */
+    uint8_t  frame_skip;   /**< Draw one frame in every frame_skip (0 or 1 = all) */
+    uint8_t  skip_counter; /**< Position within the frame-skip cycle */
+    uint8_t  audio_muted;  /**< APU sample synthesis disabled */
+    
+    /* Event scheduler */
+    uint32_t next_event;                 /**< Earliest armed event deadline */
+    uint32_t event_time[GB_EVENT_COUNT]; /**< Absolute deadline per slot */
+    uint8_t  event_pending;              /**< Bitmask of armed slots */
+    
     /* Timer internal state */
-    uint16_t div_counter;   /**< Internal 16-bit divider counter */
-    uint32_t timer_counter; /**< Internal counter for TIMA */
+    uint32_t div_base;          /**< Cycle count at the last DIV reset; DIV = (cycles - div_base) >> 8 */
+    uint32_t timer_sync_cycles; /**< Cycle count TIMA was last caught up to */
+    uint32_t apu_sync_cycles;   /**< Cycle count the APU was last caught up to */
     
     /* Memory pointers */
-    uint8_t* rom;         /**< ROM data */
+    const uint8_t* rom;   /**< ROM data (read-only, possibly borrowed) */
     size_t rom_size;
-    uint8_t* eram;        /**< External RAM */
+    void* rom_storage;    /**< Heap copy or file mapping owned by the context, NULL if borrowed */
+    bool rom_mapped;      /**< rom_storage came from gb_rom_map */
+    void* arena;          /**< Single allocation holding this context and its mutable state */
+    uint8_t* eram;        /**< External RAM (mbc.c) */
     size_t eram_size;
+    const struct GBMapper* mapper; /**< Handlers of the cartridge's MBC */
+    char* save_path;      /**< Battery save file ERAM is kept in, NULL = none */
     uint8_t* wram;        /**< Work RAM */
     uint8_t* vram;        /**< Video RAM */
     uint8_t* oam;         /**< Object Attribute Memory */
     uint8_t* hram;        /**< High RAM (0xFF80-0xFFFE) */
     uint8_t* io;          /**< I/O registers (0xFF00-0xFF7F) */
     
+    /* Memory page tables (256-byte pages, NULL = slow path) */
+    uint8_t* read_map[256];  /**< Host pointer per page for reads */
+    uint8_t* write_map[256]; /**< Host pointer per page for writes */
+    
+    /* Save-state dirty pages (state.h) */
+    uint8_t state_dirty[GB_STATE_PAGES]; /**< Page written since the base snapshot */
+    bool state_tracking;     /**< Clean WRAM pages are left out of write_map */
+    uint32_t state_base;     /**< Id of the snapshot state_dirty is relative to (0 = none) */
+    
+    /* Interpreter decode cache (interpreter.c) */
+    struct GBDecodeCache* decode_cache; /**< Predecoded instructions, NULL until first use */
+    uint8_t code_pages[256]; /**< GB_CODE_* flags per page, pages with any left out of write_map */
+    const GBOverlay* overlays; /**< Recompiled RAM routines (gb_overlays_attach) */
+    uint32_t overlay_count;
+    uint8_t overlay_state[GB_MAX_OVERLAYS]; /**< GB_OVERLAY_* per overlay */
+    struct GBJit* jit;       /**< Translator for hot interpreted code (GBRT_JIT, jit.h), NULL = off */
+    
+    /* Rewind (rewind.h) */
+    struct GBRewind* rewind; /**< Fed at the end of every frame, NULL = off */
+    bool rewind_held;        /**< gb_run_frame steps back instead of running */
+    
+    /* Input movie (movie.h) */
+    struct GBMovie* movie;   /**< Recorded or replayed by gb_run_frame, NULL = off */
+    
+    /* Lockstep validation (lockstep.h) */
+    struct GBLockstep* lockstep; /**< Checked after every step of gb_run_frame, NULL = off */
+    bool lockstep_shadow;        /**< This is a validator's shadow: no serial echo */
+    
     /* Hardware components (opaque pointers) */
     void* ppu;            /**< Pixel Processing Unit */
     void* apu;            /**< Audio Processing Unit */
@@ -134,12 +380,64 @@ typedef struct GBContext {
     void* serial;         /**< Serial port */
     void* joypad;         /**< Joypad input */
     uint8_t last_joypad;  /**< Last joypad state for interrupt generation */
+    uint8_t joypad_buttons; /**< Active low: Start, Select, B, A */
+    uint8_t joypad_dpad;    /**< Active low: Down, Up, Left, Right */
+    
+    /* Instrumentation (GBRT_INSTRUMENT >= 1) */
+    GBTraceHook trace_hook;       /**< Run per dispatch / interpreted instruction */
+    bool trace_enabled;
+    uint64_t instruction_count;
+    uint64_t instruction_limit;   /**< Exit after this many instructions (0 = no limit) */
+    
+    /* Time profiling (GBRT_PROFILE) */
+    uint64_t profile_ticks[GB_PROFILE_COUNT]; /**< Host ticks spent per section */
+    uint64_t profile_mark;        /**< Tick count the current section started at */
+    uint8_t profile_section;      /**< GBProfileSection being charged */
+    
+    /* Dispatch counters (GBRT_HOTSPOTS, hotspot.h) */
+    struct GBHotspots* hotspots;  /**< Counter table, NULL = off */
+    uint64_t hotspot_steps;       /**< Instructions interpreted so far */
+    
+    /* Debug logging counters (gbrt_debug.h) */
+    uint32_t debug_frames;
+    uint32_t debug_interp_entries;
+    uint32_t debug_ppu_writes;
+    uint16_t debug_last_dump_pc;
     
     /* Platform interface */
     void* platform;       /**< Platform-specific data */
     
 } GBContext;
 
+/**
+ * @brief CPU register file cached in locals by generated code
+ *
+ * Mirrors the leading members of GBContext. Functions generated with
+ * register caching keep a copy on the host stack, where the compiler can
+ * promote it to host registers, and sync it with the context only around
+ * runtime calls that observe CPU state.
+ */
+typedef struct GBRegisters {
+    union { struct { uint8_t f, a; }; uint16_t af; };
+    union { struct { uint8_t c, b; }; uint16_t bc; };
+    union { struct { uint8_t e, d; }; uint16_t de; };
+    union { struct { uint8_t l, h; }; uint16_t hl; };
+    uint16_t sp;
+    uint16_t pc;
+    uint8_t f_z, f_n, f_h, f_c;
+} GBRegisters;
+
+_Static_assert(offsetof(GBContext, f_c) == offsetof(GBRegisters, f_c),
+               "GBRegisters must mirror the head of GBContext");
+
+static inline void gb_regs_load(GBRegisters* regs, const GBContext* ctx) {
+    memcpy(regs, ctx, sizeof(*regs));
+}
+
+static inline void gb_regs_store(GBContext* ctx, const GBRegisters* regs) {
+    memcpy(ctx, regs, sizeof(*regs));
+}
+
 /* ============================================================================
  * Context Management
  * ========================================================================== */
@@ -173,6 +471,39 @@ void gb_context_reset(GBContext* ctx, bool skip_bootrom);
  */
 bool gb_context_load_rom(GBContext* ctx, const uint8_t* data, size_t size);
 
+/**
+ * @brief Use ROM data in place without copying it
+ * 
+ * The data must stay valid and unmodified for the context's lifetime;
+ * typically the generated rom_data[] or a mapping shared by many contexts.
+ * @return true on success
+ */
+bool gb_context_attach_rom(GBContext* ctx, const uint8_t* data, size_t size);
+
+/**
+ * @brief Map a ROM file read-only into the context
+ * 
+ * Uses mmap where available, so every process running the same ROM shares
+ * its pages; elsewhere the file is read into a private copy.
+ * @return true on success
+ */
+bool gb_context_map_rom(GBContext* ctx, const char* path);
+
+/**
+ * @brief Map a ROM file read-only for sharing between contexts
+ * 
+ * Map once, gb_context_attach_rom() it to any number of contexts, and
+ * gb_rom_unmap() it after the last of them is destroyed.
+ * @param size Receives the file size
+ * @return The image, or NULL on failure
+ */
+const uint8_t* gb_rom_map(const char* path, size_t* size);
+
+/**
+ * @brief Release an image returned by gb_rom_map()
+ */
+void gb_rom_unmap(const void* data, size_t size);
+
 /* ============================================================================
  * Memory Access
  * ========================================================================== */
@@ -193,6 +524,186 @@ uint8_t gb_read8(GBContext* ctx, uint16_t addr);
  */
 void gb_write8(GBContext* ctx, uint16_t addr, uint8_t value);
 
+/**
+ * @brief Rebuild the memory page tables
+ *
+ * Must be called whenever rom or eram change; MBC bank switches and VBK
+ * and SVBK writes use the narrower updates below, so a banked page costs
+ * the same to access as an unbanked one. Pages covering I/O, OAM and unmapped regions are
+ * left NULL and routed through the slow path, as are VRAM writes so the
+ * PPU can invalidate its decoded tile cache. While snapshots track dirty
+ * pages, clean WRAM pages are write-protected the same way until their
+ * first store, and so are RAM pages holding cached code (code_pages).
+ * @param ctx CPU context
+ */
+void gb_update_memory_map(GBContext* ctx);
+
+/**
+ * @brief Remap only 0x0000-0x7FFF after rom_bank0 or rom_bank changed
+ */
+void gb_update_rom_map(GBContext* ctx);
+
+/**
+ * @brief Remap only 0xA000-0xBFFF after ram_bank, ram_enabled or a
+ *        mapper register changed
+ */
+void gb_update_eram_map(GBContext* ctx);
+
+/**
+ * @brief Remap only 0x8000-0x9FFF after vram_bank changed
+ */
+void gb_update_vram_map(GBContext* ctx);
+
+/**
+ * @brief Remap only 0xD000-0xDFFF and its echo after wram_bank changed
+ */
+void gb_update_wram_map(GBContext* ctx);
+
+/**
+ * @brief The WRAM page mirrored by an echo page or vice versa, -1 if none
+ */
+static inline int gb_echo_page(int page) {
+    if (page >= 0xC0 && page < 0xDE) return page + 0x20;
+    if (page >= 0xE0 && page < 0xFE) return page - 0x20;
+    return -1;
+}
+
+/**
+ * @brief Drop all code cached from a RAM page (and its echo)
+ *
+ * Called on the first store to a page with code_pages flags set. Overlays
+ * on the page are compared again before their next use, and predecoded
+ * instructions and translated blocks on it are dropped.
+ */
+void gb_code_invalidate(GBContext* ctx, uint8_t page);
+
+/**
+ * @brief Drop all cached code, after memory was replaced wholesale
+ */
+void gb_code_flush(GBContext* ctx);
+
+/**
+ * @brief Attach the program's recompiled RAM overlays
+ * @param overlays Table that outlives the context (at most GB_MAX_OVERLAYS are used)
+ */
+void gb_overlays_attach(GBContext* ctx, const GBOverlay* overlays, uint32_t count);
+
+/**
+ * @brief Compare an overlay's RAM with its ROM bytes and protect its pages
+ * @return Whether the compiled function may run
+ */
+bool gb_overlay_verify(GBContext* ctx, uint32_t index);
+
+/**
+ * @brief Whether overlay index still holds the code it was compiled from
+ *
+ * Checked by the generated dispatcher before entering an overlay; costs a
+ * load and compare until a store to the overlay's pages.
+ */
+static inline bool gb_overlay_valid(GBContext* ctx, uint32_t index) {
+    uint8_t state = ctx->overlay_state[index];
+    if (state == GB_OVERLAY_UNCHECKED) return gb_overlay_verify(ctx, index);
+    return state == GB_OVERLAY_MATCHES;
+}
+
+/**
+ * @brief Drop the interpreter's predecoded code on a page (and its echo)
+ */
+void gb_decode_cache_invalidate(GBContext* ctx, uint8_t page);
+
+/**
+ * @brief Drop all predecoded code, after memory was replaced wholesale
+ */
+void gb_decode_cache_flush(GBContext* ctx);
+
+/**
+ * @brief Free the decode cache
+ */
+void gb_decode_cache_destroy(GBContext* ctx);
+
+/**
+ * @brief Read from the high page (0xFF00-0xFFFF)
+ *
+ * Used directly by generated code for LDH and other accesses whose
+ * address is known to be I/O, HRAM or IE.
+ * @param ctx CPU context
+ * @param reg Offset from 0xFF00
+ * @return Register value
+ */
+uint8_t gb_io_read(GBContext* ctx, uint8_t reg);
+
+/**
+ * @brief Write to the high page (0xFF00-0xFFFF)
+ * @param ctx CPU context
+ * @param reg Offset from 0xFF00
+ * @param value Byte to write
+ */
+void gb_io_write(GBContext* ctx, uint8_t reg, uint8_t value);
+
+/**
+ * @brief Slow-path read for pages without a host mapping
+ */
+uint8_t gb_read8_slow(GBContext* ctx, uint16_t addr);
+
+/**
+ * @brief Slow-path write for pages without a host mapping
+ */
+void gb_write8_slow(GBContext* ctx, uint16_t addr, uint8_t value);
+
+/**
+ * @brief Inline page-table read, used for dynamic addresses in generated code
+ */
+static inline uint8_t gb_read8_fast(GBContext* ctx, uint16_t addr) {
+    const uint8_t* page = ctx->read_map[addr >> 8];
+    if (page) return page[addr & 0xFF];
+    return gb_read8_slow(ctx, addr);
+}
+
+/**
+ * @brief Inline page-table write, used for dynamic addresses in generated code
+ */
+static inline void gb_write8_fast(GBContext* ctx, uint16_t addr, uint8_t value) {
+    uint8_t* page = ctx->write_map[addr >> 8];
+    if (page) { page[addr & 0xFF] = value; return; }
+    gb_write8_slow(ctx, addr, value);
+}
+
+/**
+ * @brief Store to WRAM bank 0 or its echo, used for static addresses in generated code
+ * @param offset Offset into WRAM (below 0x1000)
+ */
+static inline void gb_wram_write(GBContext* ctx, uint16_t offset, uint8_t value) {
+    if (ctx->code_pages[0xC0 + (offset >> 8)]) gb_code_invalidate(ctx, 0xC0 + (offset >> 8));
+    ctx->wram[offset] = value;
+    ctx->state_dirty[offset >> 8] = 1;
+}
+
+/**
+ * @brief Store to HRAM, used for static addresses in generated code
+ * @param offset Offset into HRAM (below 0x7F)
+ */
+static inline void gb_hram_write(GBContext* ctx, uint8_t offset, uint8_t value) {
+    if (ctx->code_pages[0xFF]) gb_code_invalidate(ctx, 0xFF);
+    ctx->hram[offset] = value;
+}
+
+/**
+ * @brief Load from OAM, used for static addresses in generated code
+ *
+ * Reads 0xFF while an OAM DMA transfer is running.
+ * @param offset Offset into OAM (below 0xA0)
+ */
+uint8_t gb_oam_read(GBContext* ctx, uint8_t offset);
+
+/**
+ * @brief Store to OAM, used for static addresses in generated code
+ *
+ * Syncs the PPU first and marks the sprite line buckets stale. Dropped
+ * while an OAM DMA transfer is running.
+ * @param offset Offset into OAM (below 0xA0)
+ */
+void gb_oam_write(GBContext* ctx, uint8_t offset, uint8_t value);
+
 /**
  * @brief Read a 16-bit word from memory (little-endian)
  * @param ctx CPU context
@@ -311,6 +822,92 @@ void gb_dispatch_call(GBContext* ctx, uint16_t addr);
  */
 void gb_interpret(GBContext* ctx, uint16_t addr);
 
+/* ============================================================================
+ * Outlined Sequences
+ * ========================================================================== */
+
+/*
+ * Out-of-line forms of the sequences generated code repeats most, used by
+ * functions compiled for size (gbrecomp --opt-size, and cold code of a
+ * profile): one call each where fast code inlines several statements.
+ */
+
+/**
+ * @brief Set PC to the next instruction and charge the cycles of this one
+ * @return true if execution must stop (ctx->stopped)
+ */
+bool gb_step_to(GBContext* ctx, uint16_t next_pc, uint32_t cycles);
+
+/**
+ * @brief Return from a function (RET, taken RET cc) and charge the cycles
+ */
+void gb_ret_tick(GBContext* ctx, uint32_t cycles);
+
+/**
+ * @brief CALL of a function resolved at compile time
+ *
+ * Pushes return_addr, jumps to target charging the cycles and calls func
+ * natively, unless execution must stop, the native call depth is used up
+ * or func's bank (if nonzero) is not selected.
+ * @return true if func returned to return_addr and execution continues
+ */
+bool gb_call_native(GBContext* ctx, uint16_t return_addr, uint16_t target, uint32_t cycles,
+                    uint8_t bank, void (*func)(GBContext* ctx, uint16_t entry));
+
+/* ============================================================================
+ * Loop Idioms
+ * ========================================================================== */
+
+/**
+ * @brief Registers named by the loop intrinsics
+ */
+typedef enum {
+    GB_LOOP_B, GB_LOOP_C, GB_LOOP_D, GB_LOOP_E, GB_LOOP_H, GB_LOOP_L,
+    GB_LOOP_BC = 8, GB_LOOP_DE, GB_LOOP_HL,
+} GBLoopReg;
+
+/*
+ * The recompiler replaces recognized copy, fill and LY polling loops by
+ * these calls. Each replays the loop with its exact register, flag and
+ * memory effects, ticking `cycles` (one iteration with the branch taken)
+ * between iterations. It returns true after the exiting iteration, whose
+ * cycles the caller charges, or false when an event stopped the CPU at the
+ * loop head.
+ *
+ * The counter is an 8-bit register (`DEC r; JR NZ`) or a pair tested
+ * through A (`DEC rr; LD A,hi; OR lo; JR NZ`).
+ */
+
+/**
+ * @brief do { A = (src); (dst) = A; src += src_step; dst += dst_step; } while (--counter)
+ */
+bool gbrt_block_copy(GBContext* ctx, GBLoopReg dst, int dst_step,
+                     GBLoopReg src, int src_step, GBLoopReg counter, uint32_t cycles);
+
+/**
+ * @brief do { A = value; (dst) = A; dst += dst_step; } while (--counter)
+ * @param value Byte loaded into A each iteration, or -1 to store A as is
+ */
+bool gbrt_block_fill(GBContext* ctx, GBLoopReg dst, int dst_step, int value,
+                     GBLoopReg counter, uint32_t cycles);
+
+/**
+ * @brief do { A = LY; CP value; } while (cond), cond 0-3 = NZ, Z, NC, C
+ *
+ * Polls that would read the same LY before the next scheduled event are
+ * skipped in one step.
+ */
+bool gbrt_wait_ly(GBContext* ctx, uint8_t value, uint8_t cond, uint32_t cycles);
+
+/**
+ * @brief The standard HRAM OAM DMA routine at addr, from its LDH to its RET
+ *
+ * LDH (46),A; LD A,delay; DEC A; JR NZ,-3; RET with the routine's own
+ * register, flag and cycle effects. When an event stops the CPU inside it,
+ * ctx->pc is left at the next instruction of the routine.
+ */
+void gbrt_oam_dma(GBContext* ctx, uint16_t addr, uint8_t delay);
+
 /* ============================================================================
  * CPU State
  * ========================================================================== */
@@ -321,10 +918,18 @@ void gb_interpret(GBContext* ctx, uint16_t addr);
 void gb_halt(GBContext* ctx);
 
 /**
- * @brief Stop the CPU (and LCD)
+ * @brief Stop the CPU (and LCD), or switch CGB speed when KEY1 is armed
  */
 void gb_stop(GBContext* ctx);
 
+/**
+ * @brief Take the highest-priority pending interrupt if IME is set
+ *
+ * Pushes PC, jumps to the vector and wakes a halted CPU; gb_run_frame
+ * calls it before every step.
+ */
+void gb_handle_interrupts(GBContext* ctx);
+
 /* ============================================================================
  * Flag Helpers
  * ========================================================================== */
@@ -368,10 +973,67 @@ bool gb_frame_complete(GBContext* ctx);
 /**
  * @brief Get the current framebuffer
  * @param ctx CPU context
- * @return Pointer to 160x144 ARGB8888 framebuffer, or NULL if not ready
+ * @return Pointer to 160x144 ARGB8888 framebuffer, or NULL if not ready or
+ *         another pixel format is selected
  */
 const uint32_t* gb_get_framebuffer(GBContext* ctx);
 
+/**
+ * @brief Select the pixel format the PPU writes its display output in
+ *
+ * GB_PIXEL_INDEX skips color output entirely; use gb_get_shades() to read
+ * the frame (e.g. for hashing in headless runs).
+ * @param ctx CPU context
+ * @param format Output format
+ */
+void gb_set_pixel_format(GBContext* ctx, GBPixelFormat format);
+
+/**
+ * @brief Make the PPU write display lines straight into a caller-owned buffer
+ *
+ * Used by the platform layer to render into locked texture memory without
+ * an intermediate copy. While a buffer is bound gb_get_framebuffer() returns
+ * NULL, since that memory may be write-only. Pass NULL to go back to the
+ * internal framebuffer.
+ * @param ctx CPU context
+ * @param pixels 160x144 destination in the selected pixel format, or NULL
+ * @param pitch Bytes per destination row
+ */
+void gb_set_output_buffer(GBContext* ctx, void* pixels, int pitch);
+
+/**
+ * @brief Write the lines the PPU has not written to the output buffer yet
+ *
+ * Call before handing a buffer set with gb_set_output_buffer() to the
+ * display: with the LCD off no line is rendered, and a locked texture's
+ * memory is not guaranteed to hold the previous contents.
+ */
+void gb_fill_output(GBContext* ctx);
+
+/**
+ * @brief Get the display framebuffer in the selected pixel format
+ * @return 160x144 pixels (32 or 16 bits each), or NULL in index mode
+ */
+const void* gb_get_pixels(GBContext* ctx);
+
+/**
+ * @brief Get the 160x144 buffer of 2-bit shades for the current frame
+ */
+const uint8_t* gb_get_shades(GBContext* ctx);
+
+/**
+ * @brief Take the display lines changed since the previous call
+ *
+ * For encoders that send only what changed. Each rendered line is compared
+ * with the shades it held before, so a line redrawn identically is not
+ * reported, nor are the lines of skipped frames, which are not redrawn.
+ * Changes accumulate until the next call, so a delta need not be taken
+ * every frame. Reset, rewinding and selecting a pixel format report every
+ * line.
+ * @return false if no line changed (the frame can be skipped)
+ */
+bool gb_get_frame_delta(GBContext* ctx, GBFrameDelta* delta);
+
 /**
  * @brief Reset the frame ready flag for the next frame
  * @param ctx CPU context
@@ -379,9 +1041,88 @@ const uint32_t* gb_get_framebuffer(GBContext* ctx);
 void gb_reset_frame(GBContext* ctx);
 
 /**
- * @brief Process hardware for the given number of cycles
+ * @brief Configure fast-forward
+ *
+ * Skipped frames still run the PPU mode state machine, so LY, STAT and
+ * VBlank timing are unaffected; only scanline rendering and the RGB
+ * conversion are omitted.
+ * @param ctx CPU context
+ * @param turbo Run uncapped
+ * @param frame_skip Draw one of every frame_skip frames (0 or 1 = draw all)
+ * @param mute_audio Skip APU sample synthesis (registers keep updating)
+ */
+void gb_set_turbo(GBContext* ctx, bool turbo, uint8_t frame_skip, bool mute_audio);
+
+/**
+ * @brief Check whether the most recently completed frame was drawn
+ */
+bool gb_frame_drawn(GBContext* ctx);
+
+/**
+ * @brief Arm an event slot to fire after the given number of cycles
+ */
+void gb_schedule_event(GBContext* ctx, GBEventType type, uint32_t delay);
+
+/**
+ * @brief Disarm an event slot
+ */
+void gb_cancel_event(GBContext* ctx, GBEventType type);
+
+/**
+ * @brief Service all due events and recompute next_event
+ *
+ * Also applies a pending EI and sets ctx->stopped when a frame completes
+ * or an enabled interrupt is pending.
+ */
+void gb_run_events(GBContext* ctx);
+
+/**
+ * @brief Force the scheduler to run at the next tick
+ *
+ * Used after IME, IE or IF change so pending interrupts are noticed.
+ */
+static inline void gb_schedule_now(GBContext* ctx) {
+    ctx->next_event = ctx->cycles;
+}
+
+/**
+ * @brief Advance time by the given number of cycles
+ *
+ * Generated code checks ctx->stopped only at safe points (control flow,
+ * EI, IE/IF writes, before DI, and at least every 64 cycles), so a due
+ * interrupt or a finished frame may be noticed that much later.
  */
-void gb_tick(GBContext* ctx, uint32_t cycles);
+static inline void gb_tick(GBContext* ctx, uint32_t cycles) {
+    ctx->cycles += cycles;
+    if ((int32_t)(ctx->cycles - ctx->next_event) >= 0) gb_run_events(ctx);
+}
+
+/* ============================================================================
+ * Profiling
+ * ========================================================================== */
+
+/**
+ * @brief Host timestamp in profiling ticks (TSC where available, else ns)
+ */
+uint64_t gbrt_profile_ticks(void);
+
+/**
+ * @brief Charge the time since the last switch to the current section and enter another
+ * @return The section that was current
+ */
+static inline GBProfileSection gbrt_profile_switch(GBContext* ctx, GBProfileSection section) {
+    uint64_t now = gbrt_profile_ticks();
+    GBProfileSection previous = (GBProfileSection)ctx->profile_section;
+    ctx->profile_ticks[previous] += now - ctx->profile_mark;
+    ctx->profile_mark = now;
+    ctx->profile_section = (uint8_t)section;
+    return previous;
+}
+
+/**
+ * @brief Zero the profile and start charging GB_PROFILE_OTHER
+ */
+void gbrt_profile_reset(GBContext* ctx);
 
 /* ============================================================================
  * Platform Interface
@@ -408,20 +1149,42 @@ void gb_set_platform_callbacks(GBContext* ctx, const GBPlatformCallbacks* callba
 
 /**
  * @brief Run one frame of emulation
+ *
+ * An attached input movie supplies or records the frame's joypad state.
+ * With a rewind buffer attached the frame is recorded into it afterwards,
+ * and while rewind_held is set the frame steps back one recorded state
+ * instead (redrawing its picture, 0 cycles executed). An attached lockstep
+ * validator checks the context against its shadow after every step.
  * @return Number of cycles executed
  */
 uint32_t gb_run_frame(GBContext* ctx);
 
 /**
- * @brief Run a single step (one instruction or until interrupt)
- * @return Number of cycles executed
+ * @brief Start a frame as gb_run_frame() does
+ *
+ * gb_run_frame() is gb_frame_begin(), gb_frame_step() until frame_done is
+ * set, then gb_frame_end(). Callers that interleave the steps of several
+ * contexts (see batch.h) use the pieces directly.
+ * @return false if the frame is already complete (rewind held)
  */
-uint32_t gb_step(GBContext* ctx);
+bool gb_frame_begin(GBContext* ctx);
 
 /**
- * @brief Helper to invoke audio callback
+ * @brief One iteration of the frame loop: interrupts, then a step or HALT wait
  */
-void gb_audio_callback(GBContext* ctx, int16_t left, int16_t right);
+void gb_frame_step(GBContext* ctx);
+
+/**
+ * @brief Finish a frame once frame_done is set
+ * @return Number of cycles the frame executed
+ */
+uint32_t gb_frame_end(GBContext* ctx);
+
+/**
+ * @brief Run a single step (one instruction or until interrupt)
+ * @return Number of cycles executed
+ */
+uint32_t gb_step(GBContext* ctx);
 
 #ifdef __cplusplus
 }
@@ -10,6 +10,8 @@
  *   GB_DEBUG_FRAME  - Frame rendering events
  *   GB_DEBUG_REGS   - LCD register changes
  *   GB_DEBUG_ALL    - Enable everything
+ *
+ * Building with GBRT_INSTRUMENT=2 enables the GB_DEBUG set.
  */
 
 #ifndef GBRT_DEBUG_H
@@ -26,29 +28,32 @@ extern "C" {
  * Debug Configuration
  * ========================================================================== */
 
-/* Uncomment to enable specific debug categories */
-/* All debug disabled for performance in cpu_instrs testing */
-#define GB_DEBUG_PPU
-// #define GB_DEBUG_MEM  
-// #define GB_DEBUG_VRAM
-// #define GB_DEBUG_FRAME
-#define GB_DEBUG_REGS
-// #define GB_DEBUG_ALL
+/* Categories are selected by the build (see runtime/CMakeLists.txt) */
+#if defined(GBRT_INSTRUMENT) && GBRT_INSTRUMENT >= 2 && !defined(GB_DEBUG)
+#define GB_DEBUG
+#endif
 
 #ifdef GB_DEBUG_ALL
-#define GB_DEBUG_PPU
 #define GB_DEBUG_MEM
-#define GB_DEBUG_VRAM
-#define GB_DEBUG_FRAME
-#define GB_DEBUG_REGS
+#ifndef GB_DEBUG
+#define GB_DEBUG
+#endif
 #endif
 
 #ifdef GB_DEBUG
+#ifndef GB_DEBUG_PPU
 #define GB_DEBUG_PPU
+#endif
+#ifndef GB_DEBUG_VRAM
 #define GB_DEBUG_VRAM
+#endif
+#ifndef GB_DEBUG_FRAME
 #define GB_DEBUG_FRAME
+#endif
+#ifndef GB_DEBUG_REGS
 #define GB_DEBUG_REGS
 #endif
+#endif
 
 /* ============================================================================
  * Debug Logging Macros
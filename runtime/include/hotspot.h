@@ -0,0 +1,108 @@
+/**
+ * @file hotspot.h
+ * @brief Dispatch and interpreter fallback counters (GBRT_HOTSPOTS = 1)
+ *
+ * Counts, per bank:address, how often each recompiled function was entered,
+ * how often execution fell back to gb_interpret, how many instructions the
+ * interpreter ran from there, and how often a computed jump (JP HL) landed
+ * there. Fallbacks are code the analyzer missed; the entry points file
+ * written from them can be passed back to gbrecomp with --entry-points to
+ * recompile it. The full profile is read by gbrecomp --profile, which also
+ * lays out and optimizes the hot functions apart from the cold ones.
+ *
+ * Attach a table with gb_hotspots_attach(). In builds without
+ * GBRT_HOTSPOTS the counters are compiled out and the table stays empty.
+ */
+
+#ifndef GB_HOTSPOT_H
+#define GB_HOTSPOT_H
+
+#include "gbrt.h"
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct GBHotspots GBHotspots;
+
+/**
+ * @brief Counters for one bank:address
+ */
+typedef struct {
+    uint8_t bank;            /**< ROM bank for 0x4000-0x7FFF, else 0 */
+    uint16_t addr;
+    uint64_t calls;          /**< Entries into the recompiled function here */
+    uint64_t fallbacks;      /**< gb_interpret entries */
+    uint64_t instructions;   /**< Instructions interpreted from those entries */
+    uint64_t jumps;          /**< Computed jumps landing here */
+} GBHotspot;
+
+/**
+ * @brief Create an empty counter table
+ * @return The table, or NULL on allocation failure
+ */
+GBHotspots* gb_hotspots_create(void);
+
+/**
+ * @brief Free a counter table (detach it from its context first)
+ */
+void gb_hotspots_destroy(GBHotspots* hs);
+
+/**
+ * @brief Count the context's execution into the table, or stop with NULL
+ */
+void gb_hotspots_attach(GBContext* ctx, GBHotspots* hs);
+
+/**
+ * @brief Count an interpreter block entered at bank:addr
+ */
+void gb_hotspots_fallback(GBHotspots* hs, uint8_t bank, uint16_t addr, uint64_t instructions);
+
+/**
+ * @brief Addresses with any count so far
+ */
+size_t gb_hotspots_count(const GBHotspots* hs);
+
+/**
+ * @brief Copy the counters out, most interpreted instructions first
+ * @param out Receives up to max entries
+ * @return Entries written
+ */
+size_t gb_hotspots_sorted(const GBHotspots* hs, GBHotspot* out, size_t max);
+
+/**
+ * @brief Print the interpreter fallbacks and the busiest functions
+ * @param limit Rows per section (0 = all)
+ */
+void gb_hotspots_report(const GBHotspots* hs, FILE* out, size_t limit);
+
+/**
+ * @brief Write every counter as a JSON profile for gbrecomp --profile
+ *
+ * {"format": "gbrt-profile", "version": 1, "sites": [{"bank": 1,
+ * "addr": 16384, "calls": 0, "fallbacks": 2, "instructions": 31,
+ * "jumps": 0}, ...]}, most interpreted first.
+ * @return true on success
+ */
+bool gb_hotspots_write_profile(const GBHotspots* hs, const char* path);
+
+/**
+ * @brief Write the ROM fallback addresses as a gbrecomp entry points file
+ *
+ * One "bank:addr" in hex per line, most interpreted first. Fallbacks in RAM
+ * are left out; they need a RAM overlay rather than an entry point.
+ * @return true on success
+ */
+bool gb_hotspots_write_entry_points(const GBHotspots* hs, const char* path);
+
+/* Bank an address is counted under */
+static inline uint8_t gb_hotspot_bank(const GBContext* ctx, uint16_t addr) {
+    return addr >= 0x4000 && addr < 0x8000 ? ctx->rom_bank : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GB_HOTSPOT_H */
@@ -0,0 +1,109 @@
+/**
+ * @file jit.h
+ * @brief Runtime translation of hot interpreted code (GBRT_JIT = 1)
+ *
+ * Code the static recompiler never saw - routines copied to WRAM, ROM
+ * reached only through computed jumps - runs in gb_interpret. Once an
+ * interpreter entry point has been entered threshold times, the run of
+ * instructions starting there is translated to host code and later
+ * entries jump straight into it. Translations live in the interpreter's
+ * decode cache, so the stores and bank switches that drop a decoded page
+ * drop its translations as well.
+ *
+ * Only x86-64 hosts with mmap are supported; elsewhere gb_jit_create
+ * returns NULL and everything stays interpreted. In builds without
+ * GBRT_JIT the interpreter never consults the translator.
+ */
+
+#ifndef GB_JIT_H
+#define GB_JIT_H
+
+#include "gbrt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Interpreter entries before a block is translated when 0 is passed */
+#define GB_JIT_DEFAULT_THRESHOLD 32
+
+typedef struct GBJit GBJit;
+
+/**
+ * @brief Translated block
+ * @return Nonzero if it left through a taken branch, call or return;
+ *         zero if execution continues in the interpreter at ctx->pc
+ */
+typedef int (*GBJitBlock)(GBContext* ctx);
+
+/**
+ * @brief Create a translator with its own code buffer
+ * @param threshold Entries before translating (0 = default, at most 65535)
+ * @return The translator, or NULL if the host is unsupported
+ */
+GBJit* gb_jit_create(uint32_t threshold);
+
+/**
+ * @brief Free a translator (detach it from its context first)
+ */
+void gb_jit_destroy(GBJit* jit);
+
+/**
+ * @brief Translate the context's hot interpreted code, or stop with NULL
+ *
+ * Drops the decode cache, and with it any blocks of a previous translator.
+ */
+void gb_jit_attach(GBContext* ctx, GBJit* jit);
+
+/**
+ * @brief Entries before a block is translated
+ */
+uint32_t gb_jit_threshold(const GBJit* jit);
+
+/**
+ * @brief Whether the code buffer can take another block
+ *
+ * When it cannot, the caller forgets all blocks and calls gb_jit_reset.
+ */
+bool gb_jit_has_room(const GBJit* jit);
+
+/**
+ * @brief Empty the code buffer; all blocks become invalid
+ */
+void gb_jit_reset(GBJit* jit);
+
+/**
+ * @brief Translate the instructions at addr
+ * @param page Host memory of the 256-byte page holding addr
+ * @param bank ROM bank addr was entered in, naming the block in the perf map
+ * @return The block, or NULL if the first instruction has no translation
+ */
+GBJitBlock gb_jit_translate(GBJit* jit, const uint8_t* page, uint8_t bank, uint16_t addr);
+
+/**
+ * @brief Name blocks translated from now on in /tmp/perf-<pid>.map
+ *
+ * perf reads the file to attribute samples in translated code, which it
+ * otherwise reports as anonymous memory: each block gets a line naming it
+ * gbjit_<bank>_<addr>. Blocks that reuse buffer space after a reset are
+ * appended again, and perf takes the latest line for an address.
+ * @return false if the file cannot be opened
+ */
+bool gb_jit_perf_map(GBJit* jit);
+
+/**
+ * @brief Blocks translated since creation
+ */
+uint64_t gb_jit_blocks(const GBJit* jit);
+
+/** Instruction length by opcode, CB-prefixed ones counting as 2 (interpreter.c) */
+extern const uint8_t gb_op_length[256];
+
+/** Cycles by opcode with branches not taken, CB-prefixed ones excepted (interpreter.c) */
+extern const uint8_t gb_op_cycles[256];
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GB_JIT_H */
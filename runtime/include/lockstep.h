@@ -0,0 +1,116 @@
+/**
+ * @file lockstep.h
+ * @brief Differential validation of recompiled code against the interpreter
+ *
+ * A lockstep validator keeps a shadow context that only ever runs through
+ * gb_interpret. After every step of gb_run_frame() (each return to the run
+ * loop from recompiled code or a HALT wait) the shadow is brought to the
+ * same cycle, stopping exactly there through GB_EVENT_BREAK, with the same
+ * joypad state and the same interrupt dispatches. Recompiled code with
+ * nested native calls may not return for a whole frame, so the context is
+ * also sent back to the run loop at its next safe point every interval
+ * cycles; it then resumes through gb_dispatch as after an interrupt. The
+ * two are then compared by a 64-bit hash of the registers, flags, HRAM, IF
+ * and IE and of the WRAM and VRAM pages either wrote since the last step;
+ * OAM and ERAM, which are not dirty-tracked, are compared once per frame.
+ * The first difference is reported with the bank:address the step was
+ * entered at and both register sets, and validation stops there.
+ *
+ * The -O1 dead-code and dead-flag passes leave registers and flags the
+ * program never reads stale. Generated code exports what is live before
+ * each of its instructions (<prefix>_live_masks); with the table set, a
+ * register or flag dead at the step's end is not compared but copied from
+ * the context into the shadow, so both carry on identically (e.g. when an
+ * interrupt handler pushes AF). Without it everything is compared, which
+ * only holds for code recompiled with -O0.
+ *
+ * Only dirty pages are hashed, so a validated run costs about twice an
+ * interpreted one and can cover a full-length input movie. While attached,
+ * the validator owns the context's dirty-page tracking: rewind snapshots
+ * fall back to full copies, and loading a state or stepping back desyncs
+ * the shadow (attach again to restart from the current state). With
+ * GB_MOVIE_PER_POLL movies the shadow sees the joypad as it was at the end
+ * of each step.
+ */
+
+#ifndef GB_LOCKSTEP_H
+#define GB_LOCKSTEP_H
+
+#include "gbrt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Cycles between forced returns used when 0 is passed (1/16 frame) */
+#define GB_LOCKSTEP_DEFAULT_INTERVAL 4389
+
+typedef struct GBLockstep GBLockstep;
+
+/* Liveness bits of GBLiveMask::live */
+#define GB_LIVE_B   0x001
+#define GB_LIVE_C   0x002
+#define GB_LIVE_D   0x004
+#define GB_LIVE_E   0x008
+#define GB_LIVE_H   0x010
+#define GB_LIVE_L   0x020
+#define GB_LIVE_SP  0x040
+#define GB_LIVE_A   0x080
+#define GB_LIVE_FC  0x100
+#define GB_LIVE_FH  0x200
+#define GB_LIVE_FN  0x400
+#define GB_LIVE_FZ  0x800
+#define GB_LIVE_ALL 0xFFF
+
+/**
+ * @brief Registers and flags live before one instruction of optimized code
+ */
+typedef struct {
+    uint32_t key;       /**< bank << 16 | address, bank 0 below 0x4000 */
+    uint16_t live;      /**< GB_LIVE_* bits */
+} GBLiveMask;
+
+/**
+ * @brief Create a validator with a shadow context for the context's ROM
+ * @param interval Cycles between forced returns of the recompiled code
+ *                 (0 = default); smaller values pin a divergence down closer
+ * @return The validator, or NULL on allocation failure
+ */
+GBLockstep* gb_lockstep_create(const GBContext* ctx, uint32_t interval);
+
+/**
+ * @brief Free a validator (detach it from its context first)
+ */
+void gb_lockstep_destroy(GBLockstep* ls);
+
+/**
+ * @brief Start validating from the context's current state, or detach with NULL
+ */
+void gb_lockstep_attach(GBContext* ctx, GBLockstep* ls);
+
+/**
+ * @brief Catch the shadow up to the context and compare; called after each step
+ */
+void gb_lockstep_check(GBLockstep* ls, GBContext* ctx);
+
+/**
+ * @brief Compare only what is live where each step ends
+ * @param masks Sorted by key; addresses not listed have everything live
+ */
+void gb_lockstep_set_live_masks(GBLockstep* ls, const GBLiveMask* masks, size_t count);
+
+/**
+ * @brief Whether a divergence has been found (and reported on stderr)
+ */
+bool gb_lockstep_diverged(const GBLockstep* ls);
+
+/**
+ * @brief Steps compared so far, including the diverging one
+ */
+uint64_t gb_lockstep_steps(const GBLockstep* ls);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GB_LOCKSTEP_H */
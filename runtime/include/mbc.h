@@ -0,0 +1,102 @@
+/**
+ * @file mbc.h
+ * @brief Cartridge memory bank controllers
+ *
+ * Each MBC family is a mapper table of the handlers for cartridge stores
+ * and for ERAM accesses that miss the page tables. Bank-switch writes set
+ * ctx->rom_bank, ctx->rom_bank0 and ctx->ram_bank and remap only the
+ * affected 0x4000 or 0x2000 bytes of read_map and write_map, so a switch
+ * costs the same whatever the cartridge size. ERAM is left to the slow
+ * path while it is disabled or while an MBC3 clock register is selected.
+ *
+ * Generated code runs 0x0000-0x3FFF code from ROM bank 0, so the MBC1
+ * mode 1 remapping of that area on ROMs over 512 KiB only reaches data
+ * reads (which go through the page tables on such ROMs) and the
+ * interpreter.
+ *
+ * The MBC3 clock counts emulated time (one second per 4194304 cycles), so
+ * it stays deterministic across replays and save states.
+ */
+
+#ifndef GB_MBC_H
+#define GB_MBC_H
+
+#include "gbrt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Mapper family, as stored in ctx->mbc_type
+ */
+typedef enum {
+    GB_MBC_NONE,  /**< 32 KiB ROM, optional unbanked RAM */
+    GB_MBC_1,     /**< Up to 2 MiB ROM, 32 KiB RAM */
+    GB_MBC_2,     /**< Up to 256 KiB ROM, 512 x 4-bit built-in RAM */
+    GB_MBC_3,     /**< Up to 2 MiB ROM, 32 KiB RAM, optional clock */
+    GB_MBC_5,     /**< Up to 8 MiB ROM, 128 KiB RAM */
+    GB_MBC_COUNT
+} GBMbcType;
+
+/**
+ * @brief Handlers of one mapper family
+ */
+typedef struct GBMapper {
+    const char* name;
+    /** Store to 0x0000-0x7FFF */
+    void (*write_rom)(GBContext* ctx, uint16_t addr, uint8_t value);
+    /** Load from 0xA000-0xBFFF while its page is not mapped */
+    uint8_t (*read_ram)(GBContext* ctx, uint16_t addr);
+    /** Store to 0xA000-0xBFFF while its page is not mapped */
+    void (*write_ram)(GBContext* ctx, uint16_t addr, uint8_t value);
+    /** Whether ctx->ram_bank selects plain ERAM that can be mapped */
+    bool (*ram_mapped)(const GBContext* ctx);
+} GBMapper;
+
+/**
+ * @brief Mapper table of a family
+ */
+const GBMapper* gb_mbc_mapper(GBMbcType type);
+
+/**
+ * @brief Pick the mapper and allocate ERAM from the attached ROM's header
+ * @return false if ERAM could not be allocated
+ */
+bool gb_mbc_attach(GBContext* ctx);
+
+/**
+ * @brief Free the ERAM allocated by gb_mbc_attach, closing its save file
+ */
+void gb_mbc_release(GBContext* ctx);
+
+/**
+ * @brief Keep battery-backed ERAM (and the MBC3 clock) in a save file
+ *
+ * The file's contents become ERAM, or it is created from the current ERAM.
+ * Where mmap is available ERAM is the file mapping, so stores cost nothing
+ * extra and the kernel writes them back in the background; they survive a
+ * crash of the process. Elsewhere the file is written when the ROM is
+ * released. Each context of a batch can be given its own file.
+ * @return false if the cartridge has no battery RAM or the file cannot be used
+ */
+bool gb_mbc_map_save(GBContext* ctx, const char* path);
+
+/**
+ * @brief Power-on bank registers (does not update the page tables)
+ */
+void gb_mbc_reset(GBContext* ctx);
+
+/**
+ * @brief Advance the MBC3 clock to ctx->cycles
+ *
+ * Run at least every few minutes of emulated time (gb_run_frame does) so
+ * the 32-bit cycle counter cannot wrap between syncs.
+ */
+void gb_rtc_sync(GBContext* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GB_MBC_H */
@@ -0,0 +1,108 @@
+/**
+ * @file movie.h
+ * @brief Deterministic input movies with periodic state checksums
+ *
+ * A movie is the joypad state of every frame (or of every JOYP read, for
+ * games that poll mid-frame) from power-on, plus a hash of the picture and
+ * RAM every few frames. Replaying it drives the joypad from the movie
+ * instead of the frontend and compares the hashes, which makes runs
+ * reproducible for benchmarking and catches any change in emulated timing.
+ *
+ * Attach a movie with gb_movie_attach() right after the context is
+ * initialized; gb_run_frame() then records or replays it.
+ */
+
+#ifndef GB_MOVIE_H
+#define GB_MOVIE_H
+
+#include "gbrt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Record one input sample per JOYP (0xFF00) read instead of per frame */
+#define GB_MOVIE_PER_POLL 0x01
+
+/** Frames between checksums used when 0 is passed */
+#define GB_MOVIE_DEFAULT_CHECK_INTERVAL 60
+
+typedef struct GBMovie GBMovie;
+
+/**
+ * @brief Start recording a movie of the context's ROM
+ * @param flags GB_MOVIE_* flags
+ * @param check_interval Frames between checksums (0 = default)
+ * @return The movie, or NULL on allocation failure
+ */
+GBMovie* gb_movie_create(const GBContext* ctx, uint32_t flags, uint32_t check_interval);
+
+/**
+ * @brief Load a movie file for replay
+ * @return The movie, or NULL if the file is missing or malformed
+ */
+GBMovie* gb_movie_load(const char* path);
+
+/**
+ * @brief Write a recorded movie to a file
+ * @return true on success
+ */
+bool gb_movie_save(const GBMovie* movie, const char* path);
+
+/**
+ * @brief Free a movie (detach it from its context first)
+ */
+void gb_movie_destroy(GBMovie* movie);
+
+/**
+ * @brief Record or replay the movie from gb_run_frame(), or detach it with NULL
+ * @return false if a replayed movie was recorded on a different ROM
+ */
+bool gb_movie_attach(GBContext* ctx, GBMovie* movie);
+
+/**
+ * @brief Apply or sample the frame's input; called before each frame
+ */
+void gb_movie_begin_frame(GBMovie* movie, GBContext* ctx);
+
+/**
+ * @brief Record or verify the checksum; called after each frame
+ */
+void gb_movie_end_frame(GBMovie* movie, GBContext* ctx);
+
+/**
+ * @brief Apply or sample the input at a JOYP read (GB_MOVIE_PER_POLL)
+ */
+void gb_movie_poll(GBMovie* movie, GBContext* ctx);
+
+/**
+ * @brief Frames recorded so far, or the length of a replayed movie
+ */
+uint32_t gb_movie_length(const GBMovie* movie);
+
+/**
+ * @brief Frames run since the movie was attached
+ */
+uint32_t gb_movie_frame(const GBMovie* movie);
+
+/**
+ * @brief Whether a replay has run all of its frames
+ */
+bool gb_movie_finished(const GBMovie* movie);
+
+/**
+ * @brief Count of checksums that did not match during replay
+ * @param first_frame Receives the frame of the first mismatch, if any (may be NULL)
+ */
+uint32_t gb_movie_mismatches(const GBMovie* movie, uint32_t* first_frame);
+
+/**
+ * @brief Hash of the picture, WRAM and HRAM used for the checksums
+ */
+uint64_t gb_movie_state_hash(GBContext* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GB_MOVIE_H */
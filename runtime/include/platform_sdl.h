@@ -13,10 +13,6 @@
 extern "C" {
 #endif
 
-// Joypad state variables
-extern uint8_t g_joypad_buttons;
-extern uint8_t g_joypad_dpad;
-
 typedef struct GBContext GBContext;
 
 /**
@@ -39,9 +35,56 @@ bool gb_platform_poll_events(GBContext* ctx);
 
 /**
  * @brief Render frame to screen
+ *
+ * When a context is bound with gb_platform_bind_framebuffer() the PPU has
+ * already drawn into the texture and framebuffer is ignored.
  */
 void gb_platform_render_frame(const uint32_t* framebuffer);
 
+/**
+ * @brief Have the PPU of ctx render straight into the streaming texture
+ *
+ * The texture stays locked while a frame is emulated and is unlocked only
+ * to present it, so no framebuffer copy or upload is needed. Lines the PPU
+ * did not render (LCD off) are filled in before each unlock, since locked
+ * texture memory need not hold the last frame. Pass NULL to unbind.
+ */
+void gb_platform_bind_framebuffer(GBContext* ctx);
+
+/**
+ * @brief Emulate ctx on a worker thread while this thread presents
+ *
+ * Call from the thread that created the window (the main thread, as macOS
+ * requires): SDL's renderer and event queue are only usable there, so it
+ * keeps them and the worker runs the game loop, pacing itself as
+ * gb_platform_vsync() does. Completed frames are handed over through a
+ * lock-free triple buffer, so vsync and driver stalls no longer block
+ * emulation. Returns once the window is closed and the worker has stopped.
+ * @return false if the worker could not be started (nothing was run)
+ */
+bool gb_platform_run_threaded(GBContext* ctx);
+
+/**
+ * @brief Queue interleaved stereo int16 frames for the audio device
+ *
+ * Safe to call from the emulation thread while the device is playing.
+ * @return Frames accepted (the rest are dropped when the queue is full)
+ */
+int gb_platform_queue_audio(const int16_t* samples, int frames);
+
+/**
+ * @brief Stereo frames currently queued for playback
+ */
+int gb_platform_audio_queued(void);
+
+/**
+ * @brief Move the APU's synthesized samples into the device queue
+ *
+ * Call once per emulated frame. Sets the APU output rate to the device rate
+ * on first use.
+ */
+void gb_platform_pump_audio(GBContext* ctx);
+
 /**
  * @brief Get joypad state
  * @return Joypad byte (active low)
@@ -50,6 +93,9 @@ uint8_t gb_platform_get_joypad(void);
 
 /**
  * @brief Wait for vsync / frame timing
+ *
+ * Paces on the audio queue fill level while the APU feeds an open audio
+ * device, otherwise on a ~60 Hz timer.
  */
 void gb_platform_vsync(void);
 
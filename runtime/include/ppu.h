@@ -8,6 +8,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "gbrt.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -38,6 +39,8 @@ extern "C" {
 #define OAM_SIZE           0xA0
 #define TILES_PER_BANK     384
 #define TILE_SIZE          16   /* 8x8 pixels, 2 bits per pixel */
+#define TILE_CACHE_TILES   (TILES_PER_BANK * 2)  /* Both CGB VRAM banks */
+#define PPU_MAX_LINE_SPRITES 10 /* Hardware limit of sprites per scanline */
 
 /* ============================================================================
  * LCD Control Register (LCDC - 0xFF40)
@@ -118,12 +121,52 @@ typedef struct GBPPU {
     uint32_t mode_cycles;     /* Cycles in current mode */
     uint8_t window_line;      /* Current window internal line counter */
     bool window_triggered;    /* Window was triggered this frame */
+    bool dma_active;          /* OAM DMA transfer in flight */
+    bool skip_render;         /* Current frame is not drawn (frame skip) */
     
-    /* Framebuffer (2-bit color indices) */
+    /* Palette registers expanded to shade lookup tables */
+    uint8_t bg_palette[4];
+    uint8_t obj_palette[2][4];
+    
+    /* Raw BG/window color indices of the line being rendered */
+    uint8_t bg_line[GB_SCREEN_WIDTH];
+    
+    /* Decoded tiles (one color index per pixel), refreshed lazily when the
+     * tile's bit in tile_dirty is set by a VRAM write */
+    uint8_t tile_cache[TILE_CACHE_TILES][8][8];
+    uint8_t tile_cache_flip[TILE_CACHE_TILES][8][8];  /* X-flipped rows */
+    uint32_t tile_dirty[TILE_CACHE_TILES / 32];
+    
+    /* OAM indices covering each line in drawing priority order, rebuilt
+     * when OAM is written (oam_dirty) or the sprite height changes */
+    uint8_t line_sprites[GB_SCREEN_HEIGHT][PPU_MAX_LINE_SPRITES];
+    uint8_t line_sprite_count[GB_SCREEN_HEIGHT];
+    uint8_t sprite_lines_height;
+    bool oam_dirty;
+    
+    /* Framebuffer (2-bit shades after palette) */
     uint8_t framebuffer[GB_FRAMEBUFFER_SIZE];
     
-    /* RGB framebuffer for display (32-bit RGBA) */
+    /* Hash of each framebuffer line, and the lines whose shades changed
+     * since the last frame delta was taken */
+    uint64_t line_hash[GB_SCREEN_HEIGHT];
+    bool line_changed[GB_SCREEN_HEIGHT];
+    
+    /* Display framebuffer, written line by line in pixel_format
+     * (RGB565 packs 16-bit pixels into the start of the buffer) */
     uint32_t rgb_framebuffer[GB_FRAMEBUFFER_SIZE];
+    uint32_t shade_colors[4];  /* Shade -> pixel value in pixel_format */
+    uint8_t pixel_format;      /* GBPixelFormat */
+    
+    /* Where display lines are written: rgb_framebuffer, or a caller-owned
+     * buffer such as a locked texture (out_pitch 0 = tightly packed) */
+    void* out_pixels;
+    int out_pitch;
+    
+    /* Lines written to out_pixels since it was set; locked texture memory
+     * holds undefined data in the others */
+    bool out_written[GB_SCREEN_HEIGHT];
+    uint8_t out_written_count;
     
     /* Frame complete flag */
     bool frame_ready;
@@ -149,6 +192,19 @@ void ppu_reset(GBPPU* ppu);
  */
 void ppu_tick(GBPPU* ppu, GBContext* ctx, uint32_t cycles);
 
+/**
+ * @brief Cycles until the PPU next needs to run, or 0 if the LCD is off
+ *
+ * This is the next mode transition, or the next VBlank entry when no STAT
+ * interrupt source is enabled (LY and STAT are then computed on read).
+ */
+uint32_t ppu_cycles_until_event(const GBPPU* ppu);
+
+/**
+ * @brief Cycles until LY next changes, or 0 if the LCD is off
+ */
+uint32_t ppu_cycles_until_ly_change(const GBPPU* ppu);
+
 /**
  * @brief Read LCD register
  */
@@ -159,6 +215,25 @@ uint8_t ppu_read_register(GBPPU* ppu, uint16_t addr);
  */
 void ppu_write_register(GBPPU* ppu, GBContext* ctx, uint16_t addr, uint8_t value);
 
+/**
+ * @brief Store a byte to VRAM (0x8000-0x9FFF) and invalidate the decoded tile
+ *
+ * VRAM pages are left out of write_map so every store lands here.
+ */
+void ppu_vram_write(GBPPU* ppu, GBContext* ctx, uint16_t addr, uint8_t value);
+
+/**
+ * @brief Mark every cached tile stale, e.g. after VRAM is replaced wholesale
+ */
+void ppu_invalidate_tiles(GBPPU* ppu);
+
+/**
+ * @brief Mark the cached tiles overlapping part of VRAM stale
+ * @param offset Offset into both VRAM banks (bank 1 starts at VRAM_SIZE)
+ * @param size Bytes replaced
+ */
+void ppu_invalidate_vram(GBPPU* ppu, uint32_t offset, uint32_t size);
+
 /**
  * @brief Check if frame is ready
  */
@@ -170,10 +245,56 @@ bool ppu_frame_ready(GBPPU* ppu);
 void ppu_clear_frame_ready(GBPPU* ppu);
 
 /**
- * @brief Get the RGB framebuffer
+ * @brief Get the ARGB8888 framebuffer, or NULL in any other pixel format
  */
 const uint32_t* ppu_get_framebuffer(GBPPU* ppu);
 
+/**
+ * @brief Get the display framebuffer in the selected format, or NULL in index mode
+ */
+const void* ppu_get_pixels(GBPPU* ppu);
+
+/**
+ * @brief Get the 160x144 buffer of 2-bit shades (valid in every format)
+ */
+const uint8_t* ppu_get_shades(GBPPU* ppu);
+
+/**
+ * @brief Fill delta with the lines changed since the last call and clear them
+ * @return false if no line changed
+ */
+bool ppu_take_frame_delta(GBPPU* ppu, GBFrameDelta* delta);
+
+/**
+ * @brief Select the display pixel format and re-emit the current frame in it
+ */
+void ppu_set_pixel_format(GBPPU* ppu, GBPixelFormat format);
+
+/**
+ * @brief Re-emit the whole shade framebuffer, e.g. after it was replaced
+ *
+ * Every line is reported as changed by the next frame delta.
+ */
+void ppu_redraw(GBPPU* ppu);
+
+/**
+ * @brief Redirect display output to a caller-owned buffer (NULL restores the
+ *        internal one)
+ *
+ * Only lines rendered after the switch land in the new buffer, so swapping
+ * between frame buffers costs nothing.
+ */
+void ppu_set_output_buffer(GBPPU* ppu, void* pixels, int pitch);
+
+/**
+ * @brief Write every line not yet written to the output buffer since it was
+ *        set, from the current shades
+ *
+ * Lines are only written as they are rendered, so a frame with the LCD off
+ * (or a buffer set mid-frame) leaves some unwritten.
+ */
+void ppu_fill_output(GBPPU* ppu);
+
 /**
  * @brief Render a scanline
  */
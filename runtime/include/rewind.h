@@ -0,0 +1,84 @@
+/**
+ * @file rewind.h
+ * @brief Rewind buffer of delta-compressed snapshots
+ *
+ * Every interval frames the context is snapshotted (see state.h) together
+ * with its picture. The newest record is kept in full; older ones are
+ * stored as the XOR against their successor, run-length encoded, in a ring
+ * of bounded size. Most of a state is unchanged from one record to the
+ * next, so a record typically costs a few hundred bytes to a few KB.
+ *
+ * Attach a buffer with gb_rewind_attach() and gb_run_frame() records it
+ * and steps back while ctx->rewind_held is set.
+ */
+
+#ifndef GB_REWIND_H
+#define GB_REWIND_H
+
+#include "gbrt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Frames between records used when 0 is passed */
+#define GB_REWIND_DEFAULT_INTERVAL 2
+
+/** Delta bytes kept when 0 is passed (several minutes of typical play) */
+#define GB_REWIND_DEFAULT_BUDGET (16u << 20)
+
+typedef struct GBRewind GBRewind;
+
+/**
+ * @brief Create a rewind buffer for the context
+ * @param interval Frames between records (0 = default)
+ * @param budget Bytes of compressed history; the oldest records are
+ *               dropped beyond it (0 = default)
+ * @return The buffer, or NULL on allocation failure
+ */
+GBRewind* gb_rewind_create(const GBContext* ctx, uint32_t interval, size_t budget);
+
+/**
+ * @brief Free a rewind buffer (detach it from its context first)
+ */
+void gb_rewind_destroy(GBRewind* rw);
+
+/**
+ * @brief Feed the buffer from gb_run_frame(), or detach it with NULL
+ */
+void gb_rewind_attach(GBContext* ctx, GBRewind* rw);
+
+/**
+ * @brief Account one emulated frame, recording every interval frames
+ */
+void gb_rewind_record(GBRewind* rw, GBContext* ctx);
+
+/**
+ * @brief Go back to the previous record and redraw its picture
+ *
+ * Frames run since the newest record are undone first; the next step drops
+ * that record and goes back one interval.
+ * @return false if there was nothing to go back to
+ */
+bool gb_rewind_step(GBRewind* rw, GBContext* ctx);
+
+/**
+ * @brief Drop all history, e.g. after loading a save state
+ */
+void gb_rewind_clear(GBRewind* rw);
+
+/**
+ * @brief Records currently available to step back through
+ */
+size_t gb_rewind_count(const GBRewind* rw);
+
+/**
+ * @brief Bytes of compressed history in use
+ */
+size_t gb_rewind_memory(const GBRewind* rw);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GB_REWIND_H */
@@ -0,0 +1,95 @@
+/**
+ * @file state.h
+ * @brief Save states and fast in-memory snapshots
+ *
+ * A state is a versioned blob holding the CPU, PPU, APU and all emulated
+ * RAM. Host-side configuration (ROM, output buffers, sample rate, turbo,
+ * callbacks) is not part of it and is kept by the context it is loaded
+ * into. Blobs use host byte order and struct layout, so they are meant for
+ * the build that wrote them.
+ *
+ * Snapshots hold the same blob in a preallocated buffer and are updated
+ * incrementally: once a context has been saved to or restored from a
+ * snapshot, only the WRAM and VRAM pages written since are copied by the
+ * next gb_snapshot_take() or gb_snapshot_restore() on that snapshot.
+ */
+
+#ifndef GB_STATE_H
+#define GB_STATE_H
+
+#include "gbrt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Bumped whenever the blob layout changes */
+#define GB_STATE_VERSION 4
+
+/* ============================================================================
+ * Save States
+ * ========================================================================== */
+
+/**
+ * @brief Bytes needed to save the context's state
+ */
+size_t gb_state_size(const GBContext* ctx);
+
+/**
+ * @brief Serialize the context's state
+ *
+ * Call between frames or instructions, not from a hardware callback.
+ * @param out Destination of at least gb_state_size() bytes
+ * @param size Size of out
+ * @return Bytes written, or 0 if out is too small
+ */
+size_t gb_state_save(const GBContext* ctx, void* out, size_t size);
+
+/**
+ * @brief Restore a state written by gb_state_save()
+ * @return false, leaving the context untouched, if the blob is truncated or
+ *         was written by a different runtime version or cartridge setup
+ */
+bool gb_state_load(GBContext* ctx, const void* data, size_t size);
+
+/* ============================================================================
+ * Snapshots
+ * ========================================================================== */
+
+typedef struct GBSnapshot GBSnapshot;
+
+/**
+ * @brief Allocate a snapshot sized for the context
+ * @return The snapshot, or NULL on allocation failure
+ */
+GBSnapshot* gb_snapshot_create(const GBContext* ctx);
+
+/**
+ * @brief Free a snapshot
+ */
+void gb_snapshot_destroy(GBSnapshot* snap);
+
+/**
+ * @brief Save the context's state into the snapshot
+ *
+ * The first take enables dirty-page tracking on the context: clean WRAM
+ * pages are write-protected in the page tables until their first store.
+ */
+void gb_snapshot_take(GBContext* ctx, GBSnapshot* snap);
+
+/**
+ * @brief Restore the context from a snapshot filled by gb_snapshot_take()
+ */
+void gb_snapshot_restore(GBContext* ctx, GBSnapshot* snap);
+
+/**
+ * @brief The snapshot as a blob accepted by gb_state_load()
+ * @param size Receives the blob size
+ */
+const void* gb_snapshot_data(const GBSnapshot* snap, size_t* size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GB_STATE_H */
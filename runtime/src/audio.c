@@ -5,6 +5,7 @@
 
 #include "audio.h"
 #include "gbrt_debug.h"
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -12,6 +13,27 @@
  * Internal Structures
  * ========================================================================== */
 
+#define GB_CPU_CLOCK       4194304
+
+/* Band-limited step synthesis (blip buffer) */
+#define BLIP_TAPS          16     /* Kernel width in output samples */
+#define BLIP_PHASE_BITS    6
+#define BLIP_PHASES        (1 << BLIP_PHASE_BITS)
+#define BLIP_UNIT_BITS     15     /* Kernel taps are fixed point 1.15 */
+#define BLIP_FRAC_BITS     32     /* Sample positions are fixed point 32.32 */
+#define BLIP_CAPACITY      4096   /* Stereo frames buffered for the host */
+
+/**
+ * @brief Delta buffer for one output channel
+ *
+ * Amplitude changes are added as band-limited impulses; reading integrates
+ * the buffer back into a waveform.
+ */
+typedef struct {
+    int32_t deltas[BLIP_CAPACITY + BLIP_TAPS];
+    int32_t integrator;
+} BlipChannel;
+
 typedef struct {
     /* Registers */
     uint8_t nr10; /* Sweep */
@@ -95,8 +117,11 @@ typedef struct GBAudio {
     int fs_step;
     
     /* Sample Generation */
-    uint32_t sample_timer;
-    uint32_t sample_period; /* Cycles per sample */
+    uint32_t sample_rate;   /* Output rate in Hz */
+    uint64_t blip_factor;   /* Output samples per CPU cycle, 32.32 */
+    uint64_t blip_offset;   /* Position of clock 0 of the current span, 32.32 */
+    BlipChannel blip[2];    /* Left, right */
+    int out_level[2][2];    /* Last emitted level per square channel, L/R */
     
 } GBAudio;
 
@@ -111,17 +136,177 @@ static const uint8_t DUTY_CYCLES[4][8] = {
     {0, 1, 1, 1, 1, 1, 1, 0}  /* 75% */
 };
 
+/* Kernel rows: the band-limited impulse for each sub-sample phase */
+static int16_t g_blip_kernel[BLIP_PHASES][BLIP_TAPS];
+static atomic_int g_blip_kernel_state;  /* 0 = unbuilt, 1 = building, 2 = ready */
+
+/**
+ * @brief sin(x) for |x| <= 2*pi without pulling in libm
+ */
+static double blip_sin(double x) {
+    const double pi = 3.14159265358979323846;
+    while (x > pi) x -= 2 * pi;
+    while (x < -pi) x += 2 * pi;
+    double term = x, sum = x, x2 = x * x;
+    for (int n = 1; n < 12; n++) {
+        term *= -x2 / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+/**
+ * @brief Build the windowed-sinc kernel, each row summing exactly to unity
+ */
+static void blip_init_kernel(void) {
+    const double pi = 3.14159265358979323846;
+    const double cutoff = 0.9;  /* Fraction of Nyquist kept */
+    const double half = BLIP_TAPS / 2;
+    
+    for (int p = 0; p < BLIP_PHASES; p++) {
+        double row[BLIP_TAPS];
+        double total = 0;
+        for (int k = 0; k < BLIP_TAPS; k++) {
+            double x = (k + 1) - half - (double)p / BLIP_PHASES;
+            double sinc = (x == 0) ? 1.0 : blip_sin(pi * cutoff * x) / (pi * cutoff * x);
+            double w = x / half;  /* Blackman window over [-1, 1] */
+            double window = (w <= -1 || w >= 1) ? 0
+                          : 0.42 + 0.5 * blip_sin(pi * w + pi / 2) + 0.08 * blip_sin(2 * pi * w + pi / 2);
+            row[k] = sinc * window;
+            total += row[k];
+        }
+        
+        int sum = 0, peak = 0;
+        for (int k = 0; k < BLIP_TAPS; k++) {
+            double v = row[k] / total * (1 << BLIP_UNIT_BITS);
+            g_blip_kernel[p][k] = (int16_t)(v < 0 ? v - 0.5 : v + 0.5);
+            sum += g_blip_kernel[p][k];
+            if (g_blip_kernel[p][k] > g_blip_kernel[p][peak]) peak = k;
+        }
+        /* Exact unity gain, otherwise the integrator drifts */
+        g_blip_kernel[p][peak] += (int16_t)((1 << BLIP_UNIT_BITS) - sum);
+    }
+}
+
+/**
+ * @brief Build the kernel once; contexts on other threads wait for it
+ */
+static void blip_ensure_kernel(void) {
+    if (atomic_load_explicit(&g_blip_kernel_state, memory_order_acquire) == 2) return;
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&g_blip_kernel_state, &expected, 1)) {
+        blip_init_kernel();
+        atomic_store_explicit(&g_blip_kernel_state, 2, memory_order_release);
+    } else {
+        while (atomic_load_explicit(&g_blip_kernel_state, memory_order_acquire) != 2) {
+        }
+    }
+}
+
+/**
+ * @brief Add an amplitude step at a CPU cycle offset into the current span
+ */
+static void blip_add_delta(GBAudio* apu, int channel, uint32_t time, int delta) {
+    uint64_t fixed = apu->blip_offset + time * apu->blip_factor;
+    uint32_t pos = (uint32_t)(fixed >> BLIP_FRAC_BITS);
+    if (pos >= BLIP_CAPACITY) return;  /* Host is not draining, drop */
+    
+    int phase = (int)(fixed >> (BLIP_FRAC_BITS - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1);
+    const int16_t* kernel = g_blip_kernel[phase];
+    int32_t* out = &apu->blip[channel].deltas[pos];
+    for (int k = 0; k < BLIP_TAPS; k++) {
+        out[k] += kernel[k] * delta;
+    }
+}
+
+/**
+ * @brief Stereo frames fully synthesized and ready to be read
+ */
+static uint32_t blip_samples_avail(const GBAudio* apu) {
+    uint32_t avail = (uint32_t)(apu->blip_offset >> BLIP_FRAC_BITS);
+    return avail < BLIP_CAPACITY ? avail : BLIP_CAPACITY;
+}
+
+/**
+ * @brief Remove count frames from the front of the buffer, integrating them into
+ *        whichever interleaved stereo output is non-NULL
+ */
+static void blip_read(GBAudio* apu, int16_t* out, float* out_f32, uint32_t count) {
+    for (int c = 0; c < 2; c++) {
+        BlipChannel* ch = &apu->blip[c];
+        int32_t sum = ch->integrator;
+        for (uint32_t i = 0; i < count; i++) {
+            sum += ch->deltas[i];
+            int32_t s = sum >> BLIP_UNIT_BITS;
+            s = s > 32767 ? 32767 : s < -32768 ? -32768 : s;
+            if (out) out[i * 2 + c] = (int16_t)s;
+            if (out_f32) out_f32[i * 2 + c] = (float)s * (1.0f / 32768.0f);
+        }
+        ch->integrator = sum;
+        
+        uint32_t remain = BLIP_CAPACITY + BLIP_TAPS - count;
+        memmove(ch->deltas, ch->deltas + count, remain * sizeof(int32_t));
+        memset(ch->deltas + remain, 0, count * sizeof(int32_t));
+    }
+    apu->blip_offset -= (uint64_t)count << BLIP_FRAC_BITS;
+}
+
+/**
+ * @brief Close a synthesized span of the given length in CPU cycles
+ */
+static void blip_end_span(GBAudio* apu, uint32_t cycles) {
+    apu->blip_offset += cycles * apu->blip_factor;
+    
+    /* Nobody is reading: keep only the newest samples */
+    uint32_t avail = (uint32_t)(apu->blip_offset >> BLIP_FRAC_BITS);
+    if (avail > BLIP_CAPACITY - BLIP_TAPS) {
+        blip_read(apu, NULL, NULL, avail - (BLIP_CAPACITY - BLIP_TAPS) / 2);
+    }
+}
+
+static void blip_set_rate(GBAudio* apu, uint32_t rate) {
+    apu->sample_rate = rate;
+    apu->blip_factor = ((uint64_t)rate << BLIP_FRAC_BITS) / GB_CPU_CLOCK;
+}
+
+static void blip_reset(GBAudio* apu, uint32_t rate) {
+    blip_ensure_kernel();
+    memset(apu->blip, 0, sizeof(apu->blip));
+    memset(apu->out_level, 0, sizeof(apu->out_level));
+    blip_set_rate(apu, rate);
+    apu->blip_offset = 0;
+}
+
 /* ============================================================================
  * Public Interface
  * ========================================================================== */
 
+size_t gb_audio_size(void) {
+    return sizeof(GBAudio);
+}
+
+void gb_audio_init(void* apu) {
+    blip_reset((GBAudio*)apu, GB_AUDIO_DEFAULT_RATE);
+}
+
+/* Emulated state is everything before the host-side synthesis fields */
+size_t gb_audio_state_size(void) {
+    return offsetof(GBAudio, sample_rate);
+}
+
+void gb_audio_save_state(const void* apu, void* out) {
+    memcpy(out, apu, gb_audio_state_size());
+}
+
+void gb_audio_load_state(void* apu, const void* in) {
+    memcpy(apu, in, gb_audio_state_size());
+}
+
 void* gb_audio_create(void) {
     GBAudio* apu = (GBAudio*)calloc(1, sizeof(GBAudio));
     if (!apu) return NULL;
     
-    /* Approx 70224 cycles per frame / 59.7 fps = ~4.19 MHz */
-    /* 4194304 / 44100 = ~95 cycles per sample */
-    apu->sample_period = 95;
+    gb_audio_init(apu);
     
     return apu;
 }
@@ -132,8 +317,9 @@ void gb_audio_destroy(void* apu) {
 
 void gb_audio_reset(void* apu_ptr) {
     GBAudio* apu = (GBAudio*)apu_ptr;
+    uint32_t rate = apu->sample_rate ? apu->sample_rate : GB_AUDIO_DEFAULT_RATE;
     memset(apu, 0, sizeof(GBAudio));
-    apu->sample_period = 95;
+    blip_reset(apu, rate);
     
     /* Initial Register Values (Standard DMG) */
     apu->ch1.nr10 = 0x80;
@@ -306,10 +492,79 @@ void gb_audio_write(GBContext* ctx, uint16_t addr, uint8_t value) {
     }
 }
 
+uint32_t gb_audio_cycles_until_event(GBContext* ctx) {
+    GBAudio* apu = (GBAudio*)ctx->apu;
+    if (!apu || !(apu->nr52 & 0x80)) return 0;
+    
+    /* Samples are synthesized lazily on sync; only the sequencer needs a wakeup */
+    return 8192 - apu->fs_timer;
+}
+
+/**
+ * @brief Emit a square channel's level change at a cycle offset into the span
+ */
+static void square_set_level(GBAudio* apu, int index, uint32_t time, int level) {
+    int left = (apu->nr51 & (0x10 << index)) ? level : 0;
+    int right = (apu->nr51 & (0x01 << index)) ? level : 0;
+    if (left != apu->out_level[index][0]) {
+        blip_add_delta(apu, 0, time, left - apu->out_level[index][0]);
+        apu->out_level[index][0] = left;
+    }
+    if (right != apu->out_level[index][1]) {
+        blip_add_delta(apu, 1, time, right - apu->out_level[index][1]);
+        apu->out_level[index][1] = right;
+    }
+}
+
+/**
+ * @brief Synthesize one square channel over a span of cycles
+ *
+ * Only duty-step edges are visited, so the cost is per waveform transition
+ * rather than per cycle or per output sample.
+ */
+static void square_synth(GBAudio* apu, int index, bool enabled, uint8_t duty_reg, uint8_t env_reg,
+                         uint16_t freq_raw, uint32_t* timer, int* wave_pos, uint32_t cycles) {
+    const int vol = 1000;  /* Fixed volume for now */
+    
+    if (!enabled) {
+        square_set_level(apu, index, 0, 0);
+        return;
+    }
+    
+    bool dac = (env_reg & 0xF0) != 0;
+    const uint8_t* duty = DUTY_CYCLES[(duty_reg >> 6) & 3];
+    square_set_level(apu, index, 0, (dac && duty[*wave_pos]) ? vol : 0);
+    
+    uint32_t period = (2048 - freq_raw) * 4;
+    if (period == 0) period = 4; /* Avoid div/0 or infinite freq */
+    
+    uint32_t t = *timer;
+    uint32_t time = 0;
+    while (cycles - time >= period - t) {
+        time += period - t;
+        t = 0;
+        *wave_pos = (*wave_pos + 1) & 7;
+        square_set_level(apu, index, time, (dac && duty[*wave_pos]) ? vol : 0);
+    }
+    *timer = t + (cycles - time);
+}
+
 void gb_audio_step(GBContext* ctx, uint32_t cycles) {
     GBAudio* apu = (GBAudio*)ctx->apu;
     if (!apu || !(apu->nr52 & 0x80)) return;
     
+    /* Synthesize the span with the register state in effect during it; every
+     * register write syncs first, so writes land at their exact cycle */
+    if (!ctx->audio_muted) {
+        square_synth(apu, 0, apu->ch1.enabled, apu->ch1.nr11, apu->ch1.nr12,
+                     apu->ch1.nr13 | ((apu->ch1.nr14 & 0x07) << 8),
+                     &apu->ch1.timer, &apu->ch1.wave_pos, cycles);
+        square_synth(apu, 1, apu->ch2.enabled, apu->ch2.nr21, apu->ch2.nr22,
+                     apu->ch2.nr23 | ((apu->ch2.nr24 & 0x07) << 8),
+                     &apu->ch2.timer, &apu->ch2.wave_pos, cycles);
+        blip_end_span(apu, cycles);
+    }
+    
     /* Advance Frame Sequencer (512 Hz) */
     /* 4194304 / 512 = 8192 cycles */
     apu->fs_timer += cycles;
@@ -341,68 +596,43 @@ void gb_audio_step(GBContext* ctx, uint32_t cycles) {
             // TODO: Envelope step
         }
     }
+}
+
+size_t gb_audio_read_samples(GBContext* ctx, int16_t* out, size_t frames) {
+    GBAudio* apu = (GBAudio*)ctx->apu;
+    if (!apu) return 0;
     
-    /* Generate Samples? */
-    /* 4194304 Hz / 44100 Hz = 95.1 cycles/sample */
-    apu->sample_timer += cycles;
-    
-    /* Channel 1 Stepping */
-    if (apu->ch1.enabled) {
-        uint16_t freq_raw = apu->ch1.nr13 | ((apu->ch1.nr14 & 0x07) << 8);
-        uint32_t period = (2048 - freq_raw) * 4;
-        if (period == 0) period = 4; /* Avoid div/0 or infinite freq */
-        
-        apu->ch1.timer += cycles;
-        while (apu->ch1.timer >= period) {
-            apu->ch1.timer -= period;
-            apu->ch1.wave_pos = (apu->ch1.wave_pos + 1) & 7;
-        }
-    }
+    uint32_t count = blip_samples_avail(apu);
+    if (count > frames) count = (uint32_t)frames;
+    blip_read(apu, out, NULL, count);
+    return count;
+}
+
+size_t gb_audio_read_samples_f32(GBContext* ctx, float* out, size_t frames) {
+    GBAudio* apu = (GBAudio*)ctx->apu;
+    if (!apu) return 0;
     
-    /* Channel 2 Stepping */
-    if (apu->ch2.enabled) {
-        uint16_t freq_raw = apu->ch2.nr23 | ((apu->ch2.nr24 & 0x07) << 8);
-        uint32_t period = (2048 - freq_raw) * 4;
-        if (period == 0) period = 4;
-        
-        apu->ch2.timer += cycles;
-        while (apu->ch2.timer >= period) {
-            apu->ch2.timer -= period;
-            apu->ch2.wave_pos = (apu->ch2.wave_pos + 1) & 7;
-        }
-    }
+    uint32_t count = blip_samples_avail(apu);
+    if (count > frames) count = (uint32_t)frames;
+    blip_read(apu, NULL, out, count);
+    return count;
+}
+
+void gb_audio_set_sample_rate(GBContext* ctx, uint32_t rate) {
+    GBAudio* apu = (GBAudio*)ctx->apu;
+    if (!apu || rate == 0) return;
     
-    if (apu->sample_timer >= apu->sample_period) {
-        apu->sample_timer -= apu->sample_period;
-        
-        int16_t left = 0;
-        int16_t right = 0;
-        
-        /* Channel 1 Output */
-        if (apu->ch1.enabled && (apu->ch1.nr12 & 0xF0)) { // DAC ON
-             int duty = (apu->ch1.nr11 >> 6) & 3;
-             int output = DUTY_CYCLES[duty][apu->ch1.wave_pos];
-             
-             if (output) {
-                 /* Fixed volume for now */
-                 int vol = 1000; 
-                 if (apu->nr51 & 0x01) right += vol;
-                 if (apu->nr51 & 0x10) left += vol;
-             }
-        }
-        
-        /* Channel 2 Output */
-        if (apu->ch2.enabled && (apu->ch2.nr22 & 0xF0)) { // DAC ON
-             int duty = (apu->ch2.nr21 >> 6) & 3;
-             int output = DUTY_CYCLES[duty][apu->ch2.wave_pos];
-             
-             if (output) {
-                 int vol = 1000;
-                 if (apu->nr51 & 0x02) right += vol;
-                 if (apu->nr51 & 0x20) left += vol;
-             }
-        }
-        
-        gb_audio_callback(ctx, left, right);
-    }
+    /* Already-synthesized samples keep their positions; only new spans
+     * are placed at the new rate */
+    blip_set_rate(apu, rate);
+}
+
+uint32_t gb_audio_get_sample_rate(GBContext* ctx) {
+    GBAudio* apu = (GBAudio*)ctx->apu;
+    return apu ? apu->sample_rate : 0;
+}
+
+size_t gb_audio_samples_available(GBContext* ctx) {
+    GBAudio* apu = (GBAudio*)ctx->apu;
+    return apu ? blip_samples_avail(apu) : 0;
 }
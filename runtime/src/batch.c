@@ -0,0 +1,463 @@
+/**
+ * @file batch.c
+ * @brief Worker pool that steps many emulator instances in parallel
+ */
+
+#include "batch.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE batch_thread;
+typedef CRITICAL_SECTION batch_mutex;
+typedef CONDITION_VARIABLE batch_cond;
+#define mutex_init(m)     InitializeCriticalSection(m)
+#define mutex_destroy(m)  DeleteCriticalSection(m)
+#define mutex_lock(m)     EnterCriticalSection(m)
+#define mutex_unlock(m)   LeaveCriticalSection(m)
+#define cond_init(c)      InitializeConditionVariable(c)
+#define cond_destroy(c)   ((void)(c))
+#define cond_wait(c, m)   SleepConditionVariableCS(c, m, INFINITE)
+#define cond_broadcast(c) WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+#include <unistd.h>
+typedef pthread_t batch_thread;
+typedef pthread_mutex_t batch_mutex;
+typedef pthread_cond_t batch_cond;
+#define mutex_init(m)     pthread_mutex_init(m, NULL)
+#define mutex_destroy(m)  pthread_mutex_destroy(m)
+#define mutex_lock(m)     pthread_mutex_lock(m)
+#define mutex_unlock(m)   pthread_mutex_unlock(m)
+#define cond_init(c)      pthread_cond_init(c, NULL)
+#define cond_destroy(c)   pthread_cond_destroy(c)
+#define cond_wait(c, m)   pthread_cond_wait(c, m)
+#define cond_broadcast(c) pthread_cond_broadcast(c)
+#endif
+
+/* ============================================================================
+ * Internal Structures
+ * ========================================================================== */
+
+struct GBBatch {
+    GBContext** contexts;
+    size_t count;
+
+    batch_thread* workers;
+    unsigned worker_count;      /* Threads besides the caller */
+
+    /* Work for the current frame: instances (or groups of group_size
+     * instances) are claimed one at a time, so instances that take longer
+     * (e.g. lag frames) balance themselves */
+    atomic_size_t next;
+    atomic_size_t remaining;
+    size_t units;
+    unsigned group_size;        /* 1 = run each instance's frame through */
+
+    const GBSoAKernelEntry* soa_kernels;  /* Sorted by key; NULL = scalar steps */
+    size_t soa_kernel_count;
+
+    atomic_uint_least64_t steps;
+    atomic_uint_least64_t shared_steps;
+    atomic_uint_least64_t soa_runs;
+    atomic_uint_least64_t soa_lanes;
+
+    batch_mutex lock;
+    batch_cond start;           /* generation advanced or quitting */
+    batch_cond done;            /* remaining reached zero */
+    unsigned generation;
+    bool quit;
+};
+
+static unsigned batch_core_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? (unsigned)info.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1;
+#endif
+}
+
+/* ============================================================================
+ * Convergent Scheduling
+ * ========================================================================== */
+
+/* Entry the next step of a context dispatches to; HALT waits share one */
+static uint32_t step_key(const GBContext* ctx) {
+    if (ctx->halted) return UINT32_MAX;
+    uint16_t pc = ctx->pc;
+    uint32_t bank = pc < 0x4000 ? ctx->rom_bank0 : pc < 0x8000 ? ctx->rom_bank : 0;
+    return (bank << 16) | pc;
+}
+
+/*
+ * Run one frame of a group of instances a step at a time. Each round every
+ * unfinished instance takes one step, in order of the bank:address it enters
+ * at, so instances running the same code call the same recompiled function
+ * back to back while its instructions and branch history are still warm.
+ * The order barely changes between rounds, so insertion sort is near linear.
+ */
+static void batch_run_group(GBBatch* batch, GBContext** contexts, size_t n) {
+    struct { uint32_t key; uint32_t index; } order[GB_BATCH_MAX_GROUP];
+    size_t active = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (gb_frame_begin(contexts[i])) order[active++].index = (uint32_t)i;
+    }
+
+    uint64_t steps = 0, shared = 0;
+    while (active) {
+        for (size_t k = 0; k < active; k++) {
+            order[k].key = step_key(contexts[order[k].index]);
+            for (size_t j = k; j > 0 && order[j - 1].key > order[j].key; j--) {
+                uint32_t key = order[j].key, index = order[j].index;
+                order[j] = order[j - 1];
+                order[j - 1].key = key;
+                order[j - 1].index = index;
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t k = 0; k < active; k++) {
+            GBContext* ctx = contexts[order[k].index];
+            if (k > 0 && order[k].key == order[k - 1].key) shared++;
+            gb_frame_step(ctx);
+            if (ctx->frame_done) gb_frame_end(ctx);
+            else order[kept++] = order[k];
+        }
+        steps += active;
+        active = kept;
+    }
+    atomic_fetch_add_explicit(&batch->steps, steps, memory_order_relaxed);
+    atomic_fetch_add_explicit(&batch->shared_steps, shared, memory_order_relaxed);
+}
+
+/* ============================================================================
+ * Lane Kernels
+ * ========================================================================== */
+
+static GBSoAKernel soa_lookup(const GBBatch* batch, uint32_t key) {
+    size_t lo = 0, hi = batch->soa_kernel_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t found = batch->soa_kernels[mid].key;
+        if (found == key) return batch->soa_kernels[mid].kernel;
+        if (found < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+static void soa_gather(GBSoARegs* s, int i, GBContext* ctx) {
+    s->a[i] = ctx->a; s->b[i] = ctx->b; s->c[i] = ctx->c; s->d[i] = ctx->d;
+    s->e[i] = ctx->e; s->h[i] = ctx->h; s->l[i] = ctx->l;
+    s->f_z[i] = ctx->f_z; s->f_n[i] = ctx->f_n; s->f_h[i] = ctx->f_h; s->f_c[i] = ctx->f_c;
+    s->ctx[i] = ctx;
+}
+
+static void soa_scatter(const GBSoARegs* s, int i) {
+    GBContext* ctx = s->ctx[i];
+    ctx->a = s->a[i]; ctx->b = s->b[i]; ctx->c = s->c[i]; ctx->d = s->d[i];
+    ctx->e = s->e[i]; ctx->h = s->h[i]; ctx->l = s->l[i];
+    ctx->f_z = s->f_z[i]; ctx->f_n = s->f_n[i]; ctx->f_h = s->f_h[i]; ctx->f_c = s->f_c[i];
+    ctx->pc = s->pc[i];
+}
+
+/*
+ * Run lanes gathered at one block through its kernel, then on through the
+ * kernels of the blocks they reach for as long as they all reach the same
+ * one and none has to stop (a due interrupt, the end of the frame), so
+ * that loops of kernel blocks stay on the lane registers. Event handlers
+ * do not look at CPU registers, so ticking before the scatter is safe.
+ * Returns the number of blocks run.
+ */
+static uint64_t soa_run(const GBBatch* batch, GBSoARegs* regs, uint32_t key, GBSoAKernel kernel, int lanes) {
+    uint64_t blocks = 0;
+    for (;;) {
+        kernel(regs, lanes);
+        blocks++;
+        bool converged = true;
+        uint32_t next = 0;
+        for (int i = 0; i < lanes; i++) {
+            GBContext* ctx = regs->ctx[i];
+            gb_tick(ctx, regs->cycles[i]);
+            ctx->pc = regs->pc[i];
+            uint32_t lane_key = step_key(ctx);
+            if (i == 0) next = lane_key;
+            converged &= !ctx->stopped && lane_key == next;
+        }
+        if (!converged) break;
+        /* A block looping on itself keeps its kernel */
+        if (next != key && !(kernel = soa_lookup(batch, key = next))) break;
+    }
+    for (int i = 0; i < lanes; i++) soa_scatter(regs, i);
+    return blocks;
+}
+
+/* Cycles instances without a kernel run per round, one scanline: short
+ * enough that they soon stop at a loop head again, long enough that they
+ * do not go back through the trampoline after every block */
+#define SOA_SLICE_CYCLES 456
+
+/*
+ * Like batch_run_group, but with lane kernels: instances entering a block
+ * that has one run it together on a gathered register file, and the
+ * others run SOA_SLICE_CYCLES up to a poll point (a break event), so that
+ * instances running the same code stop at the same places and meet again.
+ * Interrupts are taken between rounds exactly as gb_frame_step does.
+ */
+static void batch_run_group_soa(GBBatch* batch, GBContext** contexts, size_t n) {
+    struct { uint32_t key; uint32_t index; } order[GB_BATCH_MAX_GROUP];
+    GBSoARegs regs;
+    size_t active = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (gb_frame_begin(contexts[i])) order[active++].index = (uint32_t)i;
+    }
+
+    uint64_t steps = 0, shared = 0, runs = 0, lanes_run = 0;
+    while (active) {
+        for (size_t k = 0; k < active; k++) {
+            GBContext* ctx = contexts[order[k].index];
+            gb_handle_interrupts(ctx);
+            ctx->stopped = 0;
+            order[k].key = step_key(ctx);
+            for (size_t j = k; j > 0 && order[j - 1].key > order[j].key; j--) {
+                uint32_t key = order[j].key, index = order[j].index;
+                order[j] = order[j - 1];
+                order[j - 1].key = key;
+                order[j - 1].index = index;
+            }
+        }
+
+        for (size_t k = 0; k < active;) {
+            uint32_t key = order[k].key;
+            size_t end = k + 1;
+            while (end < active && order[end].key == key) end++;
+            shared += end - k - 1;
+
+            GBSoAKernel kernel = key == UINT32_MAX ? NULL : soa_lookup(batch, key);
+            int lanes = 0;
+            for (; k < end; k++) {
+                GBContext* ctx = contexts[order[k].index];
+                if (kernel && !ctx->lockstep) {
+                    soa_gather(&regs, lanes++, ctx);
+                } else if (ctx->halted || ctx->lockstep) {
+                    gb_frame_step(ctx);
+                } else {
+                    gb_schedule_event(ctx, GB_EVENT_BREAK, SOA_SLICE_CYCLES);
+                    gb_frame_step(ctx);
+                    gb_cancel_event(ctx, GB_EVENT_BREAK);
+                }
+            }
+            if (lanes) {
+                /* Blocks after the first are extra steps, all shared */
+                uint64_t blocks = soa_run(batch, &regs, key, kernel, lanes);
+                runs += blocks;
+                lanes_run += blocks * (uint64_t)lanes;
+                steps += (blocks - 1) * (uint64_t)lanes;
+                shared += (blocks - 1) * (uint64_t)(lanes - 1);
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t k = 0; k < active; k++) {
+            GBContext* ctx = contexts[order[k].index];
+            if (ctx->frame_done) gb_frame_end(ctx);
+            else order[kept++] = order[k];
+        }
+        steps += active;
+        active = kept;
+    }
+    atomic_fetch_add_explicit(&batch->steps, steps, memory_order_relaxed);
+    atomic_fetch_add_explicit(&batch->shared_steps, shared, memory_order_relaxed);
+    atomic_fetch_add_explicit(&batch->soa_runs, runs, memory_order_relaxed);
+    atomic_fetch_add_explicit(&batch->soa_lanes, lanes_run, memory_order_relaxed);
+}
+
+/* ============================================================================
+ * Worker Pool
+ * ========================================================================== */
+
+/**
+ * @brief Run frames until every unit of this generation is claimed
+ */
+static void batch_drain(GBBatch* batch) {
+    for (;;) {
+        size_t i = atomic_fetch_add_explicit(&batch->next, 1, memory_order_relaxed);
+        if (i >= batch->units) return;
+        if (batch->group_size > 1) {
+            size_t first = i * batch->group_size;
+            size_t n = batch->count - first;
+            if (n > batch->group_size) n = batch->group_size;
+            if (batch->soa_kernels) batch_run_group_soa(batch, batch->contexts + first, n);
+            else batch_run_group(batch, batch->contexts + first, n);
+        } else {
+            gb_run_frame(batch->contexts[i]);
+        }
+        if (atomic_fetch_sub_explicit(&batch->remaining, 1, memory_order_acq_rel) == 1) {
+            mutex_lock(&batch->lock);
+            cond_broadcast(&batch->done);
+            mutex_unlock(&batch->lock);
+        }
+    }
+}
+
+static void batch_worker_loop(GBBatch* batch) {
+    unsigned seen = 0;
+    for (;;) {
+        mutex_lock(&batch->lock);
+        while (!batch->quit && batch->generation == seen) cond_wait(&batch->start, &batch->lock);
+        bool quit = batch->quit;
+        seen = batch->generation;
+        mutex_unlock(&batch->lock);
+        if (quit) return;
+        batch_drain(batch);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI batch_worker(LPVOID arg) {
+    batch_worker_loop((GBBatch*)arg);
+    return 0;
+}
+#else
+static void* batch_worker(void* arg) {
+    batch_worker_loop((GBBatch*)arg);
+    return NULL;
+}
+#endif
+
+/* ============================================================================
+ * Public Interface
+ * ========================================================================== */
+
+GBBatch* gb_batch_create(size_t count, unsigned threads, void (*init)(GBContext* ctx)) {
+    GBBatch* batch = (GBBatch*)calloc(1, sizeof(GBBatch));
+    if (!batch) return NULL;
+    batch->group_size = 1;
+    mutex_init(&batch->lock);
+    cond_init(&batch->start);
+    cond_init(&batch->done);
+
+    batch->contexts = (GBContext**)calloc(count ? count : 1, sizeof(GBContext*));
+    if (!batch->contexts) {
+        gb_batch_destroy(batch);
+        return NULL;
+    }
+    for (; batch->count < count; batch->count++) {
+        GBContext* ctx = gb_context_create(NULL);
+        if (!ctx) {
+            gb_batch_destroy(batch);
+            return NULL;
+        }
+        if (init) init(ctx);
+        batch->contexts[batch->count] = ctx;
+    }
+
+    if (threads == 0) threads = batch_core_count();
+    if (threads > count) threads = count ? (unsigned)count : 1;
+    batch->workers = (batch_thread*)calloc(threads, sizeof(batch_thread));
+    if (!batch->workers) {
+        gb_batch_destroy(batch);
+        return NULL;
+    }
+    /* The caller drains too, so it is one of the threads */
+    for (unsigned i = 0; i + 1 < threads; i++) {
+#ifdef _WIN32
+        batch->workers[i] = CreateThread(NULL, 0, batch_worker, batch, 0, NULL);
+        if (!batch->workers[i]) break;
+#else
+        if (pthread_create(&batch->workers[i], NULL, batch_worker, batch) != 0) break;
+#endif
+        batch->worker_count++;
+    }
+    return batch;
+}
+
+void gb_batch_destroy(GBBatch* batch) {
+    if (!batch) return;
+    mutex_lock(&batch->lock);
+    batch->quit = true;
+    cond_broadcast(&batch->start);
+    mutex_unlock(&batch->lock);
+    for (unsigned i = 0; i < batch->worker_count; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(batch->workers[i], INFINITE);
+        CloseHandle(batch->workers[i]);
+#else
+        pthread_join(batch->workers[i], NULL);
+#endif
+    }
+    free(batch->workers);
+
+    for (size_t i = 0; i < batch->count; i++) gb_context_destroy(batch->contexts[i]);
+    free(batch->contexts);
+    cond_destroy(&batch->start);
+    cond_destroy(&batch->done);
+    mutex_destroy(&batch->lock);
+    free(batch);
+}
+
+size_t gb_batch_count(const GBBatch* batch) {
+    return batch->count;
+}
+
+GBContext* gb_batch_context(GBBatch* batch, size_t index) {
+    return index < batch->count ? batch->contexts[index] : NULL;
+}
+
+void gb_batch_run_frame(GBBatch* batch, const GBBatchInput* inputs) {
+    if (batch->count == 0) return;
+    if (inputs) {
+        for (size_t i = 0; i < batch->count; i++) {
+            batch->contexts[i]->joypad_buttons = inputs[i].buttons;
+            batch->contexts[i]->joypad_dpad = inputs[i].dpad;
+        }
+    }
+
+    batch->units = (batch->count + batch->group_size - 1) / batch->group_size;
+    atomic_store_explicit(&batch->next, 0, memory_order_relaxed);
+    atomic_store_explicit(&batch->remaining, batch->units, memory_order_relaxed);
+    mutex_lock(&batch->lock);
+    batch->generation++;
+    cond_broadcast(&batch->start);
+    mutex_unlock(&batch->lock);
+
+    batch_drain(batch);
+
+    /* Workers may still be finishing instances they claimed */
+    mutex_lock(&batch->lock);
+    while (atomic_load_explicit(&batch->remaining, memory_order_acquire) != 0) {
+        cond_wait(&batch->done, &batch->lock);
+    }
+    mutex_unlock(&batch->lock);
+}
+
+void gb_batch_view(GBBatch* batch, size_t index, GBBatchView* view) {
+    GBContext* ctx = batch->contexts[index];
+    view->pixels = gb_get_pixels(ctx);
+    view->shades = gb_get_shades(ctx);
+    view->wram = ctx->wram;
+    view->hram = ctx->hram;
+    view->frame_cycles = ctx->frame_cycles;
+}
+
+void gb_batch_set_group_size(GBBatch* batch, unsigned size) {
+    if (size == 0) size = 1;
+    if (size > GB_BATCH_MAX_GROUP) size = GB_BATCH_MAX_GROUP;
+    batch->group_size = size;
+}
+
+void gb_batch_set_soa_kernels(GBBatch* batch, const GBSoAKernelEntry* entries, size_t count) {
+    batch->soa_kernels = count ? entries : NULL;
+    batch->soa_kernel_count = entries ? count : 0;
+}
+
+void gb_batch_get_stats(const GBBatch* batch, GBBatchStats* stats) {
+    stats->steps = atomic_load_explicit(&batch->steps, memory_order_relaxed);
+    stats->shared_steps = atomic_load_explicit(&batch->shared_steps, memory_order_relaxed);
+    stats->soa_runs = atomic_load_explicit(&batch->soa_runs, memory_order_relaxed);
+    stats->soa_lanes = atomic_load_explicit(&batch->soa_lanes, memory_order_relaxed);
+}
@@ -1,12 +1,34 @@
 #include "gbrt.h"
+#include "mbc.h"
 #include "ppu.h"
 #include "audio.h"
+#include "rewind.h"
+#include "movie.h"
+#include "lockstep.h"
 #include "platform_sdl.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "gbrt_debug.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define GBRT_HAS_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define GBRT_HAS_TSC 1
+#else
+#include <time.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GBRT_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 /* ============================================================================
  * Definitions
  * ========================================================================== */
@@ -17,57 +39,93 @@
 #define IO_SIZE        0x80
 #define HRAM_SIZE      0x7F
 
+/* Upper bound on the distance to next_event when few slots are armed */
+#define GB_EVENT_MAX_DELAY 70224
+
+/* Serial transfer at the internal 8192 Hz clock: 8 bits * 512 cycles */
+#define SERIAL_TRANSFER_CYCLES 4096
+
+/* OAM DMA: 160 bytes at one byte per M-cycle */
+#define DMA_TRANSFER_CYCLES 640
+
 /* ============================================================================
- * Globals
+ * Forward Declarations
  * ========================================================================== */
 
-bool gbrt_trace_enabled = false;
-uint64_t gbrt_instruction_count = 0;
-uint64_t gbrt_instruction_limit = 0;
+/* All mutable state lives in GBContext, so contexts on different threads
+ * never share anything but the read-only ROM. */
+static void trace_count(GBContext* ctx, uint16_t addr);
+
+static void gb_context_release_rom(GBContext* ctx);
 
+/* Hardware catch-up and scheduling (see Timing & Hardware Sync) */
+static inline void gb_sync(GBContext* ctx);
+static void gb_timer_sync(GBContext* ctx);
+static inline uint32_t timer_system_counter(GBContext* ctx);
+static inline bool timer_input(GBContext* ctx, uint8_t tac);
+static void timer_increment(GBContext* ctx, uint32_t count);
+static void gb_apu_sync(GBContext* ctx);
+static void gb_schedule_ppu(GBContext* ctx);
+static void gb_schedule_timer(GBContext* ctx);
+static void gb_schedule_apu(GBContext* ctx);
+static inline uint32_t slow_clock_delay(GBContext* ctx, uint32_t cycles, uint32_t synced);
 
 /* ============================================================================
  * Context Management
  * ========================================================================== */
 
+/* Every mutable per-instance region gets its own cache lines in the arena */
+#define GB_ARENA_ALIGN 64
+
+static size_t arena_round(size_t size) {
+    return (size + GB_ARENA_ALIGN - 1) & ~(size_t)(GB_ARENA_ALIGN - 1);
+}
+
 GBContext* gb_context_create(const GBConfig* config) {
-    GBContext* ctx = (GBContext*)calloc(1, sizeof(GBContext));
-    if (!ctx) return NULL;
+    /* One zeroed allocation holds the context and all its mutable state,
+     * hottest regions first; the ROM stays outside and can be shared */
+    const size_t sizes[] = {
+        sizeof(GBContext), IO_SIZE + 1, HRAM_SIZE, OAM_SIZE,
+        sizeof(GBPPU), gb_audio_size(), WRAM_BANK_SIZE * 8, VRAM_SIZE * 2,
+    };
+    size_t offsets[sizeof(sizes) / sizeof(sizes[0])];
+    size_t total = 0;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        offsets[i] = total;
+        total += arena_round(sizes[i]);
+    }
     
-    ctx->wram = (uint8_t*)calloc(1, WRAM_BANK_SIZE * 8);
-    ctx->vram = (uint8_t*)calloc(1, VRAM_SIZE * 2);
-    ctx->oam = (uint8_t*)calloc(1, OAM_SIZE);
-    ctx->hram = (uint8_t*)calloc(1, HRAM_SIZE);
-    ctx->io = (uint8_t*)calloc(1, IO_SIZE + 1);
+    uint8_t* arena = (uint8_t*)calloc(1, total + GB_ARENA_ALIGN - 1);
+    if (!arena) return NULL;
+    uint8_t* base = (uint8_t*)(((uintptr_t)arena + GB_ARENA_ALIGN - 1) & ~(uintptr_t)(GB_ARENA_ALIGN - 1));
     
-    if (!ctx->wram || !ctx->vram || !ctx->oam || !ctx->hram || !ctx->io) {
-        gb_context_destroy(ctx);
-        return NULL;
-    }
+    GBContext* ctx = (GBContext*)base;
+    ctx->arena = arena;
+    ctx->io = base + offsets[1];
+    ctx->hram = base + offsets[2];
+    ctx->oam = base + offsets[3];
+    ctx->ppu = base + offsets[4];
+    ctx->apu = base + offsets[5];
+    ctx->wram = base + offsets[6];
+    ctx->vram = base + offsets[7];
     
-    GBPPU* ppu = (GBPPU*)calloc(1, sizeof(GBPPU));
-    if (ppu) {
-        ppu_init(ppu);
-        ctx->ppu = ppu;
-    }
+    ctx->joypad_buttons = 0xFF;
+    ctx->joypad_dpad = 0xFF;
+    ctx->trace_hook = trace_count;
+    ctx->mapper = gb_mbc_mapper(GB_MBC_NONE);
     
-    ctx->apu = gb_audio_create();
+    ppu_init((GBPPU*)ctx->ppu);
+    gb_audio_init(ctx->apu);
+    ctx->cgb = config && config->model == GB_MODEL_CGB;
     gb_context_reset(ctx, true);
-    (void)config;
     return ctx;
 }
 
 void gb_context_destroy(GBContext* ctx) {
     if (!ctx) return;
-    free(ctx->wram);
-    free(ctx->vram);
-    free(ctx->oam);
-    free(ctx->hram);
-    free(ctx->io);
-    if (ctx->ppu) free(ctx->ppu);
-    if (ctx->apu) gb_audio_destroy(ctx->apu);
-    if (ctx->rom) free(ctx->rom);
-    free(ctx);
+    gb_context_release_rom(ctx);
+    gb_decode_cache_destroy(ctx);
+    free(ctx->arena);
 }
 
 void gb_context_reset(GBContext* ctx, bool skip_bootrom) {
@@ -78,9 +136,10 @@ void gb_context_reset(GBContext* ctx, bool skip_bootrom) {
         ctx->bc = 0x0013;
         ctx->de = 0x00D8;
         ctx->hl = 0x014D;
+        if (ctx->cgb) ctx->af = 0x1180;
         gb_unpack_flags(ctx);
-        ctx->rom_bank = 1;
         ctx->wram_bank = 1;
+        ctx->vram_bank = 0;
         
         ctx->io[0x05] = 0x00; /* TIMA */
         ctx->io[0x06] = 0x00; /* TMA */
@@ -114,91 +173,461 @@ void gb_context_reset(GBContext* ctx, bool skip_bootrom) {
         ctx->io[0x4B] = 0x00; /* WX */
         ctx->io[0x80] = 0x00; /* IE */
     }
+    gb_mbc_reset(ctx);
+    gb_update_memory_map(ctx);
+    
+    ctx->double_speed = 0;
+    ctx->last_sync_cycles = ctx->cycles;
+    ctx->timer_sync_cycles = ctx->cycles;
+    ctx->div_base = ctx->cycles;
+    ctx->apu_sync_cycles = ctx->cycles;
+    ctx->event_pending = 0;
+    ctx->native_depth = 0;
+    gb_schedule_now(ctx);
+    gb_schedule_ppu(ctx);
+    gb_schedule_timer(ctx);
+    gb_schedule_apu(ctx);
 }
 
-bool gb_context_load_rom(GBContext* ctx, const uint8_t* data, size_t size) {
-    if (ctx->rom) free(ctx->rom);
-    ctx->rom = (uint8_t*)malloc(size);
-    if (!ctx->rom) return false;
-    memcpy(ctx->rom, data, size);
+static void gb_context_release_rom(GBContext* ctx) {
+    if (ctx->rom_mapped) {
+        gb_rom_unmap(ctx->rom_storage, ctx->rom_size);
+    } else {
+        free(ctx->rom_storage);
+    }
+    gb_mbc_release(ctx);
+    ctx->rom = NULL;
+    ctx->rom_size = 0;
+    ctx->rom_storage = NULL;
+    ctx->rom_mapped = false;
+}
+
+bool gb_context_attach_rom(GBContext* ctx, const uint8_t* data, size_t size) {
+    gb_context_release_rom(ctx);
+    ctx->rom = data;
     ctx->rom_size = size;
+    if (!gb_mbc_attach(ctx)) {
+        ctx->rom = NULL;
+        ctx->rom_size = 0;
+        return false;
+    }
+    gb_mbc_reset(ctx);
+    gb_code_flush(ctx);
+    if (!ctx->cgb && size > 0x143 && (data[0x143] & 0xC0) == 0xC0) {
+        /* CGB-only cartridges stop at a warning screen on a DMG */
+        ctx->cgb = 1;
+        gb_context_reset(ctx, true);
+    }
+    return true;
+}
+
+bool gb_context_load_rom(GBContext* ctx, const uint8_t* data, size_t size) {
+    uint8_t* copy = (uint8_t*)malloc(size);
+    if (!copy) return false;
+    memcpy(copy, data, size);
+    if (!gb_context_attach_rom(ctx, copy, size)) {
+        free(copy);
+        return false;
+    }
+    ctx->rom_storage = copy;
+    return true;
+}
+
+bool gb_context_map_rom(GBContext* ctx, const char* path) {
+    size_t size;
+    const uint8_t* data = gb_rom_map(path, &size);
+    if (!data) return false;
+    if (!gb_context_attach_rom(ctx, data, size)) {
+        gb_rom_unmap(data, size);
+        return false;
+    }
+    ctx->rom_storage = (void*)data;
+    ctx->rom_mapped = true;
     return true;
 }
 
+const uint8_t* gb_rom_map(const char* path, size_t* size) {
+#ifdef GBRT_HAS_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    *size = (size_t)st.st_size;
+    return (const uint8_t*)map;
+#else
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    uint8_t* data = NULL;
+    long len = -1;
+    if (fseek(f, 0, SEEK_END) == 0) len = ftell(f);
+    if (len > 0 && fseek(f, 0, SEEK_SET) == 0) data = (uint8_t*)malloc((size_t)len);
+    bool ok = data && fread(data, 1, (size_t)len, f) == (size_t)len;
+    fclose(f);
+    if (!ok) {
+        free(data);
+        return NULL;
+    }
+    *size = (size_t)len;
+    return data;
+#endif
+}
+
+void gb_rom_unmap(const void* data, size_t size) {
+    if (!data) return;
+#ifdef GBRT_HAS_MMAP
+    munmap((void*)data, size);
+#else
+    (void)size;
+    free((void*)data);
+#endif
+}
+
 /* ============================================================================
  * Memory Access
  * ========================================================================== */
 
-uint8_t gb_read8(GBContext* ctx, uint16_t addr) {
-    if (addr < 0x4000) return ctx->rom[addr];
-    if (addr < 0x8000) return ctx->rom[(ctx->rom_bank * 0x4000) + (addr - 0x4000)];
-    if (addr < 0xA000) return ctx->vram[(ctx->vram_bank * VRAM_SIZE) + (addr - 0x8000)];
-    if (addr < 0xC000) {
-        if (ctx->eram) return ctx->eram[addr - 0xA000];
-        return 0xFF;
-    }
-    if (addr < 0xD000) return ctx->wram[addr - 0xC000];
-    if (addr < 0xE000) return ctx->wram[(ctx->wram_bank * WRAM_BANK_SIZE) + (addr - 0xD000)];
-    if (addr < 0xFE00) return gb_read8(ctx, addr - 0x2000);
-    if (addr < 0xFEA0) return ctx->oam[addr - 0xFE00];
-    if (addr < 0xFF00) return 0xFF;
-    if (addr < 0xFF80) {
-        if (addr == 0xFF00) {
-             uint8_t joyp = ctx->io[0x00];
-             uint8_t res = 0xCF;
-             if (!(joyp & 0x10)) res &= g_joypad_dpad;
-             if (!(joyp & 0x20)) res &= g_joypad_buttons;
-             return res;
+/* 0x0000-0x7FFF: ROM0 + switchable ROMX (read-only, writes hit the MBC) */
+void gb_update_rom_map(GBContext* ctx) {
+    memset(ctx->read_map, 0, 0x80 * sizeof(ctx->read_map[0]));
+    if (!ctx->rom) return;
+    size_t rom0 = (size_t)ctx->rom_bank0 * 0x4000;
+    size_t romx = (size_t)ctx->rom_bank * 0x4000;
+    for (int p = 0; p < 0x40; p++) {
+        if (rom0 + (size_t)(p + 1) * 0x100 <= ctx->rom_size)
+            ctx->read_map[p] = (uint8_t*)ctx->rom + rom0 + p * 0x100;
+        if (romx + (size_t)(p + 1) * 0x100 <= ctx->rom_size)
+            ctx->read_map[0x40 + p] = (uint8_t*)ctx->rom + romx + p * 0x100;
+    }
+}
+
+/* 0xA000-0xBFFF: the selected ERAM bank while the mapper exposes it;
+ * otherwise the slow path reaches the mapper's handlers */
+void gb_update_eram_map(GBContext* ctx) {
+    memset(ctx->read_map + 0xA0, 0, 0x20 * sizeof(ctx->read_map[0]));
+    memset(ctx->write_map + 0xA0, 0, 0x20 * sizeof(ctx->write_map[0]));
+    if (!ctx->eram || !ctx->ram_enabled || !ctx->mapper->ram_mapped(ctx)) return;
+    size_t base = ctx->eram_size >= 0x2000 ? (size_t)ctx->ram_bank * 0x2000 % ctx->eram_size : 0;
+    for (int p = 0; p < 0x20; p++) {
+        if (base + (size_t)(p + 1) * 0x100 > ctx->eram_size) break;
+        ctx->read_map[0xA0 + p] = ctx->eram + base + p * 0x100;
+        if (!ctx->code_pages[0xA0 + p]) ctx->write_map[0xA0 + p] = ctx->eram + base + p * 0x100;
+    }
+}
+
+/* 0x8000-0x9FFF: VRAM (writes take the slow path to invalidate the tile cache) */
+void gb_update_vram_map(GBContext* ctx) {
+    for (int p = 0; p < 0x20; p++) {
+        ctx->read_map[0x80 + p] = ctx->vram + (ctx->vram_bank * VRAM_SIZE) + p * 0x100;
+    }
+}
+
+/* WRAM page p of 0xC000-0xDFFF and its echo. While snapshots track dirty
+ * pages, clean pages trap their first write in the slow path, which marks
+ * them and maps them writable. Pages with cached code (and their echoes)
+ * trap it to drop the cache. */
+static void map_wram_page(GBContext* ctx, int p) {
+    uint8_t* page = (p < 0x10)
+        ? ctx->wram + p * 0x100
+        : ctx->wram + (ctx->wram_bank * WRAM_BANK_SIZE) + (p - 0x10) * 0x100;
+    uint8_t* writable = (!ctx->state_tracking || ctx->state_dirty[(page - ctx->wram) >> 8])
+        && !ctx->code_pages[0xC0 + p] ? page : NULL;
+    ctx->read_map[0xC0 + p] = page;
+    ctx->write_map[0xC0 + p] = writable;
+    if (0xE0 + p < 0xFE) {
+        ctx->read_map[0xE0 + p] = page;
+        ctx->write_map[0xE0 + p] = writable;
+    }
+}
+
+/* 0xD000-0xDFFF: switchable WRAM bank, 0xF000-0xFDFF: its echo */
+void gb_update_wram_map(GBContext* ctx) {
+    for (int p = 0x10; p < 0x20; p++) map_wram_page(ctx, p);
+}
+
+void gb_update_memory_map(GBContext* ctx) {
+    memset(ctx->read_map, 0, sizeof(ctx->read_map));
+    memset(ctx->write_map, 0, sizeof(ctx->write_map));
+    
+    gb_update_rom_map(ctx);
+    gb_update_vram_map(ctx);
+    gb_update_eram_map(ctx);
+    
+    /* 0xC000-0xDFFF: WRAM bank 0 + switchable bank, 0xE000-0xFDFF: echo */
+    for (int p = 0; p < 0x20; p++) map_wram_page(ctx, p);
+    
+    /* 0xFE00-0xFFFF: OAM, I/O and HRAM always take the slow path */
+}
+
+/*
+ * CGB bank switches. Code cached from the old bank's pages no longer
+ * matches what they hold, so it is dropped first; then only the window's
+ * page-table entries change.
+ */
+static void drop_bank_code(GBContext* ctx, int first, int count) {
+    for (int p = first; p < first + count; p++) {
+        int echo = gb_echo_page(p);
+        if (ctx->code_pages[p]) gb_code_invalidate(ctx, (uint8_t)p);
+        if (echo >= 0 && ctx->code_pages[echo]) gb_code_invalidate(ctx, (uint8_t)echo);
+    }
+}
+
+static void set_vram_bank(GBContext* ctx, uint8_t bank) {
+    if (bank == ctx->vram_bank) return;
+    drop_bank_code(ctx, 0x80, 0x20);
+    ctx->vram_bank = bank;
+    gb_update_vram_map(ctx);
+}
+
+static void set_wram_bank(GBContext* ctx, uint8_t bank) {
+    if (bank == ctx->wram_bank) return;
+    drop_bank_code(ctx, 0xD0, 0x10);
+    ctx->wram_bank = bank;
+    gb_update_wram_map(ctx);
+}
+
+/* ============================================================================
+ * Cached Code
+ * ========================================================================== */
+
+/* Recompute the overlay flags in code_pages from the overlays' states */
+static void protect_overlays(GBContext* ctx) {
+    for (int p = 0; p < 256; p++) ctx->code_pages[p] &= (uint8_t)~GB_CODE_OVERLAY;
+    for (uint32_t i = 0; i < ctx->overlay_count; i++) {
+        if (ctx->overlay_state[i] == GB_OVERLAY_UNCHECKED) continue;
+        const GBOverlay* ov = &ctx->overlays[i];
+        int last = (ov->ram_addr + ov->size - 1) >> 8;
+        for (int p = ov->ram_addr >> 8; p <= last; p++) {
+            ctx->code_pages[p] |= GB_CODE_OVERLAY;
+            int echo = gb_echo_page(p);
+            if (echo >= 0) ctx->code_pages[echo] |= GB_CODE_OVERLAY;
+        }
+    }
+}
+
+/* Whether an overlay covers page or its echo */
+static bool overlay_on_page(const GBOverlay* ov, int page) {
+    int echo = gb_echo_page(page);
+    int last = (ov->ram_addr + ov->size - 1) >> 8;
+    for (int p = ov->ram_addr >> 8; p <= last; p++) {
+        if (p == page || p == echo) return true;
+    }
+    return false;
+}
+
+void gb_code_invalidate(GBContext* ctx, uint8_t page) {
+    uint8_t flags = ctx->code_pages[page];
+    if (flags & GB_CODE_OVERLAY) {
+        for (uint32_t i = 0; i < ctx->overlay_count; i++) {
+            if (overlay_on_page(&ctx->overlays[i], page)) ctx->overlay_state[i] = GB_OVERLAY_UNCHECKED;
+        }
+        protect_overlays(ctx);
+    }
+    if (flags & GB_CODE_DECODED) {
+        gb_decode_cache_invalidate(ctx, page);
+    } else {
+        gb_update_memory_map(ctx);
+    }
+}
+
+void gb_code_flush(GBContext* ctx) {
+    memset(ctx->overlay_state, GB_OVERLAY_UNCHECKED, sizeof(ctx->overlay_state));
+    protect_overlays(ctx);
+    gb_decode_cache_flush(ctx);
+}
+
+void gb_overlays_attach(GBContext* ctx, const GBOverlay* overlays, uint32_t count) {
+    ctx->overlays = overlays;
+    ctx->overlay_count = count < GB_MAX_OVERLAYS ? count : GB_MAX_OVERLAYS;
+    gb_code_flush(ctx);
+}
+
+bool gb_overlay_verify(GBContext* ctx, uint32_t index) {
+    const GBOverlay* ov = &ctx->overlays[index];
+    bool matches = ctx->rom && (size_t)ov->rom_offset + ov->size <= ctx->rom_size;
+    for (uint16_t i = 0; matches && i < ov->size; i++) {
+        matches = gb_read8_fast(ctx, (uint16_t)(ov->ram_addr + i)) == ctx->rom[ov->rom_offset + i];
+    }
+    /* Either way the answer holds until the next store to these pages */
+    ctx->overlay_state[index] = matches ? GB_OVERLAY_MATCHES : GB_OVERLAY_DIFFERS;
+    protect_overlays(ctx);
+    gb_update_memory_map(ctx);
+    return matches;
+}
+
+uint8_t gb_io_read(GBContext* ctx, uint8_t reg) {
+    if (reg >= 0x80) {
+        if (reg == 0xFF) return ctx->io[0x80];
+        return ctx->hram[reg - 0x80];
+    }
+    switch (reg) {
+        case 0x00: {
+            if (ctx->movie) gb_movie_poll(ctx->movie, ctx);
+            uint8_t joyp = ctx->io[0x00];
+            uint8_t res = 0xCF;
+            if (!(joyp & 0x10)) res &= ctx->joypad_dpad;
+            if (!(joyp & 0x20)) res &= ctx->joypad_buttons;
+            return res;
+        }
+        case 0x04: return (uint8_t)(timer_system_counter(ctx) >> 8);
+        case 0x05: gb_timer_sync(ctx); return ctx->io[0x05];
+        case 0x10 ... 0x3F: gb_apu_sync(ctx); return gb_audio_read(ctx, 0xFF00 + reg);
+        case 0x40 ... 0x4B:
+            /* STAT/LY may be lagging when the PPU only wakes at VBlank */
+            if (reg == 0x41 || reg == 0x44) gb_sync(ctx);
+            return ppu_read_register((GBPPU*)ctx->ppu, 0xFF00 + reg);
+        case 0x4D: return ctx->cgb ? (uint8_t)(0x7E | ctx->double_speed << 7 | (ctx->io[0x4D] & 0x01)) : 0xFF;
+        case 0x4F: return ctx->cgb ? (uint8_t)(0xFE | ctx->vram_bank) : 0xFF;
+        case 0x70: return ctx->cgb ? (uint8_t)(0xF8 | ctx->io[0x70]) : 0xFF;
+        default: return ctx->io[reg];
+    }
+}
+
+void gb_io_write(GBContext* ctx, uint8_t reg, uint8_t value) {
+    if (reg >= 0x80) {
+        if (reg == 0xFF) { ctx->io[0x80] = value; gb_schedule_now(ctx); return; }
+        gb_hram_write(ctx, (uint8_t)(reg - 0x80), value);
+        return;
+    }
+    switch (reg) {
+        case 0x02:
+            ctx->io[0x02] = value;
+            if (value & 0x80) {
+                if (!ctx->lockstep_shadow) { printf("%c", ctx->io[0x01]); fflush(stdout); }
+                if (value & 0x01) gb_schedule_event(ctx, GB_EVENT_SERIAL, SERIAL_TRANSFER_CYCLES);
+            }
+            return;
+        case 0x04:
+            /* Resetting the divider on a high input bit is a falling edge */
+            gb_timer_sync(ctx);
+            if (timer_input(ctx, ctx->io[0x07])) timer_increment(ctx, 1);
+            ctx->div_base = ctx->cycles;
+            gb_schedule_timer(ctx);
+            return;
+        case 0x07: {
+            /* Same for switching TAC away from a high input bit */
+            gb_timer_sync(ctx);
+            bool was_high = timer_input(ctx, ctx->io[0x07]);
+            ctx->io[0x07] = value;
+            if (was_high && !timer_input(ctx, value)) timer_increment(ctx, 1);
+            gb_schedule_timer(ctx);
+            return;
         }
-        if (addr == 0xFF04) return (uint8_t)(ctx->div_counter >> 8);
-        if (addr >= 0xFF40 && addr <= 0xFF4B) return ppu_read_register((GBPPU*)ctx->ppu, addr);
-        if (addr >= 0xFF10 && addr <= 0xFF3F) return gb_audio_read(ctx, addr);
-        return ctx->io[addr - 0xFF00];
+        case 0x05: case 0x06:
+            gb_timer_sync(ctx);
+            ctx->io[reg] = value;
+            gb_schedule_timer(ctx);
+            return;
+        case 0x0F:
+            ctx->io[0x0F] = value;
+            gb_schedule_now(ctx);
+            return;
+        case 0x10 ... 0x3F:
+            gb_apu_sync(ctx);
+            gb_audio_write(ctx, 0xFF00 + reg, value);
+            gb_schedule_apu(ctx);
+            return;
+        case 0x40 ... 0x4B:
+            gb_sync(ctx);
+            ppu_write_register((GBPPU*)ctx->ppu, ctx, 0xFF00 + reg, value);
+            gb_schedule_ppu(ctx);
+            if (reg == 0x46) gb_schedule_event(ctx, GB_EVENT_DMA, DMA_TRANSFER_CYCLES);
+            gb_schedule_now(ctx);
+            return;
+        case 0x4D:
+            /* KEY1: arm a speed switch for the next STOP */
+            if (ctx->cgb) ctx->io[0x4D] = value & 0x01;
+            return;
+        case 0x4F:
+            if (ctx->cgb) set_vram_bank(ctx, value & 0x01);
+            return;
+        case 0x70:
+            /* SVBK: bank 0 selects bank 1 */
+            if (!ctx->cgb) return;
+            ctx->io[0x70] = value & 0x07;
+            set_wram_bank(ctx, ctx->io[0x70] ? ctx->io[0x70] : 1);
+            return;
+        default: break;
     }
-    if (addr < 0xFFFF) return ctx->hram[addr - 0xFF80];
-    if (addr == 0xFFFF) return ctx->io[0x80];
+    ctx->io[reg] = value;
+}
+
+uint8_t gb_read8_slow(GBContext* ctx, uint16_t addr) {
+    if (addr >= 0xFF00) return gb_io_read(ctx, (uint8_t)addr);
+    if (addr >= 0xFE00 && addr < 0xFEA0) return gb_oam_read(ctx, (uint8_t)(addr - 0xFE00));
+    if (addr >= 0xA000 && addr < 0xC000) return ctx->mapper->read_ram(ctx, addr);
     return 0xFF;
 }
 
-void gb_write8(GBContext* ctx, uint16_t addr, uint8_t value) {
+void gb_write8_slow(GBContext* ctx, uint16_t addr, uint8_t value) {
+    if (addr < 0xFF00 && ctx->code_pages[addr >> 8]) {
+        /* Store over cached code; HRAM is checked in gb_io_write */
+        gb_code_invalidate(ctx, (uint8_t)(addr >> 8));
+        uint8_t* page = ctx->write_map[addr >> 8];
+        if (page) { page[addr & 0xFF] = value; return; }
+    }
     if (addr < 0x8000) {
-        if (addr >= 0x2000 && addr <= 0x3FFF) {
-            ctx->rom_bank = value & 0x1F;
-            if (ctx->rom_bank == 0) ctx->rom_bank = 1;
-        }
+        ctx->mapper->write_rom(ctx, addr, value);
         return;
     }
     if (addr < 0xA000) {
-        ctx->vram[(ctx->vram_bank * VRAM_SIZE) + (addr - 0x8000)] = value;
+        gb_sync(ctx);
+        ctx->state_dirty[GB_STATE_WRAM_PAGES + ((ctx->vram_bank * VRAM_SIZE + addr - 0x8000) >> 8)] = 1;
+        ppu_vram_write((GBPPU*)ctx->ppu, ctx, addr, value);
         return;
     }
     if (addr < 0xC000) {
-        if (ctx->eram) ctx->eram[addr - 0xA000] = value;
+        /* Exposed ERAM is only write-protected while it holds cached code */
+        uint8_t* page = ctx->read_map[addr >> 8];
+        if (page) page[addr & 0xFF] = value;
+        else ctx->mapper->write_ram(ctx, addr, value);
         return;
     }
-    if (addr < 0xD000) { ctx->wram[addr - 0xC000] = value; return; }
-    if (addr < 0xE000) { ctx->wram[(ctx->wram_bank * WRAM_BANK_SIZE) + (addr - 0xD000)] = value; return; }
-    if (addr < 0xFE00) { gb_write8(ctx, addr - 0x2000, value); return; }
-    if (addr < 0xFEA0) { ctx->oam[addr - 0xFE00] = value; return; }
-    if (addr < 0xFF00) return;
-    if (addr < 0xFF80) {
-        if (addr >= 0xFF40 && addr <= 0xFF4B) { ppu_write_register((GBPPU*)ctx->ppu, ctx, addr, value); return; }
-        if (addr >= 0xFF10 && addr <= 0xFF3F) { gb_audio_write(ctx, addr, value); return; }
-        if (addr == 0xFF04) { ctx->div_counter = 0; return; }
-        if (addr == 0xFF46) {
-             uint16_t src = value << 8;
-             for (int i=0; i<0xA0; i++) ctx->oam[i] = gb_read8(ctx, src + i);
-             return;
-        }
-        if (addr == 0xFF02 && (value & 0x80)) {
-            printf("%c", ctx->io[0x01]); fflush(stdout);
-            ctx->io[0x0F] |= 0x08;
-        }
-        ctx->io[addr - 0xFF00] = value;
+    if (addr < 0xFE00) {
+        /* First store to a write-protected clean WRAM page */
+        uint16_t offset = (addr - 0xC000) & 0x1FFF;
+        size_t index = offset < WRAM_BANK_SIZE
+            ? offset : (size_t)ctx->wram_bank * WRAM_BANK_SIZE + offset - WRAM_BANK_SIZE;
+        ctx->wram[index] = value;
+        ctx->state_dirty[index >> 8] = 1;
+        uint8_t* page = ctx->wram + (index & ~(size_t)0xFF);
+        ctx->write_map[0xC0 + (offset >> 8)] = page;
+        if (0xE0 + (offset >> 8) < 0xFE) ctx->write_map[0xE0 + (offset >> 8)] = page;
         return;
     }
-    if (addr < 0xFFFF) { ctx->hram[addr - 0xFF80] = value; return; }
-    if (addr == 0xFFFF) { ctx->io[0x80] = value; return; }
+    if (addr >= 0xFF00) { gb_io_write(ctx, (uint8_t)addr, value); return; }
+    if (addr >= 0xFE00 && addr < 0xFEA0) gb_oam_write(ctx, (uint8_t)(addr - 0xFE00), value);
+}
+
+/* While OAM DMA runs the CPU cannot reach OAM: reads see 0xFF and writes
+ * are lost */
+uint8_t gb_oam_read(GBContext* ctx, uint8_t offset) {
+    if (((GBPPU*)ctx->ppu)->dma_active) return 0xFF;
+    return ctx->oam[offset];
+}
+
+void gb_oam_write(GBContext* ctx, uint8_t offset, uint8_t value) {
+    GBPPU* ppu = (GBPPU*)ctx->ppu;
+    if (ppu->dma_active) return;
+    gb_sync(ctx);
+    ctx->oam[offset] = value;
+    ppu->oam_dirty = true;
+}
+
+uint8_t gb_read8(GBContext* ctx, uint16_t addr) {
+    const uint8_t* page = ctx->read_map[addr >> 8];
+    if (page) return page[addr & 0xFF];
+    return gb_read8_slow(ctx, addr);
+}
+
+void gb_write8(GBContext* ctx, uint16_t addr, uint8_t value) {
+    uint8_t* page = ctx->write_map[addr >> 8];
+    if (page) { page[addr & 0xFF] = value; return; }
+    gb_write8_slow(ctx, addr, value);
 }
 
 uint16_t gb_read16(GBContext* ctx, uint16_t addr) {
@@ -330,59 +759,345 @@ void gb_daa(GBContext* ctx) {
  * ========================================================================== */
 
 void gb_ret(GBContext* ctx) { ctx->pc = gb_pop16(ctx); }
-void gbrt_jump_hl(GBContext* ctx) { ctx->pc = ctx->hl; }
+void gbrt_jump_hl(GBContext* ctx) { ctx->pc = ctx->hl; GBRT_HOTSPOT_JUMP(ctx, ctx->pc); }
 void gb_rst(GBContext* ctx, uint8_t vec) { gb_push16(ctx, ctx->pc); ctx->pc = vec; }
 
 __attribute__((weak)) void gb_dispatch(GBContext* ctx, uint16_t addr) { ctx->pc = addr; gb_interpret(ctx, addr); }
 __attribute__((weak)) void gb_dispatch_call(GBContext* ctx, uint16_t addr) { ctx->pc = addr; }
 
+/* ============================================================================
+ * Outlined Sequences
+ * ========================================================================== */
+
+bool gb_step_to(GBContext* ctx, uint16_t next_pc, uint32_t cycles) {
+    ctx->pc = next_pc;
+    gb_tick(ctx, cycles);
+    return ctx->stopped;
+}
+
+void gb_ret_tick(GBContext* ctx, uint32_t cycles) {
+    ctx->pc = gb_pop16(ctx);
+    gb_tick(ctx, cycles);
+}
+
+bool gb_call_native(GBContext* ctx, uint16_t return_addr, uint16_t target, uint32_t cycles,
+                    uint8_t bank, void (*func)(GBContext* ctx, uint16_t entry)) {
+    gb_push16(ctx, return_addr);
+    ctx->pc = target;
+    gb_tick(ctx, cycles);
+    if (ctx->stopped || ctx->native_depth >= GB_MAX_NATIVE_DEPTH) return false;
+    if (bank && ctx->rom_bank != bank) return false;
+    ctx->native_depth++;
+    func(ctx, 0);
+    ctx->native_depth--;
+    return ctx->pc == return_addr && !ctx->stopped && !ctx->halted;
+}
+
+/* ============================================================================
+ * Loop Idioms
+ * ========================================================================== */
+
+static uint16_t* loop_pair(GBContext* ctx, GBLoopReg reg) {
+    switch (reg) {
+        case GB_LOOP_BC: return &ctx->bc;
+        case GB_LOOP_DE: return &ctx->de;
+        default:         return &ctx->hl;
+    }
+}
+
+static uint8_t* loop_reg8(GBContext* ctx, GBLoopReg reg) {
+    switch (reg) {
+        case GB_LOOP_B: return &ctx->b;
+        case GB_LOOP_C: return &ctx->c;
+        case GB_LOOP_D: return &ctx->d;
+        case GB_LOOP_E: return &ctx->e;
+        case GB_LOOP_H: return &ctx->h;
+        default:        return &ctx->l;
+    }
+}
+
+/* Counter decrement and loop test; true while the loop continues */
+static bool loop_count_down(GBContext* ctx, GBLoopReg counter) {
+    if (counter >= GB_LOOP_BC) {
+        /* DEC rr; LD A,hi; OR lo */
+        uint16_t* pair = loop_pair(ctx, counter);
+        (*pair)--;
+        ctx->a = (uint8_t)(*pair >> 8) | (uint8_t)*pair;
+        ctx->f_z = ctx->a == 0; ctx->f_n = 0; ctx->f_h = 0; ctx->f_c = 0;
+    } else {
+        /* DEC r */
+        uint8_t* reg = loop_reg8(ctx, counter);
+        ctx->f_h = (*reg & 0x0F) == 0;
+        (*reg)--;
+        ctx->f_z = *reg == 0; ctx->f_n = 1;
+    }
+    return !ctx->f_z;
+}
+
+bool gbrt_block_copy(GBContext* ctx, GBLoopReg dst, int dst_step,
+                     GBLoopReg src, int src_step, GBLoopReg counter, uint32_t cycles) {
+    uint16_t* d = loop_pair(ctx, dst);
+    uint16_t* s = loop_pair(ctx, src);
+    for (;;) {
+        ctx->a = gb_read8_fast(ctx, *s);
+        *s = (uint16_t)(*s + src_step);
+        gb_write8_fast(ctx, *d, ctx->a);
+        *d = (uint16_t)(*d + dst_step);
+        if (!loop_count_down(ctx, counter)) return true;
+        gb_tick(ctx, cycles);
+        if (ctx->stopped) return false;
+    }
+}
+
+bool gbrt_block_fill(GBContext* ctx, GBLoopReg dst, int dst_step, int value,
+                     GBLoopReg counter, uint32_t cycles) {
+    uint16_t* d = loop_pair(ctx, dst);
+    for (;;) {
+        if (value >= 0) ctx->a = (uint8_t)value;
+        gb_write8_fast(ctx, *d, ctx->a);
+        *d = (uint16_t)(*d + dst_step);
+        if (!loop_count_down(ctx, counter)) return true;
+        gb_tick(ctx, cycles);
+        if (ctx->stopped) return false;
+    }
+}
+
+bool gbrt_wait_ly(GBContext* ctx, uint8_t value, uint8_t cond, uint32_t cycles) {
+    for (;;) {
+        uint8_t ly = gb_io_read(ctx, 0x44);
+        ctx->a = ly;
+        ctx->f_z = ly == value;
+        ctx->f_n = 1;
+        ctx->f_h = (ly & 0x0F) < (value & 0x0F);
+        ctx->f_c = ly < value;
+        bool again = cond == 0 ? !ctx->f_z : cond == 1 ? ctx->f_z :
+                     cond == 2 ? !ctx->f_c : ctx->f_c;
+        if (!again) return true;
+
+        /* Polls strictly before the next LY change and the next event read
+         * the same value and tick nothing, so skip over them */
+        uint32_t until = ctx->ppu
+            ? slow_clock_delay(ctx, ppu_cycles_until_ly_change((GBPPU*)ctx->ppu), ctx->last_sync_cycles) : 0;
+        int32_t room = (int32_t)(ctx->next_event - ctx->cycles);
+        if (until > 0 && room > 0 && cycles > 0) {
+            uint32_t skip = (until - 1) / cycles;
+            uint32_t skip_events = ((uint32_t)room - 1) / cycles;
+            if (skip_events < skip) skip = skip_events;
+            ctx->cycles += skip * cycles;
+        }
+        gb_tick(ctx, cycles);
+        if (ctx->stopped) return false;
+    }
+}
+
+void gbrt_oam_dma(GBContext* ctx, uint16_t addr, uint8_t delay) {
+    /* LDH (46),A; LD A,delay */
+    gb_io_write(ctx, 0x46, ctx->a);
+    ctx->pc = (uint16_t)(addr + 2);
+    gb_tick(ctx, 12);
+    if (ctx->stopped) return;
+    ctx->a = delay;
+    ctx->pc = (uint16_t)(addr + 4);
+    gb_tick(ctx, 8);
+    if (ctx->stopped) return;
+
+    /* DEC A; JR NZ,-3 */
+    for (;;) {
+        ctx->f_h = (ctx->a & 0x0F) == 0;
+        ctx->a--;
+        ctx->f_z = ctx->a == 0; ctx->f_n = 1;
+        if (ctx->f_z) break;
+        gb_tick(ctx, 16);
+        if (ctx->stopped) return;
+    }
+    ctx->pc = (uint16_t)(addr + 7);
+    gb_tick(ctx, 12);
+    if (ctx->stopped) return;
+
+    /* RET */
+    gb_ret(ctx);
+    gb_tick(ctx, 16);
+}
+
 /* ============================================================================
  * Timing & Hardware Sync
  * ========================================================================== */
 
+/*
+ * In CGB double speed the PPU and APU keep their clock while the CPU,
+ * timer, serial port and OAM DMA run twice as fast. Everything stays in
+ * CPU cycles: the PPU and APU syncs hand over whole cycles of their own
+ * clock (delta >> double_speed, the odd cycle waits for the next sync),
+ * and their events are scheduled that many times further out. gb_tick
+ * itself never scales anything.
+ */
+static inline uint32_t slow_clock_delay(GBContext* ctx, uint32_t cycles, uint32_t synced) {
+    return (cycles << ctx->double_speed) - (ctx->cycles - synced);
+}
+
 static inline void gb_sync(GBContext* ctx) {
-    uint32_t current = ctx->cycles;
-    uint32_t delta = current - ctx->last_sync_cycles;
+    uint32_t delta = (ctx->cycles - ctx->last_sync_cycles) >> ctx->double_speed;
     if (delta > 0) {
-        ctx->last_sync_cycles = current;
-        if (ctx->ppu) ppu_tick((GBPPU*)ctx->ppu, ctx, delta);
+        ctx->last_sync_cycles += delta << ctx->double_speed;
+        if (ctx->ppu) {
+            GBRT_PROFILE_PUSH(ctx, GB_PROFILE_PPU);
+            ppu_tick((GBPPU*)ctx->ppu, ctx, delta);
+            GBRT_PROFILE_POP(ctx);
+        }
     }
 }
 
-void gb_add_cycles(GBContext* ctx, uint32_t cycles) {
-    ctx->cycles += cycles;
-    ctx->frame_cycles += cycles;
+/* log2 of the TIMA input period for each TAC clock select */
+static const uint8_t timer_shift[4] = { 10, 4, 6, 8 };
+
+/* Internal 16-bit divider, derived from the cycle counter */
+static inline uint32_t timer_system_counter(GBContext* ctx) {
+    return ctx->cycles - ctx->div_base;
 }
 
-void gb_tick(GBContext* ctx, uint32_t cycles) {
-    static uint32_t last_log = 0;
-    if (ctx->cycles - last_log >= 10000) {
-        last_log = ctx->cycles;
-        fprintf(stderr, "[TICK] Cycles: %u, PC: 0x%04X, IME: %d, IF: 0x%02X, IE: 0x%02X\n", 
-                ctx->cycles, ctx->pc, ctx->ime, ctx->io[0x0F], ctx->io[0x80]);
+/* Level of the divider bit feeding TIMA, as seen through the TAC enable gate */
+static inline bool timer_input(GBContext* ctx, uint8_t tac) {
+    if (!(tac & 0x04)) return false;
+    return (timer_system_counter(ctx) >> (timer_shift[tac & 3] - 1)) & 1;
+}
+
+static void timer_increment(GBContext* ctx, uint32_t count) {
+    uint32_t tima = ctx->io[0x05];
+    if (count < 0x100 - tima) {
+        ctx->io[0x05] = (uint8_t)(tima + count);
+        return;
     }
-    gb_add_cycles(ctx, cycles);
-    ctx->div_counter += cycles;
-    ctx->io[0x04] = (uint8_t)(ctx->div_counter >> 8);
+    count -= 0x100 - tima;
+    uint32_t span = 0x100 - ctx->io[0x06];
+    ctx->io[0x05] = (uint8_t)(ctx->io[0x06] + count % span);
+    ctx->io[0x0F] |= 0x04;
+}
+
+static void gb_timer_sync(GBContext* ctx) {
+    uint32_t delta = ctx->cycles - ctx->timer_sync_cycles;
+    if (delta == 0) return;
+    ctx->timer_sync_cycles = ctx->cycles;
     
     uint8_t tac = ctx->io[0x07];
-    if (tac & 0x04) {
-        uint32_t thr = 1024;
-        switch (tac & 3) { case 1: thr = 16; break; case 2: thr = 64; break; case 3: thr = 256; break; }
-        ctx->timer_counter += cycles;
-        while (ctx->timer_counter >= thr) {
-            ctx->timer_counter -= thr;
-            if (ctx->io[0x05] == 0xFF) { ctx->io[0x05] = ctx->io[0x06]; ctx->io[0x0F] |= 0x04; }
-            else ctx->io[0x05]++;
-        }
-    }
+    if (!(tac & 0x04)) return;
     
-    if ((ctx->cycles & 0xFF) < cycles || (ctx->ime && (ctx->io[0x0F] & ctx->io[0x80] & 0x1F))) {
-        gb_sync(ctx);
-        if (ctx->frame_done || (ctx->ime && (ctx->io[0x0F] & ctx->io[0x80] & 0x1F))) ctx->stopped = 1;
+    /* Count period boundaries crossed in (cycles - delta, cycles] */
+    uint8_t shift = timer_shift[tac & 3];
+    uint32_t start = (timer_system_counter(ctx) - delta) & ((1u << shift) - 1);
+    uint32_t count = (start + delta) >> shift;
+    if (count) timer_increment(ctx, count);
+}
+
+static void gb_apu_sync(GBContext* ctx) {
+    uint32_t delta = (ctx->cycles - ctx->apu_sync_cycles) >> ctx->double_speed;
+    ctx->apu_sync_cycles += delta << ctx->double_speed;
+    if (delta > 0 && ctx->apu) {
+        GBRT_PROFILE_PUSH(ctx, GB_PROFILE_AUDIO);
+        gb_audio_step(ctx, delta);
+        GBRT_PROFILE_POP(ctx);
     }
-    if (ctx->apu) gb_audio_step(ctx, cycles);
+}
+
+static void gb_schedule_ppu(GBContext* ctx) {
+    uint32_t delay = ctx->ppu ? ppu_cycles_until_event((GBPPU*)ctx->ppu) : 0;
+    if (delay) gb_schedule_event(ctx, GB_EVENT_PPU, slow_clock_delay(ctx, delay, ctx->last_sync_cycles));
+    else gb_cancel_event(ctx, GB_EVENT_PPU);
+}
+
+static void gb_schedule_timer(GBContext* ctx) {
+    uint8_t tac = ctx->io[0x07];
+    if (!(tac & 0x04)) { gb_cancel_event(ctx, GB_EVENT_TIMER); return; }
+    uint8_t shift = timer_shift[tac & 3];
+    uint32_t period = 1u << shift;
+    uint32_t to_edge = period - (timer_system_counter(ctx) & (period - 1));
+    uint32_t delay = to_edge + (uint32_t)(0xFF - ctx->io[0x05]) * period;
+    gb_schedule_event(ctx, GB_EVENT_TIMER, delay);
+}
+
+static void gb_schedule_apu(GBContext* ctx) {
+    uint32_t delay = ctx->apu ? gb_audio_cycles_until_event(ctx) : 0;
+    if (delay) gb_schedule_event(ctx, GB_EVENT_APU, slow_clock_delay(ctx, delay, ctx->apu_sync_cycles));
+    else gb_cancel_event(ctx, GB_EVENT_APU);
+}
+
+static void event_ppu(GBContext* ctx) {
+    gb_sync(ctx);
+    gb_schedule_ppu(ctx);
+}
+
+static void event_timer(GBContext* ctx) {
+    gb_timer_sync(ctx);
+    gb_schedule_timer(ctx);
+}
+
+static void event_apu(GBContext* ctx) {
+    gb_apu_sync(ctx);
+    gb_schedule_apu(ctx);
+}
+
+static void event_serial(GBContext* ctx) {
+    ctx->io[0x02] &= 0x7F;
+    ctx->io[0x0F] |= 0x08;
+}
+
+static void event_dma(GBContext* ctx) {
+    if (ctx->ppu) ((GBPPU*)ctx->ppu)->dma_active = false;
+}
+
+static void event_break(GBContext* ctx) {
+    ctx->stopped = 1;
+}
+
+static void (*const event_handlers[GB_EVENT_COUNT])(GBContext*) = {
+    [GB_EVENT_PPU]    = event_ppu,
+    [GB_EVENT_TIMER]  = event_timer,
+    [GB_EVENT_APU]    = event_apu,
+    [GB_EVENT_SERIAL] = event_serial,
+    [GB_EVENT_DMA]    = event_dma,
+    [GB_EVENT_BREAK]  = event_break,
+};
+
+void gb_schedule_event(GBContext* ctx, GBEventType type, uint32_t delay) {
+    uint32_t when = ctx->cycles + delay;
+    ctx->event_time[type] = when;
+    ctx->event_pending |= (uint8_t)(1u << type);
+    if ((int32_t)(when - ctx->next_event) < 0) ctx->next_event = when;
+}
+
+void gb_cancel_event(GBContext* ctx, GBEventType type) {
+    ctx->event_pending &= (uint8_t)~(1u << type);
+}
+
+void gb_run_events(GBContext* ctx) {
+    bool fired;
+    do {
+        fired = false;
+        for (int i = 0; i < GB_EVENT_COUNT; i++) {
+            uint8_t bit = (uint8_t)(1u << i);
+            if ((ctx->event_pending & bit) && (int32_t)(ctx->cycles - ctx->event_time[i]) >= 0) {
+                ctx->event_pending &= (uint8_t)~bit;
+                event_handlers[i](ctx);
+                fired = true;
+            }
+        }
+    } while (fired);
+    
     if (ctx->ime_pending) { ctx->ime = 1; ctx->ime_pending = 0; }
+    
+    uint32_t next = ctx->cycles + GB_EVENT_MAX_DELAY;
+    for (int i = 0; i < GB_EVENT_COUNT; i++) {
+        if ((ctx->event_pending & (1u << i)) && (int32_t)(ctx->event_time[i] - next) < 0) {
+            next = ctx->event_time[i];
+        }
+    }
+    ctx->next_event = next;
+    
+    if (ctx->frame_done || (ctx->ime && (ctx->io[0x0F] & ctx->io[0x80] & 0x1F))) ctx->stopped = 1;
+}
+
+void gb_add_cycles(GBContext* ctx, uint32_t cycles) {
+    ctx->cycles += cycles;
+    ctx->frame_cycles += cycles;
 }
 
 void gb_handle_interrupts(GBContext* ctx) {
@@ -407,28 +1122,107 @@ void gb_handle_interrupts(GBContext* ctx) {
     }
 }
 
+/* ============================================================================
+ * Instrumentation
+ * ========================================================================== */
+
+static void trace_count(GBContext* ctx, uint16_t addr) {
+    (void)addr;
+    if (ctx->instruction_limit > 0 && ctx->instruction_count >= ctx->instruction_limit) {
+        fprintf(stderr, "[LIMIT] Reached instruction limit %llu\n", (unsigned long long)ctx->instruction_limit);
+        exit(0);
+    }
+    ctx->instruction_count++;
+}
+
+static void trace_log(GBContext* ctx, uint16_t addr) {
+    trace_count(ctx, addr);
+    fprintf(stderr, "[TRACE] 0x%04X (Bank %d) A=%02X BC=%04X DE=%04X HL=%04X SP=%04X\n",
+            addr, addr < 0x4000 ? 0 : ctx->rom_bank, ctx->a, ctx->bc, ctx->de, ctx->hl, ctx->sp);
+}
+
+void gbrt_set_trace(GBContext* ctx, bool enabled) {
+    ctx->trace_enabled = enabled;
+    ctx->trace_hook = enabled ? trace_log : trace_count;
+}
+
+uint64_t gbrt_profile_ticks(void) {
+#ifdef GBRT_HAS_TSC
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void gbrt_profile_reset(GBContext* ctx) {
+    memset(ctx->profile_ticks, 0, sizeof(ctx->profile_ticks));
+    ctx->profile_section = GB_PROFILE_OTHER;
+    ctx->profile_mark = gbrt_profile_ticks();
+}
+
 /* ============================================================================
  * Execution
  * ========================================================================== */
 
+/*
+ * Advance a halted CPU straight to the next scheduled event. Nothing can
+ * raise IF between events, so this is equivalent to ticking 4 cycles at a
+ * time; the jump is rounded up to whole M-cycles to keep the same phase.
+ * Wakes without dispatching when an interrupt is pending with IME clear.
+ */
+static void gb_halt_wait(GBContext* ctx) {
+    if (!ctx->ime && (ctx->io[0x0F] & ctx->io[0x80] & 0x1F)) {
+        ctx->halted = 0;
+        return;
+    }
+    int32_t until = (int32_t)(ctx->next_event - ctx->cycles);
+    uint32_t cycles = until > 4 ? ((uint32_t)until + 3) & ~3u : 4;
+    gb_tick(ctx, cycles);
+}
+
 uint32_t gb_run_frame(GBContext* ctx) {
+    if (!gb_frame_begin(ctx)) return 0;
+    while (!ctx->frame_done) gb_frame_step(ctx);
+    return gb_frame_end(ctx);
+}
+
+bool gb_frame_begin(GBContext* ctx) {
     gb_reset_frame(ctx);
-    uint32_t start = ctx->cycles;
+    ctx->frame_start = ctx->cycles;
     
-    static int fcount = 0;
-    fcount++;
-    if (fcount % 60 == 0) {
-        fprintf(stderr, "[FRAME] Frame %d, Cycles: %u\n", fcount, ctx->cycles);
+    if (ctx->rewind && ctx->rewind_held) {
+        /* Show the previous record, or hold at the oldest one */
+        gb_rewind_step(ctx->rewind, ctx);
+        ctx->frame_done = 1;
+        return false;
     }
-
-    while (!ctx->frame_done) {
-        gb_handle_interrupts(ctx);
-        ctx->stopped = 0;
-        if (ctx->halted) gb_tick(ctx, 4);
-        else gb_step(ctx);
-        gb_sync(ctx);
+    if (ctx->movie) gb_movie_begin_frame(ctx->movie, ctx);
+    
+#ifdef GB_DEBUG_FRAME
+    if (++ctx->debug_frames % 60 == 0) {
+        DBG_FRAME("Frame %u, Cycles: %u", ctx->debug_frames, ctx->cycles);
     }
-    return ctx->cycles - start;
+#endif
+    return true;
+}
+
+void gb_frame_step(GBContext* ctx) {
+    gb_handle_interrupts(ctx);
+    ctx->stopped = 0;
+    if (ctx->halted) gb_halt_wait(ctx);
+    else gb_step(ctx);
+    if (ctx->lockstep) gb_lockstep_check(ctx->lockstep, ctx);
+}
+
+uint32_t gb_frame_end(GBContext* ctx) {
+    gb_apu_sync(ctx);  /* Synthesize the frame's remaining audio */
+    if (ctx->mbc_rtc) gb_rtc_sync(ctx);
+    ctx->frame_cycles = ctx->cycles - ctx->frame_start;
+    if (ctx->movie) gb_movie_end_frame(ctx->movie, ctx);
+    if (ctx->rewind) gb_rewind_record(ctx->rewind, ctx);
+    return ctx->frame_cycles;
 }
 
 uint32_t gb_step(GBContext* ctx) {
@@ -443,14 +1237,71 @@ void gb_reset_frame(GBContext* ctx) {
     if (ctx->ppu) ppu_clear_frame_ready((GBPPU*)ctx->ppu);
 }
 
+void gb_set_turbo(GBContext* ctx, bool turbo, uint8_t frame_skip, bool mute_audio) {
+    ctx->turbo = turbo;
+    ctx->frame_skip = frame_skip;
+    ctx->skip_counter = 0;
+    if (ctx->audio_muted != mute_audio) {
+        gb_apu_sync(ctx);
+        ctx->audio_muted = mute_audio;
+        gb_schedule_apu(ctx);
+    }
+}
+
+bool gb_frame_drawn(GBContext* ctx) {
+    return ctx->ppu && !((GBPPU*)ctx->ppu)->skip_render;
+}
+
 const uint32_t* gb_get_framebuffer(GBContext* ctx) {
     if (ctx->ppu) return ppu_get_framebuffer((GBPPU*)ctx->ppu);
     return NULL;
 }
 
+void gb_set_pixel_format(GBContext* ctx, GBPixelFormat format) {
+    if (ctx->ppu) ppu_set_pixel_format((GBPPU*)ctx->ppu, format);
+}
+
+void gb_set_output_buffer(GBContext* ctx, void* pixels, int pitch) {
+    if (ctx->ppu) ppu_set_output_buffer((GBPPU*)ctx->ppu, pixels, pitch);
+}
+
+void gb_fill_output(GBContext* ctx) {
+    if (ctx->ppu) ppu_fill_output((GBPPU*)ctx->ppu);
+}
+
+const void* gb_get_pixels(GBContext* ctx) {
+    if (ctx->ppu) return ppu_get_pixels((GBPPU*)ctx->ppu);
+    return NULL;
+}
+
+const uint8_t* gb_get_shades(GBContext* ctx) {
+    if (ctx->ppu) return ppu_get_shades((GBPPU*)ctx->ppu);
+    return NULL;
+}
+
+bool gb_get_frame_delta(GBContext* ctx, GBFrameDelta* delta) {
+    if (ctx->ppu) return ppu_take_frame_delta((GBPPU*)ctx->ppu, delta);
+    memset(delta, 0, sizeof(*delta));
+    return false;
+}
+
 void gb_halt(GBContext* ctx) { ctx->halted = 1; }
-void gb_stop(GBContext* ctx) { ctx->stopped = 1; }
+void gb_stop(GBContext* ctx) {
+    if (ctx->cgb && (ctx->io[0x4D] & 0x01)) {
+        /* Speed switch: settle the PPU and APU at the old rate, then
+         * restart their schedules at the new one. STOP also resets DIV. */
+        gb_sync(ctx);
+        gb_apu_sync(ctx);
+        ctx->io[0x4D] = 0;
+        ctx->double_speed ^= 1;
+        ctx->last_sync_cycles = ctx->cycles;
+        ctx->apu_sync_cycles = ctx->cycles;
+        gb_io_write(ctx, 0x04, 0);
+        gb_schedule_ppu(ctx);
+        gb_schedule_apu(ctx);
+    }
+    ctx->stopped = 1;
+}
 bool gb_frame_complete(GBContext* ctx) { return ctx->frame_done != 0; }
 
 void gb_set_platform_callbacks(GBContext* ctx, const GBPlatformCallbacks* c) { (void)ctx; (void)c; }
-void gb_audio_callback(GBContext* ctx, int16_t l, int16_t r) { (void)ctx; (void)l; (void)r; }
@@ -0,0 +1,215 @@
+/**
+ * @file hotspot.c
+ * @brief Per-address dispatch and interpreter fallback counters
+ */
+
+#include "hotspot.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Open-addressed table keyed by bank:address, kept at most half full */
+typedef struct {
+    uint32_t key;           /* bank << 16 | addr, plus one (0 = empty) */
+    GBHotspot counts;
+} HotspotSlot;
+
+struct GBHotspots {
+    HotspotSlot* slots;
+    size_t capacity;        /* Power of two */
+    size_t count;
+};
+
+static inline uint32_t slot_key(uint8_t bank, uint16_t addr) {
+    return ((uint32_t)bank << 16 | addr) + 1;
+}
+
+static inline size_t slot_hash(uint32_t key, size_t capacity) {
+    return (size_t)(key * 0x9E3779B1u) & (capacity - 1);
+}
+
+GBHotspots* gb_hotspots_create(void) {
+    GBHotspots* hs = (GBHotspots*)calloc(1, sizeof(GBHotspots));
+    if (!hs) return NULL;
+    hs->capacity = 1024;
+    hs->slots = (HotspotSlot*)calloc(hs->capacity, sizeof(HotspotSlot));
+    if (!hs->slots) {
+        free(hs);
+        return NULL;
+    }
+    return hs;
+}
+
+void gb_hotspots_destroy(GBHotspots* hs) {
+    if (!hs) return;
+    free(hs->slots);
+    free(hs);
+}
+
+void gb_hotspots_attach(GBContext* ctx, GBHotspots* hs) {
+    ctx->hotspots = hs;
+}
+
+static bool grow(GBHotspots* hs) {
+    size_t capacity = hs->capacity * 2;
+    HotspotSlot* slots = (HotspotSlot*)calloc(capacity, sizeof(HotspotSlot));
+    if (!slots) return false;
+    for (size_t i = 0; i < hs->capacity; i++) {
+        if (!hs->slots[i].key) continue;
+        size_t j = slot_hash(hs->slots[i].key, capacity);
+        while (slots[j].key) j = (j + 1) & (capacity - 1);
+        slots[j] = hs->slots[i];
+    }
+    free(hs->slots);
+    hs->slots = slots;
+    hs->capacity = capacity;
+    return true;
+}
+
+/* Counters of bank:addr, created on first use (NULL if out of memory) */
+static GBHotspot* hotspot_at(GBHotspots* hs, uint8_t bank, uint16_t addr) {
+    uint32_t key = slot_key(bank, addr);
+    size_t i = slot_hash(key, hs->capacity);
+    while (hs->slots[i].key && hs->slots[i].key != key) i = (i + 1) & (hs->capacity - 1);
+    if (hs->slots[i].key) return &hs->slots[i].counts;
+
+    if (2 * (hs->count + 1) > hs->capacity) {
+        if (!grow(hs)) return NULL;
+        return hotspot_at(hs, bank, addr);
+    }
+    hs->slots[i].key = key;
+    hs->slots[i].counts.bank = bank;
+    hs->slots[i].counts.addr = addr;
+    hs->count++;
+    return &hs->slots[i].counts;
+}
+
+void gb_hotspots_fallback(GBHotspots* hs, uint8_t bank, uint16_t addr, uint64_t instructions) {
+    GBHotspot* counts = hotspot_at(hs, bank, addr);
+    if (!counts) return;
+    counts->fallbacks++;
+    counts->instructions += instructions;
+}
+
+void gbrt_hotspot_enter(GBContext* ctx, uint8_t bank, uint16_t addr) {
+    GBHotspot* counts = hotspot_at(ctx->hotspots, bank, addr);
+    if (counts) counts->calls++;
+}
+
+void gbrt_hotspot_jump(GBContext* ctx, uint16_t addr) {
+    GBHotspot* counts = hotspot_at(ctx->hotspots, gb_hotspot_bank(ctx, addr), addr);
+    if (counts) counts->jumps++;
+}
+
+size_t gb_hotspots_count(const GBHotspots* hs) {
+    return hs->count;
+}
+
+/* ============================================================================
+ * Reports
+ * ========================================================================== */
+
+static int by_interpreted(const void* a, const void* b) {
+    const GBHotspot* x = (const GBHotspot*)a;
+    const GBHotspot* y = (const GBHotspot*)b;
+    if (x->instructions != y->instructions) return x->instructions < y->instructions ? 1 : -1;
+    if (x->fallbacks != y->fallbacks) return x->fallbacks < y->fallbacks ? 1 : -1;
+    if (x->calls != y->calls) return x->calls < y->calls ? 1 : -1;
+    if (x->jumps != y->jumps) return x->jumps < y->jumps ? 1 : -1;
+    if (x->bank != y->bank) return x->bank < y->bank ? -1 : 1;
+    return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+static int by_calls(const void* a, const void* b) {
+    const GBHotspot* x = (const GBHotspot*)a;
+    const GBHotspot* y = (const GBHotspot*)b;
+    if (x->calls != y->calls) return x->calls < y->calls ? 1 : -1;
+    return by_interpreted(a, b);
+}
+
+size_t gb_hotspots_sorted(const GBHotspots* hs, GBHotspot* out, size_t max) {
+    size_t n = 0;
+    for (size_t i = 0; i < hs->capacity && n < hs->count; i++) {
+        if (hs->slots[i].key) out[n++] = hs->slots[i].counts;
+    }
+    qsort(out, n, sizeof(GBHotspot), by_interpreted);
+    return n < max ? n : max;
+}
+
+void gb_hotspots_report(const GBHotspots* hs, FILE* out, size_t limit) {
+    GBHotspot* rows = (GBHotspot*)malloc((hs->count + 1) * sizeof(GBHotspot));
+    if (!rows) return;
+    size_t n = gb_hotspots_sorted(hs, rows, hs->count);
+
+    uint64_t calls = 0, fallbacks = 0, instructions = 0;
+    size_t fallback_sites = 0;
+    for (size_t i = 0; i < n; i++) {
+        calls += rows[i].calls;
+        fallbacks += rows[i].fallbacks;
+        instructions += rows[i].instructions;
+        if (rows[i].fallbacks) fallback_sites++;
+    }
+    fprintf(out, "Function entries: %llu, interpreter entries: %llu at %zu addresses, %llu instructions\n",
+            (unsigned long long)calls, (unsigned long long)fallbacks, fallback_sites,
+            (unsigned long long)instructions);
+
+    fprintf(out, "\nInterpreter fallbacks (most instructions first):\n");
+    fprintf(out, "  %-9s %12s %14s %12s\n", "bank:addr", "entries", "instructions", "jumps");
+    for (size_t i = 0, shown = 0; i < n && rows[i].fallbacks && (!limit || shown < limit); i++, shown++) {
+        fprintf(out, "  %02X:%04X   %12llu %14llu %12llu\n", rows[i].bank, rows[i].addr,
+                (unsigned long long)rows[i].fallbacks, (unsigned long long)rows[i].instructions,
+                (unsigned long long)rows[i].jumps);
+    }
+
+    qsort(rows, n, sizeof(GBHotspot), by_calls);
+    fprintf(out, "\nRecompiled functions (most entries first):\n");
+    fprintf(out, "  %-9s %12s %12s\n", "bank:addr", "entries", "jumps");
+    for (size_t i = 0, shown = 0; i < n && rows[i].calls && (!limit || shown < limit); i++, shown++) {
+        fprintf(out, "  %02X:%04X   %12llu %12llu\n", rows[i].bank, rows[i].addr,
+                (unsigned long long)rows[i].calls, (unsigned long long)rows[i].jumps);
+    }
+    free(rows);
+}
+
+bool gb_hotspots_write_profile(const GBHotspots* hs, const char* path) {
+    GBHotspot* rows = (GBHotspot*)malloc((hs->count + 1) * sizeof(GBHotspot));
+    if (!rows) return false;
+    size_t n = gb_hotspots_sorted(hs, rows, hs->count);
+
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        free(rows);
+        return false;
+    }
+    fprintf(f, "{\n  \"format\": \"gbrt-profile\",\n  \"version\": 1,\n  \"sites\": [");
+    for (size_t i = 0; i < n; i++) {
+        fprintf(f, "%s\n    {\"bank\": %u, \"addr\": %u, \"calls\": %llu, \"fallbacks\": %llu, "
+                "\"instructions\": %llu, \"jumps\": %llu}", i ? "," : "",
+                rows[i].bank, rows[i].addr, (unsigned long long)rows[i].calls,
+                (unsigned long long)rows[i].fallbacks, (unsigned long long)rows[i].instructions,
+                (unsigned long long)rows[i].jumps);
+    }
+    fprintf(f, "\n  ]\n}\n");
+    free(rows);
+    return fclose(f) == 0;
+}
+
+bool gb_hotspots_write_entry_points(const GBHotspots* hs, const char* path) {
+    GBHotspot* rows = (GBHotspot*)malloc((hs->count + 1) * sizeof(GBHotspot));
+    if (!rows) return false;
+    size_t n = gb_hotspots_sorted(hs, rows, hs->count);
+
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        free(rows);
+        return false;
+    }
+    fprintf(f, "# Interpreter fallbacks, for gbrecomp --entry-points\n");
+    fprintf(f, "# bank:addr  entries instructions\n");
+    for (size_t i = 0; i < n; i++) {
+        if (!rows[i].fallbacks || rows[i].addr >= 0x8000) continue;
+        fprintf(f, "%02X:%04X  # %llu %llu\n", rows[i].bank, rows[i].addr,
+                (unsigned long long)rows[i].fallbacks, (unsigned long long)rows[i].instructions);
+    }
+    free(rows);
+    return fclose(f) == 0;
+}
@@ -1,11 +1,27 @@
 #include "gbrt.h"
 #include "gbrt_debug.h"
 #include "ppu.h"
+#include "hotspot.h"
+#include "jit.h"
 #include <stdlib.h>
+#include <string.h>
 
-/* Helper macros for instruction arguments */
-#define READ8(ctx) gb_read8(ctx, ctx->pc++)
-#define READ16(ctx) (ctx->pc += 2, gb_read16(ctx, ctx->pc - 2))
+/* Operands of the current instruction; PC is already past it */
+#define IMM8 ((uint8_t)imm)
+#define IMM16 (imm)
+
+/* Computed-goto dispatch under GCC/Clang, a switch elsewhere */
+#if defined(__GNUC__)
+#define INTERP_THREADED 1
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define OP(x) op_##x:
+#else
+#define INTERP_THREADED 0
+#define OP(x) case 0x##x:
+#endif
+#define NEXT goto next
+/* Leave after a taken transfer, charging its cycles */
+#define TAKEN(cycles) do { gb_tick(ctx, cycles); return; } while (0)
 
 static uint8_t get_reg8(GBContext* ctx, uint8_t idx) {
     switch (idx) {
@@ -34,39 +50,283 @@ static void set_reg8(GBContext* ctx, uint8_t idx, uint8_t val) {
     }
 }
 
-void gb_interpret(GBContext* ctx, uint16_t addr) {
+/* ============================================================================
+ * Decode Cache
+ *
+ * Instructions are decoded once per address into opcode, length and operand,
+ * a run at a time, and kept per 256-byte page. A page is tagged with the
+ * host memory it was decoded from, so bank switches select a fresh decode
+ * instead of reusing another bank's. RAM pages holding decoded code are left
+ * out of write_map; the first store to one drops its decode (and its echo's).
+ * OAM, I/O and HRAM are never cached, nor are instructions crossing a page.
+ * With GBRT_JIT, pages also count entries and hold translated blocks (jit.h),
+ * which go with the decode.
+ * ========================================================================== */
+
+const uint8_t gb_op_length[256] = {
+    1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1,  /* 0x00 */
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,  /* 0x10 */
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,  /* 0x20 */
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,  /* 0x30 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0x40 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0x50 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0x60 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0x70 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0x80 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0x90 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0xA0 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0xB0 */
+    1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1,  /* 0xC0 */
+    1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 1, 2, 1,  /* 0xD0 */
+    2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1,  /* 0xE0 */
+    2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1,  /* 0xF0 */
+};
+
+/* Cycles by opcode, branches not taken; CB ops are charged in their handler */
+const uint8_t gb_op_cycles[256] = {
+     4, 12,  8,  8,  4,  4,  8,  4, 20,  8,  8,  8,  4,  4,  8,  4,  /* 0x00 */
+     4, 12,  8,  8,  4,  4,  8,  4, 12,  8,  8,  8,  4,  4,  8,  4,  /* 0x10 */
+     8, 12,  8,  8,  4,  4,  8,  4,  8,  8,  8,  8,  4,  4,  8,  4,  /* 0x20 */
+     8, 12,  8,  8, 12, 12, 12,  4,  8,  8,  8,  8,  4,  4,  8,  4,  /* 0x30 */
+     4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  /* 0x40 */
+     4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  /* 0x50 */
+     4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  /* 0x60 */
+     8,  8,  8,  8,  8,  8,  4,  8,  4,  4,  4,  4,  4,  4,  8,  4,  /* 0x70 */
+     4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  /* 0x80 */
+     4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  /* 0x90 */
+     4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  /* 0xA0 */
+     4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  /* 0xB0 */
+     8, 12, 12, 16, 12, 16,  8, 16,  8, 16, 12,  0, 12, 24,  8, 16,  /* 0xC0 */
+     8, 12, 12,  4, 12, 16,  8, 16,  8, 16, 12,  4, 12,  4,  8, 16,  /* 0xD0 */
+    12, 12,  8,  4,  4, 16,  8, 16, 16,  4, 16,  4,  4,  4,  8, 16,  /* 0xE0 */
+    12, 12,  8,  4,  4, 16,  8, 16, 12,  8, 16,  4,  4,  4,  8, 16,  /* 0xF0 */
+};
+
+typedef struct {
+    uint8_t op;
+    uint8_t len;            /* 0 = not decoded */
+    uint16_t imm;
+} DecodedOp;
+
+typedef struct {
+    const uint8_t* source;  /* read_map entry the page was decoded from */
+    DecodedOp ops[256];
+#if GBRT_JIT
+    uint16_t hits[256];     /* Interpreter entries, until translated */
+    GBJitBlock blocks[256];
+#endif
+} DecodedPage;
+
+struct GBDecodeCache {
+    DecodedPage* pages[256];
+};
+
+/* Unconditional control transfers end a decode run */
+static inline bool ends_run(uint8_t op) {
+    switch (op) {
+        case 0x10: case 0x18: case 0x76: case 0xC3: case 0xC9: case 0xD9: case 0xE9:
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void drop_page(GBContext* ctx, int page) {
+    ctx->code_pages[page] &= (uint8_t)~GB_CODE_DECODED;
+    DecodedPage* dp = ctx->decode_cache ? ctx->decode_cache->pages[page] : NULL;
+    if (dp) memset(dp, 0, sizeof(*dp));
+}
+
+/* Keep stores to a RAM page (and its echo) out of write_map */
+static void protect_page(GBContext* ctx, int page) {
+    ctx->code_pages[page] |= GB_CODE_DECODED;
+    ctx->write_map[page] = NULL;
+    int echo = gb_echo_page(page);
+    if (echo >= 0) {
+        ctx->code_pages[echo] |= GB_CODE_DECODED;
+        ctx->write_map[echo] = NULL;
+    }
+}
+
+/* Decoded page for the current mapping, NULL if the page is not cached */
+static DecodedPage* decode_page(GBContext* ctx, int page) {
+    const uint8_t* source = ctx->read_map[page];
+    if (page >= 0xFE || !source) return NULL;
+    if (!ctx->decode_cache) {
+        ctx->decode_cache = (struct GBDecodeCache*)calloc(1, sizeof(struct GBDecodeCache));
+        if (!ctx->decode_cache) return NULL;
+    }
+    DecodedPage* dp = ctx->decode_cache->pages[page];
+    if (!dp) {
+        dp = (DecodedPage*)calloc(1, sizeof(DecodedPage));
+        if (!dp) return NULL;
+        ctx->decode_cache->pages[page] = dp;
+    }
+    if (dp->source != source) {
+        memset(dp, 0, sizeof(*dp));
+        dp->source = source;
+    }
+    if (page >= 0x80) protect_page(ctx, page);
+    return dp;
+}
+
+/* Decode from addr up to the end of the run or the page */
+static void decode_run(DecodedPage* dp, uint16_t addr) {
+    const uint8_t* src = dp->source;
+    for (unsigned i = addr & 0xFF; i < 0x100 && !dp->ops[i].len; ) {
+        uint8_t op = src[i];
+        uint8_t len = gb_op_length[op];
+        if (i + len > 0x100) break;
+        DecodedOp* d = &dp->ops[i];
+        d->op = op;
+        d->len = len;
+        d->imm = len == 1 ? 0 : len == 2 ? src[i + 1] : (uint16_t)(src[i + 1] | src[i + 2] << 8);
+        if (ends_run(op)) break;
+        i += len;
+    }
+}
+
+/* Decode straight from memory, for code the cache does not hold */
+static void decode_uncached(GBContext* ctx, uint16_t addr, DecodedOp* out) {
+    out->op = gb_read8(ctx, addr);
+    out->len = gb_op_length[out->op];
+    out->imm = 0;
+    if (out->len >= 2) out->imm = gb_read8(ctx, addr + 1);
+    if (out->len == 3) out->imm |= (uint16_t)gb_read8(ctx, addr + 2) << 8;
+}
+
+static const DecodedOp* fetch_slow(GBContext* ctx, DecodedOp* scratch) {
+    uint16_t pc = ctx->pc;
+    DecodedPage* dp = decode_page(ctx, pc >> 8);
+    if (dp) {
+        decode_run(dp, pc);
+        if (dp->ops[pc & 0xFF].len) return &dp->ops[pc & 0xFF];
+    }
+    decode_uncached(ctx, pc, scratch);
+    return scratch;
+}
+
+static inline const DecodedOp* fetch(GBContext* ctx, DecodedOp* scratch) {
+    uint16_t pc = ctx->pc;
+    DecodedPage* dp = ctx->decode_cache ? ctx->decode_cache->pages[pc >> 8] : NULL;
+    if (dp && dp->source == ctx->read_map[pc >> 8] && dp->ops[pc & 0xFF].len) {
+        return &dp->ops[pc & 0xFF];
+    }
+    return fetch_slow(ctx, scratch);
+}
+
+void gb_decode_cache_invalidate(GBContext* ctx, uint8_t page) {
+    drop_page(ctx, page);
+    int echo = gb_echo_page(page);
+    if (echo >= 0) drop_page(ctx, echo);
+    gb_update_memory_map(ctx);
+}
+
+void gb_decode_cache_flush(GBContext* ctx) {
+    for (int p = 0; p < 256; p++) {
+        if ((ctx->code_pages[p] & GB_CODE_DECODED) || (ctx->decode_cache && ctx->decode_cache->pages[p])) drop_page(ctx, p);
+    }
+    gb_update_memory_map(ctx);
+}
+
+void gb_decode_cache_destroy(GBContext* ctx) {
+    if (!ctx->decode_cache) return;
+    for (int p = 0; p < 256; p++) free(ctx->decode_cache->pages[p]);
+    free(ctx->decode_cache);
+    ctx->decode_cache = NULL;
+    for (int p = 0; p < 256; p++) ctx->code_pages[p] &= (uint8_t)~GB_CODE_DECODED;
+}
+
+#if GBRT_JIT
+/* Forget every translated block before the translator reuses its buffer */
+static void forget_blocks(GBContext* ctx) {
+    for (int p = 0; p < 256; p++) {
+        DecodedPage* dp = ctx->decode_cache->pages[p];
+        if (!dp) continue;
+        memset(dp->hits, 0, sizeof(dp->hits));
+        memset(dp->blocks, 0, sizeof(dp->blocks));
+    }
+    gb_jit_reset(ctx->jit);
+}
+
+/* Run the block translated at addr, translating it once it is hot. False
+ * if execution continues in the interpreter at ctx->pc. */
+static bool run_translated(GBContext* ctx, uint16_t addr) {
+    DecodedPage* dp = decode_page(ctx, addr >> 8);
+    if (!dp) return false;
+    GBJitBlock block = dp->blocks[addr & 0xFF];
+    if (!block) {
+        if (++dp->hits[addr & 0xFF] != gb_jit_threshold(ctx->jit)) return false;
+        if (!gb_jit_has_room(ctx->jit)) forget_blocks(ctx);
+        block = gb_jit_translate(ctx->jit, dp->source, gb_hotspot_bank(ctx, addr), addr);
+        if (!block) return false;
+        dp->blocks[addr & 0xFF] = block;
+    }
+    return block(ctx) != 0;
+}
+#endif
+
+/* ============================================================================
+ * Interpreter
+ * ========================================================================== */
+
+static void interpret_block(GBContext* ctx, uint16_t addr) {
+#if INTERP_THREADED
+    static const void* const dispatch[256] = {
+        &&op_00, &&op_01, &&op_02, &&op_03, &&op_04, &&op_05, &&op_06, &&op_07,
+        &&op_08, &&op_09, &&op_0A, &&op_0B, &&op_0C, &&op_0D, &&op_0E, &&op_0F,
+        &&op_10, &&op_11, &&op_12, &&op_13, &&op_14, &&op_15, &&op_16, &&op_17,
+        &&op_18, &&op_19, &&op_1A, &&op_1B, &&op_1C, &&op_1D, &&op_1E, &&op_1F,
+        &&op_20, &&op_21, &&op_22, &&op_23, &&op_24, &&op_25, &&op_26, &&op_27,
+        &&op_28, &&op_29, &&op_2A, &&op_2B, &&op_2C, &&op_2D, &&op_2E, &&op_2F,
+        &&op_30, &&op_31, &&op_32, &&op_33, &&op_34, &&op_35, &&op_36, &&op_37,
+        &&op_38, &&op_39, &&op_3A, &&op_3B, &&op_3C, &&op_3D, &&op_3E, &&op_3F,
+        &&op_40, &&op_41, &&op_42, &&op_43, &&op_44, &&op_45, &&op_46, &&op_47,
+        &&op_48, &&op_49, &&op_4A, &&op_4B, &&op_4C, &&op_4D, &&op_4E, &&op_4F,
+        &&op_50, &&op_51, &&op_52, &&op_53, &&op_54, &&op_55, &&op_56, &&op_57,
+        &&op_58, &&op_59, &&op_5A, &&op_5B, &&op_5C, &&op_5D, &&op_5E, &&op_5F,
+        &&op_60, &&op_61, &&op_62, &&op_63, &&op_64, &&op_65, &&op_66, &&op_67,
+        &&op_68, &&op_69, &&op_6A, &&op_6B, &&op_6C, &&op_6D, &&op_6E, &&op_6F,
+        &&op_70, &&op_71, &&op_72, &&op_73, &&op_74, &&op_75, &&op_76, &&op_77,
+        &&op_78, &&op_79, &&op_7A, &&op_7B, &&op_7C, &&op_7D, &&op_7E, &&op_7F,
+        &&op_80, &&op_81, &&op_82, &&op_83, &&op_84, &&op_85, &&op_86, &&op_87,
+        &&op_88, &&op_89, &&op_8A, &&op_8B, &&op_8C, &&op_8D, &&op_8E, &&op_8F,
+        &&op_90, &&op_91, &&op_92, &&op_93, &&op_94, &&op_95, &&op_96, &&op_97,
+        &&op_98, &&op_99, &&op_9A, &&op_9B, &&op_9C, &&op_9D, &&op_9E, &&op_9F,
+        &&op_A0, &&op_A1, &&op_A2, &&op_A3, &&op_A4, &&op_A5, &&op_A6, &&op_A7,
+        &&op_A8, &&op_A9, &&op_AA, &&op_AB, &&op_AC, &&op_AD, &&op_AE, &&op_AF,
+        &&op_B0, &&op_B1, &&op_B2, &&op_B3, &&op_B4, &&op_B5, &&op_B6, &&op_B7,
+        &&op_B8, &&op_B9, &&op_BA, &&op_BB, &&op_BC, &&op_BD, &&op_BE, &&op_BF,
+        &&op_C0, &&op_C1, &&op_C2, &&op_C3, &&op_C4, &&op_C5, &&op_C6, &&op_C7,
+        &&op_C8, &&op_C9, &&op_CA, &&op_CB, &&op_CC, &&op_CD, &&op_CE, &&op_CF,
+        &&op_D0, &&op_D1, &&op_D2, &&op_D3, &&op_D4, &&op_D5, &&op_D6, &&op_D7,
+        &&op_D8, &&op_D9, &&op_DA, &&op_DB, &&op_DC, &&op_DD, &&op_DE, &&op_DF,
+        &&op_E0, &&op_E1, &&op_E2, &&op_E3, &&op_E4, &&op_E5, &&op_E6, &&op_E7,
+        &&op_E8, &&op_E9, &&op_EA, &&op_EB, &&op_EC, &&op_ED, &&op_EE, &&op_EF,
+        &&op_F0, &&op_F1, &&op_F2, &&op_F3, &&op_F4, &&op_F5, &&op_F6, &&op_F7,
+        &&op_F8, &&op_F9, &&op_FA, &&op_FB, &&op_FC, &&op_FD, &&op_FE, &&op_FF,
+    };
+#endif
+
     /* Set PC to the address we want to execute */
     ctx->pc = addr;
     
     /* Interpreter entry logging */
 #ifdef GB_DEBUG_REGS
-    static int entry_count = 0;
-    entry_count++;
-    if (entry_count <= 100) {
-        fprintf(stderr, "[INTERP] Enter interpreter at 0x%04X (entry #%d)\n", addr, entry_count);
+    if (++ctx->debug_interp_entries <= 100) {
+        fprintf(stderr, "[INTERP] Enter interpreter at 0x%04X (entry #%u)\n", addr, ctx->debug_interp_entries);
     }
 #endif
 
-    uint32_t instructions_executed = 0;
+#if GBRT_JIT
+    if (ctx->jit && run_translated(ctx, addr)) return;
+#endif
 
     while (!ctx->stopped) {
-        instructions_executed++;
-        
-        /* Debug logging */
-        (void)instructions_executed; /* Avoid unused warning */
-        
-        /* Check instruction limit */
-        if (gbrt_instruction_limit > 0 && gbrt_instruction_count >= gbrt_instruction_limit) {
-            fprintf(stderr, "[LIMIT] Reached instruction limit %llu\n", (unsigned long long)gbrt_instruction_limit);
-            exit(0);
-        }
-        gbrt_instruction_count++;
-
-        /* Debug logging */
-        if (gbrt_trace_enabled) {
-             DBG_GENERAL("Interpreter (0x%04X): Regs A=%02X B=%02X C=%02X D=%02X E=%02X H=%02X L=%02X SP=%04X HL=%04X",
-                        ctx->pc, ctx->a, ctx->b, ctx->c, ctx->d, ctx->e, ctx->h, ctx->l, ctx->sp, ctx->hl);
-        }
+        /* Instruction limit and tracing (GBRT_INSTRUMENT >= 1) */
+        GBRT_TRACE(ctx, ctx->pc);
+        GBRT_HOTSPOT_STEP(ctx);
 
 #ifdef GB_DEBUG_REGS
         if (1) { /* Always log if REGS is enabled */
@@ -74,14 +334,13 @@ void gb_interpret(GBContext* ctx, uint16_t addr) {
                         ctx->pc, ctx->a, ctx->b, ctx->c, ctx->d, ctx->e, ctx->h, ctx->l, ctx->sp, ctx->hl);
             
             if (ctx->pc >= 0x8000) {
-                static uint16_t last_dump_pc = 0;
-                if (ctx->pc != last_dump_pc) {
+                if (ctx->pc != ctx->debug_last_dump_pc) {
                     DBG_GENERAL("Code at 0x%04X: %02X %02X %02X %02X %02X %02X %02X %02X",
                                 ctx->pc, gb_read8(ctx, ctx->pc), gb_read8(ctx, ctx->pc+1), 
                                 gb_read8(ctx, ctx->pc+2), gb_read8(ctx, ctx->pc+3),
                                 gb_read8(ctx, ctx->pc+4), gb_read8(ctx, ctx->pc+5),
                                 gb_read8(ctx, ctx->pc+6), gb_read8(ctx, ctx->pc+7));
-                    last_dump_pc = ctx->pc;
+                    ctx->debug_last_dump_pc = ctx->pc;
                 }
             }
         }
@@ -94,442 +353,444 @@ void gb_interpret(GBContext* ctx, uint16_t addr) {
          * The interpreter is now a universal fallback for ANY uncompiled code.
          */
 
-        /* HRAM DMA Interception */
-        /* Check for standard HRAM DMA routine: LDH (0xFF46), A */
-        if (ctx->pc >= 0xFF80 && ctx->pc <= 0xFFFE) {
-             uint8_t op = gb_read8(ctx, ctx->pc);
-             if (op == 0xE0 && gb_read8(ctx, ctx->pc + 1) == 0x46) {
-                 DBG_GENERAL("Interpreter: Intercepted HRAM DMA at 0x%04X", ctx->pc);
-                 gb_write8(ctx, 0xFF46, ctx->a);
-                 gb_ret(ctx); /* Execute RET */
-                 return;
-             }
-        }
+        DecodedOp scratch;
+        const DecodedOp* d = fetch(ctx, &scratch);
 
-        uint8_t opcode = READ8(ctx);
-        
+        /* Copy it out, since a store may drop the decoded page */
+        uint8_t opcode = d->op;
+        uint32_t cycles = gb_op_cycles[opcode];
+        uint16_t imm = d->imm;
+        ctx->pc += d->len;
+
+#if INTERP_THREADED
+        goto *dispatch[opcode];
+#else
         switch (opcode) {
-            case 0x00: /* NOP */ break;
+#endif
+            OP(00) /* NOP */ NEXT;
             
-            case 0x07: gb_rlca(ctx); break;
-            case 0x0F: gb_rrca(ctx); break;
-            case 0x17: gb_rla(ctx); break;
-            case 0x1F: gb_rra(ctx); break;
-            case 0x27: gb_daa(ctx); break;
-            case 0x2F: ctx->a = ~ctx->a; ctx->f_n = 1; ctx->f_h = 1; break; /* CPL */
-            case 0x37: ctx->f_n = 0; ctx->f_h = 0; ctx->f_c = 1; break; /* SCF */
-            case 0x3F: ctx->f_n = 0; ctx->f_h = 0; ctx->f_c = !ctx->f_c; break; /* CCF */
+            OP(07) gb_rlca(ctx); NEXT;
+            OP(0F) gb_rrca(ctx); NEXT;
+            OP(17) gb_rla(ctx); NEXT;
+            OP(1F) gb_rra(ctx); NEXT;
+            OP(27) gb_daa(ctx); NEXT;
+            OP(2F) ctx->a = ~ctx->a; ctx->f_n = 1; ctx->f_h = 1; NEXT; /* CPL */
+            OP(37) ctx->f_n = 0; ctx->f_h = 0; ctx->f_c = 1; NEXT; /* SCF */
+            OP(3F) ctx->f_n = 0; ctx->f_h = 0; ctx->f_c = !ctx->f_c; NEXT; /* CCF */
             
-            case 0x10: gb_stop(ctx); ctx->pc++; break; /* STOP 0 */
+            OP(10) gb_stop(ctx); NEXT; /* STOP 0 */
             
             /* 8-bit Loads */
-            case 0x06: ctx->b = READ8(ctx); break; /* LD B,n */
-            case 0x0E: ctx->c = READ8(ctx); break; /* LD C,n */
-            case 0x16: ctx->d = READ8(ctx); break; /* LD D,n */
-            case 0x1E: ctx->e = READ8(ctx); break; /* LD E,n */
-            case 0x26: ctx->h = READ8(ctx); break; /* LD H,n */
-            case 0x2E: ctx->l = READ8(ctx); break; /* LD L,n */
-            case 0x3E: ctx->a = READ8(ctx); break; /* LD A,n */
+            OP(06) ctx->b = IMM8; NEXT; /* LD B,n */
+            OP(0E) ctx->c = IMM8; NEXT; /* LD C,n */
+            OP(16) ctx->d = IMM8; NEXT; /* LD D,n */
+            OP(1E) ctx->e = IMM8; NEXT; /* LD E,n */
+            OP(26) ctx->h = IMM8; NEXT; /* LD H,n */
+            OP(2E) ctx->l = IMM8; NEXT; /* LD L,n */
+            OP(3E) ctx->a = IMM8; NEXT; /* LD A,n */
             
             /* Complete LD r, r' instructions (0x40-0x7F) */
             /* LD B, r */
-            case 0x40: ctx->b = ctx->b; break; /* LD B,B */
-            case 0x41: ctx->b = ctx->c; break; /* LD B,C */
-            case 0x42: ctx->b = ctx->d; break; /* LD B,D */
-            case 0x43: ctx->b = ctx->e; break; /* LD B,E */
-            case 0x44: ctx->b = ctx->h; break; /* LD B,H */
-            case 0x45: ctx->b = ctx->l; break; /* LD B,L */
-            case 0x46: ctx->b = gb_read8(ctx, ctx->hl); break; /* LD B,(HL) */
-            case 0x47: ctx->b = ctx->a; break; /* LD B,A */
+            OP(40) ctx->b = ctx->b; NEXT; /* LD B,B */
+            OP(41) ctx->b = ctx->c; NEXT; /* LD B,C */
+            OP(42) ctx->b = ctx->d; NEXT; /* LD B,D */
+            OP(43) ctx->b = ctx->e; NEXT; /* LD B,E */
+            OP(44) ctx->b = ctx->h; NEXT; /* LD B,H */
+            OP(45) ctx->b = ctx->l; NEXT; /* LD B,L */
+            OP(46) ctx->b = gb_read8(ctx, ctx->hl); NEXT; /* LD B,(HL) */
+            OP(47) ctx->b = ctx->a; NEXT; /* LD B,A */
             
             /* LD C, r */
-            case 0x48: ctx->c = ctx->b; break; /* LD C,B */
-            case 0x49: ctx->c = ctx->c; break; /* LD C,C */
-            case 0x4A: ctx->c = ctx->d; break; /* LD C,D */
-            case 0x4B: ctx->c = ctx->e; break; /* LD C,E */
-            case 0x4C: ctx->c = ctx->h; break; /* LD C,H */
-            case 0x4D: ctx->c = ctx->l; break; /* LD C,L */
-            case 0x4E: ctx->c = gb_read8(ctx, ctx->hl); break; /* LD C,(HL) */
-            case 0x4F: ctx->c = ctx->a; break; /* LD C,A */
+            OP(48) ctx->c = ctx->b; NEXT; /* LD C,B */
+            OP(49) ctx->c = ctx->c; NEXT; /* LD C,C */
+            OP(4A) ctx->c = ctx->d; NEXT; /* LD C,D */
+            OP(4B) ctx->c = ctx->e; NEXT; /* LD C,E */
+            OP(4C) ctx->c = ctx->h; NEXT; /* LD C,H */
+            OP(4D) ctx->c = ctx->l; NEXT; /* LD C,L */
+            OP(4E) ctx->c = gb_read8(ctx, ctx->hl); NEXT; /* LD C,(HL) */
+            OP(4F) ctx->c = ctx->a; NEXT; /* LD C,A */
             
             /* LD D, r */
-            case 0x50: ctx->d = ctx->b; break; /* LD D,B */
-            case 0x51: ctx->d = ctx->c; break; /* LD D,C */
-            case 0x52: ctx->d = ctx->d; break; /* LD D,D */
-            case 0x53: ctx->d = ctx->e; break; /* LD D,E */
-            case 0x54: ctx->d = ctx->h; break; /* LD D,H */
-            case 0x55: ctx->d = ctx->l; break; /* LD D,L */
-            case 0x56: ctx->d = gb_read8(ctx, ctx->hl); break; /* LD D,(HL) */
-            case 0x57: ctx->d = ctx->a; break; /* LD D,A */
+            OP(50) ctx->d = ctx->b; NEXT; /* LD D,B */
+            OP(51) ctx->d = ctx->c; NEXT; /* LD D,C */
+            OP(52) ctx->d = ctx->d; NEXT; /* LD D,D */
+            OP(53) ctx->d = ctx->e; NEXT; /* LD D,E */
+            OP(54) ctx->d = ctx->h; NEXT; /* LD D,H */
+            OP(55) ctx->d = ctx->l; NEXT; /* LD D,L */
+            OP(56) ctx->d = gb_read8(ctx, ctx->hl); NEXT; /* LD D,(HL) */
+            OP(57) ctx->d = ctx->a; NEXT; /* LD D,A */
             
             /* LD E, r */
-            case 0x58: ctx->e = ctx->b; break; /* LD E,B */
-            case 0x59: ctx->e = ctx->c; break; /* LD E,C */
-            case 0x5A: ctx->e = ctx->d; break; /* LD E,D */
-            case 0x5B: ctx->e = ctx->e; break; /* LD E,E */
-            case 0x5C: ctx->e = ctx->h; break; /* LD E,H */
-            case 0x5D: ctx->e = ctx->l; break; /* LD E,L */
-            case 0x5E: ctx->e = gb_read8(ctx, ctx->hl); break; /* LD E,(HL) */
-            case 0x5F: ctx->e = ctx->a; break; /* LD E,A */
+            OP(58) ctx->e = ctx->b; NEXT; /* LD E,B */
+            OP(59) ctx->e = ctx->c; NEXT; /* LD E,C */
+            OP(5A) ctx->e = ctx->d; NEXT; /* LD E,D */
+            OP(5B) ctx->e = ctx->e; NEXT; /* LD E,E */
+            OP(5C) ctx->e = ctx->h; NEXT; /* LD E,H */
+            OP(5D) ctx->e = ctx->l; NEXT; /* LD E,L */
+            OP(5E) ctx->e = gb_read8(ctx, ctx->hl); NEXT; /* LD E,(HL) */
+            OP(5F) ctx->e = ctx->a; NEXT; /* LD E,A */
             
             /* LD H, r */
-            case 0x60: ctx->h = ctx->b; break; /* LD H,B */
-            case 0x61: ctx->h = ctx->c; break; /* LD H,C */
-            case 0x62: ctx->h = ctx->d; break; /* LD H,D */
-            case 0x63: ctx->h = ctx->e; break; /* LD H,E */
-            case 0x64: ctx->h = ctx->h; break; /* LD H,H */
-            case 0x65: ctx->h = ctx->l; break; /* LD H,L */
-            case 0x66: ctx->h = gb_read8(ctx, ctx->hl); break; /* LD H,(HL) */
-            case 0x67: ctx->h = ctx->a; break; /* LD H,A */
+            OP(60) ctx->h = ctx->b; NEXT; /* LD H,B */
+            OP(61) ctx->h = ctx->c; NEXT; /* LD H,C */
+            OP(62) ctx->h = ctx->d; NEXT; /* LD H,D */
+            OP(63) ctx->h = ctx->e; NEXT; /* LD H,E */
+            OP(64) ctx->h = ctx->h; NEXT; /* LD H,H */
+            OP(65) ctx->h = ctx->l; NEXT; /* LD H,L */
+            OP(66) ctx->h = gb_read8(ctx, ctx->hl); NEXT; /* LD H,(HL) */
+            OP(67) ctx->h = ctx->a; NEXT; /* LD H,A */
             
             /* LD L, r */
-            case 0x68: ctx->l = ctx->b; break; /* LD L,B */
-            case 0x69: ctx->l = ctx->c; break; /* LD L,C */
-            case 0x6A: ctx->l = ctx->d; break; /* LD L,D */
-            case 0x6B: ctx->l = ctx->e; break; /* LD L,E */
-            case 0x6C: ctx->l = ctx->h; break; /* LD L,H */
-            case 0x6D: ctx->l = ctx->l; break; /* LD L,L */
-            case 0x6E: ctx->l = gb_read8(ctx, ctx->hl); break; /* LD L,(HL) */
-            case 0x6F: ctx->l = ctx->a; break; /* LD L,A */
+            OP(68) ctx->l = ctx->b; NEXT; /* LD L,B */
+            OP(69) ctx->l = ctx->c; NEXT; /* LD L,C */
+            OP(6A) ctx->l = ctx->d; NEXT; /* LD L,D */
+            OP(6B) ctx->l = ctx->e; NEXT; /* LD L,E */
+            OP(6C) ctx->l = ctx->h; NEXT; /* LD L,H */
+            OP(6D) ctx->l = ctx->l; NEXT; /* LD L,L */
+            OP(6E) ctx->l = gb_read8(ctx, ctx->hl); NEXT; /* LD L,(HL) */
+            OP(6F) ctx->l = ctx->a; NEXT; /* LD L,A */
             
             /* LD (HL), r */
-            case 0x70: gb_write8(ctx, ctx->hl, ctx->b); break; /* LD (HL), B */
-            case 0x71: gb_write8(ctx, ctx->hl, ctx->c); break; /* LD (HL), C */
-            case 0x72: gb_write8(ctx, ctx->hl, ctx->d); break; /* LD (HL), D */
-            case 0x73: gb_write8(ctx, ctx->hl, ctx->e); break; /* LD (HL), E */
-            case 0x74: gb_write8(ctx, ctx->hl, ctx->h); break; /* LD (HL), H */
-            case 0x75: gb_write8(ctx, ctx->hl, ctx->l); break; /* LD (HL), L */
-            case 0x76: gb_halt(ctx); return; /* HALT */
-            case 0x77: gb_write8(ctx, ctx->hl, ctx->a); break; /* LD (HL), A */
+            OP(70) gb_write8(ctx, ctx->hl, ctx->b); NEXT; /* LD (HL), B */
+            OP(71) gb_write8(ctx, ctx->hl, ctx->c); NEXT; /* LD (HL), C */
+            OP(72) gb_write8(ctx, ctx->hl, ctx->d); NEXT; /* LD (HL), D */
+            OP(73) gb_write8(ctx, ctx->hl, ctx->e); NEXT; /* LD (HL), E */
+            OP(74) gb_write8(ctx, ctx->hl, ctx->h); NEXT; /* LD (HL), H */
+            OP(75) gb_write8(ctx, ctx->hl, ctx->l); NEXT; /* LD (HL), L */
+            OP(76) gb_halt(ctx); return; /* HALT */
+            OP(77) gb_write8(ctx, ctx->hl, ctx->a); NEXT; /* LD (HL), A */
             
             /* LD A, r */
-            case 0x78: ctx->a = ctx->b; break; /* LD A,B */
-            case 0x79: ctx->a = ctx->c; break; /* LD A,C */
-            case 0x7A: ctx->a = ctx->d; break; /* LD A,D */
-            case 0x7B: ctx->a = ctx->e; break; /* LD A,E */
-            case 0x7C: ctx->a = ctx->h; break; /* LD A,H */
-            case 0x7D: ctx->a = ctx->l; break; /* LD A,L */
-            case 0x7E: ctx->a = gb_read8(ctx, ctx->hl); break; /* LD A,(HL) */
-            case 0x7F: ctx->a = ctx->a; break; /* LD A,A */
+            OP(78) ctx->a = ctx->b; NEXT; /* LD A,B */
+            OP(79) ctx->a = ctx->c; NEXT; /* LD A,C */
+            OP(7A) ctx->a = ctx->d; NEXT; /* LD A,D */
+            OP(7B) ctx->a = ctx->e; NEXT; /* LD A,E */
+            OP(7C) ctx->a = ctx->h; NEXT; /* LD A,H */
+            OP(7D) ctx->a = ctx->l; NEXT; /* LD A,L */
+            OP(7E) ctx->a = gb_read8(ctx, ctx->hl); NEXT; /* LD A,(HL) */
+            OP(7F) ctx->a = ctx->a; NEXT; /* LD A,A */
             
-            case 0xEA: gb_write8(ctx, READ16(ctx), ctx->a); break; /* LD (nn), A */
-            case 0xFA: ctx->a = gb_read8(ctx, READ16(ctx)); break; /* LD A, (nn) */
+            OP(EA) gb_write8(ctx, IMM16, ctx->a); NEXT; /* LD (nn), A */
+            OP(FA) ctx->a = gb_read8(ctx, IMM16); NEXT; /* LD A, (nn) */
             
-            case 0xE0: gb_write8(ctx, 0xFF00 + READ8(ctx), ctx->a); break; /* LDH (n), A */
-            case 0xF0: ctx->a = gb_read8(ctx, 0xFF00 + READ8(ctx)); break; /* LDH A, (n) */
+            OP(E0) gb_write8(ctx, 0xFF00 + IMM8, ctx->a); NEXT; /* LDH (n), A */
+            OP(F0) ctx->a = gb_read8(ctx, 0xFF00 + IMM8); NEXT; /* LDH A, (n) */
             
-            case 0xE2: gb_write8(ctx, 0xFF00 + ctx->c, ctx->a); break; /* LD (C), A */
-            case 0xF2: ctx->a = gb_read8(ctx, 0xFF00 + ctx->c); break; /* LD A, (C) */
+            OP(E2) gb_write8(ctx, 0xFF00 + ctx->c, ctx->a); NEXT; /* LD (C), A */
+            OP(F2) ctx->a = gb_read8(ctx, 0xFF00 + ctx->c); NEXT; /* LD A, (C) */
             
-            case 0x0A: ctx->a = gb_read8(ctx, ctx->bc); break; /* LD A, (BC) */
-            case 0x1A: ctx->a = gb_read8(ctx, ctx->de); break; /* LD A, (DE) */
-            case 0x02: gb_write8(ctx, ctx->bc, ctx->a); break; /* LD (BC), A */
-            case 0x12: gb_write8(ctx, ctx->de, ctx->a); break; /* LD (DE), A */
-
-            case 0x22: gb_write8(ctx, ctx->hl++, ctx->a); break; /* LD (HL+), A */
-            case 0x2A: ctx->a = gb_read8(ctx, ctx->hl++); break; /* LD A, (HL+) */
-            case 0x32: gb_write8(ctx, ctx->hl--, ctx->a); break; /* LD (HL-), A */
-            case 0x3A: ctx->a = gb_read8(ctx, ctx->hl--); break; /* LD A, (HL-) */
-            case 0x08: { /* LD (nn), SP */
-                uint16_t addr = READ16(ctx);
+            OP(0A) ctx->a = gb_read8(ctx, ctx->bc); NEXT; /* LD A, (BC) */
+            OP(1A) ctx->a = gb_read8(ctx, ctx->de); NEXT; /* LD A, (DE) */
+            OP(02) gb_write8(ctx, ctx->bc, ctx->a); NEXT; /* LD (BC), A */
+            OP(12) gb_write8(ctx, ctx->de, ctx->a); NEXT; /* LD (DE), A */
+
+            OP(22) gb_write8(ctx, ctx->hl++, ctx->a); NEXT; /* LD (HL+), A */
+            OP(2A) ctx->a = gb_read8(ctx, ctx->hl++); NEXT; /* LD A, (HL+) */
+            OP(32) gb_write8(ctx, ctx->hl--, ctx->a); NEXT; /* LD (HL-), A */
+            OP(3A) ctx->a = gb_read8(ctx, ctx->hl--); NEXT; /* LD A, (HL-) */
+            OP(08) { /* LD (nn), SP */
+                uint16_t addr = IMM16;
                 gb_write16(ctx, addr, ctx->sp);
-                break;
+                NEXT;
             }
             /* 16-bit Loads */
-            case 0x01: ctx->bc = READ16(ctx); break; /* LD BC, nn */
-            case 0x11: ctx->de = READ16(ctx); break; /* LD DE, nn */
-            case 0x21: ctx->hl = READ16(ctx); break; /* LD HL, nn */
-            case 0x31: ctx->sp = READ16(ctx); break; /* LD SP, nn */
-            case 0xF9: ctx->sp = ctx->hl; break; /* LD SP, HL */
+            OP(01) ctx->bc = IMM16; NEXT; /* LD BC, nn */
+            OP(11) ctx->de = IMM16; NEXT; /* LD DE, nn */
+            OP(21) ctx->hl = IMM16; NEXT; /* LD HL, nn */
+            OP(31) ctx->sp = IMM16; NEXT; /* LD SP, nn */
+            OP(F9) ctx->sp = ctx->hl; NEXT; /* LD SP, HL */
             
             /* Stack */
-            case 0xC5: gb_push16(ctx, ctx->bc); break; /* PUSH BC */
-            case 0xD5: gb_push16(ctx, ctx->de); break; /* PUSH DE */
-            case 0xE5: gb_push16(ctx, ctx->hl); break; /* PUSH HL */
-            case 0xF5: gb_pack_flags(ctx); gb_push16(ctx, ctx->af & 0xFFF0); break; /* PUSH AF */
+            OP(C5) gb_push16(ctx, ctx->bc); NEXT; /* PUSH BC */
+            OP(D5) gb_push16(ctx, ctx->de); NEXT; /* PUSH DE */
+            OP(E5) gb_push16(ctx, ctx->hl); NEXT; /* PUSH HL */
+            OP(F5) gb_pack_flags(ctx); gb_push16(ctx, ctx->af & 0xFFF0); NEXT; /* PUSH AF */
             
-            case 0xC1: ctx->bc = gb_pop16(ctx); break; /* POP BC */
-            case 0xD1: ctx->de = gb_pop16(ctx); break; /* POP DE */
-            case 0xE1: ctx->hl = gb_pop16(ctx); break; /* POP HL */
-            case 0xF1: {
+            OP(C1) ctx->bc = gb_pop16(ctx); NEXT; /* POP BC */
+            OP(D1) ctx->de = gb_pop16(ctx); NEXT; /* POP DE */
+            OP(E1) ctx->hl = gb_pop16(ctx); NEXT; /* POP HL */
+            OP(F1) {
                 uint16_t af = gb_pop16(ctx);
                 ctx->af = af & 0xFFF0; /* Lower 4 bits of F are always 0 */
                 gb_unpack_flags(ctx);
-                break; 
+                NEXT; 
             }
             
             /* ALU 8-bit */
-            case 0x04: ctx->b = gb_inc8(ctx, ctx->b); break; /* INC B */
-            case 0x05: ctx->b = gb_dec8(ctx, ctx->b); break; /* DEC B */
-            case 0x0C: ctx->c = gb_inc8(ctx, ctx->c); break; /* INC C */
-            case 0x0D: ctx->c = gb_dec8(ctx, ctx->c); break; /* DEC C */
-            case 0x14: ctx->d = gb_inc8(ctx, ctx->d); break; /* INC D */
-            case 0x15: ctx->d = gb_dec8(ctx, ctx->d); break; /* DEC D */
-            case 0x1C: ctx->e = gb_inc8(ctx, ctx->e); break; /* INC E */
-            case 0x1D: ctx->e = gb_dec8(ctx, ctx->e); break; /* DEC E */
-            case 0x24: ctx->h = gb_inc8(ctx, ctx->h); break; /* INC H */
-            case 0x25: ctx->h = gb_dec8(ctx, ctx->h); break; /* DEC H */
-            case 0x2C: ctx->l = gb_inc8(ctx, ctx->l); break; /* INC L */
-            case 0x2D: ctx->l = gb_dec8(ctx, ctx->l); break; /* DEC L */
-            case 0x3C: ctx->a = gb_inc8(ctx, ctx->a); break; /* INC A */
-            case 0x3D: ctx->a = gb_dec8(ctx, ctx->a); break; /* DEC A */
-            case 0x34: gb_write8(ctx, ctx->hl, gb_inc8(ctx, gb_read8(ctx, ctx->hl))); break; /* INC (HL) */
-            case 0x35: gb_write8(ctx, ctx->hl, gb_dec8(ctx, gb_read8(ctx, ctx->hl))); break; /* DEC (HL) */
-
-            case 0x80: gb_add8(ctx, ctx->b); break; /* ADD A, B */
-            case 0x81: gb_add8(ctx, ctx->c); break; /* ADD A, C */
-            case 0x82: gb_add8(ctx, ctx->d); break; /* ADD A, D */
-            case 0x83: gb_add8(ctx, ctx->e); break; /* ADD A, E */
-            case 0x84: gb_add8(ctx, ctx->h); break; /* ADD A, H */
-            case 0x85: gb_add8(ctx, ctx->l); break; /* ADD A, L */
-            case 0x86: gb_add8(ctx, gb_read8(ctx, ctx->hl)); break; /* ADD A, (HL) */
-            case 0x87: gb_add8(ctx, ctx->a); break; /* ADD A, A */
-            case 0xC6: gb_add8(ctx, READ8(ctx)); break; /* ADD A, n */
-
-            case 0x88: gb_adc8(ctx, ctx->b); break; /* ADC A, B */
-            case 0x89: gb_adc8(ctx, ctx->c); break; /* ADC A, C */
-            case 0x8A: gb_adc8(ctx, ctx->d); break; /* ADC A, D */
-            case 0x8B: gb_adc8(ctx, ctx->e); break; /* ADC A, E */
-            case 0x8C: gb_adc8(ctx, ctx->h); break; /* ADC A, H */
-            case 0x8D: gb_adc8(ctx, ctx->l); break; /* ADC A, L */
-            case 0x8E: gb_adc8(ctx, gb_read8(ctx, ctx->hl)); break; /* ADC A, (HL) */
-            case 0x8F: gb_adc8(ctx, ctx->a); break; /* ADC A, A */
-            case 0xCE: gb_adc8(ctx, READ8(ctx)); break; /* ADC A, n */
-
-            case 0x90: gb_sub8(ctx, ctx->b); break; /* SUB B */
-            case 0x91: gb_sub8(ctx, ctx->c); break; /* SUB C */
-            case 0x92: gb_sub8(ctx, ctx->d); break; /* SUB D */
-            case 0x93: gb_sub8(ctx, ctx->e); break; /* SUB E */
-            case 0x94: gb_sub8(ctx, ctx->h); break; /* SUB H */
-            case 0x95: gb_sub8(ctx, ctx->l); break; /* SUB L */
-            case 0x96: gb_sub8(ctx, gb_read8(ctx, ctx->hl)); break; /* SUB (HL) */
-            case 0x97: gb_sub8(ctx, ctx->a); break; /* SUB A */
-            case 0xD6: gb_sub8(ctx, READ8(ctx)); break; /* SUB n */
-
-            case 0x98: gb_sbc8(ctx, ctx->b); break; /* SBC A, B */
-            case 0x99: gb_sbc8(ctx, ctx->c); break; /* SBC A, C */
-            case 0x9A: gb_sbc8(ctx, ctx->d); break; /* SBC A, D */
-            case 0x9B: gb_sbc8(ctx, ctx->e); break; /* SBC A, E */
-            case 0x9C: gb_sbc8(ctx, ctx->h); break; /* SBC A, H */
-            case 0x9D: gb_sbc8(ctx, ctx->l); break; /* SBC A, L */
-            case 0x9E: gb_sbc8(ctx, gb_read8(ctx, ctx->hl)); break; /* SBC A, (HL) */
-            case 0x9F: gb_sbc8(ctx, ctx->a); break; /* SBC A, A */
-            case 0xDE: gb_sbc8(ctx, READ8(ctx)); break; /* SBC A, n */
-
-            case 0xA0: gb_and8(ctx, ctx->b); break; /* AND B */
-            case 0xA1: gb_and8(ctx, ctx->c); break; /* AND C */
-            case 0xA2: gb_and8(ctx, ctx->d); break; /* AND D */
-            case 0xA3: gb_and8(ctx, ctx->e); break; /* AND E */
-            case 0xA4: gb_and8(ctx, ctx->h); break; /* AND H */
-            case 0xA5: gb_and8(ctx, ctx->l); break; /* AND L */
-            case 0xA6: gb_and8(ctx, gb_read8(ctx, ctx->hl)); break; /* AND (HL) */
-            case 0xA7: gb_and8(ctx, ctx->a); break; /* AND A */
-            case 0xE6: gb_and8(ctx, READ8(ctx)); break; /* AND n */
-
-            case 0xA8: gb_xor8(ctx, ctx->b); break; /* XOR B */
-            case 0xA9: gb_xor8(ctx, ctx->c); break; /* XOR C */
-            case 0xAA: gb_xor8(ctx, ctx->d); break; /* XOR D */
-            case 0xAB: gb_xor8(ctx, ctx->e); break; /* XOR E */
-            case 0xAC: gb_xor8(ctx, ctx->h); break; /* XOR H */
-            case 0xAD: gb_xor8(ctx, ctx->l); break; /* XOR L */
-            case 0xAE: gb_xor8(ctx, gb_read8(ctx, ctx->hl)); break; /* XOR (HL) */
-            case 0xAF: gb_xor8(ctx, ctx->a); break; /* XOR A */
-            case 0xEE: gb_xor8(ctx, READ8(ctx)); break; /* XOR n */
+            OP(04) ctx->b = gb_inc8(ctx, ctx->b); NEXT; /* INC B */
+            OP(05) ctx->b = gb_dec8(ctx, ctx->b); NEXT; /* DEC B */
+            OP(0C) ctx->c = gb_inc8(ctx, ctx->c); NEXT; /* INC C */
+            OP(0D) ctx->c = gb_dec8(ctx, ctx->c); NEXT; /* DEC C */
+            OP(14) ctx->d = gb_inc8(ctx, ctx->d); NEXT; /* INC D */
+            OP(15) ctx->d = gb_dec8(ctx, ctx->d); NEXT; /* DEC D */
+            OP(1C) ctx->e = gb_inc8(ctx, ctx->e); NEXT; /* INC E */
+            OP(1D) ctx->e = gb_dec8(ctx, ctx->e); NEXT; /* DEC E */
+            OP(24) ctx->h = gb_inc8(ctx, ctx->h); NEXT; /* INC H */
+            OP(25) ctx->h = gb_dec8(ctx, ctx->h); NEXT; /* DEC H */
+            OP(2C) ctx->l = gb_inc8(ctx, ctx->l); NEXT; /* INC L */
+            OP(2D) ctx->l = gb_dec8(ctx, ctx->l); NEXT; /* DEC L */
+            OP(3C) ctx->a = gb_inc8(ctx, ctx->a); NEXT; /* INC A */
+            OP(3D) ctx->a = gb_dec8(ctx, ctx->a); NEXT; /* DEC A */
+            OP(34) gb_write8(ctx, ctx->hl, gb_inc8(ctx, gb_read8(ctx, ctx->hl))); NEXT; /* INC (HL) */
+            OP(35) gb_write8(ctx, ctx->hl, gb_dec8(ctx, gb_read8(ctx, ctx->hl))); NEXT; /* DEC (HL) */
+            OP(36) gb_write8(ctx, ctx->hl, IMM8); NEXT; /* LD (HL), n */
+
+            OP(80) gb_add8(ctx, ctx->b); NEXT; /* ADD A, B */
+            OP(81) gb_add8(ctx, ctx->c); NEXT; /* ADD A, C */
+            OP(82) gb_add8(ctx, ctx->d); NEXT; /* ADD A, D */
+            OP(83) gb_add8(ctx, ctx->e); NEXT; /* ADD A, E */
+            OP(84) gb_add8(ctx, ctx->h); NEXT; /* ADD A, H */
+            OP(85) gb_add8(ctx, ctx->l); NEXT; /* ADD A, L */
+            OP(86) gb_add8(ctx, gb_read8(ctx, ctx->hl)); NEXT; /* ADD A, (HL) */
+            OP(87) gb_add8(ctx, ctx->a); NEXT; /* ADD A, A */
+            OP(C6) gb_add8(ctx, IMM8); NEXT; /* ADD A, n */
+
+            OP(88) gb_adc8(ctx, ctx->b); NEXT; /* ADC A, B */
+            OP(89) gb_adc8(ctx, ctx->c); NEXT; /* ADC A, C */
+            OP(8A) gb_adc8(ctx, ctx->d); NEXT; /* ADC A, D */
+            OP(8B) gb_adc8(ctx, ctx->e); NEXT; /* ADC A, E */
+            OP(8C) gb_adc8(ctx, ctx->h); NEXT; /* ADC A, H */
+            OP(8D) gb_adc8(ctx, ctx->l); NEXT; /* ADC A, L */
+            OP(8E) gb_adc8(ctx, gb_read8(ctx, ctx->hl)); NEXT; /* ADC A, (HL) */
+            OP(8F) gb_adc8(ctx, ctx->a); NEXT; /* ADC A, A */
+            OP(CE) gb_adc8(ctx, IMM8); NEXT; /* ADC A, n */
+
+            OP(90) gb_sub8(ctx, ctx->b); NEXT; /* SUB B */
+            OP(91) gb_sub8(ctx, ctx->c); NEXT; /* SUB C */
+            OP(92) gb_sub8(ctx, ctx->d); NEXT; /* SUB D */
+            OP(93) gb_sub8(ctx, ctx->e); NEXT; /* SUB E */
+            OP(94) gb_sub8(ctx, ctx->h); NEXT; /* SUB H */
+            OP(95) gb_sub8(ctx, ctx->l); NEXT; /* SUB L */
+            OP(96) gb_sub8(ctx, gb_read8(ctx, ctx->hl)); NEXT; /* SUB (HL) */
+            OP(97) gb_sub8(ctx, ctx->a); NEXT; /* SUB A */
+            OP(D6) gb_sub8(ctx, IMM8); NEXT; /* SUB n */
+
+            OP(98) gb_sbc8(ctx, ctx->b); NEXT; /* SBC A, B */
+            OP(99) gb_sbc8(ctx, ctx->c); NEXT; /* SBC A, C */
+            OP(9A) gb_sbc8(ctx, ctx->d); NEXT; /* SBC A, D */
+            OP(9B) gb_sbc8(ctx, ctx->e); NEXT; /* SBC A, E */
+            OP(9C) gb_sbc8(ctx, ctx->h); NEXT; /* SBC A, H */
+            OP(9D) gb_sbc8(ctx, ctx->l); NEXT; /* SBC A, L */
+            OP(9E) gb_sbc8(ctx, gb_read8(ctx, ctx->hl)); NEXT; /* SBC A, (HL) */
+            OP(9F) gb_sbc8(ctx, ctx->a); NEXT; /* SBC A, A */
+            OP(DE) gb_sbc8(ctx, IMM8); NEXT; /* SBC A, n */
+
+            OP(A0) gb_and8(ctx, ctx->b); NEXT; /* AND B */
+            OP(A1) gb_and8(ctx, ctx->c); NEXT; /* AND C */
+            OP(A2) gb_and8(ctx, ctx->d); NEXT; /* AND D */
+            OP(A3) gb_and8(ctx, ctx->e); NEXT; /* AND E */
+            OP(A4) gb_and8(ctx, ctx->h); NEXT; /* AND H */
+            OP(A5) gb_and8(ctx, ctx->l); NEXT; /* AND L */
+            OP(A6) gb_and8(ctx, gb_read8(ctx, ctx->hl)); NEXT; /* AND (HL) */
+            OP(A7) gb_and8(ctx, ctx->a); NEXT; /* AND A */
+            OP(E6) gb_and8(ctx, IMM8); NEXT; /* AND n */
+
+            OP(A8) gb_xor8(ctx, ctx->b); NEXT; /* XOR B */
+            OP(A9) gb_xor8(ctx, ctx->c); NEXT; /* XOR C */
+            OP(AA) gb_xor8(ctx, ctx->d); NEXT; /* XOR D */
+            OP(AB) gb_xor8(ctx, ctx->e); NEXT; /* XOR E */
+            OP(AC) gb_xor8(ctx, ctx->h); NEXT; /* XOR H */
+            OP(AD) gb_xor8(ctx, ctx->l); NEXT; /* XOR L */
+            OP(AE) gb_xor8(ctx, gb_read8(ctx, ctx->hl)); NEXT; /* XOR (HL) */
+            OP(AF) gb_xor8(ctx, ctx->a); NEXT; /* XOR A */
+            OP(EE) gb_xor8(ctx, IMM8); NEXT; /* XOR n */
             
-            case 0xB0: gb_or8(ctx, ctx->b); break; /* OR B */
-            case 0xB1: gb_or8(ctx, ctx->c); break; /* OR C */
-            case 0xB2: gb_or8(ctx, ctx->d); break; /* OR D */
-            case 0xB3: gb_or8(ctx, ctx->e); break; /* OR E */
-            case 0xB4: gb_or8(ctx, ctx->h); break; /* OR H */
-            case 0xB5: gb_or8(ctx, ctx->l); break; /* OR L */
-            case 0xB6: gb_or8(ctx, gb_read8(ctx, ctx->hl)); break; /* OR (HL) */
-            case 0xB7: gb_or8(ctx, ctx->a); break; /* OR A */
-            case 0xF6: gb_or8(ctx, READ8(ctx)); break; /* OR n */
-
-            case 0xB8: gb_cp8(ctx, ctx->b); break; /* CP B */
-            case 0xB9: gb_cp8(ctx, ctx->c); break; /* CP C */
-            case 0xBA: gb_cp8(ctx, ctx->d); break; /* CP D */
-            case 0xBB: gb_cp8(ctx, ctx->e); break; /* CP E */
-            case 0xBC: gb_cp8(ctx, ctx->h); break; /* CP H */
-            case 0xBD: gb_cp8(ctx, ctx->l); break; /* CP L */
-            case 0xBE: gb_cp8(ctx, gb_read8(ctx, ctx->hl)); break; /* CP (HL) */
-            case 0xBF: gb_cp8(ctx, ctx->a); break; /* CP A */
-            case 0xFE: gb_cp8(ctx, READ8(ctx)); break; /* CP n */
+            OP(B0) gb_or8(ctx, ctx->b); NEXT; /* OR B */
+            OP(B1) gb_or8(ctx, ctx->c); NEXT; /* OR C */
+            OP(B2) gb_or8(ctx, ctx->d); NEXT; /* OR D */
+            OP(B3) gb_or8(ctx, ctx->e); NEXT; /* OR E */
+            OP(B4) gb_or8(ctx, ctx->h); NEXT; /* OR H */
+            OP(B5) gb_or8(ctx, ctx->l); NEXT; /* OR L */
+            OP(B6) gb_or8(ctx, gb_read8(ctx, ctx->hl)); NEXT; /* OR (HL) */
+            OP(B7) gb_or8(ctx, ctx->a); NEXT; /* OR A */
+            OP(F6) gb_or8(ctx, IMM8); NEXT; /* OR n */
+
+            OP(B8) gb_cp8(ctx, ctx->b); NEXT; /* CP B */
+            OP(B9) gb_cp8(ctx, ctx->c); NEXT; /* CP C */
+            OP(BA) gb_cp8(ctx, ctx->d); NEXT; /* CP D */
+            OP(BB) gb_cp8(ctx, ctx->e); NEXT; /* CP E */
+            OP(BC) gb_cp8(ctx, ctx->h); NEXT; /* CP H */
+            OP(BD) gb_cp8(ctx, ctx->l); NEXT; /* CP L */
+            OP(BE) gb_cp8(ctx, gb_read8(ctx, ctx->hl)); NEXT; /* CP (HL) */
+            OP(BF) gb_cp8(ctx, ctx->a); NEXT; /* CP A */
+            OP(FE) gb_cp8(ctx, IMM8); NEXT; /* CP n */
 
 
             
             /* ALU 16-bit */
-            case 0x03: ctx->bc++; break; /* INC BC */
-            case 0x13: ctx->de++; break; /* INC DE */
-            case 0x23: ctx->hl++; break; /* INC HL */
-            case 0x33: ctx->sp++; break; /* INC SP */
+            OP(03) ctx->bc++; NEXT; /* INC BC */
+            OP(13) ctx->de++; NEXT; /* INC DE */
+            OP(23) ctx->hl++; NEXT; /* INC HL */
+            OP(33) ctx->sp++; NEXT; /* INC SP */
             
-            case 0x0B: ctx->bc--; break; /* DEC BC */
-            case 0x1B: ctx->de--; break; /* DEC DE */
-            case 0x2B: ctx->hl--; break; /* DEC HL */
-            case 0x3B: ctx->sp--; break; /* DEC SP */
-
-            case 0x09: gb_add16(ctx, ctx->bc); break; /* ADD HL, BC */
-            case 0x19: gb_add16(ctx, ctx->de); break; /* ADD HL, DE */
-            case 0x29: gb_add16(ctx, ctx->hl); break; /* ADD HL, HL */
-            case 0x39: gb_add16(ctx, ctx->sp); break; /* ADD HL, SP */
+            OP(0B) ctx->bc--; NEXT; /* DEC BC */
+            OP(1B) ctx->de--; NEXT; /* DEC DE */
+            OP(2B) ctx->hl--; NEXT; /* DEC HL */
+            OP(3B) ctx->sp--; NEXT; /* DEC SP */
+
+            OP(09) gb_add16(ctx, ctx->bc); NEXT; /* ADD HL, BC */
+            OP(19) gb_add16(ctx, ctx->de); NEXT; /* ADD HL, DE */
+            OP(29) gb_add16(ctx, ctx->hl); NEXT; /* ADD HL, HL */
+            OP(39) gb_add16(ctx, ctx->sp); NEXT; /* ADD HL, SP */
             
-            case 0xE8: gb_add_sp(ctx, (int8_t)READ8(ctx)); break; /* ADD SP, n */
-            case 0xF8: { /* LD HL, SP+n */
-                int8_t offset = (int8_t)READ8(ctx);
+            OP(E8) gb_add_sp(ctx, (int8_t)IMM8); NEXT; /* ADD SP, n */
+            OP(F8) { /* LD HL, SP+n */
+                int8_t offset = (int8_t)IMM8;
                 uint32_t result = ctx->sp + offset;
                 ctx->f_z = 0;
                 ctx->f_n = 0;
                 ctx->f_h = ((ctx->sp & 0x0F) + (offset & 0x0F)) > 0x0F;
                 ctx->f_c = ((ctx->sp & 0xFF) + (offset & 0xFF)) > 0xFF;
                 ctx->hl = (uint16_t)result;
-                break;
+                NEXT;
             }
 
             /* Control Flow */
             /* Control Flow */
-            case 0xC3: ctx->pc = READ16(ctx); return; /* JP nn */
-            case 0xE9: ctx->pc = ctx->hl; return; /* JP HL */
+            OP(C3) ctx->pc = IMM16; TAKEN(16); /* JP nn */
+            OP(E9) ctx->pc = ctx->hl; GBRT_HOTSPOT_JUMP(ctx, ctx->pc); TAKEN(4); /* JP HL */
             
-            case 0xC2: { /* JP NZ, nn */
-                uint16_t dest = READ16(ctx);
-                if (!ctx->f_z) { ctx->pc = dest; return; }
-                break;
+            OP(C2) { /* JP NZ, nn */
+                uint16_t dest = IMM16;
+                if (!ctx->f_z) { ctx->pc = dest; TAKEN(16); }
+                NEXT;
             }
-            case 0xCA: { /* JP Z, nn */
-                uint16_t dest = READ16(ctx);
-                if (ctx->f_z) { ctx->pc = dest; return; }
-                break;
+            OP(CA) { /* JP Z, nn */
+                uint16_t dest = IMM16;
+                if (ctx->f_z) { ctx->pc = dest; TAKEN(16); }
+                NEXT;
             }
-            case 0xD2: { /* JP NC, nn */
-                uint16_t dest = READ16(ctx);
-                if (!ctx->f_c) { ctx->pc = dest; return; }
-                break;
+            OP(D2) { /* JP NC, nn */
+                uint16_t dest = IMM16;
+                if (!ctx->f_c) { ctx->pc = dest; TAKEN(16); }
+                NEXT;
             }
-            case 0xDA: { /* JP C, nn */
-                uint16_t dest = READ16(ctx);
-                if (ctx->f_c) { ctx->pc = dest; return; }
-                break;
+            OP(DA) { /* JP C, nn */
+                uint16_t dest = IMM16;
+                if (ctx->f_c) { ctx->pc = dest; TAKEN(16); }
+                NEXT;
             }
             
-            case 0x18: { /* JR n */
-                int8_t off = (int8_t)READ8(ctx);
+            OP(18) { /* JR n */
+                int8_t off = (int8_t)IMM8;
                 ctx->pc += off;
-                return;
+                TAKEN(12);
             }
-            case 0x20: { /* JR NZ, n */
-                int8_t off = (int8_t)READ8(ctx);
-                if (!ctx->f_z) { ctx->pc += off; return; }
-                break;
+            OP(20) { /* JR NZ, n */
+                int8_t off = (int8_t)IMM8;
+                if (!ctx->f_z) { ctx->pc += off; TAKEN(12); }
+                NEXT;
             }
-            case 0x28: { /* JR Z, n */
-                int8_t off = (int8_t)READ8(ctx);
-                if (ctx->f_z) { ctx->pc += off; return; }
-                break;
+            OP(28) { /* JR Z, n */
+                int8_t off = (int8_t)IMM8;
+                if (ctx->f_z) { ctx->pc += off; TAKEN(12); }
+                NEXT;
             }
-            case 0x30: { /* JR NC, n */
-                int8_t off = (int8_t)READ8(ctx);
-                if (!ctx->f_c) { ctx->pc += off; return; }
-                break;
+            OP(30) { /* JR NC, n */
+                int8_t off = (int8_t)IMM8;
+                if (!ctx->f_c) { ctx->pc += off; TAKEN(12); }
+                NEXT;
             }
-            case 0x38: { /* JR C, n */
-                int8_t off = (int8_t)READ8(ctx);
-                if (ctx->f_c) { ctx->pc += off; return; }
-                break;
+            OP(38) { /* JR C, n */
+                int8_t off = (int8_t)IMM8;
+                if (ctx->f_c) { ctx->pc += off; TAKEN(12); }
+                NEXT;
             }
             
-            case 0xCD: { /* CALL nn */
-                uint16_t dest = READ16(ctx);
+            OP(CD) { /* CALL nn */
+                uint16_t dest = IMM16;
                 gb_push16(ctx, ctx->pc);
                 ctx->pc = dest;
-                return;
+                TAKEN(24);
             }
-            case 0xC4: { /* CALL NZ, nn */
-                uint16_t dest = READ16(ctx);
+            OP(C4) { /* CALL NZ, nn */
+                uint16_t dest = IMM16;
                 if (!ctx->f_z) {
                     gb_push16(ctx, ctx->pc);
                     ctx->pc = dest;
-                    return;
+                    TAKEN(24);
                 }
-                break;
+                NEXT;
             }
-            case 0xCC: { /* CALL Z, nn */
-                uint16_t dest = READ16(ctx);
+            OP(CC) { /* CALL Z, nn */
+                uint16_t dest = IMM16;
                 if (ctx->f_z) {
                     gb_push16(ctx, ctx->pc);
                     ctx->pc = dest;
-                    return;
+                    TAKEN(24);
                 }
-                break;
+                NEXT;
             }
-            case 0xD4: { /* CALL NC, nn */
-                uint16_t dest = READ16(ctx);
+            OP(D4) { /* CALL NC, nn */
+                uint16_t dest = IMM16;
                 if (!ctx->f_c) {
                     gb_push16(ctx, ctx->pc);
                     ctx->pc = dest;
-                    return;
+                    TAKEN(24);
                 }
-                break;
+                NEXT;
             }
-            case 0xDC: { /* CALL C, nn */
-                uint16_t dest = READ16(ctx);
+            OP(DC) { /* CALL C, nn */
+                uint16_t dest = IMM16;
                 if (ctx->f_c) {
                     gb_push16(ctx, ctx->pc);
                     ctx->pc = dest;
-                    return;
+                    TAKEN(24);
                 }
-                break;
+                NEXT;
             }
             
-            case 0xC9: /* RET */
+            OP(C9) /* RET */
                 ctx->pc = gb_pop16(ctx);
-                return;
-            case 0xC0: /* RET NZ */
-                if (!ctx->f_z) { ctx->pc = gb_pop16(ctx); return; }
-                break;
-            case 0xC8: /* RET Z */
-                if (ctx->f_z) { ctx->pc = gb_pop16(ctx); return; }
-                break;
-            case 0xD0: /* RET NC */
-                if (!ctx->f_c) { ctx->pc = gb_pop16(ctx); return; }
-                break;
-            case 0xD8: /* RET C */
-                if (ctx->f_c) { ctx->pc = gb_pop16(ctx); return; }
-                break;
-            case 0xD9: /* RETI */
+                TAKEN(16);
+            OP(C0) /* RET NZ */
+                if (!ctx->f_z) { ctx->pc = gb_pop16(ctx); TAKEN(20); }
+                NEXT;
+            OP(C8) /* RET Z */
+                if (ctx->f_z) { ctx->pc = gb_pop16(ctx); TAKEN(20); }
+                NEXT;
+            OP(D0) /* RET NC */
+                if (!ctx->f_c) { ctx->pc = gb_pop16(ctx); TAKEN(20); }
+                NEXT;
+            OP(D8) /* RET C */
+                if (ctx->f_c) { ctx->pc = gb_pop16(ctx); TAKEN(20); }
+                NEXT;
+            OP(D9) /* RETI */
                 ctx->pc = gb_pop16(ctx);
                 ctx->ime_pending = 1; /* EI behavior? Or immediate? manual says immediate usually */
                 /* RETI enables IME immediately */
                 ctx->ime = 1;
-                return;
+                gb_schedule_now(ctx);
+                TAKEN(16);
                 
-            case 0xC7: gb_rst(ctx, 0x00); return;
-            case 0xCF: gb_rst(ctx, 0x08); return;
-            case 0xD7: gb_rst(ctx, 0x10); return;
-            case 0xDF: gb_rst(ctx, 0x18); return;
-            case 0xE7: gb_rst(ctx, 0x20); return;
-            case 0xEF: gb_rst(ctx, 0x28); return;
-            case 0xF7: gb_rst(ctx, 0x30); return;
-            case 0xFF: gb_rst(ctx, 0x38); return;
+            OP(C7) gb_rst(ctx, 0x00); TAKEN(16);
+            OP(CF) gb_rst(ctx, 0x08); TAKEN(16);
+            OP(D7) gb_rst(ctx, 0x10); TAKEN(16);
+            OP(DF) gb_rst(ctx, 0x18); TAKEN(16);
+            OP(E7) gb_rst(ctx, 0x20); TAKEN(16);
+            OP(EF) gb_rst(ctx, 0x28); TAKEN(16);
+            OP(F7) gb_rst(ctx, 0x30); TAKEN(16);
+            OP(FF) gb_rst(ctx, 0x38); TAKEN(16);
                 
-            case 0xF3: ctx->ime = 0; break; /* DI */
-            case 0xFB: ctx->ime_pending = 1; break; /* EI */
+            OP(F3) ctx->ime = 0; NEXT; /* DI */
+            OP(FB) ctx->ime_pending = 1; gb_schedule_now(ctx); NEXT; /* EI */
             
             /* Unused / Illegal opcodes (No-ops on some hardware, can reach here in tests) */
-            case 0xD3: case 0xDB: case 0xDD: case 0xE3: case 0xE4:
-            case 0xEB: case 0xEC: case 0xED: case 0xF4: case 0xFC:
-            case 0xFD:
+            OP(D3) OP(DB) OP(DD) OP(E3) OP(E4)
+            OP(EB) OP(EC) OP(ED) OP(F4) OP(FC)
+            OP(FD)
                 DBG_GENERAL("Interpreter (0x%04X): Executed unused opcode 0x%02X", ctx->pc - 1, opcode);
-                break;
+                NEXT;
 
             
             /* CB Prefix */
-            case 0xCB: {
-                uint8_t cb_op = READ8(ctx);
+            OP(CB) {
+                uint8_t cb_op = IMM8;
                 uint8_t r = cb_op & 7;
                 uint8_t b = (cb_op >> 3) & 7;
                 uint8_t val = get_reg8(ctx, r);
-                
+                cycles = r != 6 ? 8 : (cb_op & 0xC0) == 0x40 ? 12 : 16;
+
                 if (cb_op < 0x40) {
                     /* Shifts and Rotates */
                     switch (b) {
@@ -558,19 +819,28 @@ void gb_interpret(GBContext* ctx, uint16_t addr) {
                     val |= (1 << b);
                     set_reg8(ctx, r, val);
                 }
-                break;
+                NEXT;
             }
-            
-            default:
-                DBG_GENERAL("Interpreter (0x%04X): Unimplemented opcode 0x%02X", ctx->pc - 1, opcode);
-                /* If we return, we might re-execute garbage or loop. Better to stop/break hard? */
-                /* For now, return to dispatch (which might call us again if PC didn't advance?)
-                   Actually we advanced PC at READ8. */
-                return;
+#if !INTERP_THREADED
         }
-        
-        /* Batch timing updates for performance - tick every 16 instructions instead of every one */
+#endif
+
+    next:
         /* Cycle counting */
-        gb_tick(ctx, 4);
+        gb_tick(ctx, cycles);
     }
 }
+
+void gb_interpret(GBContext* ctx, uint16_t addr) {
+    GBRT_PROFILE_PUSH(ctx, GB_PROFILE_INTERP);
+#if GBRT_HOTSPOTS
+    /* Charge the block to where it was entered; it may switch banks */
+    uint8_t bank = gb_hotspot_bank(ctx, addr);
+    uint64_t steps = ctx->hotspot_steps;
+    interpret_block(ctx, addr);
+    if (ctx->hotspots) gb_hotspots_fallback(ctx->hotspots, bank, addr, ctx->hotspot_steps - steps);
+#else
+    interpret_block(ctx, addr);
+#endif
+    GBRT_PROFILE_POP(ctx);
+}
@@ -0,0 +1,575 @@
+/**
+ * @file jit.c
+ * @brief x86-64 translation of hot interpreted code
+ *
+ * Blocks address the context through rbx. Register moves, immediate loads
+ * and 16-bit increments are emitted inline; anything touching flags or
+ * memory calls the same gbrt.c helpers the interpreter uses. Every
+ * instruction is followed by a tick of its gb_op_cycles, and taken
+ * branches tick their own cycles before leaving, exactly like the
+ * interpreter. A block runs
+ * to the first instruction without a translation, an unconditional
+ * transfer or the end of its page, and leaves early when the context stops
+ * or when a store switched banks or dropped the block's page.
+ */
+
+#include "jit.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define GBRT_JIT_HOST 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define GBRT_JIT_HOST 0
+#endif
+
+#define JIT_CODE_SIZE (1u << 20)
+#define JIT_MAX_OPS   48
+#define JIT_MAX_BLOCK 16384     /* Bytes JIT_MAX_OPS instructions can take */
+
+struct GBJit {
+    uint8_t* code;
+    size_t used;
+    uint32_t threshold;
+    uint64_t blocks;
+    FILE* perf_map;         /* NULL = not naming blocks */
+};
+
+GBJit* gb_jit_create(uint32_t threshold) {
+#if GBRT_JIT_HOST
+    GBJit* jit = (GBJit*)calloc(1, sizeof(GBJit));
+    if (!jit) return NULL;
+    void* code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        free(jit);
+        return NULL;
+    }
+    jit->code = (uint8_t*)code;
+    if (threshold == 0) threshold = GB_JIT_DEFAULT_THRESHOLD;
+    jit->threshold = threshold > 0xFFFF ? 0xFFFF : threshold;
+    return jit;
+#else
+    (void)threshold;
+    return NULL;
+#endif
+}
+
+void gb_jit_destroy(GBJit* jit) {
+    if (!jit) return;
+    if (jit->perf_map) fclose(jit->perf_map);
+#if GBRT_JIT_HOST
+    munmap(jit->code, JIT_CODE_SIZE);
+#endif
+    free(jit);
+}
+
+void gb_jit_attach(GBContext* ctx, GBJit* jit) {
+    ctx->jit = jit;
+    gb_decode_cache_flush(ctx);
+}
+
+uint32_t gb_jit_threshold(const GBJit* jit) {
+    return jit->threshold;
+}
+
+bool gb_jit_has_room(const GBJit* jit) {
+    return jit->used + JIT_MAX_BLOCK <= JIT_CODE_SIZE;
+}
+
+void gb_jit_reset(GBJit* jit) {
+    jit->used = 0;
+}
+
+uint64_t gb_jit_blocks(const GBJit* jit) {
+    return jit->blocks;
+}
+
+bool gb_jit_perf_map(GBJit* jit) {
+#if GBRT_JIT_HOST
+    if (jit->perf_map) return true;
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/perf-%ld.map", (long)getpid());
+    jit->perf_map = fopen(path, "a");
+    return jit->perf_map != NULL;
+#else
+    (void)jit;
+    return false;
+#endif
+}
+
+#if GBRT_JIT_HOST
+
+/* ============================================================================
+ * Emitter
+ * ========================================================================== */
+
+typedef void (*JitHelper)(void);
+
+typedef struct {
+    uint8_t* p;
+    uint8_t* exits[JIT_MAX_OPS * 4];  /* rel32 fields jumping to the common exit */
+    unsigned exit_count;
+} Emit;
+
+/* x86 register numbers */
+enum { RAX = 0, RDX = 2, RSI = 6 };
+
+#define CTX(field) ((uint32_t)offsetof(GBContext, field))
+
+static inline void emit8(Emit* e, uint8_t b) { *e->p++ = b; }
+static inline void emit16(Emit* e, uint16_t v) { memcpy(e->p, &v, 2); e->p += 2; }
+static inline void emit32(Emit* e, uint32_t v) { memcpy(e->p, &v, 4); e->p += 4; }
+static inline void emit64(Emit* e, uint64_t v) { memcpy(e->p, &v, 8); e->p += 8; }
+
+/* ModRM for [rbx + disp32] */
+static inline void emit_mem(Emit* e, uint8_t reg, uint32_t disp) {
+    emit8(e, (uint8_t)(0x83 | reg << 3));
+    emit32(e, disp);
+}
+
+/* movzx reg32, byte/word [rbx + disp] */
+static void emit_load8(Emit* e, uint8_t reg, uint32_t disp) { emit8(e, 0x0F); emit8(e, 0xB6); emit_mem(e, reg, disp); }
+static void emit_load16(Emit* e, uint8_t reg, uint32_t disp) { emit8(e, 0x0F); emit8(e, 0xB7); emit_mem(e, reg, disp); }
+
+/* mov [rbx + disp], al / ax */
+static void emit_store_al(Emit* e, uint32_t disp) { emit8(e, 0x88); emit_mem(e, RAX, disp); }
+static void emit_store_ax(Emit* e, uint32_t disp) { emit8(e, 0x66); emit8(e, 0x89); emit_mem(e, RAX, disp); }
+
+/* mov byte/word [rbx + disp], imm */
+static void emit_set8(Emit* e, uint32_t disp, uint8_t v) { emit8(e, 0xC6); emit_mem(e, 0, disp); emit8(e, v); }
+static void emit_set16(Emit* e, uint32_t disp, uint16_t v) { emit8(e, 0x66); emit8(e, 0xC7); emit_mem(e, 0, disp); emit16(e, v); }
+
+/* cmp byte [rbx + disp], 0 */
+static void emit_test8(Emit* e, uint32_t disp) { emit8(e, 0x80); emit_mem(e, 7, disp); emit8(e, 0); }
+
+/* test byte [rbx + disp], mask */
+static void emit_mask8(Emit* e, uint32_t disp, uint8_t mask) { emit8(e, 0xF6); emit_mem(e, 0, disp); emit8(e, mask); }
+
+/* mov reg32, imm32 */
+static void emit_imm(Emit* e, uint8_t reg, uint32_t v) { emit8(e, (uint8_t)(0xB8 + reg)); emit32(e, v); }
+
+/* helper(ctx, esi, edx) */
+static void emit_call(Emit* e, JitHelper helper) {
+    emit8(e, 0x48); emit8(e, 0x89); emit8(e, 0xDF);     /* mov rdi, rbx */
+    emit8(e, 0x48); emit8(e, 0xB8);                     /* mov rax, helper */
+    emit64(e, (uint64_t)(uintptr_t)helper);
+    emit8(e, 0xFF); emit8(e, 0xD0);                     /* call rax */
+}
+
+/* jcc rel32 (0x84 = je, 0x85 = jne), returning the field to patch */
+static uint8_t* emit_jcc(Emit* e, uint8_t cc) {
+    emit8(e, 0x0F); emit8(e, cc);
+    uint8_t* field = e->p;
+    emit32(e, 0);
+    return field;
+}
+
+static void patch_here(Emit* e, uint8_t* field) {
+    uint32_t rel = (uint32_t)(e->p - (field + 4));
+    memcpy(field, &rel, 4);
+}
+
+static void emit_exit_if(Emit* e, uint8_t cc) {
+    e->exits[e->exit_count++] = emit_jcc(e, cc);
+}
+
+/* gb_tick(ctx, cycles) */
+static void emit_tick(Emit* e, uint8_t cycles) {
+    emit8(e, 0x83); emit_mem(e, 0, CTX(cycles)); emit8(e, cycles); /* add dword [cycles], cycles */
+    emit8(e, 0x8B); emit_mem(e, RAX, CTX(cycles));               /* mov eax, [cycles] */
+    emit8(e, 0x2B); emit_mem(e, RAX, CTX(next_event));           /* sub eax, [next_event] */
+    emit8(e, 0x78); emit8(e, 15);                                /* js past the call */
+    emit_call(e, (JitHelper)gb_run_events);
+}
+
+/* Leave through a taken transfer after its cycles: return 1 */
+static void emit_leave_taken(Emit* e, uint8_t cycles) {
+    emit_tick(e, cycles);
+    emit_imm(e, RAX, 1);
+    emit8(e, 0x5B);                                     /* pop rbx */
+    emit8(e, 0xC3);                                     /* ret */
+}
+
+/* Leave if a store remapped the block's page or dropped its decode */
+static void emit_page_check(Emit* e, const uint8_t* page, uint8_t index) {
+    emit8(e, 0x48); emit8(e, 0xB8);                     /* mov rax, page */
+    emit64(e, (uint64_t)(uintptr_t)page);
+    emit8(e, 0x48); emit8(e, 0x39);                     /* cmp [read_map + index], rax */
+    emit_mem(e, RAX, CTX(read_map) + index * (uint32_t)sizeof(uint8_t*));
+    emit_exit_if(e, 0x85);
+    if (index >= 0x80) {
+        emit_mask8(e, CTX(code_pages) + index, GB_CODE_DECODED);
+        emit_exit_if(e, 0x84);
+    }
+}
+
+#if GBRT_INSTRUMENT >= 1 || GBRT_HOTSPOTS
+static void jit_step(GBContext* ctx, uint16_t addr) {
+    GBRT_TRACE(ctx, addr);
+    GBRT_HOTSPOT_STEP(ctx);
+}
+#endif
+
+/* ============================================================================
+ * Instructions
+ * ========================================================================== */
+
+/* Operand index (B, C, D, E, H, L, (HL), A) to context offset */
+static uint32_t reg8(uint8_t idx) {
+    switch (idx) {
+        case 0: return CTX(b);
+        case 1: return CTX(c);
+        case 2: return CTX(d);
+        case 3: return CTX(e);
+        case 4: return CTX(h);
+        case 5: return CTX(l);
+        default: return CTX(a);
+    }
+}
+
+/* Pair index (BC, DE, HL, SP) to context offset */
+static uint32_t reg16(uint8_t idx) {
+    switch (idx) {
+        case 0: return CTX(bc);
+        case 1: return CTX(de);
+        case 2: return CTX(hl);
+        default: return CTX(sp);
+    }
+}
+
+static const JitHelper alu_helpers[8] = {
+    (JitHelper)gb_add8, (JitHelper)gb_adc8, (JitHelper)gb_sub8, (JitHelper)gb_sbc8,
+    (JitHelper)gb_and8, (JitHelper)gb_xor8, (JitHelper)gb_or8, (JitHelper)gb_cp8,
+};
+
+/* esi = operand idx, reading (HL) through gb_read8 */
+static void emit_operand(Emit* e, uint8_t idx) {
+    if (idx == 6) {
+        emit_load16(e, RSI, CTX(hl));
+        emit_call(e, (JitHelper)gb_read8);
+        emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xF0); /* movzx esi, al */
+    } else {
+        emit_load8(e, RSI, reg8(idx));
+    }
+}
+
+/* gb_write8(ctx, esi, edx) */
+static void emit_write(Emit* e) {
+    emit_call(e, (JitHelper)gb_write8);
+}
+
+/* Skip the taken path when condition cc (NZ, Z, NC, C) fails */
+static uint8_t* emit_unless(Emit* e, uint8_t cc) {
+    emit_test8(e, (cc & 2) ? CTX(f_c) : CTX(f_z));
+    return emit_jcc(e, (cc & 1) ? 0x84 : 0x85);
+}
+
+typedef enum {
+    OP_NONE,        /* No translation */
+    OP_NEXT,        /* Falls through */
+    OP_STORE,       /* Falls through after a store */
+    OP_END,         /* Always leaves */
+} OpKind;
+
+/* Body of one instruction; ctx->pc is already next */
+static OpKind emit_op(Emit* e, uint8_t op, uint16_t imm, uint16_t next) {
+    uint8_t dst = (op >> 3) & 7;
+    uint8_t src = op & 7;
+    uint8_t pair = (op >> 4) & 3;
+    uint8_t* skip;
+
+    if (op >= 0x40 && op < 0x80 && op != 0x76) {       /* LD r, r' */
+        if (dst == 6) {
+            emit_load8(e, RDX, reg8(src));
+            emit_load16(e, RSI, CTX(hl));
+            emit_write(e);
+            return OP_STORE;
+        }
+        if (src == 6) {
+            emit_operand(e, src);
+            emit_store_al(e, reg8(dst));
+        } else {
+            emit_load8(e, RAX, reg8(src));
+            emit_store_al(e, reg8(dst));
+        }
+        return OP_NEXT;
+    }
+    if (op >= 0x80 && op < 0xC0) {                      /* ALU A, r */
+        emit_operand(e, src);
+        emit_call(e, alu_helpers[dst]);
+        return OP_NEXT;
+    }
+
+    switch (op) {
+        case 0x00:                                      /* NOP */
+            return OP_NEXT;
+
+        case 0x01: case 0x11: case 0x21: case 0x31:     /* LD rr, nn */
+            emit_set16(e, reg16(pair), imm);
+            return OP_NEXT;
+        case 0x03: case 0x13: case 0x23: case 0x33:     /* INC rr */
+            emit8(e, 0x66); emit8(e, 0xFF); emit_mem(e, 0, reg16(pair));
+            return OP_NEXT;
+        case 0x0B: case 0x1B: case 0x2B: case 0x3B:     /* DEC rr */
+            emit8(e, 0x66); emit8(e, 0xFF); emit_mem(e, 1, reg16(pair));
+            return OP_NEXT;
+        case 0x09: case 0x19: case 0x29: case 0x39:     /* ADD HL, rr */
+            emit_load16(e, RSI, reg16(pair));
+            emit_call(e, (JitHelper)gb_add16);
+            return OP_NEXT;
+
+        case 0x02: case 0x12:                           /* LD (BC/DE), A */
+            emit_load16(e, RSI, reg16(pair));
+            emit_load8(e, RDX, CTX(a));
+            emit_write(e);
+            return OP_STORE;
+        case 0x0A: case 0x1A:                           /* LD A, (BC/DE) */
+            emit_load16(e, RSI, reg16(pair));
+            emit_call(e, (JitHelper)gb_read8);
+            emit_store_al(e, CTX(a));
+            return OP_NEXT;
+        case 0x22: case 0x32:                           /* LD (HL+/-), A */
+            emit_load16(e, RSI, CTX(hl));
+            emit_load8(e, RDX, CTX(a));
+            emit8(e, 0x66); emit8(e, 0xFF); emit_mem(e, op == 0x22 ? 0 : 1, CTX(hl));
+            emit_write(e);
+            return OP_STORE;
+        case 0x2A: case 0x3A:                           /* LD A, (HL+/-) */
+            emit_load16(e, RSI, CTX(hl));
+            emit8(e, 0x66); emit8(e, 0xFF); emit_mem(e, op == 0x2A ? 0 : 1, CTX(hl));
+            emit_call(e, (JitHelper)gb_read8);
+            emit_store_al(e, CTX(a));
+            return OP_NEXT;
+
+        case 0x04: case 0x0C: case 0x14: case 0x1C:     /* INC r */
+        case 0x24: case 0x2C: case 0x3C:
+        case 0x05: case 0x0D: case 0x15: case 0x1D:     /* DEC r */
+        case 0x25: case 0x2D: case 0x3D:
+            emit_load8(e, RSI, reg8(dst));
+            emit_call(e, (op & 1) ? (JitHelper)gb_dec8 : (JitHelper)gb_inc8);
+            emit_store_al(e, reg8(dst));
+            return OP_NEXT;
+        case 0x34: case 0x35:                           /* INC/DEC (HL) */
+            emit_operand(e, 6);
+            emit_call(e, (op & 1) ? (JitHelper)gb_dec8 : (JitHelper)gb_inc8);
+            emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xD0);     /* movzx edx, al */
+            emit_load16(e, RSI, CTX(hl));
+            emit_write(e);
+            return OP_STORE;
+
+        case 0x06: case 0x0E: case 0x16: case 0x1E:     /* LD r, n */
+        case 0x26: case 0x2E: case 0x3E:
+            emit_set8(e, reg8(dst), (uint8_t)imm);
+            return OP_NEXT;
+        case 0x36:                                      /* LD (HL), n */
+            emit_load16(e, RSI, CTX(hl));
+            emit_imm(e, RDX, (uint8_t)imm);
+            emit_write(e);
+            return OP_STORE;
+
+        case 0x07: emit_call(e, (JitHelper)gb_rlca); return OP_NEXT;
+        case 0x0F: emit_call(e, (JitHelper)gb_rrca); return OP_NEXT;
+        case 0x17: emit_call(e, (JitHelper)gb_rla); return OP_NEXT;
+        case 0x1F: emit_call(e, (JitHelper)gb_rra); return OP_NEXT;
+        case 0x27: emit_call(e, (JitHelper)gb_daa); return OP_NEXT;
+        case 0x2F:                                      /* CPL */
+            emit8(e, 0xF6); emit_mem(e, 2, CTX(a));     /* not byte [a] */
+            emit_set8(e, CTX(f_n), 1);
+            emit_set8(e, CTX(f_h), 1);
+            return OP_NEXT;
+        case 0x37:                                      /* SCF */
+            emit_set8(e, CTX(f_n), 0);
+            emit_set8(e, CTX(f_h), 0);
+            emit_set8(e, CTX(f_c), 1);
+            return OP_NEXT;
+        case 0x3F:                                      /* CCF */
+            emit_set8(e, CTX(f_n), 0);
+            emit_set8(e, CTX(f_h), 0);
+            emit_test8(e, CTX(f_c));
+            emit8(e, 0x0F); emit8(e, 0x94); emit8(e, 0xC0);     /* sete al */
+            emit_store_al(e, CTX(f_c));
+            return OP_NEXT;
+
+        case 0xC6: case 0xCE: case 0xD6: case 0xDE:     /* ALU A, n */
+        case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+            emit_imm(e, RSI, (uint8_t)imm);
+            emit_call(e, alu_helpers[dst]);
+            return OP_NEXT;
+
+        case 0xE0:                                      /* LDH (n), A */
+            emit_imm(e, RSI, 0xFF00u + (uint8_t)imm);
+            emit_load8(e, RDX, CTX(a));
+            emit_write(e);
+            return OP_STORE;
+        case 0xF0:                                      /* LDH A, (n) */
+            emit_imm(e, RSI, 0xFF00u + (uint8_t)imm);
+            emit_call(e, (JitHelper)gb_read8);
+            emit_store_al(e, CTX(a));
+            return OP_NEXT;
+        case 0xE2:                                      /* LD (C), A */
+            emit_load8(e, RSI, CTX(c));
+            emit8(e, 0x81); emit8(e, 0xCE); emit32(e, 0xFF00);  /* or esi, 0xFF00 */
+            emit_load8(e, RDX, CTX(a));
+            emit_write(e);
+            return OP_STORE;
+        case 0xF2:                                      /* LD A, (C) */
+            emit_load8(e, RSI, CTX(c));
+            emit8(e, 0x81); emit8(e, 0xCE); emit32(e, 0xFF00);
+            emit_call(e, (JitHelper)gb_read8);
+            emit_store_al(e, CTX(a));
+            return OP_NEXT;
+        case 0xEA:                                      /* LD (nn), A */
+            emit_imm(e, RSI, imm);
+            emit_load8(e, RDX, CTX(a));
+            emit_write(e);
+            return OP_STORE;
+        case 0xFA:                                      /* LD A, (nn) */
+            emit_imm(e, RSI, imm);
+            emit_call(e, (JitHelper)gb_read8);
+            emit_store_al(e, CTX(a));
+            return OP_NEXT;
+
+        case 0xF9:                                      /* LD SP, HL */
+            emit_load16(e, RAX, CTX(hl));
+            emit_store_ax(e, CTX(sp));
+            return OP_NEXT;
+        case 0xC5: case 0xD5: case 0xE5:                /* PUSH rr */
+            emit_load16(e, RSI, reg16(pair));
+            emit_call(e, (JitHelper)gb_push16);
+            return OP_STORE;
+        case 0xC1: case 0xD1: case 0xE1:                /* POP rr */
+            emit_call(e, (JitHelper)gb_pop16);
+            emit_store_ax(e, reg16(pair));
+            return OP_NEXT;
+        case 0xF3:                                      /* DI */
+            emit_set8(e, CTX(ime), 0);
+            return OP_NEXT;
+
+        case 0x18:                                      /* JR n */
+            emit_set16(e, CTX(pc), (uint16_t)(next + (int8_t)imm));
+            emit_leave_taken(e, 12);
+            return OP_END;
+        case 0x20: case 0x28: case 0x30: case 0x38:     /* JR cc, n */
+            skip = emit_unless(e, dst & 3);
+            emit_set16(e, CTX(pc), (uint16_t)(next + (int8_t)imm));
+            emit_leave_taken(e, 12);
+            patch_here(e, skip);
+            return OP_NEXT;
+        case 0xC3:                                      /* JP nn */
+            emit_set16(e, CTX(pc), imm);
+            emit_leave_taken(e, 16);
+            return OP_END;
+        case 0xC2: case 0xCA: case 0xD2: case 0xDA:     /* JP cc, nn */
+            skip = emit_unless(e, dst & 3);
+            emit_set16(e, CTX(pc), imm);
+            emit_leave_taken(e, 16);
+            patch_here(e, skip);
+            return OP_NEXT;
+        case 0xCD:                                      /* CALL nn */
+            emit_imm(e, RSI, next);
+            emit_call(e, (JitHelper)gb_push16);
+            emit_set16(e, CTX(pc), imm);
+            emit_leave_taken(e, 24);
+            return OP_END;
+        case 0xC4: case 0xCC: case 0xD4: case 0xDC:     /* CALL cc, nn */
+            skip = emit_unless(e, dst & 3);
+            emit_imm(e, RSI, next);
+            emit_call(e, (JitHelper)gb_push16);
+            emit_set16(e, CTX(pc), imm);
+            emit_leave_taken(e, 24);
+            patch_here(e, skip);
+            return OP_NEXT;
+        case 0xC9:                                      /* RET */
+            emit_call(e, (JitHelper)gb_pop16);
+            emit_store_ax(e, CTX(pc));
+            emit_leave_taken(e, 16);
+            return OP_END;
+        case 0xC0: case 0xC8: case 0xD0: case 0xD8:     /* RET cc */
+            skip = emit_unless(e, dst & 3);
+            emit_call(e, (JitHelper)gb_pop16);
+            emit_store_ax(e, CTX(pc));
+            emit_leave_taken(e, 20);
+            patch_here(e, skip);
+            return OP_NEXT;
+
+        default:
+            /* CB ops, RST, RETI, JP HL, HALT, STOP, EI, stack pointer
+             * arithmetic and AF push/pop stay with the interpreter */
+            return OP_NONE;
+    }
+}
+
+GBJitBlock gb_jit_translate(GBJit* jit, const uint8_t* page, uint8_t bank, uint16_t addr) {
+    if (!gb_jit_has_room(jit)) return NULL;
+    if (mprotect(jit->code, JIT_CODE_SIZE, PROT_READ | PROT_WRITE) != 0) return NULL;
+
+    uint8_t* start = jit->code + jit->used;
+    Emit e = { start, { 0 }, 0 };
+    emit8(&e, 0x53);                                    /* push rbx */
+    emit8(&e, 0x48); emit8(&e, 0x89); emit8(&e, 0xFB);  /* mov rbx, rdi */
+
+    unsigned count = 0;
+    unsigned i = addr & 0xFF;
+    while (count < JIT_MAX_OPS) {
+        uint8_t op = page[i];
+        unsigned len = gb_op_length[op];
+        if (i + len > 0x100) break;
+        uint16_t imm = len == 1 ? 0 : len == 2 ? page[i + 1] : (uint16_t)(page[i + 1] | page[i + 2] << 8);
+        uint16_t here = (uint16_t)((addr & 0xFF00) | i);
+        uint16_t next = (uint16_t)(here + len);
+
+        uint8_t* mark = e.p;
+        unsigned exits = e.exit_count;
+        emit_test8(&e, CTX(stopped));
+        emit_exit_if(&e, 0x85);
+#if GBRT_INSTRUMENT >= 1 || GBRT_HOTSPOTS
+        emit_imm(&e, RSI, here);
+        emit_call(&e, (JitHelper)jit_step);
+#endif
+        emit_set16(&e, CTX(pc), next);
+        OpKind kind = emit_op(&e, op, imm, next);
+        if (kind == OP_NONE) {
+            /* Leave with ctx->pc still at this instruction */
+            e.p = mark;
+            e.exit_count = exits;
+            break;
+        }
+        count++;
+        if (kind == OP_END) break;
+        emit_tick(&e, gb_op_cycles[op]);
+        if (kind == OP_STORE) emit_page_check(&e, page, (uint8_t)(addr >> 8));
+        i += len;
+        if (i >= 0x100) break;
+    }
+
+    GBJitBlock block = NULL;
+    if (count > 0) {
+        for (unsigned x = 0; x < e.exit_count; x++) patch_here(&e, e.exits[x]);
+        emit8(&e, 0x31); emit8(&e, 0xC0);               /* xor eax, eax */
+        emit8(&e, 0x5B);                                /* pop rbx */
+        emit8(&e, 0xC3);                                /* ret */
+        if (jit->perf_map) {
+            fprintf(jit->perf_map, "%lx %lx gbjit_%02x_%04x\n", (unsigned long)(uintptr_t)start,
+                    (unsigned long)(e.p - start), bank, addr);
+            fflush(jit->perf_map);
+        }
+        jit->used = ((size_t)(e.p - jit->code) + 15) & ~(size_t)15;
+        jit->blocks++;
+        memcpy(&block, &start, sizeof(block));
+    }
+    mprotect(jit->code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC);
+    return block;
+}
+
+#else
+
+GBJitBlock gb_jit_translate(GBJit* jit, const uint8_t* page, uint8_t bank, uint16_t addr) {
+    (void)jit; (void)page; (void)bank; (void)addr;
+    return NULL;
+}
+
+#endif
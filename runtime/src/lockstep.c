@@ -0,0 +1,309 @@
+/**
+ * @file lockstep.c
+ * @brief Shadow interpreter run in lockstep with recompiled code
+ */
+
+#include "lockstep.h"
+#include "state.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct GBLockstep {
+    GBContext* shadow;      /* Runs only through gb_interpret */
+    uint8_t* state;         /* Blob the context is copied into the shadow with */
+    size_t state_size;
+    uint32_t interval;      /* Cycles between forced returns */
+    const GBLiveMask* live_masks;   /* Sorted by key, NULL = all live */
+    size_t live_mask_count;
+    uint64_t steps;
+    bool diverged;
+};
+
+/* ============================================================================
+ * Hashing
+ * ========================================================================== */
+
+#define HASH_SEED  0xCBF29CE484222325ull
+#define HASH_PRIME 0x100000001B3ull
+
+/* FNV-1a a word at a time */
+static uint64_t hash_bytes(uint64_t hash, const uint8_t* data, size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * HASH_PRIME;
+    }
+    for (; i < size; i++) hash = (hash ^ data[i]) * HASH_PRIME;
+    return hash;
+}
+
+/* Registers and flags in live (GB_LIVE_*), interrupt and bank state, IF,
+ * IE and HRAM */
+static uint64_t hash_cpu(const GBContext* ctx, uint16_t live) {
+    const uint32_t fields[] = {
+        live & GB_LIVE_A ? ctx->a : 0, live & GB_LIVE_B ? ctx->b : 0,
+        live & GB_LIVE_C ? ctx->c : 0, live & GB_LIVE_D ? ctx->d : 0,
+        live & GB_LIVE_E ? ctx->e : 0, live & GB_LIVE_H ? ctx->h : 0,
+        live & GB_LIVE_L ? ctx->l : 0,
+        live & GB_LIVE_FZ ? ctx->f_z != 0 : 0, live & GB_LIVE_FN ? ctx->f_n != 0 : 0,
+        live & GB_LIVE_FH ? ctx->f_h != 0 : 0, live & GB_LIVE_FC ? ctx->f_c != 0 : 0,
+        live & GB_LIVE_SP ? ctx->sp : 0, ctx->pc, ctx->ime, ctx->ime_pending, ctx->halted, ctx->cycles,
+        ctx->rom_bank0, ctx->rom_bank, ctx->ram_bank, ctx->wram_bank, ctx->vram_bank,
+        ctx->io[0x0F], ctx->io[0x80],
+    };
+    uint64_t hash = hash_bytes(HASH_SEED, (const uint8_t*)fields, sizeof(fields));
+    return hash_bytes(hash, ctx->hram, 0x7F);
+}
+
+static const uint8_t* state_page(const GBContext* ctx, int page) {
+    return page < GB_STATE_WRAM_PAGES
+        ? ctx->wram + page * 0x100
+        : ctx->vram + (page - GB_STATE_WRAM_PAGES) * 0x100;
+}
+
+/* ============================================================================
+ * Reporting
+ * ========================================================================== */
+
+/* Bank selected for addr, as shown in reports */
+static unsigned bank_of(const GBContext* ctx, uint16_t addr) {
+    if (addr < 0x4000) return ctx->rom_bank0;
+    if (addr < 0x8000) return ctx->rom_bank;
+    if (addr < 0xA000) return ctx->vram_bank;
+    if (addr < 0xC000) return ctx->ram_bank;
+    if (addr >= 0xD000 && addr < 0xE000) return ctx->wram_bank;
+    return 0;
+}
+
+static void print_regs(const char* name, const GBContext* ctx) {
+    fprintf(stderr, "  %-11s A=%02X F=%c%c%c%c BC=%02X%02X DE=%02X%02X HL=%02X%02X SP=%04X PC=%02X:%04X "
+            "IME=%u HALT=%u IF=%02X IE=%02X cycles=%u hash=%016llx\n",
+            name, ctx->a,
+            ctx->f_z ? 'Z' : '-', ctx->f_n ? 'N' : '-', ctx->f_h ? 'H' : '-', ctx->f_c ? 'C' : '-',
+            ctx->b, ctx->c, ctx->d, ctx->e, ctx->h, ctx->l, ctx->sp,
+            bank_of(ctx, ctx->pc), ctx->pc, ctx->ime, ctx->halted,
+            ctx->io[0x0F], ctx->io[0x80], ctx->cycles, (unsigned long long)hash_cpu(ctx, GB_LIVE_ALL));
+}
+
+/* First differing byte of two regions, or -1 */
+static long first_difference(const uint8_t* a, const uint8_t* b, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (a[i] != b[i]) return (long)i;
+    }
+    return -1;
+}
+
+static void report(GBLockstep* ls, const GBContext* ctx, uint16_t entry_bank, uint16_t entry_pc,
+                   const char* region, unsigned bank, uint16_t addr, int value, int shadow_value) {
+    const GBContext* sh = ls->shadow;
+    ls->diverged = true;
+    fprintf(stderr, "[LOCKSTEP] Diverged in step %llu, entered at %02X:%04X\n",
+            (unsigned long long)ls->steps, entry_bank, entry_pc);
+    if (value >= 0) {
+        fprintf(stderr, "  %s %02X:%04X holds %02X, interpreter %02X\n", region, bank, addr, value, shadow_value);
+    } else {
+        fprintf(stderr, "  %s differ\n", region);
+    }
+    print_regs("recompiled", ctx);
+    print_regs("interpreter", sh);
+}
+
+/* ============================================================================
+ * Liveness
+ * ========================================================================== */
+
+/* What the generated code keeps up to date where ctx stopped */
+static uint16_t live_at(const GBLockstep* ls, const GBContext* ctx) {
+    uint16_t pc = ctx->pc;
+    if (!ls->live_masks || ctx->halted || pc >= 0x8000) return GB_LIVE_ALL;
+    uint32_t key = (uint32_t)(pc < 0x4000 ? 0 : ctx->rom_bank) << 16 | pc;
+    size_t lo = 0, hi = ls->live_mask_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ls->live_masks[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < ls->live_mask_count && ls->live_masks[lo].key == key ? ls->live_masks[lo].live : GB_LIVE_ALL;
+}
+
+/* Give the shadow the context's values of what nothing reads any more */
+static void adopt_dead(GBContext* sh, const GBContext* ctx, uint16_t live) {
+    if (!(live & GB_LIVE_A)) sh->a = ctx->a;
+    if (!(live & GB_LIVE_B)) sh->b = ctx->b;
+    if (!(live & GB_LIVE_C)) sh->c = ctx->c;
+    if (!(live & GB_LIVE_D)) sh->d = ctx->d;
+    if (!(live & GB_LIVE_E)) sh->e = ctx->e;
+    if (!(live & GB_LIVE_H)) sh->h = ctx->h;
+    if (!(live & GB_LIVE_L)) sh->l = ctx->l;
+    if (!(live & GB_LIVE_SP)) sh->sp = ctx->sp;
+    if (!(live & GB_LIVE_FZ)) sh->f_z = ctx->f_z;
+    if (!(live & GB_LIVE_FN)) sh->f_n = ctx->f_n;
+    if (!(live & GB_LIVE_FH)) sh->f_h = ctx->f_h;
+    if (!(live & GB_LIVE_FC)) sh->f_c = ctx->f_c;
+}
+
+/* ============================================================================
+ * Lockstep
+ * ========================================================================== */
+
+/* Clear the dirty pages and write-protect the clean WRAM ones again. Any
+ * snapshot the context was synced with no longer matches state_dirty. */
+static void track_pages(GBContext* ctx) {
+    ctx->state_base = 0;
+    ctx->state_tracking = true;
+    memset(ctx->state_dirty, 0, sizeof(ctx->state_dirty));
+    gb_update_memory_map(ctx);
+}
+
+GBLockstep* gb_lockstep_create(const GBContext* ctx, uint32_t interval) {
+    GBLockstep* ls = (GBLockstep*)calloc(1, sizeof(GBLockstep));
+    if (!ls) return NULL;
+    ls->interval = interval ? interval : GB_LOCKSTEP_DEFAULT_INTERVAL;
+    ls->shadow = gb_context_create(NULL);
+    ls->state_size = gb_state_size(ctx);
+    ls->state = (uint8_t*)malloc(ls->state_size);
+    if (!ls->shadow || !ls->state || !gb_context_attach_rom(ls->shadow, ctx->rom, ctx->rom_size)) {
+        gb_lockstep_destroy(ls);
+        return NULL;
+    }
+    /* Nobody looks at the shadow's picture, sound or serial output */
+    ls->shadow->lockstep_shadow = true;
+    gb_set_turbo(ls->shadow, true, 255, true);
+    gb_set_pixel_format(ls->shadow, GB_PIXEL_INDEX);
+    return ls;
+}
+
+void gb_lockstep_destroy(GBLockstep* ls) {
+    if (!ls) return;
+    gb_context_destroy(ls->shadow);
+    free(ls->state);
+    free(ls);
+}
+
+void gb_lockstep_attach(GBContext* ctx, GBLockstep* ls) {
+    ctx->lockstep = ls;
+    if (!ls) {
+        gb_cancel_event(ctx, GB_EVENT_BREAK);
+        return;
+    }
+    ls->steps = 0;
+    ls->diverged = !gb_state_save(ctx, ls->state, ls->state_size) ||
+                   !gb_state_load(ls->shadow, ls->state, ls->state_size);
+    if (ls->diverged) {
+        fprintf(stderr, "[LOCKSTEP] Cannot copy the context into the shadow\n");
+        return;
+    }
+    track_pages(ctx);
+    track_pages(ls->shadow);
+    gb_schedule_event(ctx, GB_EVENT_BREAK, ls->interval);
+}
+
+/*
+ * Replay one iteration of gb_run_frame's loop on the shadow: the same
+ * interrupt dispatch, then the interpreter (or a HALT wait, 4 cycles at a
+ * time) until the context's cycle count. HALT takes no cycles, so at that
+ * count the shadow also runs into or wakes from one as the context did.
+ * Interrupts raised on the way stop gb_interpret without being taken, as
+ * the recompiled code took none.
+ */
+static void shadow_run(GBContext* sh, const GBContext* ctx) {
+    uint32_t target = ctx->cycles;
+    gb_handle_interrupts(sh);
+    sh->frame_done = 0;
+    while (true) {
+        int32_t left = (int32_t)(target - sh->cycles);
+        if (left < 0 || (left == 0 && sh->halted == ctx->halted)) break;
+        sh->stopped = 0;
+        if (sh->halted) {
+            /* gb_halt_wait, a slot at a time */
+            if (!sh->ime && (sh->io[0x0F] & sh->io[0x80] & 0x1F)) sh->halted = 0;
+            else gb_tick(sh, 4);
+        } else {
+            gb_schedule_event(sh, GB_EVENT_BREAK, (uint32_t)left);
+            gb_interpret(sh, sh->pc);
+        }
+    }
+    gb_cancel_event(sh, GB_EVENT_BREAK);
+    sh->stopped = 0;
+}
+
+void gb_lockstep_check(GBLockstep* ls, GBContext* ctx) {
+    if (ls->diverged) return;
+    GBContext* sh = ls->shadow;
+    uint16_t entry_pc = sh->pc;
+    uint16_t entry_bank = (uint16_t)bank_of(sh, entry_pc);
+    ls->steps++;
+
+    sh->joypad_buttons = ctx->joypad_buttons;
+    sh->joypad_dpad = ctx->joypad_dpad;
+    shadow_run(sh, ctx);
+
+    uint16_t live = live_at(ls, ctx);
+    if (hash_cpu(ctx, live) != hash_cpu(sh, live)) {
+        long i = first_difference(ctx->hram, sh->hram, 0x7F);
+        if (i >= 0) report(ls, ctx, entry_bank, entry_pc, "HRAM", 0, (uint16_t)(0xFF80 + i), ctx->hram[i], sh->hram[i]);
+        else report(ls, ctx, entry_bank, entry_pc, "Registers", 0, 0, -1, -1);
+        return;
+    }
+
+    bool dirty = false;
+    for (int p = 0; p < GB_STATE_PAGES; p++) {
+        if (!ctx->state_dirty[p] && !sh->state_dirty[p]) continue;
+        dirty = true;
+        const uint8_t* page = state_page(ctx, p);
+        const uint8_t* shadow_page = state_page(sh, p);
+        if (hash_bytes(HASH_SEED, page, 0x100) == hash_bytes(HASH_SEED, shadow_page, 0x100)) continue;
+        long i = first_difference(page, shadow_page, 0x100);
+        if (i < 0) continue;
+        if (p < GB_STATE_WRAM_PAGES) {
+            unsigned bank = (unsigned)p >> 4;
+            uint16_t addr = (uint16_t)((bank ? 0xD000 : 0xC000) + ((p & 0x0F) << 8) + i);
+            report(ls, ctx, entry_bank, entry_pc, "WRAM", bank, addr, page[i], shadow_page[i]);
+        } else {
+            unsigned q = (unsigned)(p - GB_STATE_WRAM_PAGES);
+            report(ls, ctx, entry_bank, entry_pc, "VRAM", q >> 5,
+                   (uint16_t)(0x8000 + ((q & 0x1F) << 8) + i), page[i], shadow_page[i]);
+        }
+        return;
+    }
+
+    /* OAM and ERAM are not dirty-tracked; compare them at frame ends */
+    if (ctx->frame_done) {
+        long i = first_difference(ctx->oam, sh->oam, 0xA0);
+        if (i >= 0) {
+            report(ls, ctx, entry_bank, entry_pc, "OAM", 0, (uint16_t)(0xFE00 + i), ctx->oam[i], sh->oam[i]);
+            return;
+        }
+        if (ctx->eram && sh->eram &&
+            hash_bytes(HASH_SEED, ctx->eram, ctx->eram_size) != hash_bytes(HASH_SEED, sh->eram, sh->eram_size)) {
+            i = first_difference(ctx->eram, sh->eram, ctx->eram_size);
+            if (i >= 0) {
+                report(ls, ctx, entry_bank, entry_pc, "ERAM", (unsigned)(i / 0x2000),
+                       (uint16_t)(0xA000 + i % 0x2000), ctx->eram[i], sh->eram[i]);
+                return;
+            }
+        }
+    }
+
+    adopt_dead(sh, ctx, live);
+    if (dirty) {
+        track_pages(ctx);
+        track_pages(sh);
+    }
+    gb_schedule_event(ctx, GB_EVENT_BREAK, ls->interval);
+}
+
+void gb_lockstep_set_live_masks(GBLockstep* ls, const GBLiveMask* masks, size_t count) {
+    ls->live_masks = count ? masks : NULL;
+    ls->live_mask_count = count;
+}
+
+bool gb_lockstep_diverged(const GBLockstep* ls) {
+    return ls->diverged;
+}
+
+uint64_t gb_lockstep_steps(const GBLockstep* ls) {
+    return ls->steps;
+}
@@ -0,0 +1,437 @@
+/**
+ * @file mbc.c
+ * @brief MBC1/2/3/5 mapper tables and the MBC3 real-time clock
+ */
+
+#include "mbc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GBRT_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define RTC_CYCLES_PER_SECOND 4194304u
+
+/* Cartridge header fields */
+#define HEADER_CART_TYPE 0x147
+#define HEADER_RAM_SIZE  0x149
+
+/* ============================================================================
+ * Shared Helpers
+ * ========================================================================== */
+
+/* Wrap a bank number to the ROM, as the unconnected high bank lines do */
+static uint16_t rom_bank_wrap(const GBContext* ctx, uint32_t bank) {
+    uint32_t banks = (uint32_t)(ctx->rom_size >> 14);
+    return (uint16_t)(banks ? bank % banks : 0);
+}
+
+static void set_ram_enabled(GBContext* ctx, uint8_t value) {
+    uint8_t enabled = (value & 0x0F) == 0x0A;
+    if (enabled == ctx->ram_enabled) return;
+    ctx->ram_enabled = enabled;
+    gb_update_eram_map(ctx);
+}
+
+static void set_rom_banks(GBContext* ctx, uint32_t bank0, uint32_t bank) {
+    uint16_t lo = rom_bank_wrap(ctx, bank0), hi = rom_bank_wrap(ctx, bank);
+    if (lo == ctx->rom_bank0 && hi == ctx->rom_bank) return;
+    ctx->rom_bank0 = lo;
+    ctx->rom_bank = hi;
+    gb_update_rom_map(ctx);
+}
+
+static void set_ram_bank(GBContext* ctx, uint8_t bank) {
+    if (bank == ctx->ram_bank) return;
+    ctx->ram_bank = bank;
+    gb_update_eram_map(ctx);
+}
+
+static uint8_t open_bus_read(GBContext* ctx, uint16_t addr) {
+    (void)ctx; (void)addr;
+    return 0xFF;
+}
+
+static void ignore_write(GBContext* ctx, uint16_t addr, uint8_t value) {
+    (void)ctx; (void)addr; (void)value;
+}
+
+static bool always_mapped(const GBContext* ctx) {
+    (void)ctx;
+    return true;
+}
+
+/* ============================================================================
+ * No MBC
+ * ========================================================================== */
+
+static const GBMapper mapper_none = {
+    "ROM", ignore_write, open_bus_read, ignore_write, always_mapped,
+};
+
+/* ============================================================================
+ * MBC1
+ * ========================================================================== */
+
+/* BANK2 supplies ROM bits 5-6 at 0x4000, and in mode 1 also selects the
+ * ROM bank at 0x0000 and the RAM bank */
+static void mbc1_update(GBContext* ctx) {
+    uint32_t upper = (uint32_t)ctx->mbc_bank2 << 5;
+    set_rom_banks(ctx, ctx->mbc_mode ? upper : 0, upper | ctx->mbc_bank1);
+    set_ram_bank(ctx, ctx->mbc_mode ? ctx->mbc_bank2 : 0);
+}
+
+static void mbc1_write_rom(GBContext* ctx, uint16_t addr, uint8_t value) {
+    switch (addr >> 13) {
+        case 0: set_ram_enabled(ctx, value); return;
+        case 1:
+            ctx->mbc_bank1 = value & 0x1F;
+            if (ctx->mbc_bank1 == 0) ctx->mbc_bank1 = 1;
+            break;
+        case 2: ctx->mbc_bank2 = value & 0x03; break;
+        default: ctx->mbc_mode = value & 0x01; break;
+    }
+    mbc1_update(ctx);
+}
+
+static const GBMapper mapper_mbc1 = {
+    "MBC1", mbc1_write_rom, open_bus_read, ignore_write, always_mapped,
+};
+
+/* ============================================================================
+ * MBC2
+ * ========================================================================== */
+
+/* Address bit 8 picks ROM bank select or RAM enable in 0x0000-0x3FFF */
+static void mbc2_write_rom(GBContext* ctx, uint16_t addr, uint8_t value) {
+    if (addr >= 0x4000) return;
+    if (addr & 0x100) {
+        uint8_t bank = value & 0x0F;
+        set_rom_banks(ctx, 0, bank ? bank : 1);
+    } else {
+        set_ram_enabled(ctx, value);
+    }
+}
+
+/* 512 nibbles echoed through 0xA000-0xBFFF; the upper bits read as 1 */
+static uint8_t mbc2_read_ram(GBContext* ctx, uint16_t addr) {
+    if (!ctx->ram_enabled || !ctx->eram) return 0xFF;
+    return (uint8_t)(ctx->eram[addr & 0x1FF] | 0xF0);
+}
+
+static void mbc2_write_ram(GBContext* ctx, uint16_t addr, uint8_t value) {
+    if (ctx->ram_enabled && ctx->eram) ctx->eram[addr & 0x1FF] = value & 0x0F;
+}
+
+static bool never_mapped(const GBContext* ctx) {
+    (void)ctx;
+    return false;
+}
+
+static const GBMapper mapper_mbc2 = {
+    "MBC2", mbc2_write_rom, mbc2_read_ram, mbc2_write_ram, never_mapped,
+};
+
+/* ============================================================================
+ * MBC3
+ * ========================================================================== */
+
+enum { RTC_S, RTC_M, RTC_H, RTC_DL, RTC_DH };
+
+#define RTC_DH_DAY8  0x01
+#define RTC_DH_HALT  0x40
+#define RTC_DH_CARRY 0x80
+
+/* One second; counters past their range run on to their bit width
+ * before wrapping without a carry, as on the chip */
+static void rtc_tick(uint8_t* rtc) {
+    if (rtc[RTC_S] != 59) { rtc[RTC_S] = (rtc[RTC_S] + 1) & 0x3F; return; }
+    rtc[RTC_S] = 0;
+    if (rtc[RTC_M] != 59) { rtc[RTC_M] = (rtc[RTC_M] + 1) & 0x3F; return; }
+    rtc[RTC_M] = 0;
+    if (rtc[RTC_H] != 23) { rtc[RTC_H] = (rtc[RTC_H] + 1) & 0x1F; return; }
+    rtc[RTC_H] = 0;
+    if (++rtc[RTC_DL] != 0) return;
+    if (rtc[RTC_DH] & RTC_DH_DAY8) rtc[RTC_DH] = (rtc[RTC_DH] & ~RTC_DH_DAY8) | RTC_DH_CARRY;
+    else rtc[RTC_DH] |= RTC_DH_DAY8;
+}
+
+static void rtc_store(GBContext* ctx);
+
+void gb_rtc_sync(GBContext* ctx) {
+    uint32_t elapsed = ctx->cycles - ctx->rtc_sync_cycles;
+    if (ctx->rtc[RTC_DH] & RTC_DH_HALT) {
+        ctx->rtc_sync_cycles = ctx->cycles;
+    } else {
+        for (; elapsed >= RTC_CYCLES_PER_SECOND; elapsed -= RTC_CYCLES_PER_SECOND) {
+            rtc_tick(ctx->rtc);
+            ctx->rtc_sync_cycles += RTC_CYCLES_PER_SECOND;
+        }
+    }
+    if (ctx->save_path) rtc_store(ctx);
+}
+
+static void mbc3_write_rom(GBContext* ctx, uint16_t addr, uint8_t value) {
+    switch (addr >> 13) {
+        case 0: set_ram_enabled(ctx, value); return;
+        case 1: {
+            uint8_t bank = value & 0x7F;
+            set_rom_banks(ctx, 0, bank ? bank : 1);
+            return;
+        }
+        case 2: set_ram_bank(ctx, value & 0x0F); return;
+        default:
+            /* Writing 0 then 1 copies the running clock to the latches */
+            if (ctx->mbc_rtc && ctx->rtc_latch == 0 && value == 1) {
+                gb_rtc_sync(ctx);
+                memcpy(ctx->rtc_latched, ctx->rtc, sizeof(ctx->rtc));
+            }
+            ctx->rtc_latch = value;
+            return;
+    }
+}
+
+static bool rtc_selected(const GBContext* ctx) {
+    return ctx->mbc_rtc && ctx->ram_bank >= 0x08 && ctx->ram_bank <= 0x0C;
+}
+
+static uint8_t mbc3_read_ram(GBContext* ctx, uint16_t addr) {
+    (void)addr;
+    if (!ctx->ram_enabled || !rtc_selected(ctx)) return 0xFF;
+    return ctx->rtc_latched[ctx->ram_bank - 0x08];
+}
+
+static void mbc3_write_ram(GBContext* ctx, uint16_t addr, uint8_t value) {
+    (void)addr;
+    if (!ctx->ram_enabled || !rtc_selected(ctx)) return;
+    static const uint8_t masks[5] = {0x3F, 0x3F, 0x1F, 0xFF, 0xC1};
+    int reg = ctx->ram_bank - 0x08;
+    gb_rtc_sync(ctx);
+    /* Setting the seconds restarts the current second */
+    if (reg == RTC_S) ctx->rtc_sync_cycles = ctx->cycles;
+    ctx->rtc[reg] = value & masks[reg];
+    ctx->rtc_latched[reg] = ctx->rtc[reg];
+}
+
+static bool mbc3_ram_mapped(const GBContext* ctx) {
+    return ctx->ram_bank < 0x08;
+}
+
+static const GBMapper mapper_mbc3 = {
+    "MBC3", mbc3_write_rom, mbc3_read_ram, mbc3_write_ram, mbc3_ram_mapped,
+};
+
+/* ============================================================================
+ * MBC5
+ * ========================================================================== */
+
+/* 9-bit ROM bank with bank 0 selectable; rumble carts use RAM bank bit 3
+ * for the motor */
+static void mbc5_write_rom(GBContext* ctx, uint16_t addr, uint8_t value) {
+    switch (addr >> 12) {
+        case 0: case 1: set_ram_enabled(ctx, value); return;
+        case 2: set_rom_banks(ctx, 0, (ctx->rom_bank & 0x100) | value); return;
+        case 3: set_rom_banks(ctx, 0, (ctx->rom_bank & 0xFF) | ((value & 0x01) << 8)); return;
+        case 4: case 5: set_ram_bank(ctx, value & (ctx->mbc_rumble ? 0x07 : 0x0F)); return;
+        default: return;
+    }
+}
+
+static const GBMapper mapper_mbc5 = {
+    "MBC5", mbc5_write_rom, open_bus_read, ignore_write, always_mapped,
+};
+
+/* ============================================================================
+ * Battery Save Files
+ * ========================================================================== */
+
+/*
+ * A save file is the ERAM image, followed for MBC3 clock cartridges by the
+ * 48-byte footer most emulators share: the five clock registers and their
+ * latched copies as little-endian 32-bit words, then the host time in
+ * seconds as a 64-bit word. With mmap the file is ERAM itself and the
+ * kernel writes dirty pages back in the background; elsewhere it is read
+ * once and written back when the ROM is released.
+ */
+#define RTC_FOOTER_SIZE 48
+
+/* Days after which the day counter has certainly overflowed */
+#define RTC_MAX_CATCH_UP (512u * 86400u)
+
+static size_t save_size(const GBContext* ctx) {
+    return ctx->eram_size + (ctx->mbc_rtc ? RTC_FOOTER_SIZE : 0);
+}
+
+static void put_le(uint8_t* out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint64_t get_le(const uint8_t* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) value |= (uint64_t)in[i] << (8 * i);
+    return value;
+}
+
+/* Refresh the footer; the file keeps the clock while the game is closed */
+static void rtc_store(GBContext* ctx) {
+    if (!ctx->mbc_rtc) return;
+    uint8_t* footer = ctx->eram + ctx->eram_size;
+    for (int i = 0; i < 5; i++) {
+        put_le(footer + i * 4, ctx->rtc[i], 4);
+        put_le(footer + 20 + i * 4, ctx->rtc_latched[i], 4);
+    }
+    put_le(footer + 40, (uint64_t)time(NULL), 8);
+}
+
+/* Restore the clock and run it on by the host time the game was closed */
+static void rtc_load(GBContext* ctx) {
+    const uint8_t* footer = ctx->eram + ctx->eram_size;
+    for (int i = 0; i < 5; i++) {
+        ctx->rtc[i] = (uint8_t)get_le(footer + i * 4, 4);
+        ctx->rtc_latched[i] = (uint8_t)get_le(footer + 20 + i * 4, 4);
+    }
+    int64_t closed = (int64_t)time(NULL) - (int64_t)get_le(footer + 40, 8);
+    if (closed <= 0 || (ctx->rtc[RTC_DH] & RTC_DH_HALT)) return;
+    if (closed > RTC_MAX_CATCH_UP) closed = RTC_MAX_CATCH_UP;
+    while (closed--) rtc_tick(ctx->rtc);
+}
+
+bool gb_mbc_map_save(GBContext* ctx, const char* path) {
+    if (!ctx->mbc_battery || (!ctx->eram && !ctx->mbc_rtc) || ctx->save_path) return false;
+    size_t size = save_size(ctx);
+    char* owned = (char*)malloc(strlen(path) + 1);
+    if (!owned) return false;
+    strcpy(owned, path);
+    
+#ifdef GBRT_HAS_MMAP
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) { free(owned); return false; }
+    struct stat st;
+    uint8_t* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && ((size_t)st.st_size >= size || ftruncate(fd, (off_t)size) == 0)) {
+        map = (uint8_t*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) { free(owned); return false; }
+    size_t existing = (size_t)st.st_size;
+    /* A new or short file starts from the current ERAM */
+    if (existing < ctx->eram_size) memcpy(map + existing, ctx->eram + existing, ctx->eram_size - existing);
+    free(ctx->eram);
+    ctx->eram = map;
+#else
+    size_t existing = 0;
+    uint8_t* grown = (uint8_t*)realloc(ctx->eram, size);
+    if (!grown) { free(owned); return false; }
+    ctx->eram = grown;
+    FILE* f = fopen(path, "rb");
+    if (f) {
+        existing = fread(ctx->eram, 1, size, f);
+        fclose(f);
+    }
+#endif
+    ctx->save_path = owned;
+    if (ctx->mbc_rtc) {
+        if (existing >= size) rtc_load(ctx);
+        rtc_store(ctx);
+    }
+    gb_update_eram_map(ctx);
+    return true;
+}
+
+/* ============================================================================
+ * Cartridge Setup
+ * ========================================================================== */
+
+const GBMapper* gb_mbc_mapper(GBMbcType type) {
+    static const GBMapper* const mappers[GB_MBC_COUNT] = {
+        [GB_MBC_NONE] = &mapper_none,
+        [GB_MBC_1] = &mapper_mbc1,
+        [GB_MBC_2] = &mapper_mbc2,
+        [GB_MBC_3] = &mapper_mbc3,
+        [GB_MBC_5] = &mapper_mbc5,
+    };
+    return type < GB_MBC_COUNT ? mappers[type] : &mapper_none;
+}
+
+/* Mapper family of a cartridge type byte; unknown types get MBC1, which
+ * most third-party controllers are compatible with */
+static GBMbcType cart_mbc(uint8_t type) {
+    switch (type) {
+        case 0x00: case 0x08: case 0x09: return GB_MBC_NONE;
+        case 0x05: case 0x06: return GB_MBC_2;
+        case 0x0F: case 0x10: case 0x11: case 0x12: case 0x13: case 0xFE: return GB_MBC_3;
+        case 0x19: case 0x1A: case 0x1B: case 0x1C: case 0x1D: case 0x1E: case 0xFC: return GB_MBC_5;
+        default: return GB_MBC_1;
+    }
+}
+
+bool gb_mbc_attach(GBContext* ctx) {
+    gb_mbc_release(ctx);
+    uint8_t type = ctx->rom_size > HEADER_RAM_SIZE ? ctx->rom[HEADER_CART_TYPE] : 0;
+    uint8_t ram_code = ctx->rom_size > HEADER_RAM_SIZE ? ctx->rom[HEADER_RAM_SIZE] : 0;
+
+    ctx->mbc_type = (uint8_t)cart_mbc(type);
+    ctx->mbc_rtc = type == 0x0F || type == 0x10;
+    ctx->mbc_rumble = type >= 0x1C && type <= 0x1E;
+    switch (type) {
+        case 0x03: case 0x06: case 0x09: case 0x0F: case 0x10: case 0x13:
+        case 0x1B: case 0x1E: case 0xFC: case 0xFE: case 0xFF:
+            ctx->mbc_battery = 1;
+            break;
+        default:
+            ctx->mbc_battery = 0;
+            break;
+    }
+    ctx->mapper = gb_mbc_mapper((GBMbcType)ctx->mbc_type);
+
+    static const size_t ram_sizes[6] = {0, 0x800, 0x2000, 0x8000, 0x20000, 0x10000};
+    size_t size = ctx->mbc_type == GB_MBC_2 ? 0x200 : ram_code < 6 ? ram_sizes[ram_code] : 0;
+    if (size) {
+        ctx->eram = (uint8_t*)calloc(1, size);
+        if (!ctx->eram) return false;
+        ctx->eram_size = size;
+    }
+    return true;
+}
+
+void gb_mbc_release(GBContext* ctx) {
+    if (ctx->save_path) {
+        if (ctx->mbc_rtc) {
+            gb_rtc_sync(ctx);
+        }
+#ifdef GBRT_HAS_MMAP
+        munmap(ctx->eram, save_size(ctx));
+        ctx->eram = NULL;
+#else
+        FILE* f = fopen(ctx->save_path, "wb");
+        if (f) {
+            fwrite(ctx->eram, 1, save_size(ctx), f);
+            fclose(f);
+        }
+#endif
+        free(ctx->save_path);
+        ctx->save_path = NULL;
+    }
+    free(ctx->eram);
+    ctx->eram = NULL;
+    ctx->eram_size = 0;
+}
+
+void gb_mbc_reset(GBContext* ctx) {
+    ctx->rom_bank0 = 0;
+    ctx->rom_bank = rom_bank_wrap(ctx, 1);
+    ctx->ram_bank = 0;
+    ctx->ram_enabled = ctx->mbc_type == GB_MBC_NONE;
+    ctx->mbc_mode = 0;
+    ctx->mbc_bank1 = 1;
+    ctx->mbc_bank2 = 0;
+    ctx->rtc_latch = 0xFF;
+    ctx->rtc_sync_cycles = ctx->cycles;
+}
@@ -0,0 +1,271 @@
+/**
+ * @file movie.c
+ * @brief Input movie recording, replay and checksum verification
+ */
+
+#include "movie.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ============================================================================
+ * File Format
+ * ========================================================================== */
+
+/*
+ * Little-endian:
+ *   "GBMV", u16 version, u16 flags, u32 check_interval,
+ *   u16 ROM global checksum, u16 reserved,
+ *   u32 frames, u32 samples, u32 checksums, u32 input bytes,
+ *   input: runs of (LEB128 length, sample byte),
+ *   checksums: u64 each
+ *
+ * A sample packs the active-low joypad state as buttons << 4 | dpad.
+ */
+#define MOVIE_MAGIC   "GBMV"
+#define MOVIE_VERSION 1
+#define MOVIE_HEADER_SIZE 32
+
+struct GBMovie {
+    uint32_t flags;
+    uint32_t check_interval;
+    uint16_t rom_checksum;
+    bool replaying;
+
+    uint8_t* samples;
+    size_t sample_count;
+    size_t sample_cap;
+    size_t cursor;          /* Next sample to replay */
+
+    uint64_t* checks;
+    size_t check_count;
+    size_t check_cap;
+
+    uint32_t frames;        /* Movie length */
+    uint32_t frame;         /* Frames run since attach */
+    uint32_t mismatches;
+    uint32_t first_mismatch;
+};
+
+static uint16_t rom_global_checksum(const GBContext* ctx) {
+    if (!ctx->rom || ctx->rom_size < 0x150) return 0;
+    return (uint16_t)(ctx->rom[0x14E] << 8 | ctx->rom[0x14F]);
+}
+
+static bool grow(void** data, size_t* cap, size_t count, size_t elem) {
+    if (count < *cap) return true;
+    size_t new_cap = *cap ? *cap * 2 : 1024;
+    void* grown = realloc(*data, new_cap * elem);
+    if (!grown) return false;
+    *data = grown;
+    *cap = new_cap;
+    return true;
+}
+
+static void put_u16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put_u32(uint8_t* p, uint32_t v) { put_u16(p, (uint16_t)v); put_u16(p + 2, (uint16_t)(v >> 16)); }
+static uint16_t get_u16(const uint8_t* p) { return (uint16_t)(p[0] | p[1] << 8); }
+static uint32_t get_u32(const uint8_t* p) { return get_u16(p) | (uint32_t)get_u16(p + 2) << 16; }
+
+/* ============================================================================
+ * Lifetime and Files
+ * ========================================================================== */
+
+GBMovie* gb_movie_create(const GBContext* ctx, uint32_t flags, uint32_t check_interval) {
+    GBMovie* movie = (GBMovie*)calloc(1, sizeof(GBMovie));
+    if (!movie) return NULL;
+    movie->flags = flags;
+    movie->check_interval = check_interval ? check_interval : GB_MOVIE_DEFAULT_CHECK_INTERVAL;
+    movie->rom_checksum = rom_global_checksum(ctx);
+    return movie;
+}
+
+void gb_movie_destroy(GBMovie* movie) {
+    if (!movie) return;
+    free(movie->samples);
+    free(movie->checks);
+    free(movie);
+}
+
+bool gb_movie_save(const GBMovie* movie, const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+
+    /* Run-length encode the samples; a run needs at most 11 bytes */
+    uint8_t* input = (uint8_t*)malloc(movie->sample_count * 11 + 1);
+    size_t input_size = 0;
+    bool ok = input != NULL;
+    for (size_t i = 0; ok && i < movie->sample_count;) {
+        size_t run = 1;
+        while (i + run < movie->sample_count && movie->samples[i + run] == movie->samples[i]) run++;
+        for (size_t v = run; ; v >>= 7) {
+            input[input_size++] = (uint8_t)(v >= 0x80 ? (v & 0x7F) | 0x80 : v);
+            if (v < 0x80) break;
+        }
+        input[input_size++] = movie->samples[i];
+        i += run;
+    }
+
+    uint8_t header[MOVIE_HEADER_SIZE] = {0};
+    memcpy(header, MOVIE_MAGIC, 4);
+    put_u16(header + 4, MOVIE_VERSION);
+    put_u16(header + 6, (uint16_t)movie->flags);
+    put_u32(header + 8, movie->check_interval);
+    put_u16(header + 12, movie->rom_checksum);
+    put_u32(header + 16, movie->frames);
+    put_u32(header + 20, (uint32_t)movie->sample_count);
+    put_u32(header + 24, (uint32_t)movie->check_count);
+    put_u32(header + 28, (uint32_t)input_size);
+    ok = ok && fwrite(header, 1, sizeof(header), f) == sizeof(header);
+    ok = ok && fwrite(input, 1, input_size, f) == input_size;
+    for (size_t i = 0; ok && i < movie->check_count; i++) {
+        uint8_t bytes[8];
+        put_u32(bytes, (uint32_t)movie->checks[i]);
+        put_u32(bytes + 4, (uint32_t)(movie->checks[i] >> 32));
+        ok = fwrite(bytes, 1, 8, f) == 8;
+    }
+    free(input);
+    return fclose(f) == 0 && ok;
+}
+
+GBMovie* gb_movie_load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    uint8_t header[MOVIE_HEADER_SIZE];
+    GBMovie* movie = NULL;
+    uint8_t* input = NULL;
+    if (fread(header, 1, sizeof(header), f) != sizeof(header) ||
+        memcmp(header, MOVIE_MAGIC, 4) != 0 || get_u16(header + 4) != MOVIE_VERSION) {
+        goto fail;
+    }
+
+    movie = (GBMovie*)calloc(1, sizeof(GBMovie));
+    if (!movie) goto fail;
+    movie->replaying = true;
+    movie->flags = get_u16(header + 6);
+    movie->check_interval = get_u32(header + 8);
+    movie->rom_checksum = get_u16(header + 12);
+    movie->frames = get_u32(header + 16);
+    movie->sample_count = movie->sample_cap = get_u32(header + 20);
+    movie->check_count = movie->check_cap = get_u32(header + 24);
+    size_t input_size = get_u32(header + 28);
+    if (movie->check_interval == 0) goto fail;
+
+    input = (uint8_t*)malloc(input_size + 1);
+    movie->samples = (uint8_t*)malloc(movie->sample_count + 1);
+    movie->checks = (uint64_t*)malloc((movie->check_count + 1) * sizeof(uint64_t));
+    if (!input || !movie->samples || !movie->checks) goto fail;
+    if (fread(input, 1, input_size, f) != input_size) goto fail;
+
+    size_t pos = 0, count = 0;
+    while (pos < input_size) {
+        size_t run = 0;
+        for (int shift = 0; pos < input_size && shift < 64; shift += 7) {
+            uint8_t byte = input[pos++];
+            run |= (size_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        if (pos >= input_size || run > movie->sample_count - count) goto fail;
+        memset(movie->samples + count, input[pos++], run);
+        count += run;
+    }
+    if (count != movie->sample_count) goto fail;
+
+    for (size_t i = 0; i < movie->check_count; i++) {
+        uint8_t bytes[8];
+        if (fread(bytes, 1, 8, f) != 8) goto fail;
+        movie->checks[i] = get_u32(bytes) | (uint64_t)get_u32(bytes + 4) << 32;
+    }
+    free(input);
+    fclose(f);
+    return movie;
+
+fail:
+    free(input);
+    gb_movie_destroy(movie);
+    fclose(f);
+    return NULL;
+}
+
+bool gb_movie_attach(GBContext* ctx, GBMovie* movie) {
+    if (movie && movie->replaying && movie->rom_checksum != rom_global_checksum(ctx)) return false;
+    ctx->movie = movie;
+    return true;
+}
+
+/* ============================================================================
+ * Recording and Replay
+ * ========================================================================== */
+
+static void movie_sample(GBMovie* movie, GBContext* ctx) {
+    if (movie->replaying) {
+        /* Past the end the last input stays held */
+        if (movie->cursor < movie->sample_count) {
+            uint8_t sample = movie->samples[movie->cursor++];
+            ctx->joypad_buttons = 0xF0 | sample >> 4;
+            ctx->joypad_dpad = 0xF0 | (sample & 0x0F);
+        }
+        return;
+    }
+    if (!grow((void**)&movie->samples, &movie->sample_cap, movie->sample_count, 1)) return;
+    movie->samples[movie->sample_count++] =
+        (uint8_t)((ctx->joypad_buttons & 0x0F) << 4 | (ctx->joypad_dpad & 0x0F));
+}
+
+void gb_movie_begin_frame(GBMovie* movie, GBContext* ctx) {
+    if (!(movie->flags & GB_MOVIE_PER_POLL)) movie_sample(movie, ctx);
+}
+
+void gb_movie_poll(GBMovie* movie, GBContext* ctx) {
+    if (movie->flags & GB_MOVIE_PER_POLL) movie_sample(movie, ctx);
+}
+
+void gb_movie_end_frame(GBMovie* movie, GBContext* ctx) {
+    movie->frame++;
+    if (!movie->replaying) movie->frames = movie->frame;
+    if (movie->frame % movie->check_interval != 0) return;
+
+    uint64_t hash = gb_movie_state_hash(ctx);
+    size_t index = movie->frame / movie->check_interval - 1;
+    if (movie->replaying) {
+        if (index < movie->check_count && movie->checks[index] != hash) {
+            if (movie->mismatches++ == 0) movie->first_mismatch = movie->frame;
+        }
+        return;
+    }
+    if (!grow((void**)&movie->checks, &movie->check_cap, movie->check_count, sizeof(uint64_t))) return;
+    movie->checks[movie->check_count++] = hash;
+}
+
+uint32_t gb_movie_length(const GBMovie* movie) {
+    return movie->frames;
+}
+
+uint32_t gb_movie_frame(const GBMovie* movie) {
+    return movie->frame;
+}
+
+bool gb_movie_finished(const GBMovie* movie) {
+    return movie->replaying && movie->frame >= movie->frames;
+}
+
+uint32_t gb_movie_mismatches(const GBMovie* movie, uint32_t* first_frame) {
+    if (first_frame && movie->mismatches) *first_frame = movie->first_mismatch;
+    return movie->mismatches;
+}
+
+uint64_t gb_movie_state_hash(GBContext* ctx) {
+    /* FNV-1a over the shades, WRAM and HRAM */
+    const struct { const uint8_t* data; size_t size; } regions[] = {
+        { gb_get_shades(ctx), 160 * 144 },
+        { ctx->wram, GB_STATE_WRAM_PAGES * 0x100 },
+        { ctx->hram, 0x7F },
+    };
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t r = 0; r < sizeof(regions) / sizeof(regions[0]); r++) {
+        for (size_t i = 0; i < regions[r].size; i++) {
+            hash = (hash ^ regions[r].data[i]) * 0x100000001B3ull;
+        }
+    }
+    return hash;
+}
@@ -6,10 +6,13 @@
 #include "platform_sdl.h"
 #include "gbrt.h"   /* For GBPlatformCallbacks */
 #include "ppu.h"
+#include "audio.h"
 #include "gbrt_debug.h"
 
 #ifdef GB_HAS_SDL2
 #include <SDL.h>
+#include <stdatomic.h>
+#include <string.h>
 
 /* ============================================================================
  * SDL State
@@ -18,13 +21,28 @@
 static SDL_Window* g_window = NULL;
 static SDL_Renderer* g_renderer = NULL;
 static SDL_Texture* g_texture = NULL;
+static GBContext* g_bound_ctx = NULL;  /* Context rendering into g_texture */
 static int g_scale = 3;
 static uint32_t g_last_frame_time = 0;
 static SDL_AudioDeviceID g_audio_device = 0;
 
-/* Joypad state - exported for gbrt.c to access */
-uint8_t g_joypad_buttons = 0xFF;  /* Active low: Start, Select, B, A */
-uint8_t g_joypad_dpad = 0xFF;     /* Active low: Down, Up, Left, Right */
+/* Emulation thread: frames travel through a triple buffer. The emulation
+ * thread owns g_frame_back, the window thread owns g_frame_front, and the
+ * slot in between is swapped atomically; FRAME_FRESH marks an unseen frame.
+ * SDL's renderer and event queue stay on the window thread. */
+#define FRAME_FRESH 0x80
+static uint32_t g_frames[3][GB_FRAMEBUFFER_SIZE];
+static atomic_uchar g_frame_middle = 1;
+static uint8_t g_frame_back = 0;
+static uint8_t g_frame_front = 2;
+static SDL_sem* g_frame_ready = NULL;
+static atomic_bool g_emulation_quit = false;
+
+/* Keyboard state, copied into the polled context (one window, one player).
+ * Atomic since the emulation thread reads it while the window thread polls. */
+static atomic_uchar g_joypad_buttons = 0xFF;  /* Active low: Start, Select, B, A */
+static atomic_uchar g_joypad_dpad = 0xFF;     /* Active low: Down, Up, Left, Right */
+static atomic_bool g_rewind_held = false;     /* R held: step back through the rewind buffer */
 
 /* ============================================================================
  * Platform Functions
@@ -33,6 +51,7 @@ uint8_t g_joypad_dpad = 0xFF;     /* Active low: Down, Up, Left, Right */
 
 
 void gb_platform_shutdown(void) {
+    gb_platform_bind_framebuffer(NULL);
     if (g_texture) {
         SDL_DestroyTexture(g_texture);
         g_texture = NULL;
@@ -56,40 +75,99 @@ void gb_platform_shutdown(void) {
  * Audio
  * ========================================================================== */
 
-#define AUDIO_SAMPLE_RATE 44100
-#define AUDIO_BUFFER_SIZE 4096 /* Samples (stereo frames) */
-
+#define AUDIO_SAMPLE_RATE 48000 /* Requested; the device may choose another */
+#define AUDIO_BUFFER_SIZE 4096 /* Stereo frames, must be a power of two */
+#define AUDIO_BUFFER_MASK (AUDIO_BUFFER_SIZE - 1)
+#define AUDIO_TARGET_FILL 2048 /* Frames kept queued when pacing on audio */
 
+/* Single-producer (emulation thread) / single-consumer (SDL audio thread)
+ * ring. Head and tail are free-running frame counters; only the producer
+ * stores head and only the consumer stores tail. */
 static int16_t g_audio_buffer[AUDIO_BUFFER_SIZE * 2]; /* *2 for stereo */
-static int g_audio_write_pos = 0;
-static int g_audio_read_pos = 0;
+static atomic_uint g_audio_head = 0;
+static atomic_uint g_audio_tail = 0;
+
+static int g_audio_rate = 0;        /* Rate the device was opened at */
+static bool g_audio_fed = false;    /* Emulation produced audio last frame */
 
 static void sdl_audio_callback(void* userdata, Uint8* stream, int len) {
     (void)userdata;
     int16_t* output = (int16_t*)stream;
-    int samples_needed = len / sizeof(int16_t) / 2; /* Stereo frames */
+    uint32_t wanted = (uint32_t)len / sizeof(int16_t) / 2; /* Stereo frames */
     
-    for (int i = 0; i < samples_needed; i++) {
-        if (g_audio_read_pos != g_audio_write_pos) {
-            output[i*2] = g_audio_buffer[g_audio_read_pos*2];
-            output[i*2+1] = g_audio_buffer[g_audio_read_pos*2+1];
-            g_audio_read_pos = (g_audio_read_pos + 1) % AUDIO_BUFFER_SIZE;
-        } else {
-            /* Buffer underrun - silence */
-            output[i*2] = 0;
-            output[i*2+1] = 0;
-        }
-    }
+    uint32_t tail = atomic_load_explicit(&g_audio_tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&g_audio_head, memory_order_acquire);
+    uint32_t count = head - tail;
+    if (count > wanted) count = wanted;
+    
+    uint32_t start = tail & AUDIO_BUFFER_MASK;
+    uint32_t first = AUDIO_BUFFER_SIZE - start;
+    if (first > count) first = count;
+    memcpy(output, &g_audio_buffer[start * 2], first * 2 * sizeof(int16_t));
+    memcpy(output + first * 2, g_audio_buffer, (count - first) * 2 * sizeof(int16_t));
+    atomic_store_explicit(&g_audio_tail, tail + count, memory_order_release);
+    
+    /* Buffer underrun - silence */
+    memset(output + count * 2, 0, (wanted - count) * 2 * sizeof(int16_t));
 }
 
-static void on_audio_sample(GBContext* ctx, int16_t left, int16_t right) {
-    (void)ctx;
-    int next_pos = (g_audio_write_pos + 1) % AUDIO_BUFFER_SIZE;
-    if (next_pos != g_audio_read_pos) {
-        g_audio_buffer[g_audio_write_pos*2] = left;
-        g_audio_buffer[g_audio_write_pos*2+1] = right;
-        g_audio_write_pos = next_pos;
+int gb_platform_audio_queued(void) {
+    uint32_t head = atomic_load_explicit(&g_audio_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&g_audio_tail, memory_order_acquire);
+    return (int)(head - tail);
+}
+
+int gb_platform_queue_audio(const int16_t* samples, int frames) {
+    uint32_t head = atomic_load_explicit(&g_audio_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&g_audio_tail, memory_order_acquire);
+    uint32_t space = AUDIO_BUFFER_SIZE - (head - tail);
+    uint32_t count = frames < 0 ? 0 : (uint32_t)frames;
+    if (count > space) count = space;  /* Overrun - drop the newest frames */
+    
+    uint32_t start = head & AUDIO_BUFFER_MASK;
+    uint32_t first = AUDIO_BUFFER_SIZE - start;
+    if (first > count) first = count;
+    memcpy(&g_audio_buffer[start * 2], samples, first * 2 * sizeof(int16_t));
+    memcpy(g_audio_buffer, samples + first * 2, (count - first) * 2 * sizeof(int16_t));
+    atomic_store_explicit(&g_audio_head, head + count, memory_order_release);
+    return (int)count;
+}
+
+void gb_platform_pump_audio(GBContext* ctx) {
+    g_audio_fed = false;
+    if (!g_audio_device || !ctx) return;
+    if (gb_audio_get_sample_rate(ctx) != (uint32_t)g_audio_rate) {
+        gb_audio_set_sample_rate(ctx, (uint32_t)g_audio_rate);
+    }
+    
+    /* Synthesize straight into the free part of the ring, at most two spans */
+    uint32_t head = atomic_load_explicit(&g_audio_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&g_audio_tail, memory_order_acquire);
+    uint32_t space = AUDIO_BUFFER_SIZE - (head - tail);
+    uint32_t written = 0;
+    while (written < space) {
+        uint32_t start = (head + written) & AUDIO_BUFFER_MASK;
+        uint32_t span = AUDIO_BUFFER_SIZE - start;
+        if (span > space - written) span = space - written;
+        size_t got = gb_audio_read_samples(ctx, &g_audio_buffer[start * 2], span);
+        written += (uint32_t)got;
+        if (got < span) break;
     }
+    atomic_store_explicit(&g_audio_head, head + written, memory_order_release);
+    
+    /* Anything that did not fit is dropped rather than building latency */
+    gb_audio_read_samples(ctx, NULL, gb_audio_samples_available(ctx));
+    g_audio_fed = written > 0;
+}
+
+static SDL_Texture* create_screen_texture(SDL_Renderer* renderer) {
+    return SDL_CreateTexture(
+        renderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STREAMING,
+        GB_SCREEN_WIDTH,
+        GB_SCREEN_HEIGHT
+    );
 }
 
 bool gb_platform_init(int scale) {
@@ -104,18 +182,21 @@ bool gb_platform_init(int scale) {
     }
     fprintf(stderr, "[SDL] SDL initialized.\n");
     
-    /* Initialize Audio */
-    /*
+    /* Initialize Audio (optional; pacing falls back to a timer without it) */
     SDL_AudioSpec want, have;
-    ...
-    */
-    g_audio_device = 0;
-    
-    /* Register callbacks */
-    GBPlatformCallbacks callbacks = {
-        .on_audio_sample = on_audio_sample
-    };
-    gb_set_platform_callbacks(NULL, &callbacks);
+    SDL_zero(want);
+    want.freq = AUDIO_SAMPLE_RATE;
+    want.format = AUDIO_S16SYS;
+    want.channels = 2;
+    want.samples = 1024;
+    want.callback = sdl_audio_callback;
+    g_audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (g_audio_device) {
+        g_audio_rate = have.freq;
+        SDL_PauseAudioDevice(g_audio_device, 0);
+    } else {
+        fprintf(stderr, "[SDL] No audio device: %s\n", SDL_GetError());
+    }
     
     fprintf(stderr, "[SDL] Creating window...\n");
     g_window = SDL_CreateWindow(
@@ -146,13 +227,7 @@ bool gb_platform_init(int scale) {
     
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
     
-    g_texture = SDL_CreateTexture(
-        g_renderer,
-        SDL_PIXELFORMAT_ARGB8888,
-        SDL_TEXTUREACCESS_STREAMING,
-        GB_SCREEN_WIDTH,
-        GB_SCREEN_HEIGHT
-    );
+    g_texture = create_screen_texture(g_renderer);
     
     if (!g_texture) {
         SDL_DestroyRenderer(g_renderer);
@@ -166,7 +241,11 @@ bool gb_platform_init(int scale) {
     return true;
 }
 
-bool gb_platform_poll_events(GBContext* ctx) {
+/**
+ * @brief Drain the SDL event queue into the keyboard state
+ * @return false if quit requested
+ */
+static bool poll_input(void) {
     SDL_Event event;
     
     while (SDL_PollEvent(&event)) {
@@ -222,6 +301,10 @@ bool gb_platform_poll_events(GBContext* ctx) {
                         else g_joypad_buttons |= 0x08;
                         break;
                     
+                    case SDL_SCANCODE_R:
+                        g_rewind_held = pressed;
+                        break;
+                    
                     case SDL_SCANCODE_ESCAPE:
                         return false;
                         
@@ -238,13 +321,145 @@ bool gb_platform_poll_events(GBContext* ctx) {
                 break;
         }
     }
-    
+    return true;
+}
+
+static void apply_input(GBContext* ctx) {
+    ctx->joypad_buttons = atomic_load_explicit(&g_joypad_buttons, memory_order_relaxed);
+    ctx->joypad_dpad = atomic_load_explicit(&g_joypad_dpad, memory_order_relaxed);
+    ctx->rewind_held = atomic_load_explicit(&g_rewind_held, memory_order_relaxed);
+}
+
+bool gb_platform_poll_events(GBContext* ctx) {
+    if (!poll_input()) return false;
+    apply_input(ctx);
     return true;
 }
 
 static int g_frame_count = 0;
 
+/**
+ * @brief Lock the texture and point the bound context's PPU at it
+ */
+static bool lock_bound_texture(void) {
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(g_texture, NULL, &pixels, &pitch) != 0) {
+        gb_set_output_buffer(g_bound_ctx, NULL, 0);
+        g_bound_ctx = NULL;
+        return false;
+    }
+    gb_set_output_buffer(g_bound_ctx, pixels, pitch);
+    return true;
+}
+
+void gb_platform_bind_framebuffer(GBContext* ctx) {
+    if (g_bound_ctx) {
+        SDL_UnlockTexture(g_texture);
+        gb_set_output_buffer(g_bound_ctx, NULL, 0);
+        g_bound_ctx = NULL;
+    }
+    if (ctx && g_texture) {
+        g_bound_ctx = ctx;
+        lock_bound_texture();
+    }
+}
+
+/* ============================================================================
+ * Emulation Thread
+ * ========================================================================== */
+
+/**
+ * @brief Publish the finished back buffer and start drawing into a free one
+ */
+static void publish_frame(GBContext* ctx) {
+    gb_fill_output(ctx);
+    uint8_t previous = atomic_exchange_explicit(&g_frame_middle, g_frame_back | FRAME_FRESH,
+                                                memory_order_acq_rel);
+    g_frame_back = previous & 0x03;
+    SDL_SemPost(g_frame_ready);
+    gb_set_output_buffer(ctx, g_frames[g_frame_back], GB_SCREEN_WIDTH * sizeof(uint32_t));
+}
+
+/* The game loop of the generated main, publishing frames instead of
+ * presenting them, so vsync and driver stalls never block emulation */
+static int emulation_main(void* data) {
+    GBContext* ctx = (GBContext*)data;
+    while (!atomic_load_explicit(&g_emulation_quit, memory_order_acquire)) {
+        gb_run_frame(ctx);
+        gb_platform_pump_audio(ctx);
+        apply_input(ctx);
+        if (ctx->frame_done) {
+            if (gb_frame_drawn(ctx)) publish_frame(ctx);
+            gb_reset_frame(ctx);
+            ctx->stopped = 0;
+            if (!ctx->turbo) gb_platform_vsync();
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Present the newest published frame, if there is one not yet shown
+ */
+static void present_published(void) {
+    uint8_t middle = atomic_load_explicit(&g_frame_middle, memory_order_relaxed);
+    if (!(middle & FRAME_FRESH)) return;
+    middle = atomic_exchange_explicit(&g_frame_middle, g_frame_front, memory_order_acq_rel);
+    g_frame_front = middle & 0x03;
+    
+    if (++g_frame_count % 60 == 0) {
+        char title[64];
+        snprintf(title, sizeof(title), "GameBoy Recompiled - Frame %d", g_frame_count);
+        SDL_SetWindowTitle(g_window, title);
+    }
+    SDL_UpdateTexture(g_texture, NULL, g_frames[g_frame_front], GB_SCREEN_WIDTH * sizeof(uint32_t));
+    SDL_RenderClear(g_renderer);
+    SDL_RenderCopy(g_renderer, g_texture, NULL, NULL);
+    SDL_RenderPresent(g_renderer);
+}
+
+bool gb_platform_run_threaded(GBContext* ctx) {
+    if (!g_renderer || !g_texture || !ctx) return false;
+    gb_platform_bind_framebuffer(NULL);
+    
+    g_frame_ready = SDL_CreateSemaphore(0);
+    if (!g_frame_ready) return false;
+    atomic_store(&g_emulation_quit, false);
+    gb_set_output_buffer(ctx, g_frames[g_frame_back], GB_SCREEN_WIDTH * sizeof(uint32_t));
+    SDL_Thread* thread = SDL_CreateThread(emulation_main, "gb-emulation", ctx);
+    if (!thread) {
+        gb_set_output_buffer(ctx, NULL, 0);
+        SDL_DestroySemaphore(g_frame_ready);
+        g_frame_ready = NULL;
+        return false;
+    }
+    
+    /* Wake at least every few milliseconds to keep the window responsive */
+    while (poll_input()) {
+        if (SDL_SemWaitTimeout(g_frame_ready, 5) == 0) present_published();
+    }
+    
+    atomic_store_explicit(&g_emulation_quit, true, memory_order_release);
+    SDL_WaitThread(thread, NULL);
+    SDL_DestroySemaphore(g_frame_ready);
+    g_frame_ready = NULL;
+    gb_set_output_buffer(ctx, NULL, 0);
+    return true;
+}
+
 void gb_platform_render_frame(const uint32_t* framebuffer) {
+    if (g_bound_ctx && g_renderer) {
+        g_frame_count++;
+        gb_fill_output(g_bound_ctx);
+        SDL_UnlockTexture(g_texture);
+        SDL_RenderClear(g_renderer);
+        SDL_RenderCopy(g_renderer, g_texture, NULL, NULL);
+        SDL_RenderPresent(g_renderer);
+        lock_bound_texture();
+        return;
+    }
+    
     if (!g_texture || !g_renderer || !framebuffer) {
         DBG_FRAME("Platform render_frame: SKIPPED (null: texture=%d, renderer=%d, fb=%d)",
                   g_texture == NULL, g_renderer == NULL, framebuffer == NULL);
@@ -286,10 +501,19 @@ void gb_platform_render_frame(const uint32_t* framebuffer) {
 uint8_t gb_platform_get_joypad(void) {
     /* Return combined state based on P1 register selection */
     /* Caller should AND with the appropriate selection bits */
-    return g_joypad_buttons & g_joypad_dpad;
+    return atomic_load(&g_joypad_buttons) & atomic_load(&g_joypad_dpad);
 }
 
 void gb_platform_vsync(void) {
+    /* With an audio device, pace emulation on its buffer fill instead */
+    if (g_audio_device && g_audio_fed) {
+        while (gb_platform_audio_queued() > AUDIO_TARGET_FILL) {
+            SDL_Delay(1);
+        }
+        g_last_frame_time = SDL_GetTicks();
+        return;
+    }
+    
     /* Target 59.7 FPS */
     const uint32_t frame_time_ms = 16;  /* ~60 FPS */
     uint32_t current_time = SDL_GetTicks();
@@ -328,6 +552,29 @@ void gb_platform_render_frame(const uint32_t* framebuffer) {
     (void)framebuffer;
 }
 
+void gb_platform_bind_framebuffer(GBContext* ctx) {
+    (void)ctx;
+}
+
+bool gb_platform_run_threaded(GBContext* ctx) {
+    (void)ctx;
+    return false;
+}
+
+int gb_platform_queue_audio(const int16_t* samples, int frames) {
+    (void)samples;
+    (void)frames;
+    return 0;
+}
+
+int gb_platform_audio_queued(void) {
+    return 0;
+}
+
+void gb_platform_pump_audio(GBContext* ctx) {
+    (void)ctx;
+}
+
 uint8_t gb_platform_get_joypad(void) {
     return 0xFF;
 }
@@ -20,12 +20,32 @@ static const uint32_t dmg_palette[4] = {
     0xFF081820,  /* Darkest (black) */
 };
 
+/**
+ * @brief Convert an ARGB8888 color to RGB565
+ */
+static uint16_t argb_to_rgb565(uint32_t argb) {
+    uint8_t r = (argb >> 16) & 0xFF;
+    uint8_t g = (argb >> 8) & 0xFF;
+    uint8_t b = argb & 0xFF;
+    return (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+/**
+ * @brief Expand a palette register into its 4-entry shade table
+ */
+static void update_palette(uint8_t table[4], uint8_t palette) {
+    for (int i = 0; i < 4; i++) {
+        table[i] = (palette >> (i * 2)) & 0x03;
+    }
+}
+
 /* ============================================================================
  * PPU Initialization
  * ========================================================================== */
 
 void ppu_init(GBPPU* ppu) {
     memset(ppu, 0, sizeof(GBPPU));
+    ppu->out_pixels = ppu->rgb_framebuffer;
     ppu_reset(ppu);
     DBG_PPU("PPU initialized");
 }
@@ -44,6 +64,11 @@ void ppu_reset(GBPPU* ppu) {
     ppu->obp1 = 0xFF;
     ppu->wy = 0;
     ppu->wx = 0;
+    update_palette(ppu->bg_palette, ppu->bgp);
+    update_palette(ppu->obj_palette[0], ppu->obp0);
+    update_palette(ppu->obj_palette[1], ppu->obp1);
+    ppu_invalidate_tiles(ppu);
+    ppu->oam_dirty = true;
     
     /* Internal state */
     ppu->mode = PPU_MODE_OAM;
@@ -52,11 +77,9 @@ void ppu_reset(GBPPU* ppu) {
     ppu->window_triggered = false;
     ppu->frame_ready = false;
     
-    /* Clear framebuffers */
+    /* Clear framebuffers (the pixel format survives a reset) */
     memset(ppu->framebuffer, 0, sizeof(ppu->framebuffer));
-    for (int i = 0; i < GB_FRAMEBUFFER_SIZE; i++) {
-        ppu->rgb_framebuffer[i] = dmg_palette[0];
-    }
+    ppu_set_pixel_format(ppu, (GBPixelFormat)ppu->pixel_format);
     
     DBG_PPU("PPU reset - LCDC=0x%02X, BGP=0x%02X, mode=%s", 
             ppu->lcdc, ppu->bgp, ppu_mode_name(ppu->mode));
@@ -67,15 +90,15 @@ void ppu_reset(GBPPU* ppu) {
  * ========================================================================== */
 
 /**
- * @brief Get tile data address for a tile index
+ * @brief Get the tile cache index (0-383) for a tile number
  */
-static uint16_t get_tile_data_addr(GBPPU* ppu, uint8_t tile_idx, bool is_obj) {
+static uint16_t get_tile_index(GBPPU* ppu, uint8_t tile_idx, bool is_obj) {
     if (is_obj || (ppu->lcdc & LCDC_TILE_DATA)) {
         /* 8000 addressing mode - unsigned indexing */
-        return 0x8000 + (tile_idx * 16);
+        return tile_idx;
     } else {
         /* 8800 addressing mode - signed indexing from 0x9000 */
-        return 0x9000 + ((int8_t)tile_idx * 16);
+        return 256 + (int8_t)tile_idx;
     }
 }
 
@@ -90,36 +113,134 @@ static uint16_t get_window_tilemap_addr(GBPPU* ppu) {
     return (ppu->lcdc & LCDC_WINDOW_TILEMAP) ? 0x9C00 : 0x9800;
 }
 
+/* ============================================================================
+ * Decoded Tile Cache
+ * ========================================================================== */
+
+/**
+ * @brief Spread the 8 bits of a tile bitplane byte into the even bits of a word
+ *
+ * Bit n of the input lands in bit 2n, so a full tile row is
+ * tile_interleave[lo] | (tile_interleave[hi] << 1) with the leftmost pixel in
+ * bits 14-15.
+ */
+#define TI_SPREAD(b) ((((b) & 0x01) << 0) | (((b) & 0x02) << 1) | \
+                      (((b) & 0x04) << 2) | (((b) & 0x08) << 3) | \
+                      (((b) & 0x10) << 4) | (((b) & 0x20) << 5) | \
+                      (((b) & 0x40) << 6) | (((b) & 0x80) << 7))
+#define TI_ROW4(n)  TI_SPREAD(n), TI_SPREAD((n) + 1), TI_SPREAD((n) + 2), TI_SPREAD((n) + 3)
+#define TI_ROW16(n) TI_ROW4(n), TI_ROW4((n) + 4), TI_ROW4((n) + 8), TI_ROW4((n) + 12)
+#define TI_ROW64(n) TI_ROW16(n), TI_ROW16((n) + 16), TI_ROW16((n) + 32), TI_ROW16((n) + 48)
+
+static const uint16_t tile_interleave[256] = {
+    TI_ROW64(0), TI_ROW64(64), TI_ROW64(128), TI_ROW64(192)
+};
+
+/**
+ * @brief Re-decode all 8 rows of a dirty tile, in both X orientations
+ */
+static void refresh_tile(GBPPU* ppu, const GBContext* ctx, uint16_t tile) {
+    const uint8_t* data = ctx->vram + (tile / TILES_PER_BANK) * VRAM_SIZE
+                        + (tile % TILES_PER_BANK) * TILE_SIZE;
+    for (int row = 0; row < 8; row++) {
+        uint16_t bits = tile_interleave[data[row * 2]]
+                      | (uint16_t)(tile_interleave[data[row * 2 + 1]] << 1);
+        uint8_t* out = ppu->tile_cache[tile][row];
+        uint8_t* flip = ppu->tile_cache_flip[tile][row];
+        for (int px = 0; px < 8; px++) {
+            uint8_t color = (bits >> (14 - px * 2)) & 0x03;
+            out[px] = color;
+            flip[7 - px] = color;
+        }
+    }
+    ppu->tile_dirty[tile / 32] &= ~(1u << (tile % 32));
+}
+
 /**
- * @brief Read a byte from VRAM
+ * @brief Get one decoded row of a tile, refreshing it first if VRAM changed
  */
-static uint8_t vram_read(GBContext* ctx, uint16_t addr) {
-    if (addr >= 0x8000 && addr <= 0x9FFF) {
-        return ctx->vram[addr - 0x8000];
+static inline const uint8_t* get_tile_row(GBPPU* ppu, const GBContext* ctx,
+                                          uint16_t tile, uint8_t row, bool flip_x) {
+    if (ppu->tile_dirty[tile / 32] & (1u << (tile % 32))) {
+        refresh_tile(ppu, ctx, tile);
+    }
+    return flip_x ? ppu->tile_cache_flip[tile][row] : ppu->tile_cache[tile][row];
+}
+
+void ppu_vram_write(GBPPU* ppu, GBContext* ctx, uint16_t addr, uint8_t value) {
+    uint16_t offset = addr - 0x8000;
+    uint8_t* cell = ctx->vram + ctx->vram_bank * VRAM_SIZE + offset;
+    if (*cell == value) return;
+    *cell = value;
+    
+    /* Tile data occupies 0x8000-0x97FF; the tilemaps above it are read raw */
+    if (offset < TILES_PER_BANK * TILE_SIZE) {
+        uint16_t tile = ctx->vram_bank * TILES_PER_BANK + offset / TILE_SIZE;
+        ppu->tile_dirty[tile / 32] |= 1u << (tile % 32);
+    }
+}
+
+void ppu_invalidate_tiles(GBPPU* ppu) {
+    memset(ppu->tile_dirty, 0xFF, sizeof(ppu->tile_dirty));
+}
+
+void ppu_invalidate_vram(GBPPU* ppu, uint32_t offset, uint32_t size) {
+    for (uint32_t end = offset + size; offset < end; offset += TILE_SIZE) {
+        uint32_t bank = offset / VRAM_SIZE, cell = offset % VRAM_SIZE;
+        if (cell >= TILES_PER_BANK * TILE_SIZE) continue;
+        uint32_t tile = bank * TILES_PER_BANK + cell / TILE_SIZE;
+        ppu->tile_dirty[tile / 32] |= 1u << (tile % 32);
     }
-    return 0xFF;
 }
 
+
 /* ============================================================================
  * Scanline Rendering
  * ========================================================================== */
 
 /**
- * @brief Apply palette to a 2-bit color value
+ * @brief Decode screen pixels [x0, x1) of one tilemap line into raw color indices
+ *
+ * @param src_x Tilemap X coordinate of the pixel at x0 (wraps at 256)
+ * @param src_y Tilemap Y coordinate of the line
  */
-static uint8_t apply_palette(uint8_t color, uint8_t palette) {
-    return (palette >> (color * 2)) & 0x03;
+static void render_tile_span(GBPPU* ppu, GBContext* ctx, uint8_t* line,
+                             int x0, int x1, uint16_t tilemap_addr,
+                             int src_x, uint8_t src_y) {
+    const uint8_t* map_row = ctx->vram + (tilemap_addr - 0x8000) + (src_y / 8) * 32;
+    uint8_t row = src_y % 8;
+    
+    int x = x0;
+    while (x < x1) {
+        uint8_t tile_idx = map_row[(src_x / 8) & 31];
+        const uint8_t* pixels = get_tile_row(ppu, ctx, get_tile_index(ppu, tile_idx, false), row, false);
+        
+        int first = src_x % 8;
+        int count = 8 - first;
+        if (count > x1 - x) count = x1 - x;
+        memcpy(line + x, pixels + first, count);
+        
+        x += count;
+        src_x += count;
+    }
 }
 
 /**
  * @brief Render background/window for current scanline
+ *
+ * The background and window are decoded as two separate runs of whole tile
+ * rows into ppu->bg_line (raw color indices, kept for sprite priority), then
+ * mapped through the BGP table in one pass.
  */
 static void render_bg_scanline(GBPPU* ppu, GBContext* ctx) {
     uint8_t scanline = ppu->ly;
+    uint8_t* out = &ppu->framebuffer[scanline * GB_SCREEN_WIDTH];
+    uint8_t* line = ppu->bg_line;
     
     if (!(ppu->lcdc & LCDC_LCD_ENABLE)) {
         /* LCD disabled - blank line */
-        memset(&ppu->framebuffer[scanline * GB_SCREEN_WIDTH], 0, GB_SCREEN_WIDTH);
+        memset(out, 0, GB_SCREEN_WIDTH);
+        memset(line, 0, GB_SCREEN_WIDTH);
         return;
     }
     
@@ -131,58 +252,31 @@ static void render_bg_scanline(GBPPU* ppu, GBContext* ctx) {
         ppu->window_triggered = true;
     }
     
-    for (int x = 0; x < GB_SCREEN_WIDTH; x++) {
-        uint8_t color = 0;
-        
-        /* Check if we're in window area */
-        bool in_window = window_enable && (x >= (ppu->wx - 7));
-        
-        if (in_window) {
-            /* Render window */
-            int win_x = x - (ppu->wx - 7);
-            int win_y = ppu->window_line;
-            
-            /* Get tile from window tilemap */
-            uint16_t tilemap_addr = get_window_tilemap_addr(ppu);
-            uint8_t tile_x = win_x / 8;
-            uint8_t tile_y = win_y / 8;
-            uint8_t tile_idx = vram_read(ctx, tilemap_addr + tile_y * 32 + tile_x);
-            
-            /* Get pixel from tile */
-            uint16_t tile_addr = get_tile_data_addr(ppu, tile_idx, false);
-            uint8_t pixel_y = win_y % 8;
-            uint8_t pixel_x = win_x % 8;
-            
-            uint8_t lo = vram_read(ctx, tile_addr + pixel_y * 2);
-            uint8_t hi = vram_read(ctx, tile_addr + pixel_y * 2 + 1);
-            
-            uint8_t bit = 7 - pixel_x;
-            color = ((lo >> bit) & 1) | (((hi >> bit) & 1) << 1);
-        } else if (bg_enable) {
-            /* Render background */
-            int bg_x = (x + ppu->scx) & 0xFF;
-            int bg_y = (scanline + ppu->scy) & 0xFF;
-            
-            /* Get tile from background tilemap */
-            uint16_t tilemap_addr = get_bg_tilemap_addr(ppu);
-            uint8_t tile_x = bg_x / 8;
-            uint8_t tile_y = bg_y / 8;
-            uint8_t tile_idx = vram_read(ctx, tilemap_addr + tile_y * 32 + tile_x);
-            
-            /* Get pixel from tile */
-            uint16_t tile_addr = get_tile_data_addr(ppu, tile_idx, false);
-            uint8_t pixel_y = bg_y % 8;
-            uint8_t pixel_x = bg_x % 8;
-            
-            uint8_t lo = vram_read(ctx, tile_addr + pixel_y * 2);
-            uint8_t hi = vram_read(ctx, tile_addr + pixel_y * 2 + 1);
-            
-            uint8_t bit = 7 - pixel_x;
-            color = ((lo >> bit) & 1) | (((hi >> bit) & 1) << 1);
+    /* First screen column covered by the window */
+    int win_start = GB_SCREEN_WIDTH;
+    if (window_enable) {
+        win_start = ppu->wx - 7;
+        if (win_start < 0) win_start = 0;
+    }
+    
+    if (win_start > 0) {
+        if (bg_enable) {
+            render_tile_span(ppu, ctx, line, 0, win_start, get_bg_tilemap_addr(ppu),
+                             ppu->scx, (uint8_t)(scanline + ppu->scy));
+        } else {
+            memset(line, 0, win_start);
         }
-        
-        /* Apply palette and store */
-        ppu->framebuffer[scanline * GB_SCREEN_WIDTH + x] = apply_palette(color, ppu->bgp);
+    }
+    
+    if (win_start < GB_SCREEN_WIDTH) {
+        render_tile_span(ppu, ctx, line, win_start, GB_SCREEN_WIDTH, get_window_tilemap_addr(ppu),
+                         win_start - (ppu->wx - 7), ppu->window_line);
+    }
+    
+    /* Apply palette and store */
+    const uint8_t* pal = ppu->bg_palette;
+    for (int x = 0; x < GB_SCREEN_WIDTH; x++) {
+        out[x] = pal[line[x]];
     }
     
     /* Increment window line counter if window was used */
@@ -191,8 +285,47 @@ static void render_bg_scanline(GBPPU* ppu, GBContext* ctx) {
     }
 }
 
+/**
+ * @brief Rebuild the per-line sprite buckets from OAM
+ *
+ * Each visible line gets the first 10 OAM entries covering it, ordered by
+ * DMG drawing priority: lower X first, ties broken by lower OAM index.
+ */
+static void build_sprite_lines(GBPPU* ppu, const GBContext* ctx, uint8_t sprite_height) {
+    memset(ppu->line_sprite_count, 0, sizeof(ppu->line_sprite_count));
+    
+    for (int i = 0; i < 40; i++) {
+        const OAMEntry* sprite = (const OAMEntry*)(ctx->oam + i * 4);
+        int top = sprite->y - 16;
+        int first = top < 0 ? 0 : top;
+        int last = top + sprite_height;
+        if (last > GB_SCREEN_HEIGHT) last = GB_SCREEN_HEIGHT;
+        
+        for (int line = first; line < last; line++) {
+            uint8_t count = ppu->line_sprite_count[line];
+            if (count == PPU_MAX_LINE_SPRITES) continue;
+            
+            /* Insert after every entry with X <= ours (earlier OAM index wins ties) */
+            uint8_t* bucket = ppu->line_sprites[line];
+            int pos = count;
+            while (pos > 0 && ((const OAMEntry*)(ctx->oam + bucket[pos - 1] * 4))->x > sprite->x) {
+                bucket[pos] = bucket[pos - 1];
+                pos--;
+            }
+            bucket[pos] = (uint8_t)i;
+            ppu->line_sprite_count[line] = count + 1;
+        }
+    }
+    
+    ppu->sprite_lines_height = sprite_height;
+    ppu->oam_dirty = false;
+}
+
 /**
  * @brief Render sprites for current scanline
+ *
+ * Sprites are visited from highest to lowest priority; the first opaque pixel
+ * at a column claims it, and only then is its behind-BG flag applied.
  */
 static void render_sprites_scanline(GBPPU* ppu, GBContext* ctx) {
     if (!(ppu->lcdc & LCDC_OBJ_ENABLE)) {
@@ -202,22 +335,19 @@ static void render_sprites_scanline(GBPPU* ppu, GBContext* ctx) {
     uint8_t scanline = ppu->ly;
     uint8_t sprite_height = (ppu->lcdc & LCDC_OBJ_SIZE) ? 16 : 8;
     
-    /* Find sprites on this scanline (max 10) */
-    int sprite_count = 0;
-    int sprites[10];
-    
-    for (int i = 0; i < 40 && sprite_count < 10; i++) {
-        OAMEntry* sprite = (OAMEntry*)(ctx->oam + i * 4);
-        int sprite_y = sprite->y - 16;
-        
-        if (scanline >= sprite_y && scanline < sprite_y + sprite_height) {
-            sprites[sprite_count++] = i;
-        }
+    if (ppu->oam_dirty || ppu->sprite_lines_height != sprite_height) {
+        build_sprite_lines(ppu, ctx, sprite_height);
     }
     
-    /* Render sprites in reverse order (priority - lower index = higher priority) */
-    for (int i = sprite_count - 1; i >= 0; i--) {
-        OAMEntry* sprite = (OAMEntry*)(ctx->oam + sprites[i] * 4);
+    uint8_t count = ppu->line_sprite_count[scanline];
+    if (count == 0) return;
+    
+    uint8_t* out = &ppu->framebuffer[scanline * GB_SCREEN_WIDTH];
+    bool claimed[GB_SCREEN_WIDTH];
+    memset(claimed, 0, sizeof(claimed));
+    
+    for (int i = 0; i < count; i++) {
+        const OAMEntry* sprite = (const OAMEntry*)(ctx->oam + ppu->line_sprites[scanline][i] * 4);
         int sprite_y = sprite->y - 16;
         int sprite_x = sprite->x - 8;
         
@@ -231,35 +361,111 @@ static void render_sprites_scanline(GBPPU* ppu, GBContext* ctx) {
             line = sprite_height - 1 - line;
         }
         
-        uint16_t tile_addr = 0x8000 + tile_idx * 16 + line * 2;
-        uint8_t lo = vram_read(ctx, tile_addr);
-        uint8_t hi = vram_read(ctx, tile_addr + 1);
+        const uint8_t* pixels = get_tile_row(ppu, ctx, get_tile_index(ppu, tile_idx + line / 8, true),
+                                             line % 8, sprite->flags & OAM_FLIP_X);
         
-        uint8_t palette = (sprite->flags & OAM_PALETTE) ? ppu->obp1 : ppu->obp0;
+        const uint8_t* palette = ppu->obj_palette[(sprite->flags & OAM_PALETTE) ? 1 : 0];
         bool behind_bg = (sprite->flags & OAM_PRIORITY);
         
         for (int px = 0; px < 8; px++) {
             int screen_x = sprite_x + px;
             if (screen_x < 0 || screen_x >= GB_SCREEN_WIDTH) continue;
             
-            int bit_pos = (sprite->flags & OAM_FLIP_X) ? px : (7 - px);
-            uint8_t color = ((lo >> bit_pos) & 1) | (((hi >> bit_pos) & 1) << 1);
+            uint8_t color = pixels[px];
+            if (color == 0 || claimed[screen_x]) continue;  /* Color 0 is transparent */
+            claimed[screen_x] = true;
             
-            if (color == 0) continue;  /* Color 0 is transparent */
+            /* Check priority (against the raw BG color, not the shade) */
+            if (behind_bg && ppu->bg_line[screen_x] != 0) continue;
             
-            /* Check priority */
-            uint8_t bg_color = ppu->framebuffer[scanline * GB_SCREEN_WIDTH + screen_x];
-            if (behind_bg && bg_color != 0) continue;
-            
-            ppu->framebuffer[scanline * GB_SCREEN_WIDTH + screen_x] = apply_palette(color, palette);
+            out[screen_x] = palette[color];
+        }
+    }
+}
+
+/**
+ * @brief Write shade indices [first_line, last_line) out in the selected pixel format
+ */
+static void output_lines(GBPPU* ppu, int first_line, int last_line) {
+    size_t pitch = ppu->out_pitch;
+    if (pitch == 0) {
+        pitch = GB_SCREEN_WIDTH * (ppu->pixel_format == GB_PIXEL_RGB565 ? 2 : 4);
+    }
+    
+    for (int y = first_line; y < last_line; y++) {
+        const uint8_t* shades = &ppu->framebuffer[y * GB_SCREEN_WIDTH];
+        uint8_t* row = (uint8_t*)ppu->out_pixels + y * pitch;
+        if (!ppu->out_written[y]) {
+            ppu->out_written[y] = true;
+            ppu->out_written_count++;
+        }
+        
+        switch ((GBPixelFormat)ppu->pixel_format) {
+            case GB_PIXEL_ARGB8888: {
+                uint32_t* out = (uint32_t*)row;
+                for (int x = 0; x < GB_SCREEN_WIDTH; x++) out[x] = ppu->shade_colors[shades[x]];
+                break;
+            }
+            case GB_PIXEL_RGB565: {
+                uint16_t* out = (uint16_t*)row;
+                for (int x = 0; x < GB_SCREEN_WIDTH; x++) out[x] = (uint16_t)ppu->shade_colors[shades[x]];
+                break;
+            }
+            case GB_PIXEL_INDEX:
+                return;
         }
     }
 }
 
+/* ============================================================================
+ * Change Tracking
+ * ========================================================================== */
+
+/**
+ * @brief FNV-1a over one line of shades, a word at a time
+ */
+static uint64_t hash_line(const uint8_t* line) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (int x = 0; x < GB_SCREEN_WIDTH; x += 8) {
+        uint64_t word;
+        memcpy(&word, line + x, 8);
+        hash = (hash ^ word) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief Compare two lines of shades
+ *
+ * Written as one OR over the XORed words, without early exit, so the
+ * compiler turns it into a few vector compares.
+ */
+static bool lines_equal(const uint8_t* a, const uint8_t* b) {
+    uint64_t diff = 0;
+    for (int x = 0; x < GB_SCREEN_WIDTH; x += 8) {
+        uint64_t wa, wb;
+        memcpy(&wa, a + x, 8);
+        memcpy(&wb, b + x, 8);
+        diff |= wa ^ wb;
+    }
+    return diff == 0;
+}
+
 void ppu_render_scanline(GBPPU* ppu, GBContext* ctx) {
+    uint8_t* line = &ppu->framebuffer[ppu->ly * GB_SCREEN_WIDTH];
+    uint8_t before[GB_SCREEN_WIDTH];
+    memcpy(before, line, GB_SCREEN_WIDTH);
+    
     render_bg_scanline(ppu, ctx);
     render_sprites_scanline(ppu, ctx);
+    output_lines(ppu, ppu->ly, ppu->ly + 1);
     
+    if (!lines_equal(before, line)) {
+        ppu->line_hash[ppu->ly] = hash_line(line);
+        ppu->line_changed[ppu->ly] = true;
+    }
+    
+#ifdef GB_DEBUG_PPU
     /* Debug: log first scanline render details */
     if (ppu->ly == 0) {
         DBG_PPU("Rendered scanline 0 - LCDC=0x%02X, BGP=0x%02X, SCX=%d, SCY=%d",
@@ -271,25 +477,7 @@ void ppu_render_scanline(GBPPU* ppu, GBContext* ctx) {
             dbg_dump_tilemap(ctx->vram, 0x1800, 16);  /* BG tilemap at 0x9800 */
         }
     }
-}
-
-/**
- * @brief Convert framebuffer to RGB
- */
-static void convert_to_rgb(GBPPU* ppu) {
-    /* Debug: check if framebuffer has any non-zero pixels */
-    static int convert_count = 0;
-    bool has_content = dbg_has_nonzero_pixels(ppu->framebuffer, GB_FRAMEBUFFER_SIZE);
-    
-    for (int i = 0; i < GB_FRAMEBUFFER_SIZE; i++) {
-        ppu->rgb_framebuffer[i] = dmg_palette[ppu->framebuffer[i] & 0x03];
-    }
-    
-    convert_count++;
-    if (convert_count <= 5 || (convert_count % 60 == 0)) {
-        DBG_FRAME("Frame %d converted to RGB - has_content=%d", convert_count, has_content);
-        dbg_dump_framebuffer(ppu->framebuffer, GB_SCREEN_WIDTH);
-    }
+#endif
 }
 
 /* ============================================================================
@@ -339,6 +527,18 @@ static void check_stat_interrupt(GBPPU* ppu, GBContext* ctx) {
     }
 }
 
+/**
+ * @brief Decide whether the frame starting now is drawn
+ */
+static void begin_frame(GBPPU* ppu, GBContext* ctx) {
+    if (ctx->frame_skip > 1) {
+        ppu->skip_render = ctx->skip_counter != 0;
+        ctx->skip_counter = (uint8_t)((ctx->skip_counter + 1) % ctx->frame_skip);
+    } else {
+        ppu->skip_render = false;
+    }
+}
+
 void ppu_tick(GBPPU* ppu, GBContext* ctx, uint32_t cycles) {
     if (!(ppu->lcdc & LCDC_LCD_ENABLE)) {
         return;  /* LCD disabled */
@@ -346,30 +546,30 @@ void ppu_tick(GBPPU* ppu, GBContext* ctx, uint32_t cycles) {
     
     ppu->mode_cycles += cycles;
     
-    switch (ppu->mode) {
-        case PPU_MODE_OAM:
-            if (ppu->mode_cycles >= CYCLES_OAM_SCAN) {
+    /* A single call may cover several transitions when catching up */
+    for (;;) {
+        switch (ppu->mode) {
+            case PPU_MODE_OAM:
+                if (ppu->mode_cycles < CYCLES_OAM_SCAN) return;
                 ppu->mode_cycles -= CYCLES_OAM_SCAN;
                 ppu->mode = PPU_MODE_DRAW;
                 update_stat(ppu, ctx);
-            }
-            break;
-            
-        case PPU_MODE_DRAW:
-            if (ppu->mode_cycles >= CYCLES_PIXEL_DRAW) {
+                break;
+                
+            case PPU_MODE_DRAW:
+                if (ppu->mode_cycles < CYCLES_PIXEL_DRAW) return;
                 ppu->mode_cycles -= CYCLES_PIXEL_DRAW;
                 
                 /* Render the scanline */
-                ppu_render_scanline(ppu, ctx);
+                if (!ppu->skip_render) ppu_render_scanline(ppu, ctx);
                 
                 ppu->mode = PPU_MODE_HBLANK;
                 update_stat(ppu, ctx);
                 check_stat_interrupt(ppu, ctx);
-            }
-            break;
-            
-        case PPU_MODE_HBLANK:
-            if (ppu->mode_cycles >= CYCLES_HBLANK) {
+                break;
+                
+            case PPU_MODE_HBLANK:
+                if (ppu->mode_cycles < CYCLES_HBLANK) return;
                 ppu->mode_cycles -= CYCLES_HBLANK;
                 ppu->ly++;
                 
@@ -377,9 +577,13 @@ void ppu_tick(GBPPU* ppu, GBContext* ctx, uint32_t cycles) {
                     /* Enter VBlank */
                     ppu->mode = PPU_MODE_VBLANK;
                     
-                    /* Convert framebuffer to RGB - only if not already ready */
                     if (!ppu->frame_ready) {
-                        convert_to_rgb(ppu);
+#ifdef GB_DEBUG_FRAME
+                        if (!ppu->skip_render) {
+                            DBG_FRAME("Frame done - has_content=%d",
+                                      dbg_has_nonzero_pixels(ppu->framebuffer, GB_FRAMEBUFFER_SIZE));
+                        }
+#endif
                         ppu->frame_ready = true;
                         ctx->frame_done = 1;
                     }
@@ -392,11 +596,10 @@ void ppu_tick(GBPPU* ppu, GBContext* ctx, uint32_t cycles) {
                 
                 update_stat(ppu, ctx);
                 check_stat_interrupt(ppu, ctx);
-            }
-            break;
-            
-        case PPU_MODE_VBLANK:
-            if (ppu->mode_cycles >= CYCLES_SCANLINE) {
+                break;
+                
+            case PPU_MODE_VBLANK:
+                if (ppu->mode_cycles < CYCLES_SCANLINE) return;
                 ppu->mode_cycles -= CYCLES_SCANLINE;
                 ppu->ly++;
                 
@@ -406,13 +609,62 @@ void ppu_tick(GBPPU* ppu, GBContext* ctx, uint32_t cycles) {
                     ppu->window_line = 0;
                     ppu->window_triggered = false;
                     ppu->mode = PPU_MODE_OAM;
+                    begin_frame(ppu, ctx);
                 }
                 
                 update_stat(ppu, ctx);
                 check_stat_interrupt(ppu, ctx);
-            }
-            break;
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Whether the PPU can run without an event at every mode change
+ *
+ * With no STAT interrupt source enabled, the only interrupt the PPU raises is
+ * VBlank. Everything else it does is observed through LY/STAT reads and
+ * VRAM/OAM/register writes, all of which sync it first, so it can be caught
+ * up a frame at a time.
+ */
+static bool ppu_can_skip_modes(const GBPPU* ppu) {
+    return (ppu->stat & (STAT_HBLANK_INT | STAT_VBLANK_INT | STAT_OAM_INT | STAT_LYC_INT)) == 0;
+}
+
+/**
+ * @brief Cycles elapsed since the start of the current frame
+ */
+static uint32_t ppu_frame_position(const GBPPU* ppu) {
+    uint32_t line_pos = ppu->mode_cycles;
+    if (ppu->mode == PPU_MODE_DRAW) line_pos += CYCLES_OAM_SCAN;
+    else if (ppu->mode == PPU_MODE_HBLANK) line_pos += CYCLES_OAM_SCAN + CYCLES_PIXEL_DRAW;
+    return ppu->ly * CYCLES_SCANLINE + line_pos;
+}
+
+uint32_t ppu_cycles_until_ly_change(const GBPPU* ppu) {
+    if (!(ppu->lcdc & LCDC_LCD_ENABLE)) return 0;
+    return CYCLES_SCANLINE - ppu_frame_position(ppu) % CYCLES_SCANLINE;
+}
+
+uint32_t ppu_cycles_until_event(const GBPPU* ppu) {
+    if (!(ppu->lcdc & LCDC_LCD_ENABLE)) return 0;
+    
+    if (ppu_can_skip_modes(ppu)) {
+        /* Next VBlank entry */
+        const uint32_t vblank_pos = VISIBLE_SCANLINES * CYCLES_SCANLINE;
+        uint32_t pos = ppu_frame_position(ppu);
+        if (pos < vblank_pos) return vblank_pos - pos;
+        return TOTAL_SCANLINES * CYCLES_SCANLINE - pos + vblank_pos;
     }
+    
+    uint32_t length;
+    switch (ppu->mode) {
+        case PPU_MODE_OAM:    length = CYCLES_OAM_SCAN; break;
+        case PPU_MODE_DRAW:   length = CYCLES_PIXEL_DRAW; break;
+        case PPU_MODE_HBLANK: length = CYCLES_HBLANK; break;
+        default:              length = CYCLES_SCANLINE; break;
+    }
+    return ppu->mode_cycles < length ? length - ppu->mode_cycles : 1;
 }
 
 /* ============================================================================
@@ -438,14 +690,15 @@ uint8_t ppu_read_register(GBPPU* ppu, uint16_t addr) {
 }
 
 void ppu_write_register(GBPPU* ppu, GBContext* ctx, uint16_t addr, uint8_t value) {
-    static int ppu_write_count = 0;
-    ppu_write_count++;
+#ifdef GB_DEBUG_REGS
+    ctx->debug_ppu_writes++;
     
     /* Only log first 100 and special values */
-    if (ppu_write_count <= 100 || (addr == 0xFF40 && (value == 0x91 || value == 0x00))) {
-        DBG_REGS("PPU write #%d: addr=0x%04X value=0x%02X (A=0x%02X)", 
-                 ppu_write_count, addr, value, ctx->a);
+    if (ctx->debug_ppu_writes <= 100 || (addr == 0xFF40 && (value == 0x91 || value == 0x00))) {
+        DBG_REGS("PPU write #%u: addr=0x%04X value=0x%02X (A=0x%02X)", 
+                 ctx->debug_ppu_writes, addr, value, ctx->a);
     }
+#endif
     
     switch (addr) {
         case 0xFF40:
@@ -483,19 +736,34 @@ void ppu_write_register(GBPPU* ppu, GBContext* ctx, uint16_t addr, uint8_t value
             /* OAM DMA transfer */
             DBG_REGS("DMA transfer from 0x%04X", (uint16_t)(value << 8));
             ppu->dma = value;
+            ppu->dma_active = true;
             {
-                uint16_t src = value << 8;
-                for (int i = 0; i < OAM_SIZE; i++) {
-                    ctx->oam[i] = gb_read8(ctx, src + i);
+                /* The source is page aligned, so a mapped page copies in one go */
+                const uint8_t* page = ctx->read_map[value];
+                if (page) {
+                    memcpy(ctx->oam, page, OAM_SIZE);
+                } else {
+                    uint16_t src = value << 8;
+                    for (int i = 0; i < OAM_SIZE; i++) {
+                        ctx->oam[i] = gb_read8(ctx, src + i);
+                    }
                 }
+                ppu->oam_dirty = true;
             }
             break;
         case 0xFF47: 
             DBG_REGS("BGP palette: 0x%02X -> 0x%02X", ppu->bgp, value);
             ppu->bgp = value; 
+            update_palette(ppu->bg_palette, value);
+            break;
+        case 0xFF48:
+            ppu->obp0 = value;
+            update_palette(ppu->obj_palette[0], value);
+            break;
+        case 0xFF49:
+            ppu->obp1 = value;
+            update_palette(ppu->obj_palette[1], value);
             break;
-        case 0xFF48: ppu->obp0 = value; break;
-        case 0xFF49: ppu->obp1 = value; break;
         case 0xFF4A: ppu->wy = value; break;
         case 0xFF4B: ppu->wx = value; break;
     }
@@ -509,11 +777,76 @@ bool ppu_frame_ready(GBPPU* ppu) {
     return ppu->frame_ready;
 }
 
-static int clear_debug = 0;
 void ppu_clear_frame_ready(GBPPU* ppu) {
     ppu->frame_ready = false;
 }
 
 const uint32_t* ppu_get_framebuffer(GBPPU* ppu) {
+    if (ppu->pixel_format != GB_PIXEL_ARGB8888 || ppu->out_pixels != ppu->rgb_framebuffer) return NULL;
     return ppu->rgb_framebuffer;
 }
+
+const void* ppu_get_pixels(GBPPU* ppu) {
+    return ppu->pixel_format == GB_PIXEL_INDEX ? NULL : ppu->out_pixels;
+}
+
+void ppu_set_output_buffer(GBPPU* ppu, void* pixels, int pitch) {
+    if (pixels) {
+        ppu->out_pixels = pixels;
+        ppu->out_pitch = pitch;
+    } else {
+        ppu->out_pixels = ppu->rgb_framebuffer;
+        ppu->out_pitch = 0;
+    }
+    memset(ppu->out_written, 0, sizeof(ppu->out_written));
+    ppu->out_written_count = 0;
+}
+
+void ppu_fill_output(GBPPU* ppu) {
+    if (ppu->out_written_count == GB_SCREEN_HEIGHT) return;
+    for (int y = 0; y < GB_SCREEN_HEIGHT; y++) {
+        if (!ppu->out_written[y]) output_lines(ppu, y, y + 1);
+    }
+}
+
+const uint8_t* ppu_get_shades(GBPPU* ppu) {
+    return ppu->framebuffer;
+}
+
+void ppu_set_pixel_format(GBPPU* ppu, GBPixelFormat format) {
+    ppu->pixel_format = (uint8_t)format;
+    for (int i = 0; i < 4; i++) {
+        ppu->shade_colors[i] = (format == GB_PIXEL_RGB565) ? argb_to_rgb565(dmg_palette[i]) : dmg_palette[i];
+    }
+    ppu_redraw(ppu);
+}
+
+void ppu_redraw(GBPPU* ppu) {
+    for (int y = 0; y < GB_SCREEN_HEIGHT; y++) {
+        ppu->line_hash[y] = hash_line(&ppu->framebuffer[y * GB_SCREEN_WIDTH]);
+        ppu->line_changed[y] = true;
+    }
+    output_lines(ppu, 0, GB_SCREEN_HEIGHT);
+}
+
+bool ppu_take_frame_delta(GBPPU* ppu, GBFrameDelta* delta) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    delta->changed = 0;
+    delta->range_count = 0;
+    for (int y = 0; y < GB_SCREEN_HEIGHT; y++) {
+        hash = (hash ^ ppu->line_hash[y]) * 0x100000001B3ull;
+        if (!ppu->line_changed[y]) continue;
+        ppu->line_changed[y] = false;
+        delta->changed++;
+        uint8_t n = delta->range_count;
+        if (n > 0 && delta->ranges[n - 1].first + delta->ranges[n - 1].count == y) {
+            delta->ranges[n - 1].count++;
+        } else {
+            delta->ranges[n].first = (uint8_t)y;
+            delta->ranges[n].count = 1;
+            delta->range_count++;
+        }
+    }
+    delta->hash = hash;
+    return delta->changed != 0;
+}
@@ -0,0 +1,267 @@
+/**
+ * @file rewind.c
+ * @brief Rewind ring of XOR-delta, run-length encoded snapshots
+ */
+
+#include "rewind.h"
+#include "state.h"
+#include "ppu.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ============================================================================
+ * Delta Encoding
+ * ========================================================================== */
+
+/*
+ * A delta is a sequence of (skip, count, bytes[count]) tokens with LEB128
+ * lengths: skip bytes are equal, then count bytes are XORed in. Equal runs
+ * shorter than DELTA_MIN_SKIP stay inside the literal, where they are
+ * cheaper than a new token.
+ */
+#define DELTA_MIN_SKIP 4
+
+static uint8_t* put_varint(uint8_t* out, size_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+static const uint8_t* get_varint(const uint8_t* in, size_t* value) {
+    size_t result = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = *in++;
+        result |= (size_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    *value = result;
+    return in;
+}
+
+static inline bool words_equal(const uint8_t* a, const uint8_t* b) {
+    uint64_t x, y;
+    memcpy(&x, a, 8);
+    memcpy(&y, b, 8);
+    return x == y;
+}
+
+/**
+ * @brief Encode b relative to a (n bytes each)
+ * @return Bytes written to out, at most 2 * n + 16
+ */
+static size_t delta_encode(const uint8_t* a, const uint8_t* b, size_t n, uint8_t* out) {
+    uint8_t* start = out;
+    size_t i = 0;
+    while (i < n) {
+        size_t skip_start = i;
+        while (i + 8 <= n && words_equal(a + i, b + i)) i += 8;
+        while (i < n && a[i] == b[i]) i++;
+
+        size_t literal_start = i, end = i;
+        while (end < n) {
+            if (a[end] != b[end]) { end++; continue; }
+            size_t run = end;
+            while (run < n && a[run] == b[run] && run - end < DELTA_MIN_SKIP) run++;
+            if (run == n || run - end >= DELTA_MIN_SKIP) break;
+            end = run;
+        }
+
+        out = put_varint(out, literal_start - skip_start);
+        out = put_varint(out, end - literal_start);
+        for (size_t k = literal_start; k < end; k++) *out++ = a[k] ^ b[k];
+        i = end;
+    }
+    return (size_t)(out - start);
+}
+
+/**
+ * @brief XOR an encoded delta of n bytes into a
+ * @return The first byte after the delta
+ */
+static const uint8_t* delta_apply(uint8_t* a, size_t n, const uint8_t* in) {
+    size_t i = 0;
+    while (i < n) {
+        size_t skip, count;
+        in = get_varint(in, &skip);
+        in = get_varint(in, &count);
+        i += skip;
+        for (size_t k = 0; k < count; k++) a[i++] ^= *in++;
+    }
+    return in;
+}
+
+/* ============================================================================
+ * Rewind Buffer
+ * ========================================================================== */
+
+typedef struct {
+    size_t offset;
+    size_t size;
+} RewindEntry;
+
+struct GBRewind {
+    uint32_t interval;
+    uint32_t since;         /* Frames run since the newest record */
+
+    GBSnapshot* capture;    /* Incrementally updated snapshot of the context */
+    size_t state_size;
+    uint8_t* head;          /* Newest record in full: state, then shades */
+    bool has_head;
+    uint8_t* scratch;       /* Encoder output */
+
+    /* Deltas from each record to its predecessor, oldest first; the
+     * region ahead of the write position holds the oldest entries */
+    uint8_t* ring;
+    size_t ring_size;
+    size_t write;
+    size_t used;
+    RewindEntry* entries;   /* Circular: count entries starting at first */
+    size_t entry_cap;
+    size_t first;
+    size_t count;
+};
+
+GBRewind* gb_rewind_create(const GBContext* ctx, uint32_t interval, size_t budget) {
+    GBRewind* rw = (GBRewind*)calloc(1, sizeof(GBRewind));
+    if (!rw) return NULL;
+    rw->interval = interval ? interval : GB_REWIND_DEFAULT_INTERVAL;
+    rw->ring_size = budget ? budget : GB_REWIND_DEFAULT_BUDGET;
+    rw->capture = gb_snapshot_create(ctx);
+    if (rw->capture) gb_snapshot_data(rw->capture, &rw->state_size);
+
+    size_t record_size = rw->state_size + GB_FRAMEBUFFER_SIZE;
+    rw->entry_cap = 256;
+    rw->head = (uint8_t*)malloc(record_size);
+    rw->scratch = (uint8_t*)malloc(2 * record_size + 32);
+    rw->ring = (uint8_t*)malloc(rw->ring_size);
+    rw->entries = (RewindEntry*)malloc(rw->entry_cap * sizeof(RewindEntry));
+    if (!rw->capture || !rw->head || !rw->scratch || !rw->ring || !rw->entries) {
+        gb_rewind_destroy(rw);
+        return NULL;
+    }
+    return rw;
+}
+
+void gb_rewind_destroy(GBRewind* rw) {
+    if (!rw) return;
+    gb_snapshot_destroy(rw->capture);
+    free(rw->head);
+    free(rw->scratch);
+    free(rw->ring);
+    free(rw->entries);
+    free(rw);
+}
+
+void gb_rewind_attach(GBContext* ctx, GBRewind* rw) {
+    ctx->rewind = rw;
+}
+
+void gb_rewind_clear(GBRewind* rw) {
+    rw->has_head = false;
+    rw->since = 0;
+    rw->write = 0;
+    rw->used = 0;
+    rw->first = 0;
+    rw->count = 0;
+}
+
+size_t gb_rewind_count(const GBRewind* rw) {
+    return rw->has_head ? rw->count + 1 : 0;
+}
+
+size_t gb_rewind_memory(const GBRewind* rw) {
+    return rw->used;
+}
+
+static void drop_oldest(GBRewind* rw) {
+    rw->used -= rw->entries[rw->first].size;
+    rw->first = (rw->first + 1) % rw->entry_cap;
+    rw->count--;
+}
+
+static const RewindEntry* oldest(const GBRewind* rw) {
+    return &rw->entries[rw->first];
+}
+
+static bool push_delta(GBRewind* rw, const uint8_t* data, size_t size) {
+    if (size > rw->ring_size) {
+        /* The chain back from the new head is broken */
+        gb_rewind_clear(rw);
+        return true;
+    }
+    if (rw->write + size > rw->ring_size) {
+        while (rw->count && oldest(rw)->offset >= rw->write) drop_oldest(rw);
+        rw->write = 0;
+    }
+    while (rw->count && oldest(rw)->offset >= rw->write && oldest(rw)->offset < rw->write + size) {
+        drop_oldest(rw);
+    }
+
+    if (rw->count == rw->entry_cap) {
+        RewindEntry* grown = (RewindEntry*)malloc(rw->entry_cap * 2 * sizeof(RewindEntry));
+        if (!grown) return false;
+        for (size_t i = 0; i < rw->count; i++) {
+            grown[i] = rw->entries[(rw->first + i) % rw->entry_cap];
+        }
+        free(rw->entries);
+        rw->entries = grown;
+        rw->entry_cap *= 2;
+        rw->first = 0;
+    }
+
+    RewindEntry* entry = &rw->entries[(rw->first + rw->count) % rw->entry_cap];
+    entry->offset = rw->write;
+    entry->size = size;
+    rw->count++;
+    memcpy(rw->ring + rw->write, data, size);
+    rw->write += size;
+    rw->used += size;
+    return true;
+}
+
+void gb_rewind_record(GBRewind* rw, GBContext* ctx) {
+    if (rw->has_head && ++rw->since < rw->interval) return;
+
+    gb_snapshot_take(ctx, rw->capture);
+    size_t size;
+    const uint8_t* state = (const uint8_t*)gb_snapshot_data(rw->capture, &size);
+    const uint8_t* shades = gb_get_shades(ctx);
+
+    if (rw->has_head) {
+        size_t n = delta_encode(state, rw->head, rw->state_size, rw->scratch);
+        n += delta_encode(shades, rw->head + rw->state_size, GB_FRAMEBUFFER_SIZE, rw->scratch + n);
+        if (!push_delta(rw, rw->scratch, n)) gb_rewind_clear(rw);
+    }
+    memcpy(rw->head, state, rw->state_size);
+    memcpy(rw->head + rw->state_size, shades, GB_FRAMEBUFFER_SIZE);
+    rw->has_head = true;
+    rw->since = 0;
+}
+
+bool gb_rewind_step(GBRewind* rw, GBContext* ctx) {
+    if (!rw->has_head) return false;
+    if (rw->since == 0) {
+        if (rw->count == 0) return false;
+        /* Turn the head back into its predecessor and free the delta */
+        const RewindEntry* newest = &rw->entries[(rw->first + rw->count - 1) % rw->entry_cap];
+        const uint8_t* delta = rw->ring + newest->offset;
+        delta = delta_apply(rw->head, rw->state_size, delta);
+        delta_apply(rw->head + rw->state_size, GB_FRAMEBUFFER_SIZE, delta);
+        rw->write = newest->offset;
+        rw->used -= newest->size;
+        rw->count--;
+    }
+    rw->since = 0;
+
+    gb_state_load(ctx, rw->head, rw->state_size);
+    GBPPU* ppu = (GBPPU*)ctx->ppu;
+    memcpy(ppu->framebuffer, rw->head + rw->state_size, GB_FRAMEBUFFER_SIZE);
+    ppu->skip_render = false;
+    ppu_redraw(ppu);
+    return true;
+}
@@ -0,0 +1,245 @@
+/**
+ * @file state.c
+ * @brief Save state serialization and incremental snapshots
+ */
+
+#include "state.h"
+#include "ppu.h"
+#include "audio.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ============================================================================
+ * Blob Layout
+ * ========================================================================== */
+
+#define STATE_MAGIC 0x54534247u  /* "GBST" */
+
+#define STATE_PAGE      0x100
+#define STATE_IO_SIZE   0x81     /* 0xFF00-0xFF7F plus IE */
+#define STATE_HRAM_SIZE 0x7F
+
+/* CPU, timer and scheduler state: the head of GBContext up to the host
+ * pointers. Frontend settings in that range are kept from the live context. */
+#define STATE_CPU_SIZE offsetof(GBContext, rom)
+
+/* PPU registers and mode state; the caches and framebuffers behind them
+ * are rebuilt or redrawn */
+#define STATE_PPU_SIZE offsetof(GBPPU, bg_line)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t cpu_size;
+    uint32_t ppu_size;
+    uint32_t apu_size;
+    uint32_t eram_size;
+} StateHeader;
+
+/* WRAM and VRAM come last, in the page order of ctx->state_dirty */
+typedef struct {
+    size_t cpu, ppu, apu, io, hram, oam, eram, pages, total;
+} StateLayout;
+
+static void state_layout(const GBContext* ctx, StateLayout* layout) {
+    size_t offset = sizeof(StateHeader);
+    layout->cpu = offset;   offset += STATE_CPU_SIZE + 1;  /* + last_joypad */
+    layout->ppu = offset;   offset += STATE_PPU_SIZE;
+    layout->apu = offset;   offset += gb_audio_state_size();
+    layout->io = offset;    offset += STATE_IO_SIZE;
+    layout->hram = offset;  offset += STATE_HRAM_SIZE;
+    layout->oam = offset;   offset += OAM_SIZE;
+    layout->eram = offset;  offset += ctx->eram ? ctx->eram_size : 0;
+    layout->pages = offset; offset += (size_t)GB_STATE_PAGES * STATE_PAGE;
+    layout->total = offset;
+}
+
+static inline uint8_t* state_page(GBContext* ctx, int page) {
+    return page < GB_STATE_WRAM_PAGES
+        ? ctx->wram + page * STATE_PAGE
+        : ctx->vram + (page - GB_STATE_WRAM_PAGES) * STATE_PAGE;
+}
+
+/**
+ * @brief Write everything but the RAM pages
+ */
+static void state_store_fixed(const GBContext* ctx, uint8_t* out, const StateLayout* layout) {
+    StateHeader header = {
+        .magic = STATE_MAGIC,
+        .version = GB_STATE_VERSION,
+        .header_size = sizeof(StateHeader),
+        .cpu_size = (uint32_t)STATE_CPU_SIZE,
+        .ppu_size = (uint32_t)STATE_PPU_SIZE,
+        .apu_size = (uint32_t)gb_audio_state_size(),
+        .eram_size = ctx->eram ? (uint32_t)ctx->eram_size : 0,
+    };
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + layout->cpu, ctx, STATE_CPU_SIZE);
+    out[layout->cpu + STATE_CPU_SIZE] = ctx->last_joypad;
+    memcpy(out + layout->ppu, ctx->ppu, STATE_PPU_SIZE);
+    gb_audio_save_state(ctx->apu, out + layout->apu);
+    memcpy(out + layout->io, ctx->io, STATE_IO_SIZE);
+    memcpy(out + layout->hram, ctx->hram, STATE_HRAM_SIZE);
+    memcpy(out + layout->oam, ctx->oam, OAM_SIZE);
+    if (ctx->eram) memcpy(out + layout->eram, ctx->eram, ctx->eram_size);
+}
+
+/**
+ * @brief Read everything but the RAM pages, keeping host-side settings
+ */
+static void state_load_fixed(GBContext* ctx, const uint8_t* in, const StateLayout* layout) {
+    uint8_t turbo = ctx->turbo, frame_skip = ctx->frame_skip, audio_muted = ctx->audio_muted;
+    uint8_t native_depth = ctx->native_depth;
+    memcpy(ctx, in + layout->cpu, STATE_CPU_SIZE);
+    ctx->turbo = turbo;
+    ctx->frame_skip = frame_skip;
+    ctx->audio_muted = audio_muted;
+    ctx->native_depth = native_depth;
+    ctx->last_joypad = in[layout->cpu + STATE_CPU_SIZE];
+
+    GBPPU* ppu = (GBPPU*)ctx->ppu;
+    memcpy(ppu, in + layout->ppu, STATE_PPU_SIZE);
+    ppu->oam_dirty = true;
+    gb_audio_load_state(ctx->apu, in + layout->apu);
+    memcpy(ctx->io, in + layout->io, STATE_IO_SIZE);
+    memcpy(ctx->hram, in + layout->hram, STATE_HRAM_SIZE);
+    memcpy(ctx->oam, in + layout->oam, OAM_SIZE);
+    if (ctx->eram) memcpy(ctx->eram, in + layout->eram, ctx->eram_size);
+}
+
+static bool state_check(const GBContext* ctx, const void* data, size_t size, StateLayout* layout) {
+    state_layout(ctx, layout);
+    if (size < layout->total) return false;
+    StateHeader header;
+    memcpy(&header, data, sizeof(header));
+    return header.magic == STATE_MAGIC &&
+           header.version == GB_STATE_VERSION &&
+           header.header_size == sizeof(StateHeader) &&
+           header.cpu_size == STATE_CPU_SIZE &&
+           header.ppu_size == STATE_PPU_SIZE &&
+           header.apu_size == gb_audio_state_size() &&
+           header.eram_size == (ctx->eram ? ctx->eram_size : 0);
+}
+
+/* ============================================================================
+ * Save States
+ * ========================================================================== */
+
+size_t gb_state_size(const GBContext* ctx) {
+    StateLayout layout;
+    state_layout(ctx, &layout);
+    return layout.total;
+}
+
+size_t gb_state_save(const GBContext* ctx, void* out, size_t size) {
+    StateLayout layout;
+    state_layout(ctx, &layout);
+    if (size < layout.total) return 0;
+    uint8_t* bytes = (uint8_t*)out;
+    state_store_fixed(ctx, bytes, &layout);
+    memcpy(bytes + layout.pages, ctx->wram, (size_t)GB_STATE_WRAM_PAGES * STATE_PAGE);
+    memcpy(bytes + layout.pages + (size_t)GB_STATE_WRAM_PAGES * STATE_PAGE,
+           ctx->vram, (size_t)GB_STATE_VRAM_PAGES * STATE_PAGE);
+    return layout.total;
+}
+
+bool gb_state_load(GBContext* ctx, const void* data, size_t size) {
+    StateLayout layout;
+    if (!state_check(ctx, data, size, &layout)) return false;
+    const uint8_t* bytes = (const uint8_t*)data;
+    gb_code_flush(ctx);
+    state_load_fixed(ctx, bytes, &layout);
+    memcpy(ctx->wram, bytes + layout.pages, (size_t)GB_STATE_WRAM_PAGES * STATE_PAGE);
+    memcpy(ctx->vram, bytes + layout.pages + (size_t)GB_STATE_WRAM_PAGES * STATE_PAGE,
+           (size_t)GB_STATE_VRAM_PAGES * STATE_PAGE);
+    ppu_invalidate_tiles((GBPPU*)ctx->ppu);
+
+    /* Memory no longer matches any snapshot; leave every page writable
+     * until the next full take */
+    ctx->state_base = 0;
+    memset(ctx->state_dirty, 1, sizeof(ctx->state_dirty));
+    gb_update_memory_map(ctx);
+    return true;
+}
+
+/* ============================================================================
+ * Snapshots
+ * ========================================================================== */
+
+struct GBSnapshot {
+    uint32_t id;        /* Changes with every take, 0 = empty */
+    StateLayout layout;
+    uint8_t data[];
+};
+
+/* Ids are unique across contexts, so a context only trusts its dirty pages
+ * against the exact snapshot contents it last synced with */
+static atomic_uint g_snapshot_ids;
+
+static uint32_t snapshot_next_id(void) {
+    uint32_t id;
+    do {
+        id = atomic_fetch_add_explicit(&g_snapshot_ids, 1, memory_order_relaxed) + 1;
+    } while (id == 0);
+    return id;
+}
+
+GBSnapshot* gb_snapshot_create(const GBContext* ctx) {
+    StateLayout layout;
+    state_layout(ctx, &layout);
+    GBSnapshot* snap = (GBSnapshot*)calloc(1, sizeof(GBSnapshot) + layout.total);
+    if (!snap) return NULL;
+    snap->layout = layout;
+    return snap;
+}
+
+void gb_snapshot_destroy(GBSnapshot* snap) {
+    free(snap);
+}
+
+/**
+ * @brief Mark the context as matching the snapshot and protect clean WRAM
+ */
+static void snapshot_sync(GBContext* ctx, const GBSnapshot* snap) {
+    ctx->state_base = snap->id;
+    ctx->state_tracking = true;
+    memset(ctx->state_dirty, 0, sizeof(ctx->state_dirty));
+    gb_update_memory_map(ctx);
+}
+
+void gb_snapshot_take(GBContext* ctx, GBSnapshot* snap) {
+    bool full = snap->id == 0 || ctx->state_base != snap->id;
+    state_store_fixed(ctx, snap->data, &snap->layout);
+    uint8_t* pages = snap->data + snap->layout.pages;
+    for (int p = 0; p < GB_STATE_PAGES; p++) {
+        if (full || ctx->state_dirty[p]) {
+            memcpy(pages + (size_t)p * STATE_PAGE, state_page(ctx, p), STATE_PAGE);
+        }
+    }
+    snap->id = snapshot_next_id();
+    snapshot_sync(ctx, snap);
+}
+
+void gb_snapshot_restore(GBContext* ctx, GBSnapshot* snap) {
+    if (snap->id == 0) return;
+    bool full = ctx->state_base != snap->id;
+    gb_code_flush(ctx);
+    state_load_fixed(ctx, snap->data, &snap->layout);
+    const uint8_t* pages = snap->data + snap->layout.pages;
+    GBPPU* ppu = (GBPPU*)ctx->ppu;
+    for (int p = 0; p < GB_STATE_PAGES; p++) {
+        if (!full && !ctx->state_dirty[p]) continue;
+        memcpy(state_page(ctx, p), pages + (size_t)p * STATE_PAGE, STATE_PAGE);
+        if (p >= GB_STATE_WRAM_PAGES) {
+            ppu_invalidate_vram(ppu, (uint32_t)(p - GB_STATE_WRAM_PAGES) * STATE_PAGE, STATE_PAGE);
+        }
+    }
+    snapshot_sync(ctx, snap);
+}
+
+const void* gb_snapshot_data(const GBSnapshot* snap, size_t* size) {
+    *size = snap->layout.total;
+    return snap->data;
+}